@@ -41,6 +41,7 @@ public:
 	apvts::stage1OnId,
 	apvts::stage1InputGainId,
 	apvts::stage1WaveShaperId,
+	apvts::stage1AntialiasingId,
 	apvts::stage1OutputGainId,
 	apvts::stage1DryWetId,
 },
@@ -48,6 +49,7 @@ public:
 	apvts::stage2OnId,
 	apvts::stage2InputGainId,
 	apvts::stage2WaveShaperId,
+	apvts::stage2AntialiasingId,
 	apvts::stage2OutputGainId,
 	apvts::stage2DryWetId,
 },
@@ -55,6 +57,7 @@ public:
 	apvts::stage3OnId,
 	apvts::stage3InputGainId,
 	apvts::stage3WaveShaperId,
+	apvts::stage3AntialiasingId,
 	apvts::stage3OutputGainId,
 	apvts::stage3DryWetId,
 },
@@ -62,6 +65,7 @@ public:
 	apvts::stage4OnId,
 	apvts::stage4InputGainId,
 	apvts::stage4WaveShaperId,
+	apvts::stage4AntialiasingId,
 	apvts::stage4OutputGainId,
 	apvts::stage4DryWetId,
 },
@@ -74,6 +78,8 @@ public:
 },
 {
 	apvts::biasId,
+	apvts::oversamplingFactorId,
+	apvts::effectReleaseDelayId,
 }
 		};
 
@@ -113,6 +119,34 @@ public:
 					));
 					mContainerPtr->addAndMakeVisible(comboBox);
 				}
+				else if (PluginUtils::isAntialiasingId(parameterId))
+				{
+					auto* comboBox = new juce::ComboBox(PluginUtils::toTitleCase(parameterId));
+					for (int antialiasingIndex = 0; antialiasingIndex < apvts::antialiasingIds.size(); antialiasingIndex++) {
+						comboBox->addItem(apvts::antialiasingIds.at(antialiasingIndex), antialiasingIndex + 1);
+					}
+					mComponentRows[row]->add(comboBox);
+					mComboBoxAttachments.add(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(
+						mAudioProcessorValueTreeState,
+						parameterId,
+						*comboBox
+					));
+					mContainerPtr->addAndMakeVisible(comboBox);
+				}
+				else if (parameterId == apvts::oversamplingFactorId)
+				{
+					auto* comboBox = new juce::ComboBox(PluginUtils::toTitleCase(parameterId));
+					for (int factorIndex = 0; factorIndex < apvts::oversamplingFactorNames.size(); factorIndex++) {
+						comboBox->addItem(apvts::oversamplingFactorNames.at(factorIndex), factorIndex + 1);
+					}
+					mComponentRows[row]->add(comboBox);
+					mComboBoxAttachments.add(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(
+						mAudioProcessorValueTreeState,
+						parameterId,
+						*comboBox
+					));
+					mContainerPtr->addAndMakeVisible(comboBox);
+				}
 				else
 				{
 					auto* slider = new juce::Slider(juce::Slider::RotaryVerticalDrag, juce::Slider::TextBoxBelow);
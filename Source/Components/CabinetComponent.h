@@ -28,7 +28,7 @@ class CabinetComponent : public juce::Component, private juce::Button::Listener,
 public:
     CabinetComponent(
                      juce::AudioProcessorValueTreeState& audioProcessorValueTreeState,
-                     std::function<void()> onClickedSelectFile
+                     std::function<void(const std::string&)> onClickedSelectFile
                      ) :
     mAudioProcessorValueTreeState(audioProcessorValueTreeState),
     mImpulseResponseFileLabelPtr(std::make_unique<juce::Label>()),
@@ -65,9 +65,37 @@ public:
 	apvts::cabinetImpulseResponseConvolutionIndexId,
 	apvts::cabinetImpulseResponseConvolutionFileId,
 	apvts::cabinetGainId
+},
+{
+	apvts::cabinetTrimThresholdId,
+	apvts::cabinetMinimumPhaseOnId,
+	apvts::cabinetQualityId
+},
+{
+	apvts::cabinetMicrophone2OnId,
+	apvts::cabinetMicrophone2IndexId,
+	apvts::cabinetMicrophone2FileId,
+	apvts::cabinetMicrophone2LevelId,
+	apvts::cabinetMicrophone2InvertOnId,
+	apvts::cabinetMicrophone2DelayId
+},
+{
+	apvts::cabinetMicrophone3OnId,
+	apvts::cabinetMicrophone3IndexId,
+	apvts::cabinetMicrophone3FileId,
+	apvts::cabinetMicrophone3LevelId,
+	apvts::cabinetMicrophone3InvertOnId,
+	apvts::cabinetMicrophone3DelayId
 }
 		};
 
+		// The state property each file button sets.
+		static const std::map<std::string, std::string> fileFullPathNameIds = {
+			{apvts::cabinetImpulseResponseConvolutionFileId, apvts::impulseResponseFileFullPathNameId},
+			{apvts::cabinetMicrophone2FileId, apvts::cabinetMicrophone2FileFullPathNameId},
+			{apvts::cabinetMicrophone3FileId, apvts::cabinetMicrophone3FileFullPathNameId}
+		};
+
 		for (int row = 0; row < apvtsIdRows.size(); ++row)
 		{
 			const auto& colIds = apvtsIdRows[row];
@@ -91,15 +119,19 @@ public:
 					));
 					mContainerPtr->addAndMakeVisible(button);
 				}
-				else if (parameterId == apvts::cabinetImpulseResponseConvolutionFileId)
+				else if (fileFullPathNameIds.count(parameterId) > 0)
 				{
+					const auto& fileFullPathNameId = fileFullPathNameIds.at(parameterId);
 					auto* selectFileButton = new juce::TextButton();
-					selectFileButton->setButtonText("Select IR File");
+					mFileFullPathNameIds[selectFileButton] = fileFullPathNameId;
+					updateSelectFileButton(selectFileButton);
 					addAndMakeVisible(selectFileButton);
 					selectFileButton->addListener(this);
 					mComponentRows[row]->add(selectFileButton);
 				}
-				else if (parameterId == apvts::cabinetImpulseResponseConvolutionIndexId)
+				else if (parameterId == apvts::cabinetImpulseResponseConvolutionIndexId
+					|| parameterId == apvts::cabinetMicrophone2IndexId
+					|| parameterId == apvts::cabinetMicrophone3IndexId)
 				{
 					auto* comboBox = new juce::ComboBox(PluginUtils::toTitleCase(parameterId));
 					for (int cabIndex = 0; cabIndex < apvts::cabIds.size(); cabIndex++) {
@@ -113,6 +145,20 @@ public:
 					));
 					mContainerPtr->addAndMakeVisible(comboBox);
 				}
+				else if (parameterId == apvts::cabinetQualityId)
+				{
+					auto* comboBox = new juce::ComboBox(PluginUtils::toTitleCase(parameterId));
+					for (int qualityIndex = 0; qualityIndex < apvts::cabinetQualityNames.size(); qualityIndex++) {
+						comboBox->addItem(PluginUtils::toTitleCase(apvts::cabinetQualityNames.at(qualityIndex)), qualityIndex + 1);
+					}
+					mComponentRows[row]->add(comboBox);
+					mComboBoxAttachments.add(new juce::AudioProcessorValueTreeState::ComboBoxAttachment(
+						mAudioProcessorValueTreeState,
+						parameterId,
+						*comboBox
+					));
+					mContainerPtr->addAndMakeVisible(comboBox);
+				}
 				else
 				{
 					auto* slider = new juce::Slider(juce::Slider::RotaryVerticalDrag, juce::Slider::TextBoxBelow);
@@ -191,12 +237,20 @@ public:
 		// Call the provided file selection function
 		if (mOnClickedSelectFile)
 		{
-			mOnClickedSelectFile();
+			mOnClickedSelectFile(mFileFullPathNameIds.at(button));
 		}
 	}
 
 	void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override
 	{
+		for (const auto& [button, fileFullPathNameId] : mFileFullPathNameIds)
+		{
+			if (property == juce::Identifier(fileFullPathNameId))
+			{
+				updateSelectFileButton(button);
+			}
+		}
+
 		if (property == juce::Identifier(apvts::impulseResponseFileFullPathNameId))
 		{
 			juce::String newFilePath = treeWhosePropertyHasChanged.getProperty(property).toString();
@@ -236,11 +290,24 @@ private:
 
 	juce::OwnedArray<juce::OwnedArray<juce::Component>> mComponentRows;
 
-	std::function<void()> mOnClickedSelectFile;
+	std::function<void(const std::string&)> mOnClickedSelectFile;
+	std::map<juce::Button*, std::string> mFileFullPathNameIds;
 
 	juce::OwnedArray<juce::AudioProcessorValueTreeState::ButtonAttachment> mButtonAttachments;
 	juce::OwnedArray<juce::AudioProcessorValueTreeState::SliderAttachment> mSliderAttachments;
 	juce::OwnedArray<juce::AudioProcessorValueTreeState::ComboBoxAttachment> mComboBoxAttachments;
 
+	// Names the file the button has loaded, if any.
+	void updateSelectFileButton(juce::Button* button)
+	{
+		const auto fullPathName = mAudioProcessorValueTreeState.state.getProperty(
+			juce::String(mFileFullPathNameIds.at(button)),
+			juce::String()).toString();
+
+		button->setButtonText(fullPathName.isNotEmpty()
+			? juce::File(fullPathName).getFileName()
+			: juce::String("Select IR File"));
+	}
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CabinetComponent)
 };
@@ -0,0 +1,131 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../PluginAudioProcessor.h"
+#include "../PluginAudioParameters.h"
+
+// Lists the pedals and the amplifier in processing order and lets each be moved
+// one place earlier or later in the chain.
+class ChainComponent : public juce::Component, juce::ValueTree::Listener
+{
+public:
+	explicit ChainComponent(PluginAudioProcessor& processorRef) :
+		mProcessorRef(processorRef),
+		mState(processorRef.getAudioProcessorValueTreeState().state)
+	{
+		const auto numRows = mProcessorRef.getEffectChain().getOrder().size();
+
+		for (int rowIndex = 0; rowIndex < numRows; ++rowIndex)
+		{
+			auto row = std::make_unique<Row>();
+
+			addAndMakeVisible(row->label);
+
+			row->earlierButton.setButtonText("Earlier");
+			row->earlierButton.setMouseCursor(juce::MouseCursor::PointingHandCursor);
+			row->earlierButton.onClick = [this, rowIndex]() { moveStage(rowIndex, rowIndex - 1); };
+			addAndMakeVisible(row->earlierButton);
+
+			row->laterButton.setButtonText("Later");
+			row->laterButton.setMouseCursor(juce::MouseCursor::PointingHandCursor);
+			row->laterButton.onClick = [this, rowIndex]() { moveStage(rowIndex, rowIndex + 1); };
+			addAndMakeVisible(row->laterButton);
+
+			mRows.push_back(std::move(row));
+		}
+
+		mState.addListener(this);
+		updateRows();
+	}
+
+	~ChainComponent() override
+	{
+		mState.removeListener(this);
+	}
+
+	void resized() override
+	{
+		auto bounds = getLocalBounds().reduced(8);
+
+		for (auto& row : mRows)
+		{
+			auto rowBounds = bounds.removeFromTop(rowHeight);
+			row->laterButton.setBounds(rowBounds.removeFromRight(buttonWidth).reduced(2));
+			row->earlierButton.setBounds(rowBounds.removeFromRight(buttonWidth).reduced(2));
+			row->label.setBounds(rowBounds);
+		}
+	}
+
+private:
+	static constexpr int rowHeight = 32;
+	static constexpr int buttonWidth = 80;
+
+	struct Row
+	{
+		juce::Label label;
+		juce::TextButton earlierButton;
+		juce::TextButton laterButton;
+	};
+
+	PluginAudioProcessor& mProcessorRef;
+	juce::ValueTree& mState;
+	std::vector<std::unique_ptr<Row>> mRows;
+
+	void moveStage(int currentIndex, int newIndex)
+	{
+		auto order = mProcessorRef.getEffectChain().getOrder();
+
+		if (juce::isPositiveAndBelow(newIndex, order.size()))
+		{
+			order.move(currentIndex, newIndex);
+			mProcessorRef.setChainOrder(order);
+		}
+	}
+
+	void updateRows()
+	{
+		const auto& effectChain = mProcessorRef.getEffectChain();
+		const auto order = effectChain.getOrder();
+
+		for (int rowIndex = 0; rowIndex < static_cast<int>(mRows.size()); ++rowIndex)
+		{
+			auto& row = *mRows[rowIndex];
+			row.label.setText(juce::String(rowIndex + 1) + ". " + effectChain.getName(order[rowIndex]), juce::dontSendNotification);
+			row.earlierButton.setEnabled(rowIndex > 0);
+			row.laterButton.setEnabled(rowIndex < order.size() - 1);
+		}
+	}
+
+	void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override
+	{
+		if (property == juce::Identifier(apvts::chainOrderId))
+		{
+			updateRows();
+		}
+	}
+
+	void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override
+	{
+		updateRows();
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChainComponent)
+};
@@ -35,8 +35,10 @@ public:
         const std::string& delayLowPassFrequencyParameterId,
         const std::string& delayFeedbackParameterId,
         const std::string& delayDryWetParameterId,
+        const std::string& delayCrossFeedParameterId,
         const std::string& delayIsSyncedParameterId,
         const std::string& delayIsLinkedParameterId,
+        const std::string& delayPingPongParameterId,
         const std::string& toggleParameterId) noexcept :
         mApvts(apvts)
     {
@@ -169,6 +171,21 @@ public:
         addAndMakeVisible(mDryWetLabelPtr.get());
         // End delayDryWetParameterId
 
+        // Start delayCrossFeedParameterId
+        mCrossFeedSliderPtr = std::make_unique<juce::Slider>(juce::Slider::RotaryVerticalDrag, juce::Slider::TextBoxBelow);
+        mCrossFeedSliderPtr->setScrollWheelEnabled(false);
+
+        mCrossFeedAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+            apvts, delayCrossFeedParameterId, *mCrossFeedSliderPtr);
+
+        mCrossFeedLabelPtr = std::make_unique<juce::Label>();
+        mCrossFeedLabelPtr->setText("Cross-feed", juce::dontSendNotification);
+        mCrossFeedLabelPtr->attachToComponent(mCrossFeedSliderPtr.get(), false);
+
+        addAndMakeVisible(mCrossFeedSliderPtr.get());
+        addAndMakeVisible(mCrossFeedLabelPtr.get());
+        // End delayCrossFeedParameterId
+
         mGroupComponentPtr.reset(new juce::GroupComponent(title, title));
         addAndMakeVisible(mGroupComponentPtr.get());
 
@@ -191,6 +208,12 @@ public:
         apvts.addParameterListener(mDelayIsLinkedParameterId, this);
         parameterChanged(mDelayIsLinkedParameterId, *apvts.getRawParameterValue(mDelayIsLinkedParameterId));
 
+        // Ping-pong Button
+        mPingPongButtonPtr = std::make_unique<juce::ToggleButton>("Ping-pong");
+        mPingPongButtonAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+            apvts, delayPingPongParameterId, *mPingPongButtonPtr);
+        addAndMakeVisible(mPingPongButtonPtr.get());
+
         // Toggle Button
         mToggleButtonPtr = std::make_unique<juce::ToggleButton>();
         mToggleButtonAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
@@ -234,6 +257,7 @@ public:
         mLowPassFrequencySliderPtr.reset();
         mFeedbackSliderPtr.reset();
         mDryWetSliderPtr.reset();
+        mCrossFeedSliderPtr.reset();
 
         // Reset labels
         mLeftPerBeatLabelPtr.reset();
@@ -244,6 +268,7 @@ public:
         mLowPassFrequencyLabelPtr.reset();
         mFeedbackLabelPtr.reset();
         mDryWetLabelPtr.reset();
+        mCrossFeedLabelPtr.reset();
 
         // Reset attachments
         mLeftPerBeatAttachmentPtr.reset();
@@ -254,8 +279,10 @@ public:
         mLowPassFrequencyAttachmentPtr.reset();
         mFeedbackAttachmentPtr.reset();
         mDryWetAttachmentPtr.reset();
+        mCrossFeedAttachmentPtr.reset();
         mSyncButtonAttachmentPtr.reset();
         mLinkedButtonAttachmentPtr.reset();
+        mPingPongButtonAttachmentPtr.reset();
 
         // Reset any additional controls not previously mentioned
         mToggleButtonPtr.reset();
@@ -264,6 +291,7 @@ public:
 
         mSyncButtonPtr.reset();
         mLinkedButtonPtr.reset();
+        mPingPongButtonPtr.reset();
     }
 
     void resized() override
@@ -288,6 +316,7 @@ public:
 
         row1FlexBox.items.add(juce::FlexItem(*mSyncButtonPtr).withFlex(0.5).withMaxHeight(44));
         row1FlexBox.items.add(juce::FlexItem(*mLinkedButtonPtr).withFlex(0.5).withMaxHeight(44));
+        row1FlexBox.items.add(juce::FlexItem(*mPingPongButtonPtr).withFlex(0.5).withMaxHeight(44));
         mainFlexBox.items.add(juce::FlexItem(row1FlexBox).withFlex(0.5));
 
         juce::FlexBox row2FlexBox;
@@ -334,6 +363,7 @@ public:
         row3FlexBox.flexWrap = juce::FlexBox::Wrap::wrap;
 
         row3FlexBox.items.add(juce::FlexItem(*mDryWetSliderPtr).withFlex(1).withMaxHeight(128));
+        row3FlexBox.items.add(juce::FlexItem(*mCrossFeedSliderPtr).withFlex(1).withMaxHeight(128));
         row3FlexBox.items.add(juce::FlexItem(*mHighPassFrequencySliderPtr).withFlex(1).withMaxHeight(128));
         row3FlexBox.items.add(juce::FlexItem(*mLowPassFrequencySliderPtr).withFlex(1).withMaxHeight(128));
 
@@ -399,11 +429,18 @@ private:
     std::unique_ptr<juce::Label> mDryWetLabelPtr;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> mDryWetAttachmentPtr;
 
+    std::unique_ptr<juce::Slider> mCrossFeedSliderPtr;
+    std::unique_ptr<juce::Label> mCrossFeedLabelPtr;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> mCrossFeedAttachmentPtr;
+
     std::unique_ptr<juce::ToggleButton> mSyncButtonPtr;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mSyncButtonAttachmentPtr;
 
     std::unique_ptr<juce::ToggleButton> mLinkedButtonPtr;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mLinkedButtonAttachmentPtr;
+
+    std::unique_ptr<juce::ToggleButton> mPingPongButtonPtr;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mPingPongButtonAttachmentPtr;
     
     std::unique_ptr<juce::ToggleButton> mToggleButtonPtr;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mToggleButtonAttachmentPtr;
@@ -0,0 +1,149 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../PluginAudioProcessor.h"
+
+// Shows how much of the callback deadline each stage of processBlock uses,
+// heaviest first, over the last timer period.
+class DspLoadComponent : public juce::Component, private juce::Timer
+{
+public:
+	explicit DspLoadComponent(PluginAudioProcessor& processorRef) :
+		mStageProfiler(processorRef.getStageProfiler())
+	{
+		mStageProfiler.setEnabled(true);
+		mStageProfiler.takeSnapshot();
+		juce::Timer::startTimerHz(2);
+	}
+
+	~DspLoadComponent() override
+	{
+		juce::Timer::stopTimer();
+		mStageProfiler.setEnabled(false);
+	}
+
+	void paint(juce::Graphics& g) override
+	{
+		auto bounds = getLocalBounds().reduced(4);
+		const auto textColour = getLookAndFeel().findColour(juce::Label::textColourId);
+
+		g.setColour(textColour);
+		g.setFont(juce::Font(rowHeight - 2.0f));
+		g.drawText(
+			"DSP load " + formatShare(mTotalRow.meanShare) + " (p99 " + formatShare(mTotalRow.percentile99Share) + ", max " + formatShare(mTotalRow.maximumShare) + ")",
+			bounds.removeFromTop(rowHeight),
+			juce::Justification::centredLeft);
+
+		for (const auto& row : mStageRows)
+		{
+			if (bounds.getHeight() < rowHeight)
+			{
+				break;
+			}
+
+			auto rowBounds = bounds.removeFromTop(rowHeight);
+			const auto nameBounds = rowBounds.removeFromLeft(rowBounds.getWidth() / 2);
+			const auto barBounds = rowBounds.reduced(2, 3).toFloat();
+
+			g.setColour(textColour);
+			g.drawText(row.name, nameBounds, juce::Justification::centredLeft);
+
+			g.setColour(textColour.withAlpha(0.2f));
+			g.fillRect(barBounds);
+
+			g.setColour(getColourForShare(row.percentile99Share));
+			g.fillRect(barBounds.withWidth(barBounds.getWidth() * static_cast<float>(juce::jmin(row.meanShare, 1.0))));
+
+			const auto percentile99X = barBounds.getX() + barBounds.getWidth() * static_cast<float>(juce::jmin(row.percentile99Share, 1.0));
+			g.drawVerticalLine(juce::roundToInt(percentile99X), barBounds.getY() - 2.0f, barBounds.getBottom() + 2.0f);
+		}
+	}
+
+private:
+	static constexpr int rowHeight = 14;
+
+	struct Row
+	{
+		juce::String name;
+		double meanShare = 0.0;
+		double percentile99Share = 0.0;
+		double maximumShare = 0.0;
+	};
+
+	StageProfiler& mStageProfiler;
+	Row mTotalRow;
+	std::vector<Row> mStageRows;
+
+	void timerCallback() override
+	{
+		const auto snapshot = mStageProfiler.takeSnapshot();
+		if (snapshot.deadlineSeconds <= 0.0)
+		{
+			return;
+		}
+
+		const auto makeRow = [&snapshot](ProfiledStage stage)
+		{
+			const auto& statistics = snapshot.stages[static_cast<size_t>(stage)];
+			return Row{
+				getProfiledStageName(stage),
+				statistics.meanSeconds / snapshot.deadlineSeconds,
+				statistics.percentile99Seconds / snapshot.deadlineSeconds,
+				statistics.maximumSeconds / snapshot.deadlineSeconds
+			};
+		};
+
+		mTotalRow = makeRow(ProfiledStage::total);
+		mStageRows.clear();
+
+		for (int stageIndex = 0; stageIndex < static_cast<int>(ProfiledStage::total); ++stageIndex)
+		{
+			if (snapshot.stages[stageIndex].numBlocks > 0)
+			{
+				mStageRows.push_back(makeRow(static_cast<ProfiledStage>(stageIndex)));
+			}
+		}
+
+		std::sort(mStageRows.begin(), mStageRows.end(), [](const Row& a, const Row& b)
+			{
+				return a.percentile99Share > b.percentile99Share;
+			});
+
+		repaint();
+	}
+
+	static juce::String formatShare(double share)
+	{
+		return juce::String(share * 100.0, 1) + "%";
+	}
+
+	static juce::Colour getColourForShare(double share)
+	{
+		if (share > 0.5)
+		{
+			return juce::Colours::red;
+		}
+
+		return share > 0.2 ? juce::Colours::orange : juce::Colours::green;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DspLoadComponent)
+};
@@ -42,7 +42,9 @@ public:
 
 		mContainerPtr->addAndMakeVisible(new TunerPedalComponent(
 			mAudioProcessor,
-			apvts::tunerOnId));
+			apvts::tunerOnId,
+			apvts::tunerMuteOnId,
+			apvts::tunerStrumOnId));
 
 		mContainerPtr->addAndMakeVisible(new PedalComponent(
 			mAudioProcessor.getAudioProcessorValueTreeState(),
@@ -104,8 +106,10 @@ public:
 			apvts::delayLowPassFrequencyId,
 			apvts::delayFeedbackId,
 			apvts::delayDryWetId,
+			apvts::delayCrossFeedId,
 			apvts::delayIsSyncedId,
 			apvts::delayLinkedId,
+			apvts::delayPingPongId,
 			apvts::delayOnId));
 
 		mContainerPtr->addAndMakeVisible(new PedalComponent(
@@ -116,6 +120,7 @@ public:
 				{ apvts::chorusDepthId, "Depth", "" },
 				{ apvts::chorusFrequencyId, "Frequency", "" },
 				{ apvts::chorusWidthId, "Width", "" },
+				{ apvts::chorusVoicesId, "Voices", "" },
 		},
 			apvts::chorusOnId));
 
@@ -127,6 +132,7 @@ public:
 				{ apvts::phaserWidthId, "Width", "" },
 				{ apvts::phaserFeedbackId, "Feedback", "" },
 				{ apvts::phaserFrequencyId, "Frequency", "" },
+				{ apvts::phaserStagesId, "Stages", "" },
 		},
 			apvts::phaserIsOnId));
 
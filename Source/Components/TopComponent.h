@@ -23,13 +23,15 @@
 #include "../PluginPresetManager.h"
 #include "../PluginAudioParameters.h"
 #include "../PluginUtils.h"
+#include "DspLoadComponent.h"
 
 class TopComponent : public juce::Component
 {
 public:
 	TopComponent(
 		PluginAudioProcessor& audioProcessor) :
-		mAudioProcessorValueTreeState(audioProcessor.getAudioProcessorValueTreeState())
+		mAudioProcessorValueTreeState(audioProcessor.getAudioProcessorValueTreeState()),
+		mDspLoadComponent(audioProcessor)
 	{
 		mViewportPtr = std::make_unique<juce::Viewport>();
 		mContainerPtr = std::make_unique<juce::Component>();
@@ -44,6 +46,8 @@ public:
 		mOutputLevelMeter.setMeterSource(&audioProcessor.getOutputMeterSource());
 		addAndMakeVisible(mOutputLevelMeter);
 
+		addAndMakeVisible(mDspLoadComponent);
+
 		addAndMakeVisible(mViewportPtr.get());
 		mViewportPtr->setViewedComponent(mContainerPtr.get(), false);
 
@@ -135,9 +139,11 @@ public:
 	void resized() override
 	{
 		const auto localBounds = getLocalBounds();
-		mViewportPtr->setBounds(localBounds);
-
 		const int levelMeterWidth = 30; // Arbitrary width for the level meters
+		const int dspLoadWidth = 240;
+
+		mViewportPtr->setBounds(localBounds.withTrimmedRight(dspLoadWidth + levelMeterWidth));
+		mDspLoadComponent.setBounds(localBounds.getWidth() - levelMeterWidth - dspLoadWidth, 0, dspLoadWidth, localBounds.getHeight());
 
 		// Place the input level meter on the very left, spanning the full height.
 		mInputLevelMeter.setBounds(0, 0, levelMeterWidth, localBounds.getHeight());
@@ -153,7 +159,7 @@ public:
 			}
 		}
 
-		int buttonWidth = (localBounds.getWidth() - levelMeterWidth) / numCols;
+		int buttonWidth = (mViewportPtr->getWidth() - levelMeterWidth) / numCols;
 		int buttonHeight = 125;
 
 		int totalHeight = ((buttonHeight + 12.5) * numRows);
@@ -186,5 +192,7 @@ private:
 	foleys::LevelMeter mInputLevelMeter{ foleys::LevelMeter::Minimal };
 	foleys::LevelMeter mOutputLevelMeter{ foleys::LevelMeter::Minimal };
 
+	DspLoadComponent mDspLoadComponent;
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TopComponent)
 };
@@ -27,7 +27,9 @@ public:
 
 	explicit TunerPedalComponent(
 		PluginAudioProcessor& processorRef,
-		const std::string& toggleOnParameterId) : mAudioProcessorRef(processorRef) 
+		const std::string& toggleOnParameterId,
+		const std::string& muteOnParameterId,
+		const std::string& strumOnParameterId) : mAudioProcessorRef(processorRef) 
 	{
 		mGroupComponentPtr.reset(new juce::GroupComponent("tuner", "Tuner"));
 		addAndMakeVisible(*mGroupComponentPtr);
@@ -38,19 +40,42 @@ public:
 		mRemainderLabel = std::make_unique<juce::Label>("Remainder", "Remainder");
 		addAndMakeVisible(*mRemainderLabel);
 
-		juce::Timer::startTimerHz(4);
+		for (auto& stringLabel : mStringLabels)
+		{
+			stringLabel = std::make_unique<juce::Label>();
+			stringLabel->setJustificationType(juce::Justification::centred);
+			addChildComponent(*stringLabel);
+		}
+
+		juce::Timer::startTimerHz(TunerAnalyser::publishRateHz);
 
 		// Toggle Button
 		mToggleButtonPtr = std::make_unique<juce::ToggleButton>();
 		mToggleButtonAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
 			processorRef.getAudioProcessorValueTreeState(), toggleOnParameterId, *mToggleButtonPtr);
 		addAndMakeVisible(*mToggleButtonPtr);
+
+		mMuteToggleButtonPtr = std::make_unique<juce::ToggleButton>();
+		mMuteToggleButtonPtr->setButtonText(PluginUtils::toTitleCase(muteOnParameterId));
+		mMuteToggleButtonAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+			processorRef.getAudioProcessorValueTreeState(), muteOnParameterId, *mMuteToggleButtonPtr);
+		addAndMakeVisible(*mMuteToggleButtonPtr);
+
+		mStrumToggleButtonPtr = std::make_unique<juce::ToggleButton>();
+		mStrumToggleButtonPtr->setButtonText(PluginUtils::toTitleCase(strumOnParameterId));
+		mStrumToggleButtonAttachmentPtr = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+			processorRef.getAudioProcessorValueTreeState(), strumOnParameterId, *mStrumToggleButtonPtr);
+		addAndMakeVisible(*mStrumToggleButtonPtr);
 	}
 
 	~TunerPedalComponent()
 	{
 		mToggleButtonPtr.reset();
 		mToggleButtonAttachmentPtr.reset();
+		mMuteToggleButtonPtr.reset();
+		mMuteToggleButtonAttachmentPtr.reset();
+		mStrumToggleButtonPtr.reset();
+		mStrumToggleButtonAttachmentPtr.reset();
 		mGroupComponentPtr.reset();
 	}
 
@@ -84,10 +109,22 @@ public:
 		row2FlexBox.alignContent = juce::FlexBox::AlignContent::stretch;
 		row2FlexBox.flexWrap = juce::FlexBox::Wrap::wrap;
 
-		row2FlexBox.items.add(juce::FlexItem(*mPitchLabel).withFlex(1).withMaxHeight(128));
-		row2FlexBox.items.add(juce::FlexItem(*mRemainderLabel).withFlex(1).withMaxHeight(128));
+		if (mIsStrumShown)
+		{
+			for (auto& stringLabel : mStringLabels)
+			{
+				row2FlexBox.items.add(juce::FlexItem(*stringLabel).withFlex(1).withMaxHeight(128));
+			}
+		}
+		else
+		{
+			row2FlexBox.items.add(juce::FlexItem(*mPitchLabel).withFlex(1).withMaxHeight(128));
+			row2FlexBox.items.add(juce::FlexItem(*mRemainderLabel).withFlex(1).withMaxHeight(128));
+		}
 
 		mainFlexBox.items.add(juce::FlexItem(row2FlexBox).withFlex(1)); // 2/3 of space
+		mainFlexBox.items.add(juce::FlexItem(*mMuteToggleButtonPtr).withFlex(0.5));
+		mainFlexBox.items.add(juce::FlexItem(*mStrumToggleButtonPtr).withFlex(0.5));
 
 		// FlexBox for the bottom 1/3 where toggle button will be
 		juce::FlexBox row4FlexBox;
@@ -112,23 +149,78 @@ private:
 	std::unique_ptr<juce::Label> mRemainderLabel;
 	PluginAudioProcessor& mAudioProcessorRef;
 
-	float mLastPitch;
+	float mLastPitch = -1.0f;
+
+	std::array<std::unique_ptr<juce::Label>, StrumPitchEstimator::numStrings> mStringLabels;
+	bool mIsStrumShown = false;
 
 	void timerCallback() override
 	{
+		if (mStrumToggleButtonPtr->getToggleState() != mIsStrumShown)
+		{
+			mIsStrumShown = !mIsStrumShown;
+			mPitchLabel->setVisible(!mIsStrumShown);
+			mRemainderLabel->setVisible(!mIsStrumShown);
+
+			for (auto& stringLabel : mStringLabels)
+			{
+				stringLabel->setVisible(mIsStrumShown);
+			}
+
+			resized();
+		}
+
+		if (mIsStrumShown)
+		{
+			updateStringLabels();
+			return;
+		}
+
 		const auto newPitch = mAudioProcessorRef.getPitch();
 		if (newPitch != mLastPitch)
 		{
 			mLastPitch = newPitch;
 
+			// The analyser has no pitch for silence or for a window without a clear note.
+			if (mLastPitch <= 0.0f)
+			{
+				mPitchLabel->setText("-", juce::dontSendNotification);
+				mRemainderLabel->setText("-", juce::dontSendNotification);
+				return;
+			}
+
 			const auto result = PluginUtils::getNoteNameAndCentsFromFrequency(mLastPitch);
 			
 			mPitchLabel->setText(std::get<0>(result), juce::dontSendNotification);
-			mRemainderLabel->setText(juce::String::formatted("%.1f Hz", std::get<1>(result)), juce::dontSendNotification);
+			mRemainderLabel->setText(juce::String::formatted("%+.1f cents", std::get<1>(result)), juce::dontSendNotification);
+		}
+	}
+
+	// Each string's open note and how far it is from it, or "-" when it is not sounding.
+	void updateStringLabels()
+	{
+		for (int string = 0; string < StrumPitchEstimator::numStrings; ++string)
+		{
+			const auto openFrequency = StrumPitchEstimator::openStringFrequencies[static_cast<size_t>(string)];
+			const auto noteName = std::get<0>(PluginUtils::getNoteNameAndCentsFromFrequency(openFrequency));
+			const auto pitch = mAudioProcessorRef.getStringPitch(string);
+			const auto remainder = pitch > 0.0f
+				? juce::String::formatted("%+.1f", 1200.0f * std::log2(pitch / openFrequency))
+				: juce::String("-");
+
+			mStringLabels[static_cast<size_t>(string)]->setText(juce::String(noteName) + "\n" + remainder, juce::dontSendNotification);
 		}
 	}
 
 	// Toggle Button
 	std::unique_ptr<juce::ToggleButton> mToggleButtonPtr;
 	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mToggleButtonAttachmentPtr;
+
+	// Mute while tuning
+	std::unique_ptr<juce::ToggleButton> mMuteToggleButtonPtr;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mMuteToggleButtonAttachmentPtr;
+
+	// All six strings at once
+	std::unique_ptr<juce::ToggleButton> mStrumToggleButtonPtr;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mStrumToggleButtonAttachmentPtr;
 };
@@ -0,0 +1,262 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../PluginAudioProcessor.h"
+#include "../PluginAudioParameters.h"
+
+// Draws the user's wave shaper curve, used by the stages set to "curve". Points
+// are dragged to move them, double clicked into being and right clicked away,
+// or a list of x, y pairs is imported from a text file.
+class WaveShaperCurveComponent : public juce::Component, juce::ValueTree::Listener
+{
+public:
+	explicit WaveShaperCurveComponent(PluginAudioProcessor& processorRef) :
+		mProcessorRef(processorRef),
+		mState(processorRef.getAudioProcessorValueTreeState().state),
+		mCurve(processorRef.getWaveShaperCurve())
+	{
+		mInterpolationComboBox.addItem("Linear", 1);
+		mInterpolationComboBox.addItem("Cubic", 2);
+		mInterpolationComboBox.onChange = [this]()
+		{
+			mCurve.interpolation = mInterpolationComboBox.getSelectedId() == 1
+				? WaveShaperCurve::Interpolation::linear
+				: WaveShaperCurve::Interpolation::cubic;
+			mProcessorRef.setWaveShaperCurve(mCurve);
+		};
+		addAndMakeVisible(mInterpolationComboBox);
+
+		mImportButton.setButtonText("Import...");
+		mImportButton.setMouseCursor(juce::MouseCursor::PointingHandCursor);
+		mImportButton.onClick = [this]() { launchAsyncFileChooser(); };
+		addAndMakeVisible(mImportButton);
+
+		mResetButton.setButtonText("Reset");
+		mResetButton.setMouseCursor(juce::MouseCursor::PointingHandCursor);
+		mResetButton.onClick = [this]() { mProcessorRef.setWaveShaperCurve(WaveShaperCurve::getDefault()); };
+		addAndMakeVisible(mResetButton);
+
+		mState.addListener(this);
+		updateCurve();
+	}
+
+	~WaveShaperCurveComponent() override
+	{
+		mState.removeListener(this);
+	}
+
+	void paint(juce::Graphics& g) override
+	{
+		const auto graphBounds = mGraphBounds.toFloat();
+
+		g.setColour(juce::Colours::white.withAlpha(0.2f));
+		g.drawRect(graphBounds);
+		g.drawHorizontalLine(juce::roundToInt(graphBounds.getCentreY()), graphBounds.getX(), graphBounds.getRight());
+		g.drawVerticalLine(juce::roundToInt(graphBounds.getCentreX()), graphBounds.getY(), graphBounds.getBottom());
+
+		juce::Path path;
+		const auto width = juce::jmax(1, mGraphBounds.getWidth());
+		for (int pixel = 0; pixel <= width; ++pixel)
+		{
+			const auto x = juce::jmap(static_cast<float>(pixel), 0.0f, static_cast<float>(width), -WaveShaperCurve::inputRange, WaveShaperCurve::inputRange);
+			const auto position = toScreen({ x, mCurve.evaluate(x) });
+
+			if (pixel == 0)
+			{
+				path.startNewSubPath(position);
+			}
+			else
+			{
+				path.lineTo(position);
+			}
+		}
+
+		g.setColour(juce::Colours::white);
+		g.strokePath(path, juce::PathStrokeType(2.0f));
+
+		for (int pointIndex = 0; pointIndex < static_cast<int>(mCurve.points.size()); ++pointIndex)
+		{
+			g.setColour(pointIndex == mDraggedPointIndex ? juce::Colours::orange : juce::Colours::white);
+			g.fillEllipse(juce::Rectangle<float>(pointSize, pointSize).withCentre(toScreen(mCurve.points[pointIndex])));
+		}
+	}
+
+	void resized() override
+	{
+		auto bounds = getLocalBounds().reduced(8);
+
+		auto buttonRow = bounds.removeFromBottom(rowHeight);
+		mInterpolationComboBox.setBounds(buttonRow.removeFromLeft(buttonWidth).reduced(2));
+		mResetButton.setBounds(buttonRow.removeFromRight(buttonWidth).reduced(2));
+		mImportButton.setBounds(buttonRow.removeFromRight(buttonWidth).reduced(2));
+
+		const auto side = juce::jmin(bounds.getWidth(), bounds.getHeight());
+		mGraphBounds = bounds.withSizeKeepingCentre(side, side).reduced(static_cast<int>(pointSize));
+	}
+
+	void mouseDown(const juce::MouseEvent& event) override
+	{
+		mDraggedPointIndex = getPointIndexAt(event.position);
+
+		if (event.mods.isPopupMenu() && mDraggedPointIndex >= 0)
+		{
+			// The curve needs both of its ends.
+			if (mCurve.points.size() > 2)
+			{
+				mCurve.points.erase(mCurve.points.begin() + mDraggedPointIndex);
+				mProcessorRef.setWaveShaperCurve(mCurve);
+			}
+
+			mDraggedPointIndex = -1;
+		}
+
+		repaint();
+	}
+
+	void mouseDrag(const juce::MouseEvent& event) override
+	{
+		if (mDraggedPointIndex < 0)
+		{
+			return;
+		}
+
+		// A point stays between its neighbours, so the points keep their order.
+		const auto& points = mCurve.points;
+		const auto lower = mDraggedPointIndex > 0 ? points[mDraggedPointIndex - 1].x + minimumSpacing : -WaveShaperCurve::inputRange;
+		const auto upper = mDraggedPointIndex < static_cast<int>(points.size()) - 1 ? points[mDraggedPointIndex + 1].x - minimumSpacing : WaveShaperCurve::inputRange;
+		const auto position = fromScreen(event.position);
+
+		mCurve.points[mDraggedPointIndex] = {
+			juce::jlimit(lower, juce::jmax(lower, upper), position.x),
+			juce::jlimit(-WaveShaperCurve::inputRange, WaveShaperCurve::inputRange, position.y)
+		};
+		mProcessorRef.setWaveShaperCurve(mCurve);
+	}
+
+	void mouseUp(const juce::MouseEvent& event) override
+	{
+		mDraggedPointIndex = -1;
+		repaint();
+	}
+
+	void mouseDoubleClick(const juce::MouseEvent& event) override
+	{
+		if (getPointIndexAt(event.position) < 0 && mGraphBounds.contains(event.getPosition()))
+		{
+			mCurve.addPoint(fromScreen(event.position));
+			mProcessorRef.setWaveShaperCurve(mCurve);
+		}
+	}
+
+private:
+	static constexpr int rowHeight = 32;
+	static constexpr int buttonWidth = 100;
+	static constexpr float pointSize = 10.0f;
+	static constexpr float minimumSpacing = 0.01f;
+
+	PluginAudioProcessor& mProcessorRef;
+	juce::ValueTree& mState;
+	WaveShaperCurve mCurve;
+	juce::Rectangle<int> mGraphBounds;
+	int mDraggedPointIndex = -1;
+
+	juce::ComboBox mInterpolationComboBox;
+	juce::TextButton mImportButton;
+	juce::TextButton mResetButton;
+	std::unique_ptr<juce::FileChooser> mFileChooser;
+
+	juce::Point<float> toScreen(juce::Point<float> point) const
+	{
+		const auto bounds = mGraphBounds.toFloat();
+		return {
+			juce::jmap(point.x, -WaveShaperCurve::inputRange, WaveShaperCurve::inputRange, bounds.getX(), bounds.getRight()),
+			juce::jmap(point.y, -WaveShaperCurve::inputRange, WaveShaperCurve::inputRange, bounds.getBottom(), bounds.getY())
+		};
+	}
+
+	juce::Point<float> fromScreen(juce::Point<float> position) const
+	{
+		const auto bounds = mGraphBounds.toFloat();
+		return {
+			juce::jmap(position.x, bounds.getX(), bounds.getRight(), -WaveShaperCurve::inputRange, WaveShaperCurve::inputRange),
+			juce::jmap(position.y, bounds.getBottom(), bounds.getY(), -WaveShaperCurve::inputRange, WaveShaperCurve::inputRange)
+		};
+	}
+
+	int getPointIndexAt(juce::Point<float> position) const
+	{
+		for (int pointIndex = 0; pointIndex < static_cast<int>(mCurve.points.size()); ++pointIndex)
+		{
+			if (toScreen(mCurve.points[pointIndex]).getDistanceFrom(position) <= pointSize)
+			{
+				return pointIndex;
+			}
+		}
+
+		return -1;
+	}
+
+	void launchAsyncFileChooser()
+	{
+		mFileChooser = std::make_unique<juce::FileChooser>("Select a Curve File", juce::File{}, "*.txt;*.csv");
+		mFileChooser->launchAsync(
+			juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+			[this](const juce::FileChooser& chooser)
+			{
+				const auto file = chooser.getResult();
+
+				if (file.existsAsFile())
+				{
+					auto curve = WaveShaperCurve::fromPointList(file.loadFileAsString());
+					curve.interpolation = mCurve.interpolation;
+					mProcessorRef.setWaveShaperCurve(curve);
+				}
+			});
+	}
+
+	void updateCurve()
+	{
+		mCurve = mProcessorRef.getWaveShaperCurve();
+
+		if (!juce::isPositiveAndBelow(mDraggedPointIndex, static_cast<int>(mCurve.points.size())))
+		{
+			mDraggedPointIndex = -1;
+		}
+
+		mInterpolationComboBox.setSelectedId(mCurve.interpolation == WaveShaperCurve::Interpolation::linear ? 1 : 2, juce::dontSendNotification);
+		repaint();
+	}
+
+	void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override
+	{
+		if (property == juce::Identifier(apvts::waveShaperCurveId))
+		{
+			updateCurve();
+		}
+	}
+
+	void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override
+	{
+		updateCurve();
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveShaperCurveComponent)
+};
@@ -66,8 +66,10 @@ namespace apvts
 	static constexpr int version = 3;
 
 	static const std::string impulseResponseFileFullPathNameId = "ir_full_path";
-
-	static constexpr float sampleRateAssumption = 441000.0f;
+	static const std::string cabinetMicrophone2FileFullPathNameId = "ir_full_path_mic2";
+	static const std::string cabinetMicrophone3FileFullPathNameId = "ir_full_path_mic3";
+	static const std::string chainOrderId = "chain_order";
+	static const std::string waveShaperCurveId = "wave_shaper_curve";
 
 	// Defaults
 
@@ -103,6 +105,7 @@ namespace apvts
 	static const std::string cubicNonLineartyWaveShaperId = "cube";
 	static const std::string hardClipWaveShaperId = "hard";
 	static const std::string exponentialWaveShaperId = "expo";
+	static const std::string curveWaveShaperId = "curve";
 
 	static const std::vector<std::string> waveShaperIds = {
 		hyperbolicTangentWaveShaperId,
@@ -111,6 +114,26 @@ namespace apvts
 		cubicNonLineartyWaveShaperId,
 		hardClipWaveShaperId,
 		exponentialWaveShaperId,
+		curveWaveShaperId,
+	};
+
+	// Antialiasing
+
+	static const std::string antialiasingComponentId = "antialiasing";
+
+	static const std::vector<std::string> antialiasingIds = {
+		"off",
+		"adaa1",
+		"adaa2",
+	};
+
+	// Oversampling
+
+	static const std::vector<std::string> oversamplingFactorNames = {
+		"off",
+		"2x",
+		"4x",
+		"8x",
 	};
 
 	static const std::vector<std::string> cabIds = {
@@ -118,19 +141,25 @@ namespace apvts
 	"croy",
 	};
 
-	static const std::map<std::string, float (*) (float)> waveShaperIdToFunctionMap = {
-		{hyperbolicTangentWaveShaperId, [](float x) { return std::tanh(x); }},
-		{softClipWaveShaperId, [](float x) { return x / (std::abs(x) + 1.0f); }},
-		{arctangentWaveShaperId, [](float x) { return std::atan(x); }},
-		{cubicNonLineartyWaveShaperId, [](float x) { return x - (1.0f / 3.0f) * std::pow(x, 3.0f); }},
-		{hardClipWaveShaperId, [](float x) { return std::max(-1.0f, std::min(1.0f, x)); }},
-		{exponentialWaveShaperId, [](float x) { return std::exp(x) - 1; }}
+	static const std::vector<std::string> cabinetQualityNames = {
+		"low",
+		"medium",
+		"high",
+	};
+
+	// The longest the cabinet's impulse response is kept at each quality.
+	static const std::vector<double> cabinetQualityMaximumLengthsInSeconds = {
+		0.1,
+		0.25,
+		3.0,
 	};
 
 	// BYPASS
 
 	static const std::string onComponentId = "on";
 	static const std::string biasId = "bias";
+	static const std::string oversamplingFactorId = "oversampling_factor";
+	static const std::string effectReleaseDelayId = "effect_release_delay";
 
 	// GAIN
 
@@ -216,6 +245,42 @@ namespace apvts
 	static constexpr float limiterThresholdDefaultValue = -1.0f;
 	static constexpr float limiterReleaseDefaultValue = 100.0f;
 
+	// Cabinet
+
+	static constexpr float cabinetTrimThresholdMinimumValue = -120.0f;
+	static constexpr float cabinetTrimThresholdMaximumValue = -40.0f;
+	static constexpr float cabinetTrimThresholdDefaultValue = -80.0f;
+	static const juce::NormalisableRange<float> cabinetTrimThresholdNormalisableRange(
+		cabinetTrimThresholdMinimumValue,
+		cabinetTrimThresholdMaximumValue,
+		1.0f);
+
+	// The microphones blended with the cabinet's own are levelled and delayed
+	// against it.
+	static constexpr float cabinetMicrophoneLevelMinimumValue = -36.0f;
+	static constexpr float cabinetMicrophoneLevelMaximumValue = 12.0f;
+	static constexpr float cabinetMicrophoneLevelDefaultValue = 0.0f;
+	static const juce::NormalisableRange<float> cabinetMicrophoneLevelNormalisableRange(
+		cabinetMicrophoneLevelMinimumValue,
+		cabinetMicrophoneLevelMaximumValue,
+		0.1f);
+
+	static constexpr float cabinetMicrophoneDelayMaximumValue = 10.0f;
+	static constexpr float cabinetMicrophoneDelayDefaultValue = 0.0f;
+	static const juce::NormalisableRange<float> cabinetMicrophoneDelayNormalisableRange(
+		-cabinetMicrophoneDelayMaximumValue,
+		cabinetMicrophoneDelayMaximumValue,
+		0.01f);
+
+	// How long an effect switched off keeps its memory, in case it is switched
+	// back on.
+	static constexpr float effectReleaseDelaySecondsDefaultValue = 30.0f;
+	static constexpr float effectReleaseDelaySecondsMaximumValue = 300.0f;
+	static const juce::NormalisableRange<float> effectReleaseDelaySecondsNormalisableRange = juce::NormalisableRange<float>(
+		0.0f,
+		effectReleaseDelaySecondsMaximumValue,
+		1.0f);
+
 	// DELAY
 
 	static constexpr float delayTimeMsDefaultValue = 100.0f;
@@ -275,6 +340,8 @@ namespace apvts
 		NOISE_GATE_RELEASE,
 
 		TUNER_ON,
+		TUNER_MUTE_ON,
+		TUNER_STRUM_ON,
 
 		PRE_COMPRESSOR_IS_ON,
 		PRE_COMPRESSOR_THRESHOLD,
@@ -310,28 +377,34 @@ namespace apvts
 		STAGE1_ON,
 		STAGE1_INPUT_GAIN,
 		STAGE1_WAVE_SHAPER,
+		STAGE1_ANTIALIASING,
 		STAGE1_OUTPUT_GAIN,
 		STAGE1_DRY_WET_MIX,
 
 		STAGE2_ON,
 		STAGE2_INPUT_GAIN,
 		STAGE2_WAVE_SHAPER,
+		STAGE2_ANTIALIASING,
 		STAGE2_OUTPUT_GAIN,
 		STAGE2_DRY_WET_MIX,
 
 		STAGE3_ON,
 		STAGE3_INPUT_GAIN,
 		STAGE3_WAVE_SHAPER,
+		STAGE3_ANTIALIASING,
 		STAGE3_OUTPUT_GAIN,
 		STAGE3_DRY_WET_MIX,
 
 		STAGE4_ON,
 		STAGE4_INPUT_GAIN,
 		STAGE4_WAVE_SHAPER,
+		STAGE4_ANTIALIASING,
 		STAGE4_OUTPUT_GAIN,
 		STAGE4_DRY_WET_MIX,
 
 		BIAS,
+		OVERSAMPLING_FACTOR,
+		EFFECT_RELEASE_DELAY,
 
 		AMP_RESONANCE_DB,
 		AMP_BASS_DB,
@@ -350,18 +423,22 @@ namespace apvts
 		DELAY_HIGH_PASS_FREQUENCY,
 		DELAY_FEEDBACK,
 		DELAY_DRY_WET,
+		DELAY_PING_PONG,
+		DELAY_CROSS_FEED,
 
 		CHORUS_ON,
 		CHORUS_DEPTH,
 		CHORUS_DELAY,
 		CHORUS_WIDTH,
 		CHORUS_FREQUENCY,
+		CHORUS_VOICES,
 
 		PHASER_IS_ON,
 		PHASER_DEPTH,
 		PHASER_FEEDBACK,
 		PHASER_FREQUENCY,
 		PHASER_WIDTH,
+		PHASER_STAGES,
 
 		FLANGER_ON,
 		FLANGER_DELAY,
@@ -383,6 +460,19 @@ namespace apvts
 		CABINET_IMPULSE_RESPONSE_CONVOLUTION_ON,
 		CABINET_IMPULSE_RESPONSE_INDEX,
 		CABINET_OUTPUT_GAIN,
+		CABINET_TRIM_THRESHOLD,
+		CABINET_MINIMUM_PHASE_ON,
+		CABINET_QUALITY,
+		CABINET_MIC2_ON,
+		CABINET_MIC2_INDEX,
+		CABINET_MIC2_LEVEL,
+		CABINET_MIC2_INVERT_ON,
+		CABINET_MIC2_DELAY,
+		CABINET_MIC3_ON,
+		CABINET_MIC3_INDEX,
+		CABINET_MIC3_LEVEL,
+		CABINET_MIC3_INVERT_ON,
+		CABINET_MIC3_DELAY,
 
 		INSTRUMENT_COMPRESSOR_IS_PRE_EQ_ON,
 		INSTRUMENT_COMPRESSOR_IS_ON,
@@ -448,6 +538,8 @@ namespace apvts
 	static const std::string noiseGateGainId = "noise_gate_gain";
 
 	static const std::string tunerOnId = "tuner_on";
+	static const std::string tunerMuteOnId = "tuner_mute_on";
+	static const std::string tunerStrumOnId = "tuner_strum_on";
 
 	static const std::string preCompressorOnId = "pre_compressor_on";
 	static const std::string preCompressorThresholdId = "pre_comp_thresh";
@@ -483,24 +575,28 @@ namespace apvts
 	static const std::string stage1OnId = "stage_1_on";
 	static const std::string stage1InputGainId = "stage_1_input_gain";
 	static const std::string stage1WaveShaperId = "stage_1_wave_shaper";
+	static const std::string stage1AntialiasingId = "stage_1_antialiasing";
 	static const std::string stage1OutputGainId = "stage_1_output_gain";
 	static const std::string stage1DryWetId = "stage_1_mix";
 
 	static const std::string stage2OnId = "stage_2_on";
 	static const std::string stage2InputGainId = "stage_2_input_gain";
 	static const std::string stage2WaveShaperId = "stage_2_wave_shaper";
+	static const std::string stage2AntialiasingId = "stage_2_antialiasing";
 	static const std::string stage2OutputGainId = "stage_2_output_gain";
 	static const std::string stage2DryWetId = "stage_2_mix";
 
 	static const std::string stage3OnId = "stage_3_on";
 	static const std::string stage3InputGainId = "stage_3_input_gain";
 	static const std::string stage3WaveShaperId = "stage_3_wave_shaper";
+	static const std::string stage3AntialiasingId = "stage_3_antialiasing";
 	static const std::string stage3OutputGainId = "stage_3_output_gain";
 	static const std::string stage3DryWetId = "stage_3_mix";
 
 	static const std::string stage4OnId = "stage_4_on";
 	static const std::string stage4InputGainId = "stage_4_input_gain";
 	static const std::string stage4WaveShaperId = "stage_4_wave_shaper";
+	static const std::string stage4AntialiasingId = "stage_4_antialiasing";
 	static const std::string stage4OutputGainId = "stage_4_output_gain";
 	static const std::string stage4DryWetId = "stage_4_mix";
 
@@ -521,18 +617,22 @@ namespace apvts
 	static const std::string delayLowPassFrequencyId = "delay_low_pass_freq";
 	static const std::string delayFeedbackId = "delay_feedback";
 	static const std::string delayDryWetId = "delay_mix";
+	static const std::string delayPingPongId = "delay_ping_pong";
+	static const std::string delayCrossFeedId = "delay_cross_feed";
 
 	static const std::string chorusOnId = "chorus_on";
 	static const std::string chorusDelayId = "chorus_delay";
 	static const std::string chorusDepthId = "chorus_depth";
 	static const std::string chorusWidthId = "chorus_width";
 	static const std::string chorusFrequencyId = "chorus_feedback";
+	static const std::string chorusVoicesId = "chorus_voices";
 
 	static const std::string phaserIsOnId = "phaser_on";
 	static const std::string phaserDepthId = "phaser_depth";
 	static const std::string phaserWidthId = "phaser_width";
 	static const std::string phaserFrequencyId = "phaser_frequency";
 	static const std::string phaserFeedbackId = "phaser_feedback";
+	static const std::string phaserStagesId = "phaser_stages";
 
 	static const std::string flangerOnId = "flanger_on";
 	static const std::string flangerDelayId = "flanger_delay";
@@ -555,6 +655,21 @@ namespace apvts
 	static const std::string cabinetImpulseResponseConvolutionFileId = "cab_file";
 	static const std::string cabinetImpulseResponseConvolutionIndexId = "cab_index";
 	static const std::string cabinetGainId = "cabinet_gain";
+	static const std::string cabinetTrimThresholdId = "cabinet_trim_threshold";
+	static const std::string cabinetMinimumPhaseOnId = "cabinet_minimum_phase_on";
+	static const std::string cabinetQualityId = "cabinet_quality";
+	static const std::string cabinetMicrophone2OnId = "cabinet_mic2_on";
+	static const std::string cabinetMicrophone2FileId = "cabinet_mic2_file";
+	static const std::string cabinetMicrophone2IndexId = "cabinet_mic2_index";
+	static const std::string cabinetMicrophone2LevelId = "cabinet_mic2_level";
+	static const std::string cabinetMicrophone2InvertOnId = "cabinet_mic2_invert_on";
+	static const std::string cabinetMicrophone2DelayId = "cabinet_mic2_delay";
+	static const std::string cabinetMicrophone3OnId = "cabinet_mic3_on";
+	static const std::string cabinetMicrophone3FileId = "cabinet_mic3_file";
+	static const std::string cabinetMicrophone3IndexId = "cabinet_mic3_index";
+	static const std::string cabinetMicrophone3LevelId = "cabinet_mic3_level";
+	static const std::string cabinetMicrophone3InvertOnId = "cabinet_mic3_invert_on";
+	static const std::string cabinetMicrophone3DelayId = "cabinet_mic3_delay";
 
 	static const std::string instrumentCompressorIsPreEq = "inst_comp_pre_eq_on";
 	static const std::string instrumentCompressorIsOn = "inst_comp_is_on";
@@ -616,6 +731,8 @@ namespace apvts
 		{noiseGateReleaseId, ParameterEnum::NOISE_GATE_RELEASE},
 
 		{tunerOnId, ParameterEnum::TUNER_ON},
+		{tunerMuteOnId, ParameterEnum::TUNER_MUTE_ON},
+		{tunerStrumOnId, ParameterEnum::TUNER_STRUM_ON},
 
 		{preCompressorOnId, ParameterEnum::PRE_COMPRESSOR_IS_ON},
 		{preCompressorThresholdId, ParameterEnum::PRE_COMPRESSOR_THRESHOLD},
@@ -651,28 +768,34 @@ namespace apvts
 		{stage1OnId, ParameterEnum::STAGE1_ON},
 		{stage1InputGainId, ParameterEnum::STAGE1_INPUT_GAIN},
 		{stage1WaveShaperId, ParameterEnum::STAGE1_WAVE_SHAPER},
+		{stage1AntialiasingId, ParameterEnum::STAGE1_ANTIALIASING},
 		{stage1OutputGainId, ParameterEnum::STAGE1_OUTPUT_GAIN},
 		{stage1DryWetId, ParameterEnum::STAGE1_DRY_WET_MIX},
 
 		{stage2OnId, ParameterEnum::STAGE2_ON},
 		{stage2InputGainId, ParameterEnum::STAGE2_INPUT_GAIN},
 		{stage2WaveShaperId, ParameterEnum::STAGE2_WAVE_SHAPER},
+		{stage2AntialiasingId, ParameterEnum::STAGE2_ANTIALIASING},
 		{stage2OutputGainId, ParameterEnum::STAGE2_OUTPUT_GAIN},
 		{stage2DryWetId, ParameterEnum::STAGE2_DRY_WET_MIX},
 
 		{stage3OnId, ParameterEnum::STAGE3_ON},
 		{stage3InputGainId, ParameterEnum::STAGE3_INPUT_GAIN},
 		{stage3WaveShaperId, ParameterEnum::STAGE3_WAVE_SHAPER},
+		{stage3AntialiasingId, ParameterEnum::STAGE3_ANTIALIASING},
 		{stage3OutputGainId, ParameterEnum::STAGE3_OUTPUT_GAIN},
 		{stage3DryWetId, ParameterEnum::STAGE3_DRY_WET_MIX},
 
 		{stage4OnId, ParameterEnum::STAGE4_ON},
 		{stage4InputGainId, ParameterEnum::STAGE4_INPUT_GAIN},
 		{stage4WaveShaperId, ParameterEnum::STAGE4_WAVE_SHAPER},
+		{stage4AntialiasingId, ParameterEnum::STAGE4_ANTIALIASING},
 		{stage4OutputGainId, ParameterEnum::STAGE4_OUTPUT_GAIN},
 		{stage4DryWetId, ParameterEnum::STAGE4_DRY_WET_MIX},
 
 		{biasId, ParameterEnum::BIAS},
+		{oversamplingFactorId, ParameterEnum::OVERSAMPLING_FACTOR},
+		{effectReleaseDelayId, ParameterEnum::EFFECT_RELEASE_DELAY},
 
 		{ampResonanceDbId, ParameterEnum::AMP_RESONANCE_DB},
 		{ampBassDbId, ParameterEnum::AMP_BASS_DB},
@@ -684,6 +807,19 @@ namespace apvts
 		{cabinetImpulseResponseConvolutionIndexId, ParameterEnum::CABINET_IMPULSE_RESPONSE_INDEX},
 
 		{cabinetGainId, ParameterEnum::CABINET_OUTPUT_GAIN},
+		{cabinetTrimThresholdId, ParameterEnum::CABINET_TRIM_THRESHOLD},
+		{cabinetMinimumPhaseOnId, ParameterEnum::CABINET_MINIMUM_PHASE_ON},
+		{cabinetQualityId, ParameterEnum::CABINET_QUALITY},
+		{cabinetMicrophone2OnId, ParameterEnum::CABINET_MIC2_ON},
+		{cabinetMicrophone2IndexId, ParameterEnum::CABINET_MIC2_INDEX},
+		{cabinetMicrophone2LevelId, ParameterEnum::CABINET_MIC2_LEVEL},
+		{cabinetMicrophone2InvertOnId, ParameterEnum::CABINET_MIC2_INVERT_ON},
+		{cabinetMicrophone2DelayId, ParameterEnum::CABINET_MIC2_DELAY},
+		{cabinetMicrophone3OnId, ParameterEnum::CABINET_MIC3_ON},
+		{cabinetMicrophone3IndexId, ParameterEnum::CABINET_MIC3_INDEX},
+		{cabinetMicrophone3LevelId, ParameterEnum::CABINET_MIC3_LEVEL},
+		{cabinetMicrophone3InvertOnId, ParameterEnum::CABINET_MIC3_INVERT_ON},
+		{cabinetMicrophone3DelayId, ParameterEnum::CABINET_MIC3_DELAY},
 
 		{limiterOnId, ParameterEnum::LIMITER_ON},
 		{limiterThresholdId, ParameterEnum::LIMITER_THRESHOLD},
@@ -700,11 +836,14 @@ namespace apvts
 		{delayLowPassFrequencyId, ParameterEnum::DELAY_LOW_PASS_FREQUENCY},
 		{delayFeedbackId, ParameterEnum::DELAY_FEEDBACK},
 		{delayDryWetId, ParameterEnum::DELAY_DRY_WET},
+		{delayPingPongId, ParameterEnum::DELAY_PING_PONG},
+		{delayCrossFeedId, ParameterEnum::DELAY_CROSS_FEED},
 
 		{chorusOnId, ParameterEnum::CHORUS_ON},
 		{chorusDepthId, ParameterEnum::CHORUS_DEPTH},
 		{chorusWidthId, ParameterEnum::CHORUS_WIDTH},
 		{chorusFrequencyId, ParameterEnum::CHORUS_FREQUENCY},
+		{chorusVoicesId, ParameterEnum::CHORUS_VOICES},
 		{chorusDelayId, ParameterEnum::CHORUS_DELAY},
 
 		{flangerOnId, ParameterEnum::FLANGER_ON},
@@ -719,6 +858,7 @@ namespace apvts
 		{phaserFrequencyId, ParameterEnum::PHASER_FREQUENCY},
 		{phaserWidthId, ParameterEnum::PHASER_WIDTH},
 		{phaserFeedbackId, ParameterEnum::PHASER_FEEDBACK},
+		{phaserStagesId, ParameterEnum::PHASER_STAGES},
 
 		{bitCrusherOnId, ParameterEnum::BIT_CRUSHER_ON},
 		{bitCrusherSampleRateId, ParameterEnum::BIT_CRUSHER_SAMPLE_RATE},
@@ -41,11 +41,11 @@ PluginAudioProcessor::PluginAudioProcessor()
 		createParameterLayout())),
 	mPresetManagerPtr(std::make_unique<PluginPresetManager>(*mAudioProcessorValueTreeStatePtr.get())),
 	mAudioFormatManagerPtr(std::make_unique<juce::AudioFormatManager>()),
-	mPitchMPM(std::make_unique<adamski::PitchMPM>(44100, 1024)),
-	mAudioFifo(std::make_unique<AudioFifo>()),
-	mAudioBuffer(std::make_unique<juce::AudioBuffer<float>>()),
+	mTunerAnalyserPtr(std::make_unique<TunerAnalyser>()),
 	mInputLevelMeterSourcePtr(std::make_unique<foleys::LevelMeterSource>()),
 	mOutputLevelMeterSourcePtr(std::make_unique<foleys::LevelMeterSource>()),
+	mStageProfilerPtr(std::make_unique<StageProfiler>()),
+	mEffectChainPtr(std::make_unique<EffectChain>(*mStageProfilerPtr)),
 
 	mInputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
 
@@ -59,77 +59,346 @@ PluginAudioProcessor::PluginAudioProcessor()
 	mMouseDrivePtr(std::make_unique<MouseDrive>()),
 	mGraphicEqualiser(std::make_unique<GraphicEqualiser>()),
 
-	mStage1Buffer(std::make_unique<juce::AudioBuffer<float>>()),
-	mStage1InputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage1WaveShaperPtr(std::make_unique<juce::dsp::WaveShaper<float>>()),
-	mStage1OutputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage1DryWetMixerPtr(std::make_unique<juce::dsp::DryWetMixer<float>>()),
-
-	mStage2Buffer(std::make_unique<juce::AudioBuffer<float>>()),
-	mStage2InputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage2WaveShaperPtr(std::make_unique<juce::dsp::WaveShaper<float>>()),
-	mStage2OutputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage2DryWetMixerPtr(std::make_unique<juce::dsp::DryWetMixer<float>>()),
-
-	mStage3Buffer(std::make_unique<juce::AudioBuffer<float>>()),
-	mStage3InputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage3WaveShaperPtr(std::make_unique<juce::dsp::WaveShaper<float>>()),
-	mStage3OutputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage3DryWetMixerPtr(std::make_unique<juce::dsp::DryWetMixer<float>>()),
-
-	mStage4Buffer(std::make_unique<juce::AudioBuffer<float>>()),
-	mStage4InputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage4WaveShaperPtr(std::make_unique<juce::dsp::WaveShaper<float>>()),
-	mStage4OutputGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
-	mStage4DryWetMixerPtr(std::make_unique<juce::dsp::DryWetMixer<float>>()),
+	mPreampPtr(std::make_unique<Preamp>()),
 
 	mBiasPtr(std::make_unique<juce::dsp::Bias<float>>()),
 	mAmplifierEqualiser(std::make_unique<AmplifierEqualiser>()),
 
-	mDelayLineLeftPtr(std::make_unique<juce::dsp::DelayLine<float>>(apvts::delayTimeMsMaximumValue* (apvts::sampleRateAssumption / 1000))),
-	mDelayLineRightPtr(std::make_unique<juce::dsp::DelayLine<float>>(apvts::delayTimeMsMaximumValue* (apvts::sampleRateAssumption / 1000))),
+	mStereoDelayPtr(std::make_unique<StereoDelay>()),
 	mDelayLineDryWetMixerPtr(std::make_unique<juce::dsp::DryWetMixer<float>>()),
-	mDelayHighPassFilterPtr(std::make_unique<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>>(
-		juce::dsp::IIR::Coefficients<float>::makeHighPass(apvts::sampleRateAssumption, InstrumentEqualiser::sHighPassFrequencyNormalisableRange.start)
-		)),
-	mDelayLowPassFilterPtr(std::make_unique<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>>(
-		juce::dsp::IIR::Coefficients<float>::makeLowPass(apvts::sampleRateAssumption, InstrumentEqualiser::sLowPassFrequencyNormalisableRange.start)
-		)),
+	mDelayFiltersPtr(std::make_unique<BiquadCascade<2>>()),
 
 	mChorusPtr(std::make_unique<Chorus>()),
 	mPhaserPtr(std::make_unique<Phaser>()),
 	mFlangerPtr(std::make_unique<Flanger>()),
 	mBitcrusherPtr(std::make_unique<Bitcrusher>()),
 
-	mConvolutionMessageQueuePtr(std::make_unique<juce::dsp::ConvolutionMessageQueue>()),
-	mCabinetImpulseResponseConvolutionPtr(std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::NonUniform{ 128 }, * mConvolutionMessageQueuePtr.get())),
-	mLofiImpulseResponseConvolutionPtr(std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::NonUniform{ 128 }, * mConvolutionMessageQueuePtr.get())),
+	mLinearStageFolderPtr(std::make_unique<LinearStageFolder>()),
+	mLofiConvolutionPtr(std::make_unique<PartitionedConvolution>()),
 
 	mInstrumentCompressorPtr(std::make_unique<Compressor>()),
 	mInstrumentEqualiserPtr(std::make_unique<InstrumentEqualiser>()),
 
 	mReverbPtr(std::make_unique<juce::dsp::Reverb>()),
 
-	mCabinetGainPtr(std::make_unique<juce::dsp::Gain<float>>()),
 	mLimiterPtr(std::make_unique<juce::dsp::Limiter<float>>()),
 
 	mOutputGainPtr(std::make_unique<juce::dsp::Gain<float>>())
 {
 	mAudioFormatManagerPtr->registerBasicFormats();
 
+	// Cabinets read and resampled once are kept for the next session.
+	mImpulseResponseCache->setDirectory(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile(ProjectInfo::companyName)
+		.getChildFile(ProjectInfo::projectName)
+		.getChildFile("ImpulseResponseCache"));
+
+	createEffectChain();
+
 	mAudioProcessorValueTreeStatePtr->state.addListener(this);
 	for (const auto& parameterIdAndEnum : apvts::parameterIdToEnumMap) {
 		mAudioProcessorValueTreeStatePtr->addParameterListener(parameterIdAndEnum.first, this);
 	}
 }
 
+void PluginAudioProcessor::createEffectChain()
+{
+	const auto addStage = [this](
+		const juce::String& key,
+		const juce::String& name,
+		bool isMovable,
+		ProfiledStage profiledStage,
+		FunctionChainStage::PrepareFunction prepareFunction,
+		FunctionChainStage::ProcessFunction processFunction,
+		FunctionChainStage::ResetFunction resetFunction,
+		FunctionChainStage::IsActiveFunction isActiveFunction = nullptr,
+		FunctionChainStage::ReleaseFunction releaseFunction = nullptr,
+		FunctionChainStage::MemoryUsageFunction memoryUsageFunction = nullptr)
+	{
+		mEffectChainPtr->addStage(key, name, isMovable, profiledStage, std::make_unique<FunctionChainStage>(
+			std::move(prepareFunction),
+			std::move(processFunction),
+			std::move(resetFunction),
+			std::move(isActiveFunction),
+			std::move(releaseFunction),
+			std::move(memoryUsageFunction)));
+	};
+
+	addStage("noise_gate", "Noise Gate", false, ProfiledStage::noiseGate,
+		[this](juce::dsp::ProcessSpec& spec) { mNoiseGate->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mNoiseGate->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]() { mNoiseGate->reset(); });
+
+	addStage("input_gain", "Input Gain", false, ProfiledStage::inputGain,
+		[this](juce::dsp::ProcessSpec& spec) { mInputGainPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mInputGainPtr->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]() { mInputGainPtr->reset(); });
+
+	addStage("pre_compressor", "Compressor", true, ProfiledStage::preCompressor,
+		[this](juce::dsp::ProcessSpec& spec)
+		{
+			mPreCompressorPtr->prepare(spec);
+			mPreCompressorGainPtr->prepare(spec);
+			mPreCompressorDryWetMixerPtr->prepare(spec);
+		},
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			const auto totalNumInputChannels = getTotalNumInputChannels();
+			const auto numSamples = buffer.getNumSamples();
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
+
+			mPreCompressorDryWetMixerPtr->pushDrySamples(audioBlock);
+			float preCompressorInputRms = mIsPreCompressorAutoMakeup ? buffer.getRMSLevel(0, 0, numSamples) : 0;
+			mPreCompressorPtr->process(processContext);
+
+			if (mIsPreCompressorAutoMakeup)
+			{
+				float preCompressorOutputRms = buffer.getRMSLevel(0, 0, numSamples);
+				mPreCompressorGainSmoothedValue.setTargetValue(std::min(preCompressorInputRms / preCompressorOutputRms, 12.0f));
+
+				for (int sample = 0; sample < numSamples; ++sample)
+				{
+					float preCompressorGainSmoothedNextValue = mPreCompressorGainSmoothedValue.getNextValue();
+
+					for (int channel = 0; channel < totalNumInputChannels; ++channel)
+					{
+						auto* channelData = buffer.getWritePointer(channel);
+						channelData[sample] *= preCompressorGainSmoothedNextValue;
+					}
+				}
+			}
+
+			mPreCompressorGainPtr->process(processContext);
+			mPreCompressorDryWetMixerPtr->mixWetSamples(audioBlock);
+		},
+		[this]()
+		{
+			mPreCompressorPtr->reset();
+			mPreCompressorGainPtr->reset();
+			mPreCompressorDryWetMixerPtr->reset();
+		},
+		[this]() { return mIsPreCompressorOn; });
+
+	addStage("graphic_equaliser", "Equaliser", true, ProfiledStage::graphicEqualiser,
+		[this](juce::dsp::ProcessSpec& spec) { mGraphicEqualiser->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mGraphicEqualiser->processBlock(buffer); },
+		[this]() { mGraphicEqualiser->reset(); },
+		[this]() { return mIsGraphicEqualiserOn; });
+
+	addStage("tube_screamer", "Screamer", true, ProfiledStage::tubeScreamer,
+		[this](juce::dsp::ProcessSpec& spec) { mTubeScreamerPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mTubeScreamerPtr->processBlock(buffer); },
+		[this]() { mTubeScreamerPtr->reset(); },
+		[this]() { return mIsTubeScreamerOn; });
+
+	addStage("mouse_drive", "Driver", true, ProfiledStage::mouseDrive,
+		[this](juce::dsp::ProcessSpec& spec) { mMouseDrivePtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mMouseDrivePtr->processBlock(buffer); },
+		[this]() { mMouseDrivePtr->reset(); },
+		[this]() { return mIsMouseDriveOn; });
+
+	addStage("amplifier", "Amplifier", true, ProfiledStage::preamp,
+		[this](juce::dsp::ProcessSpec& spec) { mPreampPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mPreampPtr->processBlock(buffer); },
+		[this]() { mPreampPtr->reset(); },
+		[this]() { return mPreampPtr->isAnyStageOn(); });
+
+	addStage("amplifier", "Amplifier", true, ProfiledStage::amplifierEqualiser,
+		[this](juce::dsp::ProcessSpec& spec)
+		{
+			mBiasPtr->prepare(spec);
+			mAmplifierEqualiser->prepare(spec);
+		},
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mAmplifierEqualiser->processBlock(buffer);
+			mBiasPtr->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]()
+		{
+			mBiasPtr->reset();
+			mAmplifierEqualiser->reset();
+		});
+
+	addStage("delay", "Delay", true, ProfiledStage::delay,
+		[this](juce::dsp::ProcessSpec& spec)
+		{
+			const auto maximumDelayInSamples = apvts::delayTimeMsMaximumValue * (spec.sampleRate / 1000);
+			mStereoDelayPtr->prepare(spec, static_cast<int>(std::ceil(maximumDelayInSamples)));
+			mDelayLineDryWetMixerPtr->setWetMixProportion(mDelayWetMixProportion.load());
+			mDelayLineDryWetMixerPtr->prepare(spec);
+
+			mDelayFiltersPtr->prepare(spec);
+		},
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mDelayLineDryWetMixerPtr->setWetMixProportion(mDelayWetMixProportion.load());
+			mDelayLineDryWetMixerPtr->pushDrySamples(audioBlock);
+			mStereoDelayPtr->processBlock(buffer);
+			mDelayFiltersPtr->processBlock(buffer);
+			mDelayLineDryWetMixerPtr->mixWetSamples(audioBlock);
+		},
+		[this]()
+		{
+			mStereoDelayPtr->reset();
+			mDelayLineDryWetMixerPtr->reset();
+			mDelayFiltersPtr->reset();
+		},
+		[this]() { return mDelayFeedback > 0.0f && mIsDelayOn; },
+		[this]() { mStereoDelayPtr->release(); },
+		[this]() { return mStereoDelayPtr->getMemoryUsageInBytes(); });
+
+	addStage("chorus", "Chorus", true, ProfiledStage::chorus,
+		[this](juce::dsp::ProcessSpec& spec) { mChorusPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mChorusPtr->process(buffer); },
+		[this]() { mChorusPtr->reset(); },
+		[this]() { return mIsChorusOn; },
+		[this]() { mChorusPtr->release(); },
+		[this]() { return mChorusPtr->getMemoryUsageInBytes(); });
+
+	addStage("phaser", "Phaser", true, ProfiledStage::phaser,
+		[this](juce::dsp::ProcessSpec& spec) { mPhaserPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mPhaserPtr->process(buffer); },
+		[this]() { mPhaserPtr->reset(); },
+		[this]() { return mIsPhaserOn; });
+
+	addStage("flanger", "Flanger", true, ProfiledStage::flanger,
+		[this](juce::dsp::ProcessSpec& spec) { mFlangerPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mFlangerPtr->process(buffer); },
+		[this]() { mFlangerPtr->reset(); },
+		[this]() { return mIsFlangerOn; },
+		[this]() { mFlangerPtr->release(); },
+		[this]() { return mFlangerPtr->getMemoryUsageInBytes(); });
+
+	addStage("bit_crusher", "Bit Crusher", true, ProfiledStage::bitcrusher,
+		[this](juce::dsp::ProcessSpec& spec) { mBitcrusherPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mBitcrusherPtr->process(buffer); },
+		[this]() { mBitcrusherPtr->reset(); },
+		[this]() { return mIsBitcrusherOn; });
+
+	addStage("reverb", "Reverb", true, ProfiledStage::reverb,
+		[this](juce::dsp::ProcessSpec& spec) { mReverbPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mReverbPtr->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]() { mReverbPtr->reset(); },
+		[this]() { return mIsReverbOn; });
+
+	// The cabinet gain is folded into the cabinet's impulse response, and so are
+	// the instrument EQ and lofi when nothing else sits between them and the
+	// cabinet, which leaves their stages nothing to do. See foldLinearStages().
+	addStage("cabinet", "Cabinet", false, ProfiledStage::cabinet,
+		[this](juce::dsp::ProcessSpec& spec) { mLinearStageFolderPtr->prepare(spec, getConvolutionPartitionSize()); },
+		[this](juce::AudioBuffer<float>& buffer) { mLinearStageFolderPtr->processBlock(buffer); },
+		[this]() { mLinearStageFolderPtr->reset(); },
+		[this]() { return mIsCabImpulseResponseConvolutionOn; },
+		nullptr,
+		[this]() { return mLinearStageFolderPtr->getMemoryUsageInBytes(); });
+
+	// The instrument compressor sits either side of the instrument EQ, so it has a
+	// stage in both places and only one of them is ever active.
+	addStage("instrument_compressor_pre_equaliser", "Instrument Compressor", false, ProfiledStage::instrumentCompressor,
+		[this](juce::dsp::ProcessSpec& spec) { mInstrumentCompressorPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer) { mInstrumentCompressorPtr->process(buffer); },
+		[this]() { mInstrumentCompressorPtr->reset(); },
+		[this]() { return mIsInstrumentCompressorOn && mIsInstrumentCompressorPreEqualiser; });
+
+	addStage("instrument_equaliser", "Instrument EQ", false, ProfiledStage::instrumentEqualiser,
+		[this](juce::dsp::ProcessSpec& spec) { mInstrumentEqualiserPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			if (!mLinearStageFolderPtr->isFolded(LinearStageFolder::instrumentEqualiser))
+			{
+				mInstrumentEqualiserPtr->processBlock(buffer);
+			}
+		},
+		[this]() { mInstrumentEqualiserPtr->reset(); });
+
+	addStage("instrument_compressor_post_equaliser", "Instrument Compressor", false, ProfiledStage::instrumentCompressor,
+		nullptr,
+		[this](juce::AudioBuffer<float>& buffer) { mInstrumentCompressorPtr->process(buffer); },
+		nullptr,
+		[this]() { return mIsInstrumentCompressorOn && !mIsInstrumentCompressorPreEqualiser; });
+
+	addStage("limiter", "Limiter", false, ProfiledStage::limiter,
+		[this](juce::dsp::ProcessSpec& spec) { mLimiterPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mLimiterPtr->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]() { mLimiterPtr->reset(); },
+		[this]() { return mIsLimiterOn; });
+
+	addStage("lofi", "Lofi", false, ProfiledStage::lofi,
+		[this](juce::dsp::ProcessSpec& spec) { prepareLofiConvolution(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			if (!mLinearStageFolderPtr->isFolded(LinearStageFolder::lofi))
+			{
+				mLofiConvolutionPtr->process(buffer);
+			}
+		},
+		[this]() { mLofiConvolutionPtr->reset(); },
+		[this]() { return mIsLofi; });
+
+	addStage("output_gain", "Output Gain", false, ProfiledStage::outputGain,
+		[this](juce::dsp::ProcessSpec& spec) { mOutputGainPtr->prepare(spec); },
+		[this](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			mOutputGainPtr->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		},
+		[this]() { mOutputGainPtr->reset(); });
+
+	// The drives and the preamp stages alias, so they run oversampled when that is
+	// switched on. The amp EQ comes along, which keeps the amplifier a single run.
+	mEffectChainPtr->setSlotIsOversampled("tube_screamer");
+	mEffectChainPtr->setSlotIsOversampled("mouse_drive");
+	mEffectChainPtr->setSlotIsOversampled("amplifier");
+
+	// The stages whose buffers are large hold nothing until they are first
+	// switched on, and give it back once they have been off for a while.
+	mEffectChainPtr->setSlotIsPreparedOnDemand("delay");
+	mEffectChainPtr->setSlotIsPreparedOnDemand("chorus");
+	mEffectChainPtr->setSlotIsPreparedOnDemand("flanger");
+	mEffectChainPtr->onSlotPrepared = [this]() { triggerAsyncUpdate(); };
+
+	// For the crossfades that fold these stages into the cabinet or hand them back.
+	mLinearStageFolderPtr->setStageFunctions(LinearStageFolder::instrumentEqualiser,
+		[this](juce::AudioBuffer<float>& buffer) { mInstrumentEqualiserPtr->processBlock(buffer); },
+		[this]() { mInstrumentEqualiserPtr->reset(); });
+
+	mLinearStageFolderPtr->setStageFunctions(LinearStageFolder::lofi,
+		[this](juce::AudioBuffer<float>& buffer) { mLofiConvolutionPtr->process(buffer); },
+		[this]() { mLofiConvolutionPtr->reset(); });
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::createParameterLayout()
 {
 	juce::AudioProcessorValueTreeState::ParameterLayout layout;
 
 	juce::StringArray waveShaperIdsJuceStringArray;
-	for (const auto& idToFunction : apvts::waveShaperIdToFunctionMap) {
-		waveShaperIdsJuceStringArray.add(idToFunction.first);
+	for (const auto& waveShaperId : apvts::waveShaperIds) {
+		waveShaperIdsJuceStringArray.add(waveShaperId);
+	}
+
+	juce::StringArray antialiasingIdsJuceStringArray;
+	for (const auto& antialiasingId : apvts::antialiasingIds) {
+		antialiasingIdsJuceStringArray.add(antialiasingId);
 	}
 
 	for (const auto& parameterIdAndEnum : apvts::parameterIdToEnumMap)
@@ -176,6 +445,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 		case apvts::ParameterEnum::FLANGER_ON:
 		case apvts::ParameterEnum::IS_LOFI:
 		case apvts::ParameterEnum::TUNER_ON:
+		case apvts::ParameterEnum::TUNER_MUTE_ON:
+		case apvts::ParameterEnum::TUNER_STRUM_ON:
+		case apvts::ParameterEnum::CABINET_MINIMUM_PHASE_ON:
+		case apvts::ParameterEnum::CABINET_MIC2_ON:
+		case apvts::ParameterEnum::CABINET_MIC2_INVERT_ON:
+		case apvts::ParameterEnum::CABINET_MIC3_ON:
+		case apvts::ParameterEnum::CABINET_MIC3_INVERT_ON:
+		case apvts::ParameterEnum::DELAY_PING_PONG:
 			layout.add(std::make_unique<juce::AudioParameterBool>(
 				juce::ParameterID{ parameterId, apvts::version },
 				parameterId,
@@ -254,6 +531,46 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				10.0f
 				));
 			break;
+		case apvts::ParameterEnum::CABINET_TRIM_THRESHOLD:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				apvts::cabinetTrimThresholdNormalisableRange,
+				apvts::cabinetTrimThresholdDefaultValue
+				));
+			break;
+		case apvts::ParameterEnum::CABINET_MIC2_LEVEL:
+		case apvts::ParameterEnum::CABINET_MIC3_LEVEL:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				apvts::cabinetMicrophoneLevelNormalisableRange,
+				apvts::cabinetMicrophoneLevelDefaultValue
+				));
+			break;
+		case apvts::ParameterEnum::CABINET_MIC2_DELAY:
+		case apvts::ParameterEnum::CABINET_MIC3_DELAY:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				apvts::cabinetMicrophoneDelayNormalisableRange,
+				apvts::cabinetMicrophoneDelayDefaultValue
+				));
+			break;
+		case apvts::ParameterEnum::CABINET_QUALITY:
+		{
+			juce::StringArray cabinetQualityNames;
+			for (const auto& name : apvts::cabinetQualityNames) {
+				cabinetQualityNames.add(name);
+			}
+
+			layout.add(std::make_unique<juce::AudioParameterChoice>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				cabinetQualityNames,
+				static_cast<int>(apvts::cabinetQualityNames.size()) - 1));
+		}
+		break;
 		case apvts::ParameterEnum::PRE_COMPRESSOR_THRESHOLD:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
 				juce::ParameterID{ parameterId, apvts::version },
@@ -405,6 +722,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				apvts::defaultValueHalf
 				));
 			break;
+		case apvts::ParameterEnum::DELAY_CROSS_FEED:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				apvts::zeroToOneLinearNormalisableRange,
+				apvts::defaultValueOff
+				));
+			break;
 		case apvts::ParameterEnum::NOISE_GATE_THRESHOLD:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
 				juce::ParameterID{ parameterId, apvts::version },
@@ -431,6 +756,38 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				waveShaperIdsJuceStringArray,
 				1));
 			break;
+		case apvts::ParameterEnum::STAGE1_ANTIALIASING:
+		case apvts::ParameterEnum::STAGE2_ANTIALIASING:
+		case apvts::ParameterEnum::STAGE3_ANTIALIASING:
+		case apvts::ParameterEnum::STAGE4_ANTIALIASING:
+			layout.add(std::make_unique<juce::AudioParameterChoice>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				antialiasingIdsJuceStringArray,
+				0));
+			break;
+		case apvts::ParameterEnum::OVERSAMPLING_FACTOR:
+		{
+			juce::StringArray oversamplingFactorNames;
+			for (const auto& name : apvts::oversamplingFactorNames) {
+				oversamplingFactorNames.add(name);
+			}
+
+			layout.add(std::make_unique<juce::AudioParameterChoice>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				oversamplingFactorNames,
+				0));
+		}
+		break;
+		case apvts::ParameterEnum::EFFECT_RELEASE_DELAY:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				apvts::effectReleaseDelaySecondsNormalisableRange,
+				apvts::effectReleaseDelaySecondsDefaultValue
+				));
+			break;
 		case apvts::ParameterEnum::BIAS:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
 				juce::ParameterID{ parameterId, apvts::version },
@@ -482,6 +839,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				Chorus::frequencyDefaultValue
 				));
 			break;
+		case apvts::ParameterEnum::CHORUS_VOICES:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				Chorus::voicesNormalisableRange,
+				Chorus::voicesDefaultValue
+				));
+			break;
 		case apvts::ParameterEnum::CHORUS_DEPTH:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
 				juce::ParameterID{ parameterId, apvts::version },
@@ -546,6 +911,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				Phaser::feedbackDefaultValue
 				));
 			break;
+		case apvts::ParameterEnum::PHASER_STAGES:
+			layout.add(std::make_unique<juce::AudioParameterFloat>(
+				juce::ParameterID{ parameterId, apvts::version },
+				PluginUtils::toTitleCase(parameterId),
+				Phaser::stagesNormalisableRange,
+				Phaser::stagesDefaultValue
+				));
+			break;
 		case apvts::ParameterEnum::DELAY_RIGHT_MS:
 		case apvts::ParameterEnum::DELAY_LEFT_MS:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
@@ -812,6 +1185,8 @@ juce::AudioProcessorValueTreeState::ParameterLayout PluginAudioProcessor::create
 				));
 			break;
 		case apvts::ParameterEnum::CABINET_IMPULSE_RESPONSE_INDEX:
+		case apvts::ParameterEnum::CABINET_MIC2_INDEX:
+		case apvts::ParameterEnum::CABINET_MIC3_INDEX:
 			layout.add(std::make_unique<juce::AudioParameterFloat>(
 				juce::ParameterID{ parameterId, apvts::version },
 				PluginUtils::toTitleCase(parameterId),
@@ -838,158 +1213,56 @@ void PluginAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 	spec.maximumBlockSize = samplesPerBlock;
 	spec.numChannels = numChannels;
 
-	mAudioFifo->setSize(numChannels, samplesPerBlock * 4.0f);
-	mAudioBuffer->setSize(numChannels, samplesPerBlock * 2.0f);
-
-	mPitchMPM->setBufferSize(1024);
-	mPitchMPM->setSampleRate(sampleRate);
+	mTunerAnalyserPtr->prepare(spec);
 
 	mInputLevelMeterSourcePtr->resize(getTotalNumOutputChannels(), sampleRate * 0.1 / samplesPerBlock);
 	mOutputLevelMeterSourcePtr->resize(getTotalNumOutputChannels(), sampleRate * 0.1 / samplesPerBlock);
 
-	mInputGainPtr->prepare(spec);
-
-	mNoiseGate->prepare(spec);
-	mPreCompressorPtr->prepare(spec);
-	mPreCompressorGainPtr->prepare(spec);
-	mPreCompressorDryWetMixerPtr->prepare(spec);
-
-	mGraphicEqualiser->prepare(spec);
-
-	mTubeScreamerPtr->prepare(spec);
-	mMouseDrivePtr->prepare(spec);
-
-	mStage1Buffer->setSize(numChannels, samplesPerBlock);
-	mStage1InputGainPtr->prepare(spec);
-	mStage1WaveShaperPtr->prepare(spec);
-	mStage1OutputGainPtr->prepare(spec);
-	mStage1DryWetMixerPtr->prepare(spec);
-
-	mStage2Buffer->setSize(numChannels, samplesPerBlock);
-	mStage2InputGainPtr->prepare(spec);
-	mStage2WaveShaperPtr->prepare(spec);
-	mStage2OutputGainPtr->prepare(spec);
-	mStage2DryWetMixerPtr->prepare(spec);
-
-	mStage3Buffer->setSize(numChannels, samplesPerBlock);
-	mStage3InputGainPtr->prepare(spec);
-	mStage3WaveShaperPtr->prepare(spec);
-	mStage3OutputGainPtr->prepare(spec);
-	mStage3DryWetMixerPtr->prepare(spec);
-
-	mStage4Buffer->setSize(numChannels, samplesPerBlock);
-	mStage4InputGainPtr->prepare(spec);
-	mStage4WaveShaperPtr->prepare(spec);
-	mStage4OutputGainPtr->prepare(spec);
-	mStage4DryWetMixerPtr->prepare(spec);
+	mOversamplingFactor = 1 << static_cast<int>(*mAudioProcessorValueTreeStatePtr->getRawParameterValue(apvts::oversamplingFactorId));
+	mEffectChainPtr->setOversamplingFactor(mOversamplingFactor);
+	mEffectChainPtr->prepare(spec);
 
-	mBiasPtr->prepare(spec);
-	mAmplifierEqualiser->prepare(spec);
+	// The host has stopped the audio thread, so nothing reads the retired tables.
+	mAcknowledgedWaveShaperCurveGeneration.store(mWaveShaperCurveGeneration.load());
+	loadWaveShaperCurveFromState();
 
-	const auto maximumDelayInSamples = apvts::delayTimeMsMaximumValue * (spec.sampleRate / 1000);
-	mDelayLineLeftPtr->setMaximumDelayInSamples(maximumDelayInSamples);
-	mDelayLineLeftPtr->prepare(spec);
-	mDelayLineRightPtr->setMaximumDelayInSamples(maximumDelayInSamples);
-	mDelayLineRightPtr->prepare(spec);
-	mDelayLineDryWetMixerPtr->prepare(spec);
+	applyParameterValues();
 
-	mDelayLowPassFilterPtr->prepare(spec);
-	mDelayHighPassFilterPtr->prepare(spec);
+	loadChainOrderFromState();
+	updateLatency();
 
-	mChorusPtr->prepare(spec);
-	mPhaserPtr->prepare(spec);
-	mFlangerPtr->prepare(spec);
-	mBitcrusherPtr->prepare(spec);
-
-	mCabinetImpulseResponseConvolutionPtr->prepare(spec);
-	mLofiImpulseResponseConvolutionPtr->prepare(spec);
-	loadImpulseResponseFromState();
-
-	mInstrumentEqualiserPtr->prepare(spec);
-	mInstrumentCompressorPtr->prepare(spec);
-
-	if (*mAudioProcessorValueTreeStatePtr->getRawParameterValue(apvts::instrumentCompressorIsLookaheadOn) > 0.5f)
-	{
-		setLatencySamples(static_cast<int>(0.005 * sampleRate));
-	}
-	else
-	{
-		setLatencySamples(0);
-	}
-
-	mReverbPtr->prepare(spec);
-
-	mCabinetGainPtr->prepare(spec);
-	mLimiterPtr->prepare(spec);
-
-	mOutputGainPtr->prepare(spec);
+	// Handed to the folder's thread now rather than from handleAsyncUpdate(), as
+	// a host rendering offline may never run the message thread. Later changes
+	// still fold it again from there.
+	foldLinearStages();
+}
 
+// Sets every processor from the state, without asking for any of the updates
+// a change would, as the values are the ones they were already made for.
+void PluginAudioProcessor::applyParameterValues()
+{
 	for (const auto& patameterIdToEnum : apvts::parameterIdToEnumMap)
 	{
 		float newValue = *mAudioProcessorValueTreeStatePtr->getRawParameterValue(patameterIdToEnum.first);
-		parameterChanged(patameterIdToEnum.first, newValue);
+		applyParameterValue(patameterIdToEnum.second, newValue);
 	}
 }
 
-void PluginAudioProcessor::reset()
+void PluginAudioProcessor::updateLatency()
 {
-	mInputGainPtr->reset();
+	auto latencyInSamples = juce::roundToInt(mEffectChainPtr->getLatencyInSamples());
 
-	mNoiseGate->reset();
-	mPreCompressorPtr->reset();
-	mPreCompressorGainPtr->reset();
-
-	mPreCompressorDryWetMixerPtr->reset();
-
-	mTubeScreamerPtr->reset();
-	mMouseDrivePtr->reset();
-
-	mStage1InputGainPtr->reset();
-	mStage1WaveShaperPtr->reset();
-	mStage1OutputGainPtr->reset();
-	mStage1DryWetMixerPtr->reset();
-
-	mStage2InputGainPtr->reset();
-	mStage2WaveShaperPtr->reset();
-	mStage2OutputGainPtr->reset();
-	mStage2DryWetMixerPtr->reset();
-
-	mStage3InputGainPtr->reset();
-	mStage3WaveShaperPtr->reset();
-	mStage3OutputGainPtr->reset();
-	mStage3DryWetMixerPtr->reset();
-
-	mStage4InputGainPtr->reset();
-	mStage4WaveShaperPtr->reset();
-	mStage4OutputGainPtr->reset();
-	mStage4DryWetMixerPtr->reset();
-
-	mBiasPtr->reset();
-	mAmplifierEqualiser->reset();
-
-	mDelayLineLeftPtr->reset();
-	mDelayLineRightPtr->reset();
-	mDelayLineDryWetMixerPtr->reset();
-	mDelayLowPassFilterPtr->reset();
-	mDelayHighPassFilterPtr->reset();
-
-	mChorusPtr->reset();
-	mPhaserPtr->reset();
-	mFlangerPtr->reset();
-	mBitcrusherPtr->reset();
-
-	mCabinetImpulseResponseConvolutionPtr->reset();
-	mLofiImpulseResponseConvolutionPtr->reset();
-	mInstrumentEqualiserPtr->reset();
-	//mInstrumentCompressor->reset();
-
-	mReverbPtr->reset();
-
-	mCabinetGainPtr->reset();
+	if (mIsInstrumentCompressorLookaheadOn)
+	{
+		latencyInSamples += static_cast<int>(0.005 * getSampleRate());
+	}
 
-	mLimiterPtr->reset();
+	setLatencySamples(latencyInSamples);
+}
 
-	mOutputGainPtr->reset();
+void PluginAudioProcessor::reset()
+{
+	mEffectChainPtr->reset();
 }
 
 void PluginAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
@@ -1001,11 +1274,20 @@ void PluginAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::
 	const double rawBeatsPerMinute = getPlayHead()->getPosition()->getBpm().orFallback(120);
 	mBpmSmoothedValue.setTargetValue(rawBeatsPerMinute);
 
+	// The wave shapers read their table from here on, so only tables set with
+	// this generation or later ones.
+	mAcknowledgedWaveShaperCurveGeneration.store(
+		mWaveShaperCurveGeneration.load(std::memory_order_acquire),
+		std::memory_order_release);
+
 	if (mIsBypassOn)
 	{
 		return;
 	}
 
+	mStageProfilerPtr->beginBlock(numSamples, getSampleRate());
+	StageProfiler::ScopedTimer totalTimer(*mStageProfilerPtr, ProfiledStage::total);
+
 	mInputLevelMeterSourcePtr->measureBlock(buffer);
 
 	for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
@@ -1013,190 +1295,34 @@ void PluginAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::
 		buffer.clear(i, 0, numSamples);
 	}
 
-	auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
-	auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
-
 	if (mTunerOn)
 	{
-		mAudioFifo->write(buffer);
-		mAudioFifo->read(*mAudioBuffer);
-		mPitchAtom = mPitchMPM->getPitch(mAudioBuffer->getReadPointer(0));
-	}
-
-	mNoiseGate->process(processContext);
-	mInputGainPtr->process(processContext);
-
-	if (mIsPreCompressorOn)
-	{
-		mPreCompressorDryWetMixerPtr->pushDrySamples(audioBlock);
-		float preCompressorInputRms = mIsPreCompressorAutoMakeup ? buffer.getRMSLevel(0, 0, numSamples) : 0;
-		mPreCompressorPtr->process(processContext);
-
-		if (mIsPreCompressorAutoMakeup)
-		{
-			float preCompressorOutputRms = buffer.getRMSLevel(0, 0, numSamples);
-			mPreCompressorGainSmoothedValue.setTargetValue(std::min(preCompressorInputRms / preCompressorOutputRms, 12.0f));
-
-			for (int sample = 0; sample < numSamples; ++sample)
-			{
-				float preCompressorGainSmoothedNextValue = mPreCompressorGainSmoothedValue.getNextValue();
-
-				for (int channel = 0; channel < totalNumInputChannels; ++channel)
-				{
-					auto* channelData = buffer.getWritePointer(channel);
-					channelData[sample] *= preCompressorGainSmoothedNextValue;
-				}
-			}
-		}
-
-		mPreCompressorGainPtr->process(processContext);
-		mPreCompressorDryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	if (mIsGraphicEqualiserOn)
-	{
-		mGraphicEqualiser->processBlock(buffer);
-	}
-
-	if (mIsTubeScreamerOn)
-	{
-		mTubeScreamerPtr->processBlock(buffer);
-	}
-
-	if (mIsMouseDriveOn)
-	{
-		mMouseDrivePtr->processBlock(buffer);
-	}
-
-	if (mIsStage1On)
-	{
-		mStage1DryWetMixerPtr->pushDrySamples(audioBlock);
-		mStage1InputGainPtr->process(processContext);
-		mStage1WaveShaperPtr->process(processContext);
-		mStage1OutputGainPtr->process(processContext);
-		mStage1DryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	if (mIsStage2On)
-	{
-		mStage2DryWetMixerPtr->pushDrySamples(audioBlock);
-		mStage2InputGainPtr->process(processContext);
-		mStage2WaveShaperPtr->process(processContext);
-		mStage2OutputGainPtr->process(processContext);
-		mStage2DryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	if (mIsStage3On)
-	{
-		mStage3DryWetMixerPtr->pushDrySamples(audioBlock);
-		mStage3InputGainPtr->process(processContext);
-		mStage3WaveShaperPtr->process(processContext);
-		mStage3OutputGainPtr->process(processContext);
-		mStage3DryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	if (mIsStage4On)
-	{
-		mStage4DryWetMixerPtr->pushDrySamples(audioBlock);
-		mStage4InputGainPtr->process(processContext);
-		mStage4WaveShaperPtr->process(processContext);
-		mStage4OutputGainPtr->process(processContext);
-		mStage4DryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	mAmplifierEqualiser->processBlock(buffer);
-	mBiasPtr->process(processContext);
-
-	if (mDelayFeedback > 0.0f && mIsDelayOn)
-	{
-		mDelayLineDryWetMixerPtr->pushDrySamples(audioBlock);
-
-		auto* leftChannelData = audioBlock.getChannelPointer(0);
-		if (leftChannelData)
 		{
-			for (int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
-			{
-				const float delayedSample = mDelayLineLeftPtr->popSample(0, mDelayLineLeftPtr->getDelay());
-
-				if (sampleIndex < audioBlock.getNumSamples())
-				{
-					mDelayLineLeftPtr->pushSample(0, leftChannelData[sampleIndex] + mDelayFeedback * delayedSample);
-					leftChannelData[sampleIndex] += delayedSample;
-				}
-			}
+			StageProfiler::ScopedTimer timer(*mStageProfilerPtr, ProfiledStage::tuner);
+			mTunerAnalyserPtr->push(buffer);
 		}
 
-		auto* rightChannelData = audioBlock.getChannelPointer(1);
-		if (rightChannelData)
+		// Silent tuning skips the whole chain rather than running it to no end.
+		if (mIsTunerMuteOn)
 		{
-			for (int sampleIndex = 0; sampleIndex < numSamples; ++sampleIndex)
-			{
-				const float delayedSample = mDelayLineRightPtr->popSample(0, mDelayLineRightPtr->getDelay());
-
-				if (sampleIndex < audioBlock.getNumSamples())
-				{
-					mDelayLineRightPtr->pushSample(0, rightChannelData[sampleIndex] + mDelayFeedback * delayedSample);
-					rightChannelData[sampleIndex] += delayedSample;
-				}
-			}
+			buffer.clear();
+			mOutputLevelMeterSourcePtr->measureBlock(buffer);
+			return;
 		}
-
-		juce::dsp::ProcessContextReplacing<float> wetContext(audioBlock);
-
-		mDelayLowPassFilterPtr->process(wetContext);
-		mDelayHighPassFilterPtr->process(wetContext);
-		mDelayLineDryWetMixerPtr->mixWetSamples(audioBlock);
-	}
-
-	mChorusPtr->process(buffer);
-	mPhaserPtr->process(buffer);
-	mFlangerPtr->process(buffer);
-	mBitcrusherPtr->process(buffer);
-
-	if (mIsReverbOn)
-	{
-		mReverbPtr->process(processContext);
-	}
-
-	if (mIsCabImpulseResponseConvolutionOn)
-	{
-		mCabinetImpulseResponseConvolutionPtr->process(processContext);
-		mCabinetGainPtr->process(processContext);
-	}
-
-	if (mIsInstrumentCompressorPreEqualiser)
-	{
-		mInstrumentCompressorPtr->process(buffer);
 	}
 
-	mInstrumentEqualiserPtr->processBlock(buffer);
-
-	if (!mIsInstrumentCompressorPreEqualiser)
-	{
-		mInstrumentCompressorPtr->process(buffer);
-	}
-
-	if (mIsLimiterOn)
-	{
-		mLimiterPtr->process(processContext);
-	}
-
-	if (mIsLofi)
-	{
-		mLofiImpulseResponseConvolutionPtr->process(processContext);
-	}
-
-	mOutputGainPtr->process(processContext);
+	mLinearStageFolderPtr->beginBlock();
+	mEffectChainPtr->processBlock(buffer);
 
 	mOutputLevelMeterSourcePtr->measureBlock(buffer);
 
 #ifdef JUCE_DEBUG
-	PluginUtils::checkForInvalidSamples(audioBlock);
+	PluginUtils::checkForInvalidSamples(juce::dsp::AudioBlock<float>(buffer));
 #endif
 }
 
 
-void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceString, float newValue)
+void PluginAudioProcessor::applyParameterValue(apvts::ParameterEnum parameterEnum, float newValue)
 {
 	auto sampleRate = getSampleRate();
 	auto playhead = this->getPlayHead();
@@ -1212,7 +1338,7 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		}
 	}
 
-	switch (apvts::parameterIdToEnumMap.at(parameterIdJuceString.toStdString()))
+	switch (parameterEnum)
 	{
 	case apvts::ParameterEnum::INPUT_GAIN:
 		mInputGainPtr->setGainDecibels(newValue);
@@ -1227,16 +1353,16 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mIsBypassOn = static_cast<bool>(newValue);
 		break;
 	case apvts::ParameterEnum::STAGE1_ON:
-		mIsStage1On = static_cast<bool>(newValue);
+		mPreampPtr->setStageIsOn(0, static_cast<bool>(newValue));
 		break;
 	case apvts::ParameterEnum::STAGE2_ON:
-		mIsStage2On = static_cast<bool>(newValue);
+		mPreampPtr->setStageIsOn(1, static_cast<bool>(newValue));
 		break;
 	case apvts::ParameterEnum::STAGE3_ON:
-		mIsStage3On = static_cast<bool>(newValue);
+		mPreampPtr->setStageIsOn(2, static_cast<bool>(newValue));
 		break;
 	case apvts::ParameterEnum::STAGE4_ON:
-		mIsStage4On = static_cast<bool>(newValue);
+		mPreampPtr->setStageIsOn(3, static_cast<bool>(newValue));
 		break;
 	case apvts::ParameterEnum::PRE_EQUALISER_ON:
 		mIsGraphicEqualiserOn = static_cast<bool>(newValue);
@@ -1287,52 +1413,64 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mIsPreCompressorOn = static_cast<bool>(newValue);
 		break;
 	case apvts::ParameterEnum::STAGE1_INPUT_GAIN:
-		mStage1InputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageInputGainDecibels(0, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE2_INPUT_GAIN:
-		mStage2InputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageInputGainDecibels(1, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE3_INPUT_GAIN:
-		mStage3InputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageInputGainDecibels(2, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE4_INPUT_GAIN:
-		mStage4InputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageInputGainDecibels(3, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE1_WAVE_SHAPER:
-		mStage1WaveShaperPtr->functionToUse = apvts::waveShaperIdToFunctionMap.at(apvts::waveShaperIds.at(newValue));
+		mPreampPtr->setStageWaveShaperFunction(0, static_cast<WaveShaper::Function>(static_cast<int>(newValue)));
+		break;
+	case apvts::ParameterEnum::STAGE1_ANTIALIASING:
+		mPreampPtr->setStageAntialiasing(0, static_cast<WaveShaper::Antialiasing>(static_cast<int>(newValue)));
 		break;
 	case apvts::ParameterEnum::STAGE2_WAVE_SHAPER:
-		mStage2WaveShaperPtr->functionToUse = apvts::waveShaperIdToFunctionMap.at(apvts::waveShaperIds.at(newValue));
+		mPreampPtr->setStageWaveShaperFunction(1, static_cast<WaveShaper::Function>(static_cast<int>(newValue)));
+		break;
+	case apvts::ParameterEnum::STAGE2_ANTIALIASING:
+		mPreampPtr->setStageAntialiasing(1, static_cast<WaveShaper::Antialiasing>(static_cast<int>(newValue)));
 		break;
 	case apvts::ParameterEnum::STAGE3_WAVE_SHAPER:
-		mStage3WaveShaperPtr->functionToUse = apvts::waveShaperIdToFunctionMap.at(apvts::waveShaperIds.at(newValue));
+		mPreampPtr->setStageWaveShaperFunction(2, static_cast<WaveShaper::Function>(static_cast<int>(newValue)));
+		break;
+	case apvts::ParameterEnum::STAGE3_ANTIALIASING:
+		mPreampPtr->setStageAntialiasing(2, static_cast<WaveShaper::Antialiasing>(static_cast<int>(newValue)));
 		break;
 	case apvts::ParameterEnum::STAGE4_WAVE_SHAPER:
-		mStage4WaveShaperPtr->functionToUse = apvts::waveShaperIdToFunctionMap.at(apvts::waveShaperIds.at(newValue));
+		mPreampPtr->setStageWaveShaperFunction(3, static_cast<WaveShaper::Function>(static_cast<int>(newValue)));
+		break;
+	case apvts::ParameterEnum::STAGE4_ANTIALIASING:
+		mPreampPtr->setStageAntialiasing(3, static_cast<WaveShaper::Antialiasing>(static_cast<int>(newValue)));
 		break;
 	case apvts::ParameterEnum::STAGE1_OUTPUT_GAIN:
-		mStage1OutputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageOutputGainDecibels(0, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE2_OUTPUT_GAIN:
-		mStage2OutputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageOutputGainDecibels(1, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE3_OUTPUT_GAIN:
-		mStage3OutputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageOutputGainDecibels(2, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE4_OUTPUT_GAIN:
-		mStage4OutputGainPtr->setGainDecibels(newValue);
+		mPreampPtr->setStageOutputGainDecibels(3, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE1_DRY_WET_MIX:
-		mStage1DryWetMixerPtr->setWetMixProportion(newValue);
+		mPreampPtr->setStageMix(0, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE2_DRY_WET_MIX:
-		mStage2DryWetMixerPtr->setWetMixProportion(newValue);
+		mPreampPtr->setStageMix(1, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE3_DRY_WET_MIX:
-		mStage3DryWetMixerPtr->setWetMixProportion(newValue);
+		mPreampPtr->setStageMix(2, newValue);
 		break;
 	case apvts::ParameterEnum::STAGE4_DRY_WET_MIX:
-		mStage4DryWetMixerPtr->setWetMixProportion(newValue);
+		mPreampPtr->setStageMix(3, newValue);
 		break;
 	case apvts::ParameterEnum::BIAS:
 		mBiasPtr->setBias(newValue);
@@ -1359,7 +1497,10 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mIsCabImpulseResponseConvolutionOn = static_cast<bool>(newValue);
 		break;
 	case apvts::ParameterEnum::CABINET_OUTPUT_GAIN:
-		mCabinetGainPtr->setGainDecibels(newValue);
+		mCabinetGainDecibels = newValue;
+		break;
+	case apvts::ParameterEnum::CABINET_TRIM_THRESHOLD:
+		mCabinetTrimThresholdDecibels = newValue;
 		break;
 	case apvts::ParameterEnum::LIMITER_RELEASE:
 		mLimiterPtr->setRelease(newValue);
@@ -1379,6 +1520,9 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 	case apvts::ParameterEnum::CHORUS_FREQUENCY:
 		mChorusPtr->setFrequency(newValue);
 		break;
+	case apvts::ParameterEnum::CHORUS_VOICES:
+		mChorusPtr->setNumVoices(juce::roundToInt(newValue));
+		break;
 	case apvts::ParameterEnum::PHASER_DEPTH:
 		mPhaserPtr->setDepth(newValue);
 		break;
@@ -1391,6 +1535,9 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 	case apvts::ParameterEnum::PHASER_WIDTH:
 		mPhaserPtr->setWidth(newValue);
 		break;
+	case apvts::ParameterEnum::PHASER_STAGES:
+		mPhaserPtr->setNumStages(juce::roundToInt(newValue));
+		break;
 	case apvts::ParameterEnum::REVERB_SIZE:
 	{
 		const auto& parameters = mReverbPtr->getParameters();
@@ -1416,44 +1563,58 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 	}
 	break;
 	case apvts::ParameterEnum::DELAY_DRY_WET:
-		mDelayLineDryWetMixerPtr->setWetMixProportion(newValue);
+		mDelayWetMixProportion.store(newValue);
+		break;
+	case apvts::ParameterEnum::DELAY_PING_PONG:
+		mStereoDelayPtr->setIsPingPong(static_cast<bool>(newValue));
+		break;
+	case apvts::ParameterEnum::DELAY_CROSS_FEED:
+		mStereoDelayPtr->setCrossFeed(newValue);
 		break;
 	case apvts::ParameterEnum::DELAY_FEEDBACK:
+	{
+		const bool wasDelayAudible = mDelayFeedback > 0.0f;
 		mDelayFeedback = newValue;
-		break;
+		mStereoDelayPtr->setFeedback(newValue);
+		if (wasDelayAudible != (mDelayFeedback > 0.0f))
+		{
+			requestUpdates(compileUpdate);
+		}
+	}
+	break;
 	case apvts::ParameterEnum::DELAY_LOW_PASS_FREQUENCY:
-		*mDelayLowPassFilterPtr->state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(sampleRate, std::max(newValue, apvts::defaultEpsilon), 0.7);
+		mDelayFiltersPtr->setCoefficients(0, juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(sampleRate, std::max(newValue, apvts::defaultEpsilon), 0.7f));
 		break;
 	case apvts::ParameterEnum::DELAY_HIGH_PASS_FREQUENCY:
-		*mDelayHighPassFilterPtr->state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, std::max(newValue, apvts::defaultEpsilon), 0.7);
+		mDelayFiltersPtr->setCoefficients(1, juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(sampleRate, std::max(newValue, apvts::defaultEpsilon), 0.7f));
 		break;
 	case apvts::ParameterEnum::DELAY_LEFT_MS:
 		mDelayLeftMilliseconds = newValue;
-		mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, newValue));
+		mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForMilliseconds(sampleRate, newValue));
 		break;
 	case apvts::ParameterEnum::DELAY_RIGHT_MS:
 		mDelayRightMilliseconds = newValue;
-		mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, newValue));
+		mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForMilliseconds(sampleRate, newValue));
 		break;
 	case apvts::ParameterEnum::DELAY_LEFT_PER_BEAT:
 		mDelayLeftPerBeatDivision = newValue;
-		mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, newValue, sampleRate));
+		mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, newValue, sampleRate));
 		break;
 	case apvts::ParameterEnum::DELAY_RIGHT_PER_BEAT:
 		mDelayRightPerBeatDivision = newValue;
-		mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, newValue, sampleRate));
+		mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, newValue, sampleRate));
 		break;
 	case apvts::ParameterEnum::DELAY_IS_SYNCED:
 		mDelayBpmSynced = newValue;
 		if (mDelayBpmSynced)
 		{
-			mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
-			mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayRightPerBeatDivision, sampleRate));
+			mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
+			mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayRightPerBeatDivision, sampleRate));
 		}
 		else
 		{
-			mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
-			mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayRightMilliseconds));
+			mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
+			mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayRightMilliseconds));
 		}
 		break;
 	case apvts::ParameterEnum::NOISE_GATE_THRESHOLD:
@@ -1505,10 +1666,12 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mIsDelayOn = static_cast<bool>(newValue);
 		break;
 	case apvts::ParameterEnum::PHASER_IS_ON:
-		mPhaserPtr->setBypassed(!static_cast<bool>(newValue));
+		mIsPhaserOn = static_cast<bool>(newValue);
+		mPhaserPtr->setBypassed(!mIsPhaserOn);
 		break;
 	case apvts::ParameterEnum::CHORUS_ON:
-		mChorusPtr->setBypassed(!static_cast<bool>(newValue));
+		mIsChorusOn = static_cast<bool>(newValue);
+		mChorusPtr->setBypassed(!mIsChorusOn);
 		break;
 	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PASS_ON:
 		mInstrumentEqualiserPtr->setOnAtIndex(static_cast<bool>(newValue), 0);
@@ -1580,20 +1743,13 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mIsInstrumentCompressorPreEqualiser = static_cast<bool>(newValue);
 		break;
 	case apvts::ParameterEnum::INSTRUMENT_COMPRESSOR_IS_ON:
-		mInstrumentCompressorPtr->setPower(!static_cast<bool>(newValue));
+		mIsInstrumentCompressorOn = static_cast<bool>(newValue);
+		mInstrumentCompressorPtr->setPower(!mIsInstrumentCompressorOn);
 		break;
 	case apvts::ParameterEnum::INSTRUMENT_COMPRESSOR_LOOKAHEAD_ON:
 	{
 		const bool newBool = static_cast<bool>(newValue);
-		if (newBool)
-		{
-			setLatencySamples(static_cast<int>(0.005 * mInstrumentCompressorPtr->getSampleRate()));
-		}
-		else
-		{
-			setLatencySamples(0);
-		}
-
+		mIsInstrumentCompressorLookaheadOn = newBool;
 		mInstrumentCompressorPtr->setLookahead(newBool);
 	}
 	break;
@@ -1604,26 +1760,26 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		{
 			if (mDelayBpmSynced)
 			{
-				mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
-				mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
+				mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
+				mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
 			}
 			else
 			{
-				mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
-				mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
+				mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
+				mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
 			}
 		}
 		else
 		{
 			if (mDelayBpmSynced)
 			{
-				mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
-				mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayRightPerBeatDivision, sampleRate));
+				mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayLeftPerBeatDivision, sampleRate));
+				mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForBpmFractionAndRate(beatsPerMinute, mDelayRightPerBeatDivision, sampleRate));
 			}
 			else
 			{
-				mDelayLineLeftPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
-				mDelayLineRightPtr->setDelay(PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayRightMilliseconds));
+				mStereoDelayPtr->setDelay(0, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayLeftMilliseconds));
+				mStereoDelayPtr->setDelay(1, PluginUtils::calculateSamplesForMilliseconds(sampleRate, mDelayRightMilliseconds));
 			}
 		}
 
@@ -1677,7 +1833,8 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mInstrumentCompressorPtr->setMix(newValue);
 		break;
 	case apvts::ParameterEnum::BIT_CRUSHER_ON:
-		mBitcrusherPtr->setIsBypassed(!newValue);
+		mIsBitcrusherOn = static_cast<bool>(newValue);
+		mBitcrusherPtr->setIsBypassed(!mIsBitcrusherOn);
 		break;
 	case apvts::ParameterEnum::BIT_CRUSHER_SAMPLE_RATE:
 		mBitcrusherPtr->setTargetSampleRate(newValue);
@@ -1686,7 +1843,8 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		mBitcrusherPtr->setBitDepth(newValue);
 		break;
 	case apvts::ParameterEnum::FLANGER_ON:
-		mFlangerPtr->setBypassed(!static_cast<bool>(newValue));
+		mIsFlangerOn = static_cast<bool>(newValue);
+		mFlangerPtr->setBypassed(!mIsFlangerOn);
 		break;
 	case apvts::ParameterEnum::FLANGER_DELAY:
 		mFlangerPtr->setDelay(newValue);
@@ -1708,68 +1866,426 @@ void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceS
 		break;
 	case apvts::ParameterEnum::CABINET_IMPULSE_RESPONSE_INDEX:
 		mCabinetImpulseResponseIndex = newValue;
-		loadImpulseResponseFromState();
+		break;
+	case apvts::ParameterEnum::CABINET_MINIMUM_PHASE_ON:
+		mIsCabinetMinimumPhaseOn = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_QUALITY:
+		mCabinetQualityIndex = static_cast<int>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC2_ON:
+		mCabinetMicrophones[0].isOn = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC2_INDEX:
+		mCabinetMicrophones[0].impulseResponseIndex = static_cast<int>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC2_LEVEL:
+		mCabinetMicrophones[0].levelDecibels = newValue;
+		break;
+	case apvts::ParameterEnum::CABINET_MIC2_INVERT_ON:
+		mCabinetMicrophones[0].isPolarityInverted = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC2_DELAY:
+		mCabinetMicrophones[0].delayInMilliseconds = newValue;
+		break;
+	case apvts::ParameterEnum::CABINET_MIC3_ON:
+		mCabinetMicrophones[1].isOn = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC3_INDEX:
+		mCabinetMicrophones[1].impulseResponseIndex = static_cast<int>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC3_LEVEL:
+		mCabinetMicrophones[1].levelDecibels = newValue;
+		break;
+	case apvts::ParameterEnum::CABINET_MIC3_INVERT_ON:
+		mCabinetMicrophones[1].isPolarityInverted = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::CABINET_MIC3_DELAY:
+		mCabinetMicrophones[1].delayInMilliseconds = newValue;
 		break;
 	case apvts::ParameterEnum::TUNER_ON:
 		mTunerOn = static_cast<bool>(newValue);
 		break;
+	case apvts::ParameterEnum::TUNER_MUTE_ON:
+		mIsTunerMuteOn = static_cast<bool>(newValue);
+		break;
+	case apvts::ParameterEnum::TUNER_STRUM_ON:
+		mTunerAnalyserPtr->setIsStrumOn(static_cast<bool>(newValue));
+		break;
+	case apvts::ParameterEnum::OVERSAMPLING_FACTOR:
+		mOversamplingFactor = 1 << static_cast<int>(newValue);
+		break;
+	case apvts::ParameterEnum::EFFECT_RELEASE_DELAY:
+		mEffectChainPtr->setReleaseDelay(newValue);
+		break;
 	default:
 		assert(false);
 	}
 }
 
+void PluginAudioProcessor::parameterChanged(const juce::String& parameterIdJuceString, float newValue)
+{
+	const auto parameterEnum = apvts::parameterIdToEnumMap.at(parameterIdJuceString.toStdString());
+	applyParameterValue(parameterEnum, newValue);
+
+	// Switching a stage on or off changes which stages the audio thread runs, so
+	// the chain is recompiled on the message thread. That is also where the
+	// cabinet is folded again, which only the stages folded into it and the
+	// cabinet's own parameters change, and where the latency is reported, as
+	// this may be called on the audio thread.
+	switch (parameterEnum)
+	{
+	case apvts::ParameterEnum::PRE_COMPRESSOR_IS_ON:
+	case apvts::ParameterEnum::PRE_EQUALISER_ON:
+	case apvts::ParameterEnum::TUBE_SCREAMER_ON:
+	case apvts::ParameterEnum::MOUSE_DRIVE_ON:
+	case apvts::ParameterEnum::STAGE1_ON:
+	case apvts::ParameterEnum::STAGE2_ON:
+	case apvts::ParameterEnum::STAGE3_ON:
+	case apvts::ParameterEnum::STAGE4_ON:
+	case apvts::ParameterEnum::DELAY_ON:
+	case apvts::ParameterEnum::CHORUS_ON:
+	case apvts::ParameterEnum::PHASER_IS_ON:
+	case apvts::ParameterEnum::FLANGER_ON:
+	case apvts::ParameterEnum::BIT_CRUSHER_ON:
+	case apvts::ParameterEnum::REVERB_ON:
+	case apvts::ParameterEnum::CABINET_IMPULSE_RESPONSE_CONVOLUTION_ON:
+		requestUpdates(compileUpdate);
+		break;
+	case apvts::ParameterEnum::INSTRUMENT_COMPRESSOR_IS_ON:
+	case apvts::ParameterEnum::INSTRUMENT_COMPRESSOR_IS_PRE_EQ_ON:
+	case apvts::ParameterEnum::LIMITER_ON:
+	case apvts::ParameterEnum::IS_LOFI:
+		requestUpdates(compileUpdate | foldUpdate);
+		break;
+	case apvts::ParameterEnum::CABINET_IMPULSE_RESPONSE_INDEX:
+	case apvts::ParameterEnum::CABINET_OUTPUT_GAIN:
+	case apvts::ParameterEnum::CABINET_TRIM_THRESHOLD:
+	case apvts::ParameterEnum::CABINET_MINIMUM_PHASE_ON:
+	case apvts::ParameterEnum::CABINET_QUALITY:
+	case apvts::ParameterEnum::CABINET_MIC2_ON:
+	case apvts::ParameterEnum::CABINET_MIC2_INDEX:
+	case apvts::ParameterEnum::CABINET_MIC2_LEVEL:
+	case apvts::ParameterEnum::CABINET_MIC2_INVERT_ON:
+	case apvts::ParameterEnum::CABINET_MIC2_DELAY:
+	case apvts::ParameterEnum::CABINET_MIC3_ON:
+	case apvts::ParameterEnum::CABINET_MIC3_INDEX:
+	case apvts::ParameterEnum::CABINET_MIC3_LEVEL:
+	case apvts::ParameterEnum::CABINET_MIC3_INVERT_ON:
+	case apvts::ParameterEnum::CABINET_MIC3_DELAY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PASS_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PASS_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PASS_QUALITY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PEAK_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PEAK_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PEAK_GAIN:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PEAK_QUALITY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_MID_PEAK_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_MID_PEAK_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_MID_PEAK_GAIN:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_MID_PEAK_QUALITY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_MID_PEAK_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_MID_PEAK_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_MID_PEAK_GAIN:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_MID_PEAK_QUALITY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PEAK_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PEAK_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PEAK_GAIN:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_HIGH_PEAK_QUALITY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PASS_ON:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PASS_FREQUENCY:
+	case apvts::ParameterEnum::INSTRUMENT_EQUALISER_LOW_PASS_QUALITY:
+		requestUpdates(foldUpdate);
+		break;
+	case apvts::ParameterEnum::INSTRUMENT_COMPRESSOR_LOOKAHEAD_ON:
+	case apvts::ParameterEnum::OVERSAMPLING_FACTOR:
+		requestUpdates(latencyUpdate);
+		break;
+	default:
+		break;
+	}
+}
+
+// Any thread.
+void PluginAudioProcessor::requestUpdates(int updates)
+{
+	mPendingUpdates |= updates;
+	triggerAsyncUpdate();
+}
+
 void PluginAudioProcessor::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property)
 {
-	if (property == juce::Identifier(apvts::impulseResponseFileFullPathNameId))
+	if (property == juce::Identifier(apvts::impulseResponseFileFullPathNameId)
+		|| property == juce::Identifier(apvts::cabinetMicrophone2FileFullPathNameId)
+		|| property == juce::Identifier(apvts::cabinetMicrophone3FileFullPathNameId))
 	{
 		loadImpulseResponseFromState();
 	}
+	else if (property == juce::Identifier(apvts::chainOrderId))
+	{
+		loadChainOrderFromState();
+	}
+	else if (property == juce::Identifier(apvts::waveShaperCurveId))
+	{
+		loadWaveShaperCurveFromState();
+	}
 }
 
-void PluginAudioProcessor::loadImpulseResponseFromState()
+void PluginAudioProcessor::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
 {
-	const auto impulseResponseFullPathName = mAudioProcessorValueTreeStatePtr->state.getProperty(
-		juce::String(apvts::impulseResponseFileFullPathNameId),
+	loadChainOrderFromState();
+	loadWaveShaperCurveFromState();
+}
+
+void PluginAudioProcessor::handleAsyncUpdate()
+{
+	auto pendingUpdates = mPendingUpdates.exchange(0);
+
+	if (mOversamplingFactor != mEffectChainPtr->getOversamplingFactor())
+	{
+		// The oversampled stages are prepared again at the new rate, which must not
+		// happen during a callback, and then need their parameters applied again.
+		suspendProcessing(true);
+		mEffectChainPtr->setOversamplingFactor(mOversamplingFactor);
+		applyParameterValues();
+		suspendProcessing(false);
+		pendingUpdates |= compileUpdate;
+	}
+
+	// Stages prepared on demand may have been reset to their defaults.
+	if (mEffectChainPtr->takeNewlyPreparedSlots())
+	{
+		applyParameterValues();
+		pendingUpdates |= compileUpdate;
+	}
+
+	if ((pendingUpdates & compileUpdate) != 0)
+	{
+		mEffectChainPtr->compile();
+	}
+
+	if ((pendingUpdates & foldUpdate) != 0)
+	{
+		foldLinearStages();
+	}
+
+	// Which stages run oversampled, and so the oversamplers' latency, is only
+	// known once the chain is compiled.
+	if ((pendingUpdates & (compileUpdate | latencyUpdate)) != 0)
+	{
+		updateLatency();
+	}
+}
+
+void PluginAudioProcessor::setChainOrder(const juce::StringArray& newOrder)
+{
+	mAudioProcessorValueTreeStatePtr->state.setProperty(
+		juce::Identifier(apvts::chainOrderId),
+		newOrder.joinIntoString(","),
+		nullptr);
+}
+
+void PluginAudioProcessor::loadChainOrderFromState()
+{
+	const auto chainOrder = mAudioProcessorValueTreeStatePtr->state.getProperty(
+		juce::Identifier(apvts::chainOrderId),
+		juce::String()).toString();
+
+	mEffectChainPtr->setOrder(juce::StringArray::fromTokens(chainOrder, ",", ""));
+	mEffectChainPtr->compile();
+}
+
+void PluginAudioProcessor::setWaveShaperCurve(const WaveShaperCurve& newCurve)
+{
+	mAudioProcessorValueTreeStatePtr->state.setProperty(
+		juce::Identifier(apvts::waveShaperCurveId),
+		newCurve.toString(),
+		nullptr);
+}
+
+WaveShaperCurve PluginAudioProcessor::getWaveShaperCurve() const
+{
+	const auto text = mAudioProcessorValueTreeStatePtr->state.getProperty(
+		juce::Identifier(apvts::waveShaperCurveId),
 		juce::String()).toString();
-	juce::File* impulseResponseFile = new juce::File(impulseResponseFullPathName);
 
-	if (impulseResponseFullPathName.length() > 0)
+	return WaveShaperCurve::fromString(text);
+}
+
+void PluginAudioProcessor::loadWaveShaperCurveFromState()
+{
+	auto newTable = mWaveShaperTableCache->getTable(getWaveShaperCurve());
+	if (newTable == mWaveShaperCurveTable)
 	{
-		mCabinetImpulseResponseConvolutionPtr->loadImpulseResponse(
-			*impulseResponseFile,
-			juce::dsp::Convolution::Stereo::yes,
-			juce::dsp::Convolution::Trim::no, 0,
-			juce::dsp::Convolution::Normalise::yes
-		);
+		return;
 	}
-	else
+
+	mPreampPtr->setCurveTable(newTable.get());
+	const auto generation = mWaveShaperCurveGeneration.fetch_add(1, std::memory_order_release) + 1;
+
+	if (mWaveShaperCurveTable != nullptr)
 	{
-		switch (mCabinetImpulseResponseIndex)
+		mRetiredWaveShaperCurveTables.emplace_back(generation, std::move(mWaveShaperCurveTable));
+	}
+
+	mWaveShaperCurveTable = std::move(newTable);
+	collectRetiredWaveShaperCurveTables();
+}
+
+// Once processBlock() has acknowledged a generation, every table it reads is
+// that generation's or a later one's, and the blocks that read the tables it
+// replaced are over.
+void PluginAudioProcessor::collectRetiredWaveShaperCurveTables()
+{
+	const auto acknowledgedGeneration = mAcknowledgedWaveShaperCurveGeneration.load(std::memory_order_acquire);
+
+	std::erase_if(mRetiredWaveShaperCurveTables, [acknowledgedGeneration](const auto& retiredTable)
 		{
-		case 0:
-			mCabinetImpulseResponseConvolutionPtr->loadImpulseResponse(
-				BinaryData::default_cab_wav,
-				BinaryData::default_cab_wavSize,
-				juce::dsp::Convolution::Stereo::yes,
-				juce::dsp::Convolution::Trim::no,
-				BinaryData::default_cab_wavSize,
-				juce::dsp::Convolution::Normalise::yes);
-			break;
-		case 1:
-			mCabinetImpulseResponseConvolutionPtr->loadImpulseResponse(
-				BinaryData::croy_cab_wav,
-				BinaryData::croy_cab_wavSize,
-				juce::dsp::Convolution::Stereo::yes,
-				juce::dsp::Convolution::Trim::no,
-				BinaryData::croy_cab_wavSize,
-				juce::dsp::Convolution::Normalise::yes);
-			break;
-		default:
-			break;
+			return retiredTable.first <= acknowledgedGeneration;
+		});
+}
+
+void PluginAudioProcessor::loadImpulseResponseFromState()
+{
+	// Loading a preset or a session asks for this more than once, and changes
+	// parameters that fold the cabinet again too, so it all waits for one fold.
+	requestUpdates(foldUpdate);
+}
+
+void PluginAudioProcessor::foldLinearStages()
+{
+	const auto sampleRate = getSampleRate();
+	if (sampleRate <= 0.0)
+	{
+		return;
+	}
+
+	LinearStageFolder::Settings settings;
+	settings.cabinetGainDecibels = mCabinetGainDecibels;
+	settings.conditioning.tailThresholdDecibels = mCabinetTrimThresholdDecibels;
+	settings.conditioning.isMinimumPhase = mIsCabinetMinimumPhaseOn;
+	settings.conditioning.maximumLengthInSeconds = apvts::cabinetQualityMaximumLengthsInSeconds[static_cast<size_t>(
+		juce::jlimit(0, static_cast<int>(apvts::cabinetQualityMaximumLengthsInSeconds.size()) - 1, mCabinetQualityIndex))];
+
+	// The cabinet's own microphone comes first, and the others are blended with
+	// it, levelled, inverted and delayed against it.
+	LinearStageFolder::Microphone ownMicrophone;
+	ownMicrophone.source = getCabinetImpulseResponseSource(apvts::impulseResponseFileFullPathNameId, mCabinetImpulseResponseIndex);
+	settings.microphones.push_back(std::move(ownMicrophone));
+
+	static const std::array<std::string, 2> microphoneFileFullPathNameIds = {
+		apvts::cabinetMicrophone2FileFullPathNameId,
+		apvts::cabinetMicrophone3FileFullPathNameId
+	};
+
+	for (size_t index = 0; index < mCabinetMicrophones.size(); ++index)
+	{
+		const auto& cabinetMicrophone = mCabinetMicrophones[index];
+		if (!cabinetMicrophone.isOn)
+		{
+			continue;
 		}
+
+		LinearStageFolder::Microphone microphone;
+		microphone.source = getCabinetImpulseResponseSource(microphoneFileFullPathNameIds[index], cabinetMicrophone.impulseResponseIndex);
+		microphone.gainDecibels = cabinetMicrophone.levelDecibels;
+		microphone.isPolarityInverted = cabinetMicrophone.isPolarityInverted;
+		microphone.delayInMilliseconds = cabinetMicrophone.delayInMilliseconds;
+		settings.microphones.push_back(std::move(microphone));
+	}
+
+	// Only what follows the cabinet with nothing between them that is not linear
+	// and time invariant can be folded into it. The instrument compressor and the
+	// limiter are neither, and the limiter is on by default.
+	const auto isEqualiserFoldable = !(mIsInstrumentCompressorOn && mIsInstrumentCompressorPreEqualiser);
+	const auto isLofiFoldable = !mIsInstrumentCompressorOn && !mIsLimiterOn;
+
+	if (isEqualiserFoldable)
+	{
+		settings.equaliserImpulseResponse.resize(static_cast<size_t>(
+			juce::roundToInt(sampleRate * LinearStageFolder::equaliserImpulseResponseLengthInSeconds)));
+		mInstrumentEqualiserPtr->renderImpulseResponse(
+			settings.equaliserImpulseResponse.data(),
+			static_cast<int>(settings.equaliserImpulseResponse.size()));
+	}
+
+	if (isLofiFoldable && mIsLofi)
+	{
+		settings.lofi.data = BinaryData::lofi_cab_wav;
+		settings.lofi.dataSize = BinaryData::lofi_cab_wavSize;
+	}
+
+	mLinearStageFolderPtr->fold(std::move(settings));
+}
+
+// The file the state names, or else the built in cabinet at index.
+ImpulseResponseSource PluginAudioProcessor::getCabinetImpulseResponseSource(const std::string& fileFullPathNameId, int index) const
+{
+	ImpulseResponseSource source;
+
+	const auto fullPathName = mAudioProcessorValueTreeStatePtr->state.getProperty(
+		juce::String(fileFullPathNameId),
+		juce::String()).toString();
+
+	if (fullPathName.length() > 0)
+	{
+		source.file = juce::File(fullPathName);
+		return source;
+	}
+
+	switch (index)
+	{
+	case 0:
+		source.data = BinaryData::default_cab_wav;
+		source.dataSize = BinaryData::default_cab_wavSize;
+		break;
+	case 1:
+		source.data = BinaryData::croy_cab_wav;
+		source.dataSize = BinaryData::croy_cab_wavSize;
+		break;
+	default:
+		break;
+	}
+
+	return source;
+}
+
+void PluginAudioProcessor::prepareLofiConvolution(const juce::dsp::ProcessSpec& spec)
+{
+	ImpulseResponseSource lofi;
+	lofi.data = BinaryData::lofi_cab_wav;
+	lofi.dataSize = BinaryData::lofi_cab_wavSize;
+
+	// Prepared for no longer a kernel than the impulse response, which is short.
+	const auto impulseResponse = mImpulseResponseCache->getImpulseResponse(lofi, spec.sampleRate);
+	const auto length = impulseResponse != nullptr ? impulseResponse->buffer.getNumSamples() : 1;
+	mLofiConvolutionPtr->prepare(spec, length, getConvolutionPartitionSize());
+
+	if (impulseResponse != nullptr)
+	{
+		mLofiConvolutionPtr->setKernel(PartitionedConvolution::createKernel(
+			impulseResponse->buffer,
+			mLofiConvolutionPtr->getPartitionSize(),
+			length,
+			0));
 	}
 }
 
+void PluginAudioProcessor::setConvolutionPartitionSize(int partitionSize)
+{
+	mConvolutionPartitionSize.store(partitionSize);
+}
+
+int PluginAudioProcessor::getConvolutionPartitionSize() const
+{
+	if (const auto partitionSize = mConvolutionPartitionSize.load(); partitionSize != PartitionedConvolution::timedPartitionSize)
+	{
+		return partitionSize;
+	}
+
+	return isNonRealtime() ? PartitionedConvolution::defaultPartitionSize : PartitionedConvolution::timedPartitionSize;
+}
+
 void PluginAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
 	auto state = mAudioProcessorValueTreeStatePtr->copyState();
@@ -1799,11 +2315,18 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 
 PluginAudioProcessor::~PluginAudioProcessor()
 {
+	// The chain prepares stages on a thread of its own, which has to stop before
+	// the processors it prepares are destroyed.
+	mEffectChainPtr.reset();
 }
 
 const juce::String PluginAudioProcessor::getName() const
 {
+#ifdef JucePlugin_Name
 	return JucePlugin_Name;
+#else
+	return ProjectInfo::projectName;
+#endif
 }
 
 bool PluginAudioProcessor::acceptsMidi() const
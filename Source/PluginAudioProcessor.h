@@ -26,17 +26,23 @@
 #include "PluginPresetManager.h"
 #include "Processors/Saturators/MouseDrive.h"
 #include "Processors/Saturators/TubeScreamer.h"
+#include "Processors/Saturators/Preamp.h"
 #include "Processors/Equilisers/GraphicEqualiser.h"
 #include "Processors/Equilisers/AmplifierEqualiser.h"
 #include "Processors/Equilisers/InstrumentEqualiser.h"
+#include "Processors/Equilisers/BiquadCascade.h"
 #include "Processors/CTAGDRC/dsp/include/Compressor.h"
 #include "Processors/Other/Bitcrusher.h"
+#include "Processors/Other/TunerAnalyser.h"
 #include "Processors/Modulators/Phaser.h"
 #include "Processors/Modulators/Chorus.h"
 #include "Processors/Modulators/Flanger.h"
-#include "Utilities/GinAudioFifo.h"
+#include "Processors/Delays/StereoDelay.h"
+#include "Processors/Chain/EffectChain.h"
+#include "Processors/Convolution/LinearStageFolder.h"
+#include "Utilities/StageProfiler.h"
 
-class PluginAudioProcessor : public juce::AudioProcessor, juce::AudioProcessorValueTreeState::Listener, juce::ValueTree::Listener
+class PluginAudioProcessor : public juce::AudioProcessor, juce::AudioProcessorValueTreeState::Listener, juce::ValueTree::Listener, juce::AsyncUpdater
 {
 public:
     PluginAudioProcessor();
@@ -72,6 +78,8 @@ public:
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     void parameterChanged (const juce::String& parameterID, float newValue) override;
     void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
+    void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+    void handleAsyncUpdate() override;
 
     foleys::LevelMeterSource& getInputMeterSource()
     {
@@ -100,9 +108,43 @@ public:
 
     float getPitch()
     {
-        return (float)mPitchAtom;
+        return mTunerAnalyserPtr->getPitch();
     }
 
+    float getStringPitch(int string)
+    {
+        return mTunerAnalyserPtr->getStringPitch(string);
+    }
+
+    int getCabinetImpulseResponseSize() const
+    {
+        return mLinearStageFolderPtr->getImpulseResponseSize();
+    }
+
+    StageProfiler& getStageProfiler()
+    {
+        return *mStageProfilerPtr;
+    }
+
+    EffectChain& getEffectChain()
+    {
+        return *mEffectChainPtr;
+    }
+
+    // Message thread. Stores the order of the movable pedals in the state, so it
+    // is saved with presets, and recompiles the chain.
+    void setChainOrder(const juce::StringArray& newOrder);
+
+    // Message thread. Stores the user's wave shaper curve in the state, so it is
+    // saved with presets, and bakes its table.
+    void setWaveShaperCurve(const WaveShaperCurve& newCurve);
+    WaveShaperCurve getWaveShaperCurve() const;
+
+    // Message thread, before prepareToPlay(). Fixes the partition size of the
+    // convolutions, which are otherwise timed, or at defaultPartitionSize when
+    // rendering offline, so the output is the same from run to run.
+    void setConvolutionPartitionSize(int partitionSize);
+
 private:
     std::unique_ptr <juce::UndoManager> mUndoManager;
     std::unique_ptr<juce::AudioProcessorValueTreeState> mAudioProcessorValueTreeStatePtr;
@@ -111,14 +153,28 @@ private:
     juce::SmoothedValue<double, juce::ValueSmoothingTypes::Linear> mBpmSmoothedValue;
 
     float mTunerOn = false;
-    std::atomic<float> mPitchAtom = 0;
-    std::unique_ptr <adamski::PitchMPM> mPitchMPM;
-    std::unique_ptr <AudioFifo> mAudioFifo;
-    std::unique_ptr<juce::AudioBuffer<float>> mAudioBuffer;
+    bool mIsTunerMuteOn = false;
+    std::unique_ptr<TunerAnalyser> mTunerAnalyserPtr;
 
     std::unique_ptr <foleys::LevelMeterSource> mInputLevelMeterSourcePtr;
     std::unique_ptr <foleys::LevelMeterSource> mOutputLevelMeterSourcePtr;
 
+    std::unique_ptr<StageProfiler> mStageProfilerPtr;
+    std::unique_ptr<EffectChain> mEffectChainPtr;
+    std::atomic<int> mOversamplingFactor{ 1 };
+    std::atomic<int> mConvolutionPartitionSize{ PartitionedConvolution::timedPartitionSize };
+
+    // What the next handleAsyncUpdate() has to do, as parameters can change on
+    // any thread.
+    enum PendingUpdate
+    {
+        compileUpdate = 1 << 0,
+        foldUpdate = 1 << 1,
+        latencyUpdate = 1 << 2
+    };
+
+    std::atomic<int> mPendingUpdates{ 0 };
+
     std::unique_ptr<juce::dsp::Gain<float>> mInputGainPtr;
 
     std::unique_ptr<juce::dsp::NoiseGate<float>> mNoiseGate;
@@ -139,33 +195,15 @@ private:
     bool mIsGraphicEqualiserOn = false;
     std::unique_ptr<GraphicEqualiser> mGraphicEqualiser;
 
-    bool mIsStage1On = false;
-    std::unique_ptr<juce::AudioBuffer<float>> mStage1Buffer;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage1InputGainPtr;
-    std::unique_ptr<juce::dsp::WaveShaper<float>> mStage1WaveShaperPtr;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage1OutputGainPtr;
-    std::unique_ptr<juce::dsp::DryWetMixer<float>> mStage1DryWetMixerPtr;
-
-    bool mIsStage2On = false;
-    std::unique_ptr<juce::AudioBuffer<float>> mStage2Buffer;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage2InputGainPtr;
-    std::unique_ptr<juce::dsp::WaveShaper<float>> mStage2WaveShaperPtr;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage2OutputGainPtr;
-    std::unique_ptr<juce::dsp::DryWetMixer<float>> mStage2DryWetMixerPtr;
-
-    bool mIsStage3On = false;
-    std::unique_ptr<juce::AudioBuffer<float>> mStage3Buffer;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage3InputGainPtr;
-    std::unique_ptr<juce::dsp::WaveShaper<float>> mStage3WaveShaperPtr;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage3OutputGainPtr;
-    std::unique_ptr<juce::dsp::DryWetMixer<float>> mStage3DryWetMixerPtr;
-
-    bool mIsStage4On = false;
-    std::unique_ptr<juce::AudioBuffer<float>> mStage4Buffer;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage4InputGainPtr;
-    std::unique_ptr<juce::dsp::WaveShaper<float>> mStage4WaveShaperPtr;
-    std::unique_ptr<juce::dsp::Gain<float>> mStage4OutputGainPtr;
-    std::unique_ptr<juce::dsp::DryWetMixer<float>> mStage4DryWetMixerPtr;
+    std::unique_ptr<Preamp> mPreampPtr;
+    juce::SharedResourcePointer<WaveShaperTableCache> mWaveShaperTableCache;
+    // Each table replaced is kept with the generation that replaced it, until
+    // processBlock() acknowledges that generation, so it is never freed while
+    // the audio thread may still be reading it.
+    std::shared_ptr<const WaveShaperTable> mWaveShaperCurveTable;
+    std::vector<std::pair<juce::uint64, std::shared_ptr<const WaveShaperTable>>> mRetiredWaveShaperCurveTables;
+    std::atomic<juce::uint64> mWaveShaperCurveGeneration{ 0 };
+    std::atomic<juce::uint64> mAcknowledgedWaveShaperCurveGeneration{ 0 };
 
     std::unique_ptr<juce::dsp::Bias<float>> mBiasPtr;
     std::unique_ptr<AmplifierEqualiser> mAmplifierEqualiser;
@@ -178,33 +216,56 @@ private:
     float mDelayLeftPerBeatDivision = 2.0f;
     float mDelayRightPerBeatDivision = 2.0f;
     float mDelayFeedback = 0.5f;
-    std::unique_ptr<juce::dsp::DelayLine<float>> mDelayLineLeftPtr;
-    std::unique_ptr<juce::dsp::DelayLine<float>> mDelayLineRightPtr;
-    std::unique_ptr<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>> mDelayLowPassFilterPtr;
-    std::unique_ptr<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>> mDelayHighPassFilterPtr;
+    std::unique_ptr<StereoDelay> mStereoDelayPtr;
+    // The low pass filter, then the high pass filter.
+    std::unique_ptr<BiquadCascade<2>> mDelayFiltersPtr;
+    // Set on the audio thread, as the mixer is prepared on the chain's thread.
+    std::atomic<float> mDelayWetMixProportion{ apvts::defaultValueHalf };
     std::unique_ptr<juce::dsp::DryWetMixer<float>> mDelayLineDryWetMixerPtr;
 
+    bool mIsChorusOn = false;
     std::unique_ptr<Chorus> mChorusPtr;
+    bool mIsPhaserOn = false;
     std::unique_ptr<Phaser> mPhaserPtr;
+    bool mIsFlangerOn = false;
     std::unique_ptr<Flanger> mFlangerPtr;
+    bool mIsBitcrusherOn = false;
     std::unique_ptr<Bitcrusher> mBitcrusherPtr;
 
     bool mIsCabImpulseResponseConvolutionOn = true;
     int mCabinetImpulseResponseIndex = 0;
-    std::unique_ptr<juce::dsp::ConvolutionMessageQueue> mConvolutionMessageQueuePtr;
-    std::unique_ptr<juce::dsp::Convolution> mCabinetImpulseResponseConvolutionPtr;
+    float mCabinetGainDecibels = 0.0f;
+    float mCabinetTrimThresholdDecibels = apvts::cabinetTrimThresholdDefaultValue;
+    bool mIsCabinetMinimumPhaseOn = false;
+    int mCabinetQualityIndex = static_cast<int>(apvts::cabinetQualityNames.size()) - 1;
+    // The microphones blended with the cabinet's own, which are off until
+    // switched on.
+    struct CabinetMicrophone
+    {
+        bool isOn = false;
+        int impulseResponseIndex = 0;
+        float levelDecibels = apvts::cabinetMicrophoneLevelDefaultValue;
+        bool isPolarityInverted = false;
+        float delayInMilliseconds = apvts::cabinetMicrophoneDelayDefaultValue;
+    };
+    std::array<CabinetMicrophone, 2> mCabinetMicrophones;
+    // The cabinet convolution, into which the cabinet gain, the instrument EQ and
+    // lofi are folded when nothing else sits between them.
+    std::unique_ptr<LinearStageFolder> mLinearStageFolderPtr;
+    juce::SharedResourcePointer<ImpulseResponseCache> mImpulseResponseCache;
 
     bool mIsLofi = false;
-    std::unique_ptr<juce::dsp::Convolution> mLofiImpulseResponseConvolutionPtr;
+    // Lofi on its own, when it is not folded into the cabinet.
+    std::unique_ptr<PartitionedConvolution> mLofiConvolutionPtr;
 
     bool mIsReverbOn = false;
     std::unique_ptr<juce::dsp::Reverb> mReverbPtr;
     
-    std::unique_ptr<juce::dsp::Gain<float>> mCabinetGainPtr;
-
     std::unique_ptr<InstrumentEqualiser> mInstrumentEqualiserPtr;
 
-    bool mIsInstrumentCompressorPreEqualiser;
+    bool mIsInstrumentCompressorOn = false;
+    bool mIsInstrumentCompressorLookaheadOn = false;
+    bool mIsInstrumentCompressorPreEqualiser = false;
     std::unique_ptr<Compressor> mInstrumentCompressorPtr;
 
     bool mIsLimiterOn = true;
@@ -215,6 +276,18 @@ private:
     bool mIsBypassOn = false;
 
     void loadImpulseResponseFromState();
+    void foldLinearStages();
+    ImpulseResponseSource getCabinetImpulseResponseSource(const std::string& fileFullPathNameId, int index) const;
+    void prepareLofiConvolution(const juce::dsp::ProcessSpec& spec);
+    int getConvolutionPartitionSize() const;
+    void loadChainOrderFromState();
+    void loadWaveShaperCurveFromState();
+    void collectRetiredWaveShaperCurveTables();
+    void createEffectChain();
+    void applyParameterValue(apvts::ParameterEnum parameterEnum, float newValue);
+    void applyParameterValues();
+    void requestUpdates(int updates);
+    void updateLatency();
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginAudioProcessor)
 };
@@ -101,10 +101,12 @@ PluginAudioProcessorEditor::PluginAudioProcessorEditor(PluginAudioProcessor& pro
 	mTabbedComponentPtr(std::make_unique<juce::TabbedComponent>(juce::TabbedButtonBar::Orientation::TabsAtTop)),
 	mPresetComponentPtr(std::make_unique<PresetComponent>(processorRef.getPresetManager(), processorRef.getUndoManager())),
 	mPedalsComponentPtr(std::make_unique<PreAmpComponent>(processorRef)),
+	mChainComponentPtr(std::make_unique<ChainComponent>(processorRef)),
 	mAmpComponentPtr(std::make_unique<AmpComponent>(mAudioProcessorValueTreeState)),
+	mWaveShaperCurveComponentPtr(std::make_unique<WaveShaperCurveComponent>(processorRef)),
 	mFileChooser(std::make_unique<juce::FileChooser>("Select an Impulse Response File", juce::File{}, "*.wav;*.aiff;*.flac")),
-	mCabinetComponentPtr(std::make_unique<CabinetComponent>(mAudioProcessorValueTreeState, [this]() {
-	this->launchAsyncFileChooserForImpulseResponse();
+	mCabinetComponentPtr(std::make_unique<CabinetComponent>(mAudioProcessorValueTreeState, [this](const std::string& fileFullPathNameId) {
+	this->launchAsyncFileChooserForImpulseResponse(fileFullPathNameId);
 		})),
 	mMixerApvtsIdComponentPtr(std::make_unique<ApvtsIdComponent>(mAudioProcessorValueTreeState, sMixerIds)),
 			mHiddenApvtsIdComponentPtr(std::make_unique<ApvtsIdComponent>(mAudioProcessorValueTreeState, sHiddenIds))
@@ -118,7 +120,9 @@ PluginAudioProcessorEditor::PluginAudioProcessorEditor(PluginAudioProcessor& pro
 	addAndMakeVisible(mTabbedComponentPtr.get());
 
 	mTabbedComponentPtr->addTab("Pedals", juce::Colours::transparentBlack, mPedalsComponentPtr.get(), true);
+	mTabbedComponentPtr->addTab("Chain", juce::Colours::transparentBlack, mChainComponentPtr.get(), true);
 	mTabbedComponentPtr->addTab("Amplifier", juce::Colours::transparentBlack, mAmpComponentPtr.get(), true);
+	mTabbedComponentPtr->addTab("Curve", juce::Colours::transparentBlack, mWaveShaperCurveComponentPtr.get(), true);
 	mTabbedComponentPtr->addTab("Cabinet", juce::Colours::transparentBlack, mCabinetComponentPtr.get(), true);
 	mTabbedComponentPtr->addTab("Mixer", juce::Colours::transparentBlack, mMixerApvtsIdComponentPtr.get(), true);
 	mTabbedComponentPtr->addTab("Hidden", juce::Colours::transparentBlack, mHiddenApvtsIdComponentPtr.get(), true);
@@ -127,14 +131,14 @@ PluginAudioProcessorEditor::PluginAudioProcessorEditor(PluginAudioProcessor& pro
 	setResizable(true, true);
 }
 
-void PluginAudioProcessorEditor::launchAsyncFileChooserForImpulseResponse()
+void PluginAudioProcessorEditor::launchAsyncFileChooserForImpulseResponse(const std::string& fileFullPathNameId)
 {
 	mFileChooser->launchAsync(
 		juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
-		[this](const juce::FileChooser& chooser)
+		[this, fileFullPathNameId](const juce::FileChooser& chooser)
 		{
 			mAudioProcessorValueTreeState.state.setProperty(
-				juce::Identifier(apvts::impulseResponseFileFullPathNameId),
+				juce::Identifier(fileFullPathNameId),
 				chooser.getResult().getFullPathName(), nullptr);
 		});
 }
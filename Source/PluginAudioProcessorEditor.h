@@ -26,6 +26,8 @@
 #include "Components/CabinetComponent.h"
 #include "Components/MixerComponent.h"
 #include "Components/TopComponent.h"
+#include "Components/ChainComponent.h"
+#include "Components/WaveShaperCurveComponent.h"
 
 class PluginAudioProcessorEditor : public juce::AudioProcessorEditor
 {
@@ -36,7 +38,9 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
 
-    void launchAsyncFileChooserForImpulseResponse();
+    // Into the state property fileFullPathNameId, for the cabinet or one of its
+    // other microphones.
+    void launchAsyncFileChooserForImpulseResponse(const std::string& fileFullPathNameId);
 
 private:
     PluginAudioProcessor& mProcessorRef;
@@ -52,7 +56,9 @@ private:
 
     std::unique_ptr<juce::TabbedComponent> mTabbedComponentPtr;
     std::unique_ptr<PreAmpComponent> mPedalsComponentPtr;
+    std::unique_ptr<ChainComponent> mChainComponentPtr;
     std::unique_ptr<AmpComponent> mAmpComponentPtr;
+    std::unique_ptr<WaveShaperCurveComponent> mWaveShaperCurveComponentPtr;
     std::unique_ptr<CabinetComponent> mCabinetComponentPtr;
     std::unique_ptr<ApvtsIdComponent> mMixerApvtsIdComponentPtr;
     std::unique_ptr<ApvtsIdComponent> mHiddenApvtsIdComponentPtr;
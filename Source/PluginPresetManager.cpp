@@ -86,19 +86,32 @@ void PluginPresetManager::loadPreset(const juce::String& presetName)
 		return;
 
 	const auto presetFile = defaultDirectory.getChildFile(presetName + "." + extension);
+	if (loadPresetFile(presetFile))
+	{
+		currentPreset.setValue(presetName);
+	}
+}
+
+bool PluginPresetManager::loadPresetFile(const juce::File& presetFile)
+{
 	if (!presetFile.existsAsFile())
 	{
 		DBG("Preset file " + presetFile.getFullPathName() + " does not exist");
 		jassertfalse;
-		return;
+		return false;
 	}
 	// presetFile (XML) -> (ValueTree)
 	juce::XmlDocument xmlDocument{ presetFile };
-	const auto valueTreeToLoad = juce::ValueTree::fromXml(*xmlDocument.getDocumentElement());
+	const auto xmlElement = xmlDocument.getDocumentElement();
+	if (xmlElement == nullptr || !xmlElement->hasTagName(valueTreeState.state.getType()))
+	{
+		DBG("Preset file " + presetFile.getFullPathName() + " could not be parsed: " + xmlDocument.getLastParseError());
+		return false;
+	}
 
+	const auto valueTreeToLoad = juce::ValueTree::fromXml(*xmlElement);
 	valueTreeState.replaceState(valueTreeToLoad);
-	currentPreset.setValue(presetName);
-
+	return true;
 }
 
 int PluginPresetManager::loadNextPreset()
@@ -31,6 +31,7 @@ public:
 	void savePreset(const juce::String& presetName);
 	void deletePreset(const juce::String& presetName);
 	void loadPreset(const juce::String& presetName);
+	bool loadPresetFile(const juce::File& presetFile);
 	int loadNextPreset();
 	int loadPreviousPreset();
 	juce::StringArray getAllPresets() const;
@@ -48,6 +48,18 @@ bool PluginUtils::isWaveshaperId(const std::string& str)
     }
 }
 
+bool PluginUtils::isAntialiasingId(const std::string& str)
+{
+    if (str.length() >= apvts::antialiasingComponentId.length())
+    {
+        return (0 == str.compare(str.length() - apvts::antialiasingComponentId.length(), apvts::antialiasingComponentId.length(), apvts::antialiasingComponentId));
+    }
+    else
+    {
+        return false;
+    }
+}
+
 std::string PluginUtils::toSnakeCase(const std::string& str) {
     std::string result;
     for (char ch : str) {
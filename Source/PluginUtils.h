@@ -27,6 +27,7 @@ public:
     static bool isNumeric(const std::string& str);
     static bool isToggleId(const std::string& str);
     static bool isWaveshaperId(const std::string& str);
+    static bool isAntialiasingId(const std::string& str);
     static std::string toSnakeCase(const std::string& str);
     static std::string toTitleCase(const std::string& str);
 
@@ -40,6 +40,12 @@ void Compressor::prepare(const dsp::ProcessSpec& ps)
     smoothedAutoMakeup.setAlpha(0.03);
 }
 
+void Compressor::reset()
+{
+    if (procSpec.sampleRate > 0)
+        prepare(procSpec);
+}
+
 void Compressor::setPower(bool newPower)
 {
     bypassed = newPower;
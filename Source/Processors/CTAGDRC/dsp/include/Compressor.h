@@ -39,6 +39,9 @@ public:
     // Prepares compressor with a ProcessSpec-Object containing samplerate, blocksize and number of channels
     void prepare(const dsp::ProcessSpec& ps);
 
+    // Clears detector, lookahead and smoothing state using the current ProcessSpec
+    void reset();
+
     // Sets compressor to bypassed/not bypassed
     void setPower(bool);
 
@@ -0,0 +1,860 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/MemoryUsage.h"
+#include "../../Utilities/StageProfiler.h"
+#include "../../Utilities/TripleBuffer.h"
+#include "../Oversampling/PolyphaseOversampler.h"
+
+// One step of the signal chain.
+class ChainStage
+{
+public:
+	virtual ~ChainStage() = default;
+
+	virtual void prepare(juce::dsp::ProcessSpec& spec) = 0;
+	virtual void processBlock(juce::AudioBuffer<float>& buffer) = 0;
+	virtual void reset() = 0;
+
+	// Frees what prepare() allocated, for stages in slots prepared on demand.
+	// The stage is prepared again before it next runs.
+	virtual void release()
+	{
+	}
+
+	// The bytes the stage allocated in prepare(), for the chain's memory
+	// accounting. Stages whose processors keep their buffers to themselves
+	// report nothing.
+	virtual size_t getMemoryUsageInBytes() const
+	{
+		return 0;
+	}
+
+	// Message thread. Stages that are not active are left out of the compiled
+	// schedule, so they cost nothing on the audio thread.
+	virtual bool isActive() const
+	{
+		return true;
+	}
+};
+
+// Adapts a processor that is owned elsewhere to the ChainStage interface.
+class FunctionChainStage : public ChainStage
+{
+public:
+	using PrepareFunction = std::function<void(juce::dsp::ProcessSpec&)>;
+	using ProcessFunction = std::function<void(juce::AudioBuffer<float>&)>;
+	using ResetFunction = std::function<void()>;
+	using IsActiveFunction = std::function<bool()>;
+	using ReleaseFunction = std::function<void()>;
+	using MemoryUsageFunction = std::function<size_t()>;
+
+	FunctionChainStage(
+		PrepareFunction prepareFunction,
+		ProcessFunction processFunction,
+		ResetFunction resetFunction,
+		IsActiveFunction isActiveFunction = nullptr,
+		ReleaseFunction releaseFunction = nullptr,
+		MemoryUsageFunction memoryUsageFunction = nullptr) :
+		mPrepareFunction(std::move(prepareFunction)),
+		mProcessFunction(std::move(processFunction)),
+		mResetFunction(std::move(resetFunction)),
+		mIsActiveFunction(std::move(isActiveFunction)),
+		mReleaseFunction(std::move(releaseFunction)),
+		mMemoryUsageFunction(std::move(memoryUsageFunction))
+	{
+	}
+
+	void prepare(juce::dsp::ProcessSpec& spec) override
+	{
+		if (mPrepareFunction != nullptr)
+		{
+			mPrepareFunction(spec);
+		}
+	}
+
+	void processBlock(juce::AudioBuffer<float>& buffer) override
+	{
+		mProcessFunction(buffer);
+	}
+
+	void reset() override
+	{
+		if (mResetFunction != nullptr)
+		{
+			mResetFunction();
+		}
+	}
+
+	void release() override
+	{
+		if (mReleaseFunction != nullptr)
+		{
+			mReleaseFunction();
+		}
+	}
+
+	size_t getMemoryUsageInBytes() const override
+	{
+		return mMemoryUsageFunction != nullptr ? mMemoryUsageFunction() : 0;
+	}
+
+	bool isActive() const override
+	{
+		return mIsActiveFunction == nullptr || mIsActiveFunction();
+	}
+
+private:
+	const PrepareFunction mPrepareFunction;
+	const ProcessFunction mProcessFunction;
+	const ResetFunction mResetFunction;
+	const IsActiveFunction mIsActiveFunction;
+	const ReleaseFunction mReleaseFunction;
+	const MemoryUsageFunction mMemoryUsageFunction;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FunctionChainStage)
+};
+
+/*
+	The signal chain as an ordered list of slots, each holding one or more stages
+	that always run together (the four preamp stages and the amp EQ form the
+	amplifier slot, for instance). Slots marked movable can be reordered among
+	the positions movable slots take in the default order; the rest stay put.
+
+	The audio thread never walks this list. compile() flattens it, on the message
+	thread, into a fixed-size schedule of the stages that are currently active and
+	publishes that through a triple buffer, which processBlock() picks up at the
+	start of the next block without locking or allocating.
+
+	Slots marked oversampled run at a multiple of the host rate. Each contiguous
+	run of them in the schedule is oversampled once as a whole, up before its
+	first stage and down after its last, rather than stage by stage.
+
+	Slots marked prepared on demand hold nothing until they are first switched
+	on. compile() leaves them out of the schedule and asks a background thread
+	to prepare them; once the owner has applied its parameters again (see
+	takeNewlyPreparedSlots()), the next compile() schedules them and they fade
+	in from the dry signal. A slot switched off for longer than the release
+	delay is released on the same thread, once the audio thread has moved on to
+	a schedule without it. As the owner may set their parameters at any time
+	meanwhile, their stages must only take them through atomics, which
+	prepare() reads again.
+ */
+class EffectChain : private juce::Thread
+{
+public:
+	static constexpr int maximumNumScheduledStages = 32;
+	static constexpr double defaultReleaseDelayInSeconds = 30.0;
+	static constexpr double fadeInLengthInSeconds = 0.05;
+
+	// Background thread. A slot has been prepared on demand; the owner should
+	// call takeNewlyPreparedSlots() and compile() on the message thread.
+	std::function<void()> onSlotPrepared;
+
+	explicit EffectChain(StageProfiler& stageProfiler) :
+		juce::Thread("Effect Chain Preparer"),
+		mStageProfiler(stageProfiler)
+	{
+	}
+
+	~EffectChain() override
+	{
+		stopThread(stopTimeoutMilliseconds);
+	}
+
+	// Construction only. A stage added under the same key as the previous one
+	// joins that slot.
+	void addStage(
+		const juce::String& key,
+		const juce::String& name,
+		bool isMovable,
+		ProfiledStage profiledStage,
+		std::unique_ptr<ChainStage> stage)
+	{
+		if (mSlots.empty() || mSlots.back().key != key)
+		{
+			mSlots.push_back({ key, name, isMovable, {} });
+			mOrder.push_back(static_cast<int>(mSlots.size()) - 1);
+		}
+
+		mSlots.back().stages.push_back({ profiledStage, std::move(stage) });
+	}
+
+	// Construction only. Every oversampled slot gets an oversampler of its own,
+	// as reordering can leave each in a run by itself.
+	void setSlotIsOversampled(const juce::String& key)
+	{
+		const auto slotIndex = getSlotIndex(key);
+		jassert(slotIndex >= 0 && !mSlots[slotIndex].isOversampled);
+
+		mSlots[slotIndex].isOversampled = true;
+		mOversamplers.push_back(std::make_unique<PolyphaseOversampler>());
+	}
+
+	// Construction only. The fade in runs at the host rate, so the slot must not
+	// be oversampled.
+	void setSlotIsPreparedOnDemand(const juce::String& key)
+	{
+		const auto slotIndex = getSlotIndex(key);
+		jassert(slotIndex >= 0 && !mSlots[slotIndex].isOversampled);
+
+		mSlots[slotIndex].preparation = std::make_unique<SlotPreparation>();
+	}
+
+	// Any thread. How long a slot prepared on demand stays prepared after it was
+	// switched off.
+	void setReleaseDelay(double seconds)
+	{
+		mReleaseDelayInMilliseconds.store(seconds * 1000.0);
+	}
+
+	// Message thread, with the audio thread stopped. Slots prepared on demand
+	// are prepared now if they are on and released if they are not. The first
+	// call starts the background thread, so the slots and onSlotPrepared must
+	// all be set up before it.
+	void prepare(juce::dsp::ProcessSpec& spec)
+	{
+		const juce::ScopedLock preparationLock(mPreparationLock);
+		mSpec = spec;
+		mDryBuffer.setSize(static_cast<int>(spec.numChannels), static_cast<int>(spec.maximumBlockSize));
+		mFadeInLengthInSamples = juce::jmax(1, juce::roundToInt(spec.sampleRate * fadeInLengthInSeconds));
+
+		for (auto& slot : mSlots)
+		{
+			if (slot.preparation == nullptr)
+			{
+				prepareSlot(slot);
+				continue;
+			}
+
+			const auto isWanted = isSlotActive(slot);
+
+			if (isWanted)
+			{
+				prepareSlot(slot);
+			}
+			else if (slot.preparation->state != SlotState::released)
+			{
+				releaseSlot(slot);
+			}
+
+			const juce::ScopedLock lock(mCompileLock);
+			slot.preparation->state = isWanted ? SlotState::prepared : SlotState::released;
+			slot.preparation->isWanted = isWanted;
+		}
+
+		for (auto& oversampler : mOversamplers)
+		{
+			oversampler->prepare(spec);
+			oversampler->setFactor(mOversamplingFactor);
+		}
+
+		if (!isThreadRunning())
+		{
+			startThread();
+		}
+	}
+
+	// 1, 2, 4 or 8. Once prepared, this prepares the oversampled stages again at
+	// the new rate, so it must not overlap processBlock(). Call compile() after.
+	void setOversamplingFactor(int newFactor)
+	{
+		if (newFactor == mOversamplingFactor)
+		{
+			return;
+		}
+
+		mOversamplingFactor = newFactor;
+
+		if (mSpec.sampleRate <= 0.0)
+		{
+			return;
+		}
+
+		for (auto& slot : mSlots)
+		{
+			if (slot.isOversampled)
+			{
+				prepareSlot(slot);
+			}
+		}
+
+		for (auto& oversampler : mOversamplers)
+		{
+			oversampler->setFactor(mOversamplingFactor);
+			oversampler->reset();
+		}
+	}
+
+	int getOversamplingFactor() const
+	{
+		return mOversamplingFactor;
+	}
+
+	// Message thread. The delay of the oversampling filters in the schedule that
+	// was compiled last, in host samples.
+	float getLatencyInSamples() const
+	{
+		const juce::ScopedLock lock(mCompileLock);
+		return mOversamplers.empty() ? 0.0f : mNumOversampledRuns * mOversamplers.front()->getLatencyInSamples();
+	}
+
+	void reset()
+	{
+		const juce::ScopedLock preparationLock(mPreparationLock);
+
+		for (auto& slot : mSlots)
+		{
+			if (slot.preparation != nullptr && slot.preparation->state == SlotState::released)
+			{
+				continue;
+			}
+
+			for (auto& entry : slot.stages)
+			{
+				entry.stage->reset();
+			}
+		}
+
+		for (auto& oversampler : mOversamplers)
+		{
+			oversampler->reset();
+		}
+	}
+
+	// Audio thread.
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		mIsProcessing.store(true);
+		const auto& schedule = mSchedule.read();
+		mScheduleGenerationInUse.store(schedule.generation);
+		auto* stageBuffer = &buffer;
+
+		for (int index = 0; index < schedule.numStages; ++index)
+		{
+			const auto& scheduledStage = schedule.stages[index];
+
+			if (scheduledStage.oversamplerToStart != nullptr)
+			{
+				StageProfiler::ScopedTimer timer(mStageProfiler, ProfiledStage::oversampling);
+				stageBuffer = &scheduledStage.oversamplerToStart->processSamplesUp(buffer);
+			}
+
+			{
+				StageProfiler::ScopedTimer timer(mStageProfiler, scheduledStage.profiledStage);
+
+				if (scheduledStage.preparation != nullptr)
+				{
+					processFadingIn(*scheduledStage.stage, *scheduledStage.preparation, *stageBuffer);
+				}
+				else
+				{
+					scheduledStage.stage->processBlock(*stageBuffer);
+				}
+			}
+
+			if (scheduledStage.oversamplerToFinish != nullptr)
+			{
+				StageProfiler::ScopedTimer timer(mStageProfiler, ProfiledStage::oversampling);
+				scheduledStage.oversamplerToFinish->processSamplesDown(buffer);
+				stageBuffer = &buffer;
+			}
+		}
+
+		mIsProcessing.store(false);
+	}
+
+	// Any thread but the audio thread. Rebuilds the schedule from the current
+	// order and the stages' active state.
+	void compile()
+	{
+		const juce::ScopedLock lock(mCompileLock);
+		auto& schedule = mSchedule.getWriteBuffer();
+		schedule.numStages = 0;
+		schedule.generation = ++mScheduleGeneration;
+		mNumOversampledRuns = 0;
+		PolyphaseOversampler* currentOversampler = nullptr;
+		auto isPreparationNeeded = false;
+
+		for (const auto slotIndex : mOrder)
+		{
+			const auto& slot = mSlots[slotIndex];
+
+			if (slot.preparation != nullptr)
+			{
+				auto& preparation = *slot.preparation;
+				preparation.isWanted = isSlotActive(slot);
+				isPreparationNeeded = isPreparationNeeded || (preparation.isWanted && preparation.state == SlotState::released);
+
+				const auto isScheduled = preparation.isWanted && preparation.state == SlotState::prepared;
+
+				if (isScheduled && !preparation.isScheduled)
+				{
+					preparation.isFadeInPending.store(true);
+				}
+				else if (!isScheduled && preparation.isScheduled)
+				{
+					preparation.retiredGeneration = schedule.generation;
+					preparation.retiredMilliseconds = juce::Time::getMillisecondCounterHiRes();
+				}
+
+				preparation.isScheduled = isScheduled;
+
+				if (!isScheduled)
+				{
+					continue;
+				}
+			}
+
+			for (const auto& entry : slot.stages)
+			{
+				if (!entry.stage->isActive())
+				{
+					continue;
+				}
+
+				jassert(schedule.numStages < maximumNumScheduledStages);
+				if (schedule.numStages == maximumNumScheduledStages)
+				{
+					break;
+				}
+
+				auto& scheduledStage = schedule.stages[schedule.numStages++];
+				scheduledStage = { entry.stage.get(), entry.profiledStage, nullptr, nullptr, slot.preparation.get() };
+
+				const auto isOversampled = slot.isOversampled && mOversamplingFactor > 1;
+				if (isOversampled && currentOversampler == nullptr)
+				{
+					currentOversampler = mOversamplers[mNumOversampledRuns++].get();
+					scheduledStage.oversamplerToStart = currentOversampler;
+				}
+				else if (!isOversampled && currentOversampler != nullptr)
+				{
+					// The run ended with the previous stage, which brings the signal
+					// back down before this one.
+					schedule.stages[schedule.numStages - 2].oversamplerToFinish = currentOversampler;
+					currentOversampler = nullptr;
+				}
+			}
+		}
+
+		if (currentOversampler != nullptr)
+		{
+			schedule.stages[schedule.numStages - 1].oversamplerToFinish = currentOversampler;
+		}
+
+		mSchedule.publish();
+
+		if (isPreparationNeeded)
+		{
+			notify();
+		}
+	}
+
+	// Message thread. Whether slots have been prepared on demand since the last
+	// call. Preparing may have reset their parameters, so the owner applies them
+	// again before the compile() that lets them be heard.
+	bool takeNewlyPreparedSlots()
+	{
+		const juce::ScopedLock lock(mCompileLock);
+		auto hasNewlyPreparedSlots = false;
+
+		for (auto& slot : mSlots)
+		{
+			if (slot.preparation != nullptr && slot.preparation->state == SlotState::awaitingParameters)
+			{
+				slot.preparation->state = SlotState::prepared;
+				hasNewlyPreparedSlots = true;
+			}
+		}
+
+		return hasNewlyPreparedSlots;
+	}
+
+	// Message thread. Keys of the movable slots in processing order.
+	juce::StringArray getOrder() const
+	{
+		const juce::ScopedLock lock(mCompileLock);
+		juce::StringArray order;
+
+		for (const auto slotIndex : mOrder)
+		{
+			if (mSlots[slotIndex].isMovable)
+			{
+				order.add(mSlots[slotIndex].key);
+			}
+		}
+
+		return order;
+	}
+
+	// Message thread. Unknown keys are ignored and movable slots missing from
+	// newOrder keep their default relative order after the listed ones. Call
+	// compile() afterwards for the new order to be heard.
+	void setOrder(const juce::StringArray& newOrder)
+	{
+		std::vector<int> movableSlotIndices;
+
+		for (const auto& key : newOrder)
+		{
+			const auto slotIndex = getSlotIndex(key);
+			if (slotIndex >= 0 && mSlots[slotIndex].isMovable
+				&& std::find(movableSlotIndices.begin(), movableSlotIndices.end(), slotIndex) == movableSlotIndices.end())
+			{
+				movableSlotIndices.push_back(slotIndex);
+			}
+		}
+
+		for (int slotIndex = 0; slotIndex < static_cast<int>(mSlots.size()); ++slotIndex)
+		{
+			if (mSlots[slotIndex].isMovable
+				&& std::find(movableSlotIndices.begin(), movableSlotIndices.end(), slotIndex) == movableSlotIndices.end())
+			{
+				movableSlotIndices.push_back(slotIndex);
+			}
+		}
+
+		const juce::ScopedLock lock(mCompileLock);
+		auto nextMovableSlotIndex = movableSlotIndices.begin();
+
+		for (int position = 0; position < static_cast<int>(mSlots.size()); ++position)
+		{
+			if (mSlots[position].isMovable)
+			{
+				mOrder[position] = *nextMovableSlotIndex++;
+			}
+			else
+			{
+				mOrder[position] = position;
+			}
+		}
+	}
+
+	juce::String getName(const juce::String& key) const
+	{
+		const auto slotIndex = getSlotIndex(key);
+		return slotIndex >= 0 ? mSlots[slotIndex].name : juce::String();
+	}
+
+	// Message thread. Keys of every slot in processing order.
+	juce::StringArray getKeys() const
+	{
+		const juce::ScopedLock lock(mCompileLock);
+		juce::StringArray keys;
+
+		for (const auto slotIndex : mOrder)
+		{
+			keys.add(mSlots[slotIndex].key);
+		}
+
+		return keys;
+	}
+
+	// Message thread. What the slot's stages allocated, which is nothing for a
+	// slot prepared on demand while it is released.
+	size_t getMemoryUsageInBytes(const juce::String& key) const
+	{
+		const juce::ScopedLock preparationLock(mPreparationLock);
+		const auto slotIndex = getSlotIndex(key);
+		return slotIndex >= 0 ? getMemoryUsageInBytes(mSlots[slotIndex]) : 0;
+	}
+
+	// Message thread. Every slot, the oversamplers and the chain's own buffers.
+	size_t getMemoryUsageInBytes() const
+	{
+		const juce::ScopedLock preparationLock(mPreparationLock);
+		auto bytes = MemoryUsage::getSizeInBytes(mDryBuffer);
+
+		for (const auto& slot : mSlots)
+		{
+			bytes += getMemoryUsageInBytes(slot);
+		}
+
+		for (const auto& oversampler : mOversamplers)
+		{
+			bytes += oversampler->getMemoryUsageInBytes();
+		}
+
+		return bytes;
+	}
+
+private:
+	static constexpr int stopTimeoutMilliseconds = 4000;
+	static constexpr int pollIntervalMilliseconds = 500;
+
+	struct Entry
+	{
+		ProfiledStage profiledStage;
+		std::unique_ptr<ChainStage> stage;
+	};
+
+	enum class SlotState
+	{
+		released,
+		preparing,
+		awaitingParameters,
+		prepared
+	};
+
+	// The state of a slot prepared on demand. Everything but the fade is guarded
+	// by mCompileLock.
+	struct SlotPreparation
+	{
+		SlotState state = SlotState::released;
+		bool isWanted = false;
+		bool isScheduled = false;
+		juce::uint32 retiredGeneration = 0;
+		double retiredMilliseconds = 0.0;
+
+		std::atomic<bool> isFadeInPending{ false };
+		// Audio thread.
+		int fadeInPosition = 0;
+	};
+
+	struct Slot
+	{
+		juce::String key;
+		juce::String name;
+		bool isMovable;
+		std::vector<Entry> stages;
+		bool isOversampled = false;
+		std::unique_ptr<SlotPreparation> preparation;
+	};
+
+	struct ScheduledStage
+	{
+		ChainStage* stage = nullptr;
+		ProfiledStage profiledStage = ProfiledStage::total;
+		PolyphaseOversampler* oversamplerToStart = nullptr;
+		PolyphaseOversampler* oversamplerToFinish = nullptr;
+		SlotPreparation* preparation = nullptr;
+	};
+
+	struct Schedule
+	{
+		std::array<ScheduledStage, maximumNumScheduledStages> stages;
+		int numStages = 0;
+		juce::uint32 generation = 0;
+	};
+
+	StageProfiler& mStageProfiler;
+	std::vector<Slot> mSlots;
+	std::vector<int> mOrder;
+	juce::CriticalSection mCompileLock;
+	TripleBuffer<Schedule> mSchedule;
+
+	juce::dsp::ProcessSpec mSpec{};
+	int mOversamplingFactor = 1;
+	int mNumOversampledRuns = 0;
+	std::vector<std::unique_ptr<PolyphaseOversampler>> mOversamplers;
+
+	// Held while stages are prepared or released, so that the background thread
+	// and prepare() take turns.
+	juce::CriticalSection mPreparationLock;
+	std::atomic<double> mReleaseDelayInMilliseconds{ defaultReleaseDelayInSeconds * 1000.0 };
+	juce::uint32 mScheduleGeneration = 0;
+	std::atomic<juce::uint32> mScheduleGenerationInUse{ 0 };
+	std::atomic<bool> mIsProcessing{ false };
+
+	// Audio thread, for the fade in.
+	juce::AudioBuffer<float> mDryBuffer;
+	int mFadeInLengthInSamples = 1;
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			wait(pollIntervalMilliseconds);
+
+			for (auto& slot : mSlots)
+			{
+				if (threadShouldExit())
+				{
+					return;
+				}
+
+				if (slot.preparation != nullptr)
+				{
+					updateSlotPreparation(slot);
+				}
+			}
+		}
+	}
+
+	// Background thread. Prepares a slot that was switched on, or releases one
+	// that has been off for long enough.
+	void updateSlotPreparation(Slot& slot)
+	{
+		const juce::ScopedLock preparationLock(mPreparationLock);
+		auto& preparation = *slot.preparation;
+		auto shouldPrepare = false;
+		auto shouldRelease = false;
+
+		{
+			const juce::ScopedLock lock(mCompileLock);
+
+			if (preparation.state == SlotState::released)
+			{
+				shouldPrepare = preparation.isWanted && mSpec.sampleRate > 0.0;
+			}
+			else if (!preparation.isWanted && !preparation.isScheduled)
+			{
+				const auto elapsedMilliseconds = juce::Time::getMillisecondCounterHiRes() - preparation.retiredMilliseconds;
+				shouldRelease = elapsedMilliseconds >= mReleaseDelayInMilliseconds.load() && isRetired(preparation.retiredGeneration);
+			}
+
+			if (shouldPrepare)
+			{
+				preparation.state = SlotState::preparing;
+			}
+			else if (shouldRelease)
+			{
+				preparation.state = SlotState::released;
+			}
+		}
+
+		if (shouldPrepare)
+		{
+			prepareSlot(slot);
+
+			{
+				const juce::ScopedLock lock(mCompileLock);
+				preparation.state = SlotState::awaitingParameters;
+			}
+
+			if (onSlotPrepared != nullptr)
+			{
+				onSlotPrepared();
+			}
+		}
+		else if (shouldRelease)
+		{
+			releaseSlot(slot);
+		}
+	}
+
+	// Whether the audio thread can no longer be running a schedule older than
+	// the given one.
+	bool isRetired(juce::uint32 generation) const
+	{
+		return !mIsProcessing.load() || mScheduleGenerationInUse.load() >= generation;
+	}
+
+	// Audio thread. Crossfades from the dry signal for a while after the slot has
+	// come into the schedule.
+	void processFadingIn(ChainStage& stage, SlotPreparation& preparation, juce::AudioBuffer<float>& buffer)
+	{
+		if (preparation.isFadeInPending.exchange(false))
+		{
+			preparation.fadeInPosition = 0;
+		}
+
+		const auto numSamples = buffer.getNumSamples();
+		const auto numChannels = juce::jmin(buffer.getNumChannels(), mDryBuffer.getNumChannels());
+
+		if (preparation.fadeInPosition >= mFadeInLengthInSamples || numSamples > mDryBuffer.getNumSamples())
+		{
+			stage.processBlock(buffer);
+			return;
+		}
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			juce::FloatVectorOperations::copy(mDryBuffer.getWritePointer(channel), buffer.getReadPointer(channel), numSamples);
+		}
+
+		stage.processBlock(buffer);
+
+		const auto gainIncrement = 1.0f / static_cast<float>(mFadeInLengthInSamples);
+		const auto startGain = static_cast<float>(preparation.fadeInPosition) * gainIncrement;
+		const auto numFadingSamples = juce::jmin(numSamples, mFadeInLengthInSamples - preparation.fadeInPosition);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* dry = mDryBuffer.getReadPointer(channel);
+			auto* wet = buffer.getWritePointer(channel);
+
+			for (int sample = 0; sample < numFadingSamples; ++sample)
+			{
+				const auto gain = startGain + static_cast<float>(sample) * gainIncrement;
+				wet[sample] = dry[sample] + gain * (wet[sample] - dry[sample]);
+			}
+		}
+
+		preparation.fadeInPosition += numFadingSamples;
+	}
+
+	static bool isSlotActive(const Slot& slot)
+	{
+		return std::any_of(slot.stages.begin(), slot.stages.end(), [](const Entry& entry) { return entry.stage->isActive(); });
+	}
+
+	static size_t getMemoryUsageInBytes(const Slot& slot)
+	{
+		size_t bytes = 0;
+
+		for (const auto& entry : slot.stages)
+		{
+			bytes += entry.stage->getMemoryUsageInBytes();
+		}
+
+		return bytes;
+	}
+
+	static void releaseSlot(Slot& slot)
+	{
+		for (auto& entry : slot.stages)
+		{
+			entry.stage->release();
+		}
+	}
+
+	void prepareSlot(Slot& slot)
+	{
+		auto slotSpec = mSpec;
+
+		if (slot.isOversampled)
+		{
+			slotSpec.sampleRate *= mOversamplingFactor;
+			slotSpec.maximumBlockSize *= static_cast<juce::uint32>(mOversamplingFactor);
+		}
+
+		for (auto& entry : slot.stages)
+		{
+			entry.stage->prepare(slotSpec);
+		}
+	}
+
+	int getSlotIndex(const juce::String& key) const
+	{
+		for (int slotIndex = 0; slotIndex < static_cast<int>(mSlots.size()); ++slotIndex)
+		{
+			if (mSlots[slotIndex].key == key)
+			{
+				return slotIndex;
+			}
+		}
+
+		return -1;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EffectChain)
+};
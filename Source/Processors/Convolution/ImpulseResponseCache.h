@@ -0,0 +1,502 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <future>
+#include "PartitionedConvolution.h"
+#include "../../Utilities/MemoryUsage.h"
+
+// A file, or a sound file in memory, such as BinaryData.
+struct ImpulseResponseSource
+{
+	juce::File file;
+	const void* data = nullptr;
+	size_t dataSize = 0;
+
+	bool isEmpty() const
+	{
+		return data == nullptr && file == juce::File();
+	}
+
+	bool operator==(const ImpulseResponseSource& other) const
+	{
+		return file == other.file && data == other.data && dataSize == other.dataSize;
+	}
+};
+
+/*
+	Impulse responses read, resampled and normalised, and the kernels folded
+	from them, shared by every plugin instance in the process through a
+	juce::SharedResourcePointer. Going back to a cabinet, or a second instance
+	with the same one, finds the work done.
+
+	Impulse responses are keyed by a hash of the sound file and the rate they
+	were resampled to, so the same file under another name is found, and one
+	that has been changed is not. A file is only read again to hash it when
+	its size or modification time has changed. Kernels are keyed by whatever
+	the caller folded them from, and share their spectra with the kernels
+	handed to the convolutions.
+
+	Whoever asks first for something that is not there makes it, and anyone
+	asking for it meanwhile waits for that rather than making it again. What
+	has been least recently asked for goes once the cache holds more than
+	maximumMemoryUsageInBytes.
+
+	Given a directory, impulse responses are also kept there between sessions,
+	the least recently used going once it holds more than
+	maximumDiskUsageInBytes. Any thread but the audio thread.
+ */
+class ImpulseResponseCache
+{
+public:
+	static constexpr double maximumLengthInSeconds = 3.0;
+	static constexpr size_t maximumMemoryUsageInBytes = 64 * 1024 * 1024;
+	static constexpr juce::int64 maximumDiskUsageInBytes = 256 * 1024 * 1024;
+
+	struct ImpulseResponse
+	{
+		// The hash of the sound file and the rate, for the keys of the kernels
+		// folded from it.
+		juce::String key;
+		juce::AudioBuffer<float> buffer;
+	};
+
+	using Kernel = PartitionedConvolution::Kernel;
+	using KernelFunction = std::function<std::shared_ptr<const Kernel>()>;
+
+	ImpulseResponseCache() = default;
+
+	// Where impulse responses are kept between sessions, or juce::File() to keep
+	// them in memory only, which is the default.
+	void setDirectory(const juce::File& directory)
+	{
+		const juce::ScopedLock lock(mLock);
+		mDirectory = directory;
+	}
+
+	// Read, resampled to sampleRate and normalised as juce::dsp::Convolution
+	// does with Stereo::yes and Normalise::yes. Null if the source cannot be
+	// read.
+	std::shared_ptr<const ImpulseResponse> getImpulseResponse(const ImpulseResponseSource& source, double sampleRate)
+	{
+		const auto identity = getIdentity(source);
+		if (identity.isEmpty())
+		{
+			return nullptr;
+		}
+
+		// Only read when it has to be, and then only once.
+		juce::MemoryBlock fileData;
+		auto contentHash = findContentHash(identity);
+
+		if (!contentHash.has_value())
+		{
+			const auto content = getContent(source, fileData);
+			if (content.size == 0)
+			{
+				return nullptr;
+			}
+
+			contentHash = getHash(content.data, content.size);
+			const juce::ScopedLock lock(mLock);
+			mContentHashes[identity] = *contentHash;
+		}
+
+		const auto key = juce::String::toHexString(static_cast<juce::int64>(*contentHash))
+			+ "-" + juce::String(juce::roundToInt(sampleRate));
+
+		return get(mImpulseResponses, key, [&]() { return loadImpulseResponse(source, fileData, key, sampleRate); });
+	}
+
+	// 64 bit FNV-1a, for keys.
+	static juce::uint64 getHash(const void* data, size_t size)
+	{
+		auto hash = static_cast<juce::uint64>(0xcbf29ce484222325ull);
+		const auto* bytes = static_cast<const juce::uint8*>(data);
+
+		for (size_t index = 0; index < size; ++index)
+		{
+			hash = (hash ^ bytes[index]) * static_cast<juce::uint64>(0x100000001b3ull);
+		}
+
+		return hash;
+	}
+
+	// The kernel cached under key, or the one createKernel() makes if there is
+	// none. The key must say everything the kernel was folded from.
+	std::shared_ptr<const Kernel> getKernel(const juce::String& key, const KernelFunction& createKernel)
+	{
+		return get(mKernels, key, createKernel);
+	}
+
+private:
+	static constexpr int fileFormatVersion = 1;
+
+	// The bytes of a sound file, wherever they are.
+	struct Content
+	{
+		const void* data = nullptr;
+		size_t size = 0;
+	};
+
+	template <typename ValueType>
+	struct Entry
+	{
+		std::shared_future<std::shared_ptr<const ValueType>> value;
+		// 0 until the value has been made.
+		size_t sizeInBytes = 0;
+		juce::uint64 lastUsed = 0;
+	};
+
+	template <typename ValueType>
+	using EntryMap = std::map<juce::String, Entry<ValueType>>;
+
+	juce::CriticalSection mLock;
+	juce::File mDirectory;
+	std::map<juce::String, juce::uint64> mContentHashes;
+	EntryMap<ImpulseResponse> mImpulseResponses;
+	EntryMap<Kernel> mKernels;
+	size_t mMemoryUsageInBytes = 0;
+	juce::uint64 mUseCount = 0;
+
+	template <typename ValueType, typename CreateFunction>
+	std::shared_ptr<const ValueType> get(EntryMap<ValueType>& entries, const juce::String& key, const CreateFunction& create)
+	{
+		std::promise<std::shared_ptr<const ValueType>> promise;
+		{
+			const juce::ScopedLock lock(mLock);
+			auto& entry = entries[key];
+			entry.lastUsed = ++mUseCount;
+
+			if (entry.value.valid())
+			{
+				const auto value = entry.value;
+				const juce::ScopedUnlock unlock(mLock);
+				return value.get();
+			}
+
+			entry.value = promise.get_future().share();
+		}
+
+		std::shared_ptr<const ValueType> value = create();
+		promise.set_value(value);
+
+		const juce::ScopedLock lock(mLock);
+		const auto found = entries.find(key);
+
+		if (value == nullptr)
+		{
+			// So that it is tried again, as a file may yet appear.
+			entries.erase(found);
+		}
+		else
+		{
+			found->second.sizeInBytes = getSizeInBytes(*value);
+			mMemoryUsageInBytes += found->second.sizeInBytes;
+			evict(key);
+		}
+
+		return value;
+	}
+
+	static size_t getSizeInBytes(const ImpulseResponse& impulseResponse)
+	{
+		return MemoryUsage::getSizeInBytes(impulseResponse.buffer);
+	}
+
+	static size_t getSizeInBytes(const Kernel& kernel)
+	{
+		return kernel.getMemoryUsageInBytes();
+	}
+
+	// The least recently used entries that have been made, other than the one
+	// just added. Whoever holds one of them keeps it.
+	void evict(const juce::String& keptKey)
+	{
+		while (mMemoryUsageInBytes > maximumMemoryUsageInBytes)
+		{
+			auto oldestImpulseResponse = findOldest(mImpulseResponses, keptKey);
+			auto oldestKernel = findOldest(mKernels, keptKey);
+			const auto hasImpulseResponse = oldestImpulseResponse != mImpulseResponses.end();
+			const auto hasKernel = oldestKernel != mKernels.end();
+
+			if (!hasImpulseResponse && !hasKernel)
+			{
+				return;
+			}
+
+			if (hasImpulseResponse && (!hasKernel || oldestImpulseResponse->second.lastUsed < oldestKernel->second.lastUsed))
+			{
+				mMemoryUsageInBytes -= oldestImpulseResponse->second.sizeInBytes;
+				mImpulseResponses.erase(oldestImpulseResponse);
+			}
+			else
+			{
+				mMemoryUsageInBytes -= oldestKernel->second.sizeInBytes;
+				mKernels.erase(oldestKernel);
+			}
+		}
+	}
+
+	template <typename ValueType>
+	static typename EntryMap<ValueType>::iterator findOldest(EntryMap<ValueType>& entries, const juce::String& keptKey)
+	{
+		auto oldest = entries.end();
+
+		for (auto iterator = entries.begin(); iterator != entries.end(); ++iterator)
+		{
+			if (iterator->second.sizeInBytes > 0 && iterator->first != keptKey
+				&& (oldest == entries.end() || iterator->second.lastUsed < oldest->second.lastUsed))
+			{
+				oldest = iterator;
+			}
+		}
+
+		return oldest;
+	}
+
+	// What the content hash is remembered under: where the sound is and, for a
+	// file, what would change if it were written to. Empty for a file that is
+	// not there.
+	static juce::String getIdentity(const ImpulseResponseSource& source)
+	{
+		if (source.data != nullptr)
+		{
+			return "memory:" + juce::String::toHexString(static_cast<juce::int64>(reinterpret_cast<juce::pointer_sized_int>(source.data)))
+				+ ":" + juce::String(static_cast<juce::int64>(source.dataSize));
+		}
+
+		if (!source.file.existsAsFile())
+		{
+			return {};
+		}
+
+		return source.file.getFullPathName()
+			+ ":" + juce::String(source.file.getSize())
+			+ ":" + juce::String(source.file.getLastModificationTime().toMilliseconds());
+	}
+
+	std::optional<juce::uint64> findContentHash(const juce::String& identity)
+	{
+		const juce::ScopedLock lock(mLock);
+		const auto found = mContentHashes.find(identity);
+		return found != mContentHashes.end() ? std::optional<juce::uint64>(found->second) : std::nullopt;
+	}
+
+	// The bytes of the sound file, read into fileData the first time for a file.
+	static Content getContent(const ImpulseResponseSource& source, juce::MemoryBlock& fileData)
+	{
+		if (source.data != nullptr)
+		{
+			return { source.data, source.dataSize };
+		}
+
+		if (fileData.getSize() == 0)
+		{
+			source.file.loadFileAsData(fileData);
+		}
+
+		return { fileData.getData(), fileData.getSize() };
+	}
+
+	std::shared_ptr<const ImpulseResponse> loadImpulseResponse(const ImpulseResponseSource& source, juce::MemoryBlock& fileData, const juce::String& key, double sampleRate)
+	{
+		const auto file = getFile(key);
+
+		if (auto impulseResponse = readImpulseResponse(file))
+		{
+			impulseResponse->key = key;
+			return impulseResponse;
+		}
+
+		const auto content = getContent(source, fileData);
+		juce::AudioFormatManager audioFormatManager;
+		audioFormatManager.registerBasicFormats();
+		std::unique_ptr<juce::AudioFormatReader> reader(audioFormatManager.createReaderFor(
+			std::make_unique<juce::MemoryInputStream>(content.data, content.size, false)));
+
+		if (reader == nullptr || reader->lengthInSamples <= 0)
+		{
+			return nullptr;
+		}
+
+		const auto maximumLength = static_cast<juce::int64>(std::ceil(maximumLengthInSeconds * reader->sampleRate));
+		const auto numSamples = static_cast<int>(juce::jmin(reader->lengthInSamples, maximumLength));
+		const auto numChannels = juce::jlimit(1, 2, static_cast<int>(reader->numChannels));
+
+		auto impulseResponse = std::make_shared<ImpulseResponse>();
+		impulseResponse->key = key;
+		impulseResponse->buffer.setSize(numChannels, numSamples);
+		reader->read(&impulseResponse->buffer, 0, numSamples, 0, true, numChannels > 1);
+
+		if (reader->sampleRate != sampleRate)
+		{
+			impulseResponse->buffer = resample(impulseResponse->buffer, reader->sampleRate, sampleRate);
+		}
+
+		normalise(impulseResponse->buffer);
+		writeImpulseResponse(file, impulseResponse->buffer);
+		return impulseResponse;
+	}
+
+	juce::File getFile(const juce::String& key)
+	{
+		const juce::ScopedLock lock(mLock);
+		return mDirectory == juce::File() ? juce::File() : mDirectory.getChildFile(key + ".ir");
+	}
+
+	// Null if there is no such file, or it is not one this wrote. A file that is
+	// read counts as used, for the trim.
+	static std::shared_ptr<ImpulseResponse> readImpulseResponse(const juce::File& file)
+	{
+		if (file == juce::File() || !file.existsAsFile())
+		{
+			return nullptr;
+		}
+
+		juce::FileInputStream stream(file);
+		if (!stream.openedOk() || stream.readInt() != fileFormatVersion)
+		{
+			return nullptr;
+		}
+
+		const auto numChannels = stream.readInt();
+		const auto numSamples = stream.readInt();
+		const auto numBytes = static_cast<juce::int64>(numSamples) * static_cast<juce::int64>(sizeof(float));
+
+		if (numChannels <= 0 || numChannels > 2 || numSamples <= 0
+			|| stream.getNumBytesRemaining() != numChannels * numBytes)
+		{
+			file.deleteFile();
+			return nullptr;
+		}
+
+		auto impulseResponse = std::make_shared<ImpulseResponse>();
+		impulseResponse->buffer.setSize(numChannels, numSamples);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			stream.read(impulseResponse->buffer.getWritePointer(channel), static_cast<int>(numBytes));
+		}
+
+		file.setLastModificationTime(juce::Time::getCurrentTime());
+		return impulseResponse;
+	}
+
+	// Written whole or not at all, then the least recently used files go if the
+	// directory has grown too big.
+	static void writeImpulseResponse(const juce::File& file, const juce::AudioBuffer<float>& buffer)
+	{
+		if (file == juce::File() || !file.getParentDirectory().createDirectory().wasOk())
+		{
+			return;
+		}
+
+		juce::TemporaryFile temporaryFile(file);
+		{
+			juce::FileOutputStream stream(temporaryFile.getFile());
+			if (!stream.openedOk())
+			{
+				return;
+			}
+
+			stream.writeInt(fileFormatVersion);
+			stream.writeInt(buffer.getNumChannels());
+			stream.writeInt(buffer.getNumSamples());
+
+			for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+			{
+				stream.write(buffer.getReadPointer(channel), static_cast<size_t>(buffer.getNumSamples()) * sizeof(float));
+			}
+
+			stream.flush();
+			if (stream.getStatus().failed())
+			{
+				return;
+			}
+		}
+
+		if (temporaryFile.overwriteTargetFileWithTemporary())
+		{
+			trimDirectory(file.getParentDirectory());
+		}
+	}
+
+	static void trimDirectory(const juce::File& directory)
+	{
+		auto files = directory.findChildFiles(juce::File::findFiles, false, "*.ir");
+		auto totalSize = static_cast<juce::int64>(0);
+
+		for (const auto& file : files)
+		{
+			totalSize += file.getSize();
+		}
+
+		std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b)
+			{
+				return a.getLastModificationTime() < b.getLastModificationTime();
+			});
+
+		for (const auto& file : files)
+		{
+			if (totalSize <= maximumDiskUsageInBytes)
+			{
+				break;
+			}
+
+			totalSize -= file.getSize();
+			file.deleteFile();
+		}
+	}
+
+	static juce::AudioBuffer<float> resample(const juce::AudioBuffer<float>& buffer, double sourceSampleRate, double destinationSampleRate)
+	{
+		const auto ratio = sourceSampleRate / destinationSampleRate;
+		auto source = buffer;
+		juce::MemoryAudioSource memorySource(source, false);
+		juce::ResamplingAudioSource resamplingSource(&memorySource, false, buffer.getNumChannels());
+
+		const auto numSamples = juce::roundToInt(juce::jmax(1.0, buffer.getNumSamples() / ratio));
+		resamplingSource.setResamplingRatio(ratio);
+		resamplingSource.prepareToPlay(numSamples, sourceSampleRate);
+
+		juce::AudioBuffer<float> resampled(buffer.getNumChannels(), numSamples);
+		resamplingSource.getNextAudioBlock({ &resampled, 0, numSamples });
+		return resampled;
+	}
+
+	static void normalise(juce::AudioBuffer<float>& buffer)
+	{
+		auto maximumEnergy = 0.0f;
+
+		for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+		{
+			const auto* samples = buffer.getReadPointer(channel);
+			maximumEnergy = juce::jmax(maximumEnergy, std::inner_product(samples, samples + buffer.getNumSamples(), samples, 0.0f));
+		}
+
+		if (maximumEnergy > 0.0f)
+		{
+			buffer.applyGain(1.0f / std::sqrt(maximumEnergy));
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ImpulseResponseCache)
+};
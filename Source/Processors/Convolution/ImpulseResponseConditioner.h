@@ -0,0 +1,180 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+	Shortens an impulse response before it is partitioned, as the convolution
+	costs as much as the impulse response is long, and most cabinets end in
+	a tail far below anything that can be heard.
+
+	The tail goes from where less than a given part of the energy is left.
+	Before that, the impulse response can be made minimum phase, from its
+	folded real cepstrum, which brings its energy as early as its magnitude
+	response allows: the silence before it and any ringing ahead of the peak
+	go, and the tail can be cut shorter still. The magnitude response is kept,
+	but not the phase, nor the timing between the channels. Then the length
+	is capped, and the end faded out so that the cut does not click.
+ */
+class ImpulseResponseConditioner
+{
+public:
+	static constexpr double fadeLengthInSeconds = 0.005;
+
+	struct Options
+	{
+		// How far below the whole impulse response the energy of the cut tail
+		// must be.
+		float tailThresholdDecibels = -80.0f;
+		bool isMinimumPhase = false;
+		double maximumLengthInSeconds = 3.0;
+
+		bool operator==(const Options& other) const = default;
+	};
+
+	static void condition(juce::AudioBuffer<float>& impulseResponse, const Options& options, double sampleRate)
+	{
+		auto length = getTrimmedLength(impulseResponse, impulseResponse.getNumSamples(), options.tailThresholdDecibels);
+
+		if (options.isMinimumPhase)
+		{
+			makeMinimumPhase(impulseResponse, length);
+			length = getTrimmedLength(impulseResponse, length, options.tailThresholdDecibels);
+		}
+
+		length = juce::jlimit(1, length, juce::roundToInt(options.maximumLengthInSeconds * sampleRate));
+		fadeOut(impulseResponse, length, juce::jmin(length / 2, juce::roundToInt(fadeLengthInSeconds * sampleRate)));
+		impulseResponse.setSize(impulseResponse.getNumChannels(), length, true);
+	}
+
+private:
+	// Below this, relative to the peak of the magnitude response, the
+	// logarithm is taken of the floor instead, which keeps the cepstrum from
+	// being swamped by bins that hold nothing.
+	static constexpr float magnitudeFloor = 1.0e-6f;
+	// How many times longer than the impulse response the cepstrum is, so
+	// that it is not aliased into the part that is kept.
+	static constexpr int cepstrumPadding = 4;
+
+	// The number of samples, of the first numSamples, from which the energy
+	// left over all the channels is below the threshold.
+	static int getTrimmedLength(const juce::AudioBuffer<float>& impulseResponse, int numSamples, float thresholdDecibels)
+	{
+		std::vector<double> energies(static_cast<size_t>(numSamples), 0.0);
+
+		for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+		{
+			const auto* samples = impulseResponse.getReadPointer(channel);
+
+			for (int sample = 0; sample < numSamples; ++sample)
+			{
+				energies[static_cast<size_t>(sample)] += static_cast<double>(samples[sample]) * samples[sample];
+			}
+		}
+
+		const auto totalEnergy = std::accumulate(energies.begin(), energies.end(), 0.0);
+		const auto allowedEnergy = totalEnergy * std::pow(10.0, thresholdDecibels / 10.0);
+		auto tailEnergy = 0.0;
+
+		for (auto length = numSamples; length > 1; --length)
+		{
+			tailEnergy += energies[static_cast<size_t>(length - 1)];
+
+			if (tailEnergy > allowedEnergy)
+			{
+				return length;
+			}
+		}
+
+		return 1;
+	}
+
+	// Each channel of the first numSamples in place: the inverse transform of
+	// the exponential of the transform of the cepstrum of the log magnitude,
+	// folded onto its causal half.
+	static void makeMinimumPhase(juce::AudioBuffer<float>& impulseResponse, int numSamples)
+	{
+		const auto fftOrder = juce::roundToInt(std::log2(juce::nextPowerOfTwo(numSamples * cepstrumPadding)));
+		const auto fftSize = 1 << fftOrder;
+		juce::dsp::FFT fft(fftOrder);
+		std::vector<std::complex<float>> spectrum(static_cast<size_t>(fftSize));
+		std::vector<std::complex<float>> cepstrum(static_cast<size_t>(fftSize));
+
+		for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+		{
+			auto* samples = impulseResponse.getWritePointer(channel);
+
+			std::fill(cepstrum.begin(), cepstrum.end(), std::complex<float>());
+			std::copy(samples, samples + numSamples, cepstrum.begin());
+			fft.perform(cepstrum.data(), spectrum.data(), false);
+
+			const auto peak = std::accumulate(spectrum.begin(), spectrum.end(), 0.0f,
+				[](float maximum, const std::complex<float>& bin) { return juce::jmax(maximum, std::abs(bin)); });
+
+			if (peak <= 0.0f)
+			{
+				continue;
+			}
+
+			for (auto& bin : spectrum)
+			{
+				bin = std::log(juce::jmax(std::abs(bin), peak * magnitudeFloor));
+			}
+
+			fft.perform(spectrum.data(), cepstrum.data(), true);
+
+			for (int index = 1; index < fftSize / 2; ++index)
+			{
+				cepstrum[static_cast<size_t>(index)] = 2.0f * cepstrum[static_cast<size_t>(index)].real();
+			}
+
+			cepstrum[0] = cepstrum[0].real();
+			cepstrum[static_cast<size_t>(fftSize / 2)] = cepstrum[static_cast<size_t>(fftSize / 2)].real();
+			std::fill(cepstrum.begin() + fftSize / 2 + 1, cepstrum.end(), std::complex<float>());
+
+			fft.perform(cepstrum.data(), spectrum.data(), false);
+
+			for (auto& bin : spectrum)
+			{
+				bin = std::exp(bin);
+			}
+
+			fft.perform(spectrum.data(), cepstrum.data(), true);
+
+			for (int sample = 0; sample < numSamples; ++sample)
+			{
+				samples[sample] = cepstrum[static_cast<size_t>(sample)].real();
+			}
+		}
+	}
+
+	static void fadeOut(juce::AudioBuffer<float>& impulseResponse, int length, int fadeLength)
+	{
+		for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+		{
+			auto* samples = impulseResponse.getWritePointer(channel) + length - fadeLength;
+
+			for (int sample = 0; sample < fadeLength; ++sample)
+			{
+				samples[sample] *= 0.5f + 0.5f * std::cos(juce::MathConstants<float>::pi * static_cast<float>(sample + 1) / static_cast<float>(fadeLength + 1));
+			}
+		}
+	}
+};
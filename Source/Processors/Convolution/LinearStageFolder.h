@@ -0,0 +1,564 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <bit>
+#include "ImpulseResponseCache.h"
+#include "ImpulseResponseConditioner.h"
+#include "PartitionedConvolution.h"
+
+/*
+	The cabinet convolution, with the cabinet gain and, where they can be, the
+	stages after it folded into its impulse response, so one convolution does
+	the work of all of them. Those are the instrument EQ and the lofi impulse
+	response, which are linear and time invariant, and can only be folded in
+	while nothing that is not sits between them and the cabinet. The owner
+	works that out and says what to fold with fold().
+
+	The cabinet can be several microphones, each with its own impulse response,
+	which are blended into one, at their levels and polarities and with their
+	delays, before anything is folded in. The blend is a sum of spectra, so it
+	costs one convolution however many microphones there are, and the delays
+	need not be whole samples.
+
+	Folding runs on a background thread, which also shortens what has been
+	folded with ImpulseResponseConditioner, and the result is crossfaded in by
+	PartitionedConvolution. A folded stage keeps its place in the chain, where
+	it asks isFolded() and leaves the block alone. The impulse responses and
+	the kernels come from the ImpulseResponseCache every instance shares, so
+	going back to settings folded before costs no more than looking them up.
+
+	When a new kernel folds in a different set of stages from the one it
+	replaces, the stages that differ are run here during the crossfade, on
+	whichever side lacks them, so both sides are the same chain. A stage that
+	is handed back has its state cleared first, as it has not run since it was
+	folded in.
+ */
+class LinearStageFolder : private juce::Thread
+{
+public:
+	// In chain order, as flags.
+	enum FoldedStage
+	{
+		instrumentEqualiser = 1 << 0,
+		lofi = 1 << 1
+	};
+
+	static constexpr std::array<FoldedStage, 2> foldedStages = { instrumentEqualiser, lofi };
+	static constexpr double maximumImpulseResponseLengthInSeconds = ImpulseResponseCache::maximumLengthInSeconds;
+	// How much of the EQ's response the owner renders. The end of it is trimmed
+	// where it has died away.
+	static constexpr double equaliserImpulseResponseLengthInSeconds = 1.0;
+
+	using ImpulseResponseSource = ::ImpulseResponseSource;
+
+	// One of the cabinet's impulse responses and how it is blended with the
+	// others.
+	struct Microphone
+	{
+		ImpulseResponseSource source;
+		float gainDecibels = 0.0f;
+		bool isPolarityInverted = false;
+		// Against the others, which may be negative, as only the differences
+		// are kept.
+		float delayInMilliseconds = 0.0f;
+
+		bool operator==(const Microphone& other) const
+		{
+			return source == other.source
+				&& gainDecibels == other.gainDecibels
+				&& isPolarityInverted == other.isPolarityInverted
+				&& delayInMilliseconds == other.delayInMilliseconds;
+		}
+	};
+
+	// What the kernel is folded from.
+	struct Settings
+	{
+		// At least one. Those that cannot be read are left out.
+		std::vector<Microphone> microphones;
+		float cabinetGainDecibels = 0.0f;
+		// Empty when the EQ is not to be folded in.
+		std::vector<float> equaliserImpulseResponse;
+		// Empty when lofi is not to be folded in.
+		ImpulseResponseSource lofi;
+		// How the folded impulse response is shortened.
+		ImpulseResponseConditioner::Options conditioning;
+
+		bool operator==(const Settings& other) const
+		{
+			return microphones == other.microphones
+				&& cabinetGainDecibels == other.cabinetGainDecibels
+				&& equaliserImpulseResponse == other.equaliserImpulseResponse
+				&& lofi == other.lofi
+				&& conditioning == other.conditioning;
+		}
+	};
+
+	using ProcessFunction = std::function<void(juce::AudioBuffer<float>&)>;
+	using ResetFunction = std::function<void()>;
+
+	LinearStageFolder() :
+		juce::Thread("Linear Stage Folder")
+	{
+		startThread();
+	}
+
+	~LinearStageFolder() override
+	{
+		stopThread(stopTimeoutMilliseconds);
+	}
+
+	// Construction only. How the chain runs a stage that can be folded in, for
+	// the crossfades that fold it in or hand it back.
+	void setStageFunctions(FoldedStage stage, ProcessFunction processFunction, ResetFunction resetFunction)
+	{
+		auto& functions = mStageFunctions[getStageIndex(stage)];
+		functions.process = std::move(processFunction);
+		functions.reset = std::move(resetFunction);
+	}
+
+	// The kernel is folded again at the new rate, from the last settings given.
+	// The partition size is passed on to PartitionedConvolution::prepare().
+	void prepare(const juce::dsp::ProcessSpec& spec, int partitionSize = PartitionedConvolution::timedPartitionSize)
+	{
+		{
+			const juce::ScopedLock lock(mFoldLock);
+			mSampleRate = spec.sampleRate;
+			mConvolution.prepare(spec, juce::roundToInt(spec.sampleRate * maximumImpulseResponseLengthInSeconds), partitionSize);
+			mHasFolded = false;
+		}
+
+		{
+			const juce::ScopedLock lock(mSettingsLock);
+			mIsFoldPending = mHasSettings;
+		}
+
+		notify();
+	}
+
+	void reset()
+	{
+		mConvolution.reset();
+	}
+
+	// Message thread. Folds a new kernel on the background thread, unless it
+	// would be the one already folded.
+	void fold(Settings newSettings)
+	{
+		{
+			const juce::ScopedLock lock(mSettingsLock);
+			mSettings = std::move(newSettings);
+			mHasSettings = true;
+			mIsFoldPending = true;
+		}
+
+		notify();
+	}
+
+	// Any thread. The length of the kernel in use, or 0 before the first one
+	// has been taken over.
+	int getImpulseResponseSize() const
+	{
+		return mConvolution.getKernelLength();
+	}
+
+	// Message thread. The convolution's. What the cache holds is shared with
+	// every other instance, so not counted here.
+	size_t getMemoryUsageInBytes() const
+	{
+		return mConvolution.getMemoryUsageInBytes();
+	}
+
+	// Audio thread, at the start of every block, as the cabinet may not run.
+	void beginBlock()
+	{
+		mBlockFoldedStages = 0;
+	}
+
+	// Audio thread.
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		mConvolution.processUnmixed(buffer);
+		auto blockFoldedStages = getFoldedStages(mConvolution.getKernel());
+
+		if (mConvolution.isCrossfading())
+		{
+			const auto previousFoldedStages = getFoldedStages(mConvolution.getPreviousKernel());
+			auto previousOutput = mConvolution.getPreviousOutput(buffer.getNumChannels(), buffer.getNumSamples());
+
+			for (const auto stage : foldedStages)
+			{
+				auto& functions = mStageFunctions[getStageIndex(stage)];
+				const auto isFoldedIn = (blockFoldedStages & stage) != 0;
+				const auto wasFoldedIn = (previousFoldedStages & stage) != 0;
+
+				if (isFoldedIn && !wasFoldedIn)
+				{
+					functions.process(previousOutput);
+				}
+				else if (wasFoldedIn && !isFoldedIn)
+				{
+					if (mConvolution.isStartingCrossfade())
+					{
+						functions.reset();
+					}
+
+					functions.process(buffer);
+				}
+			}
+
+			mConvolution.mixCrossfade(buffer);
+			blockFoldedStages |= previousFoldedStages;
+		}
+
+		mBlockFoldedStages = blockFoldedStages;
+	}
+
+	// Audio thread. Whether the stage has been done for this block, so must
+	// leave it alone.
+	bool isFolded(FoldedStage stage) const
+	{
+		return (mBlockFoldedStages & stage) != 0;
+	}
+
+private:
+	static constexpr int stopTimeoutMilliseconds = 4000;
+	// The background thread also wakes this often to free the kernels the
+	// audio thread has finished with.
+	static constexpr int collectIntervalMilliseconds = 100;
+	// Below this, relative to its peak, the end of the EQ's response is cut.
+	static constexpr float equaliserTailThreshold = 1.0e-5f;
+	// How far the ripples of a microphone delayed by part of a sample are kept
+	// either side of it.
+	static constexpr int blendPaddingInSamples = 64;
+
+	struct StageFunctions
+	{
+		ProcessFunction process;
+		ResetFunction reset;
+	};
+
+	PartitionedConvolution mConvolution;
+	std::array<StageFunctions, foldedStages.size()> mStageFunctions;
+	int mBlockFoldedStages = 0;
+
+	juce::CriticalSection mSettingsLock;
+	Settings mSettings;
+	bool mHasSettings = false;
+	bool mIsFoldPending = false;
+
+	// Held while folding, which prepare() waits for.
+	juce::CriticalSection mFoldLock;
+	double mSampleRate = 0.0;
+	Settings mFoldedSettings;
+	bool mHasFolded = false;
+	juce::SharedResourcePointer<ImpulseResponseCache> mImpulseResponseCache;
+
+	static int getStageIndex(FoldedStage stage)
+	{
+		return stage == instrumentEqualiser ? 0 : 1;
+	}
+
+	static int getFoldedStages(const PartitionedConvolution::Kernel* kernel)
+	{
+		return kernel != nullptr ? kernel->tag : 0;
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			wait(collectIntervalMilliseconds);
+			mConvolution.collectRetiredKernels();
+
+			Settings settings;
+			{
+				const juce::ScopedLock lock(mSettingsLock);
+				if (!mIsFoldPending)
+				{
+					continue;
+				}
+
+				settings = mSettings;
+				mIsFoldPending = false;
+			}
+
+			foldKernel(settings);
+		}
+	}
+
+	void foldKernel(const Settings& settings)
+	{
+		const juce::ScopedLock lock(mFoldLock);
+
+		if (mSampleRate <= 0.0 || (mHasFolded && settings == mFoldedSettings))
+		{
+			return;
+		}
+
+		// A cabinet none of whose microphones can be read leaves the kernel as
+		// it was, as juce::dsp::Convolution does.
+		std::vector<Microphone> microphones;
+		std::vector<std::shared_ptr<const ImpulseResponseCache::ImpulseResponse>> impulseResponses;
+
+		for (const auto& microphone : settings.microphones)
+		{
+			if (auto impulseResponse = mImpulseResponseCache->getImpulseResponse(microphone.source, mSampleRate))
+			{
+				microphones.push_back(microphone);
+				impulseResponses.push_back(std::move(impulseResponse));
+			}
+		}
+
+		if (impulseResponses.empty())
+		{
+			return;
+		}
+
+		const auto lofiImpulseResponse = settings.lofi.isEmpty()
+			? nullptr
+			: mImpulseResponseCache->getImpulseResponse(settings.lofi, mSampleRate);
+		const auto partitionSize = mConvolution.getPartitionSize();
+		const auto maximumKernelLength = mConvolution.getMaximumKernelLength();
+
+		const auto kernel = mImpulseResponseCache->getKernel(
+			getKernelKey(settings, microphones, impulseResponses, lofiImpulseResponse.get(), partitionSize, maximumKernelLength),
+			[&]() -> std::shared_ptr<const PartitionedConvolution::Kernel>
+			{
+				auto folded = blend(microphones, impulseResponses, mSampleRate);
+				folded.applyGain(juce::Decibels::decibelsToGain(settings.cabinetGainDecibels));
+				auto foldedStages = 0;
+
+				if (!settings.equaliserImpulseResponse.empty())
+				{
+					folded = convolve(folded, trimEqualiserImpulseResponse(settings.equaliserImpulseResponse));
+					foldedStages |= instrumentEqualiser;
+				}
+
+				if (lofiImpulseResponse != nullptr)
+				{
+					folded = convolve(folded, lofiImpulseResponse->buffer);
+					foldedStages |= lofi;
+				}
+
+				ImpulseResponseConditioner::condition(folded, settings.conditioning, mSampleRate);
+
+				return PartitionedConvolution::createKernel(folded, partitionSize, maximumKernelLength, foldedStages);
+			});
+
+		// A copy, sharing the spectra, as the convolution takes ownership.
+		mConvolution.setKernel(std::make_unique<PartitionedConvolution::Kernel>(*kernel));
+
+		mFoldedSettings = settings;
+		mHasFolded = true;
+	}
+
+	// Everything the kernel is folded from, with the impulse responses by the
+	// hash of their files, so the same settings from any instance find it.
+	static juce::String getKernelKey(const Settings& settings,
+		const std::vector<Microphone>& microphones,
+		const std::vector<std::shared_ptr<const ImpulseResponseCache::ImpulseResponse>>& impulseResponses,
+		const ImpulseResponseCache::ImpulseResponse* lofiImpulseResponse,
+		int partitionSize,
+		int maximumKernelLength)
+	{
+		juce::MemoryOutputStream stream;
+
+		for (size_t index = 0; index < microphones.size(); ++index)
+		{
+			stream << impulseResponses[index]->key
+				<< " " << juce::String::toHexString(std::bit_cast<int>(microphones[index].gainDecibels))
+				<< " " << (microphones[index].isPolarityInverted ? 1 : 0)
+				<< " " << juce::String::toHexString(std::bit_cast<int>(microphones[index].delayInMilliseconds))
+				<< " ";
+		}
+
+		stream << (lofiImpulseResponse != nullptr ? lofiImpulseResponse->key : juce::String("-"))
+			<< " " << partitionSize
+			<< " " << maximumKernelLength
+			<< " " << juce::String::toHexString(std::bit_cast<int>(settings.cabinetGainDecibels))
+			<< " " << juce::String::toHexString(std::bit_cast<int>(settings.conditioning.tailThresholdDecibels))
+			<< " " << (settings.conditioning.isMinimumPhase ? 1 : 0)
+			<< " " << juce::String::toHexString(std::bit_cast<juce::int64>(settings.conditioning.maximumLengthInSeconds))
+			<< " " << static_cast<int>(settings.equaliserImpulseResponse.size())
+			<< " " << juce::String::toHexString(static_cast<juce::int64>(ImpulseResponseCache::getHash(
+				settings.equaliserImpulseResponse.data(),
+				settings.equaliserImpulseResponse.size() * sizeof(float))));
+
+		return stream.toString();
+	}
+
+	// The microphones' impulse responses at their gains and polarities, delayed
+	// against the earliest and summed. A single microphone is only scaled.
+	static juce::AudioBuffer<float> blend(const std::vector<Microphone>& microphones,
+		const std::vector<std::shared_ptr<const ImpulseResponseCache::ImpulseResponse>>& impulseResponses,
+		double sampleRate)
+	{
+		auto earliestDelayInMilliseconds = std::numeric_limits<float>::max();
+		for (const auto& microphone : microphones)
+		{
+			earliestDelayInMilliseconds = juce::jmin(earliestDelayInMilliseconds, microphone.delayInMilliseconds);
+		}
+
+		const auto getGain = [](const Microphone& microphone)
+		{
+			return juce::Decibels::decibelsToGain(microphone.gainDecibels) * (microphone.isPolarityInverted ? -1.0f : 1.0f);
+		};
+
+		const auto getDelayInSamples = [&](const Microphone& microphone)
+		{
+			return static_cast<double>(microphone.delayInMilliseconds - earliestDelayInMilliseconds) * 0.001 * sampleRate;
+		};
+
+		if (microphones.size() == 1)
+		{
+			auto blended = impulseResponses.front()->buffer;
+			blended.applyGain(getGain(microphones.front()));
+			return blended;
+		}
+
+		auto length = 0;
+		auto numChannels = 0;
+
+		for (size_t index = 0; index < microphones.size(); ++index)
+		{
+			const auto& buffer = impulseResponses[index]->buffer;
+			length = juce::jmax(length, buffer.getNumSamples() + static_cast<int>(std::ceil(getDelayInSamples(microphones[index]))));
+			numChannels = juce::jmax(numChannels, buffer.getNumChannels());
+		}
+
+		// Room for the ripples either side of a delay that is not a whole
+		// number of samples, which would otherwise wrap around.
+		const auto fftSize = juce::nextPowerOfTwo(length + 2 * blendPaddingInSamples);
+		juce::dsp::FFT fft(juce::roundToInt(std::log2(fftSize)));
+		std::vector<float> spectrum(static_cast<size_t>(2 * fftSize));
+		std::vector<std::complex<float>> sum(static_cast<size_t>(fftSize));
+		juce::AudioBuffer<float> result(numChannels, length);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			std::fill(sum.begin(), sum.end(), std::complex<float>());
+
+			for (size_t index = 0; index < microphones.size(); ++index)
+			{
+				const auto& buffer = impulseResponses[index]->buffer;
+				const auto* samples = buffer.getReadPointer(juce::jmin(channel, buffer.getNumChannels() - 1));
+				const auto gain = getGain(microphones[index]);
+				// Late by the padding, which is taken back off the result.
+				const auto delayInSamples = getDelayInSamples(microphones[index]) + blendPaddingInSamples;
+
+				std::fill(spectrum.begin(), spectrum.end(), 0.0f);
+				std::copy(samples, samples + buffer.getNumSamples(), spectrum.begin());
+				fft.performRealOnlyForwardTransform(spectrum.data());
+
+				for (int bin = 0; bin < fftSize; ++bin)
+				{
+					// The bins past the middle are the negative frequencies.
+					const auto frequency = bin <= fftSize / 2 ? bin : bin - fftSize;
+					const auto phase = -juce::MathConstants<double>::twoPi * frequency * delayInSamples / fftSize;
+					sum[static_cast<size_t>(bin)] += std::complex<float>(spectrum[2 * bin], spectrum[2 * bin + 1])
+						* std::polar(gain, static_cast<float>(phase));
+				}
+			}
+
+			for (int bin = 0; bin < fftSize; ++bin)
+			{
+				spectrum[2 * bin] = sum[static_cast<size_t>(bin)].real();
+				spectrum[2 * bin + 1] = sum[static_cast<size_t>(bin)].imag();
+			}
+
+			fft.performRealOnlyInverseTransform(spectrum.data());
+			std::copy(spectrum.begin() + blendPaddingInSamples, spectrum.begin() + blendPaddingInSamples + length, result.getWritePointer(channel));
+		}
+
+		return result;
+	}
+
+	static juce::AudioBuffer<float> trimEqualiserImpulseResponse(const std::vector<float>& impulseResponse)
+	{
+		const auto peak = std::accumulate(impulseResponse.begin(), impulseResponse.end(), 0.0f,
+			[](float maximum, float sample) { return juce::jmax(maximum, std::abs(sample)); });
+
+		auto length = static_cast<int>(impulseResponse.size());
+		while (length > 1 && std::abs(impulseResponse[static_cast<size_t>(length - 1)]) <= peak * equaliserTailThreshold)
+		{
+			--length;
+		}
+
+		juce::AudioBuffer<float> buffer(1, length);
+		std::copy(impulseResponse.begin(), impulseResponse.begin() + length, buffer.getWritePointer(0));
+		return buffer;
+	}
+
+	// Each channel of a with the same channel of b, a mono one serving both.
+	static juce::AudioBuffer<float> convolve(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+	{
+		const auto length = a.getNumSamples() + b.getNumSamples() - 1;
+		const auto numChannels = juce::jmax(a.getNumChannels(), b.getNumChannels());
+		juce::AudioBuffer<float> result(numChannels, length);
+
+		// An impulse, which is all the EQ is with every band off.
+		if (b.getNumSamples() == 1 && b.getNumChannels() == 1)
+		{
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				result.copyFrom(channel, 0, a, juce::jmin(channel, a.getNumChannels() - 1), 0, length);
+			}
+
+			result.applyGain(b.getSample(0, 0));
+			return result;
+		}
+
+		const auto fftSize = juce::nextPowerOfTwo(length);
+		juce::dsp::FFT fft(juce::roundToInt(std::log2(fftSize)));
+		std::vector<float> aSpectrum(static_cast<size_t>(2 * fftSize));
+		std::vector<float> bSpectrum(static_cast<size_t>(2 * fftSize));
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* aSamples = a.getReadPointer(juce::jmin(channel, a.getNumChannels() - 1));
+			const auto* bSamples = b.getReadPointer(juce::jmin(channel, b.getNumChannels() - 1));
+
+			std::fill(aSpectrum.begin(), aSpectrum.end(), 0.0f);
+			std::fill(bSpectrum.begin(), bSpectrum.end(), 0.0f);
+			std::copy(aSamples, aSamples + a.getNumSamples(), aSpectrum.begin());
+			std::copy(bSamples, bSamples + b.getNumSamples(), bSpectrum.begin());
+			fft.performRealOnlyForwardTransform(aSpectrum.data());
+			fft.performRealOnlyForwardTransform(bSpectrum.data());
+
+			for (int bin = 0; bin < fftSize; ++bin)
+			{
+				const std::complex<float> product =
+					std::complex<float>(aSpectrum[2 * bin], aSpectrum[2 * bin + 1])
+					* std::complex<float>(bSpectrum[2 * bin], bSpectrum[2 * bin + 1]);
+				aSpectrum[2 * bin] = product.real();
+				aSpectrum[2 * bin + 1] = product.imag();
+			}
+
+			fft.performRealOnlyInverseTransform(aSpectrum.data());
+			std::copy(aSpectrum.begin(), aSpectrum.begin() + length, result.getWritePointer(channel));
+		}
+
+		return result;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LinearStageFolder)
+};
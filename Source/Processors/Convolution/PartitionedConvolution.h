@@ -0,0 +1,878 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+#include "../../Utilities/MemoryUsage.h"
+
+/*
+	Convolution without latency at any block size, uniformly partitioned and
+	overlap-add in the frequency domain. Each partition of input is transformed
+	once, when it is complete, into a history of spectra. A partition that comes
+	in whole within a block is convolved there in one go. One that comes in
+	pieces has the part of its output that the earlier partitions make worked
+	out from the history as it starts, and the part that its own samples make
+	through the kernel's first partition worked out directly, as a vectorised
+	dot product per sample. What its own samples make past its end is added
+	once it is complete.
+
+	The partition size trades one part against the other: a longer one makes
+	the dot products longer and the transforms fewer, and blocks at least as
+	long need no dot products at all. prepare() tries each size on a copy of
+	the engine, at the block size and kernel length it is given, and keeps the
+	fastest, counting the slowest block as well as the average, as the
+	transforms fall on the blocks a partition starts or completes in. What it
+	finds is kept for the rest of the process. The timings vary from run to
+	run, and the output with them in its last bits, so an offline render asks
+	for a fixed size instead.
+
+	Kernels are built off the audio thread with createKernel() and handed over
+	with setKernel(), which the audio thread picks up at the start of a block.
+	The spectra of past input are kept apart from the kernels, so a new kernel
+	comes in with its whole history. It runs next to the kernel it replaces
+	while one is crossfaded into the other, and nothing is lost to the gap a
+	freshly loaded convolution would leave.
+
+	The audio thread takes kernels over and hands back the ones it is done
+	with, which are freed by the next call to setKernel() or
+	collectRetiredKernels(). It never allocates or frees one itself.
+ */
+class PartitionedConvolution
+{
+public:
+	static constexpr double crossfadeLengthInSeconds = 0.05;
+	static constexpr int minimumPartitionSize = 64;
+	static constexpr int maximumPartitionSize = 2048;
+	static constexpr int defaultPartitionSize = 512;
+
+	// Given to prepare() for the fastest partition size.
+	static constexpr int timedPartitionSize = 0;
+
+	// An impulse response split into partitions and transformed, with the first
+	// partition's samples kept as well. The tag is for the owner to say what
+	// the impulse response was made of. Copies share the samples and the
+	// spectra, which are never changed once made.
+	struct Kernel
+	{
+		int partitionSize = 0;
+		int numPartitions = 0;
+		int numChannels = 0;
+		int length = 0;
+		int tag = 0;
+		// By channel, the first partition's samples back to front.
+		std::shared_ptr<const std::vector<float>> head;
+		// By channel then partition, the real parts of the bins then the
+		// imaginary parts.
+		std::shared_ptr<const std::vector<float>> spectra;
+
+		// How many of the first partition's samples there are, at the end of
+		// the channel's head.
+		int getHeadLength() const
+		{
+			return juce::jmin(partitionSize, length);
+		}
+
+		const float* getHead(int channel) const
+		{
+			return head->data() + static_cast<size_t>(channel) * partitionSize;
+		}
+
+		const float* getSpectrum(int channel, int partition) const
+		{
+			return spectra->data() + getSpectrumOffset(channel, partition);
+		}
+
+		size_t getSpectrumOffset(int channel, int partition) const
+		{
+			return (static_cast<size_t>(channel) * numPartitions + partition) * 2 * (partitionSize + 1);
+		}
+
+		size_t getMemoryUsageInBytes() const
+		{
+			return (head != nullptr ? MemoryUsage::getSizeInBytes(*head) : 0)
+				+ (spectra != nullptr ? MemoryUsage::getSizeInBytes(*spectra) : 0);
+		}
+	};
+
+	PartitionedConvolution() = default;
+
+	~PartitionedConvolution()
+	{
+		releaseKernels();
+	}
+
+	// Any thread but the audio thread. The impulse response is cut to
+	// maximumLength samples, and partitionSize must be what getPartitionSize()
+	// returns once prepared.
+	static std::unique_ptr<Kernel> createKernel(const juce::AudioBuffer<float>& impulseResponse, int partitionSize, int maximumLength, int tag)
+	{
+		jassert(juce::isPowerOfTwo(partitionSize));
+
+		auto kernel = std::make_unique<Kernel>();
+		kernel->partitionSize = partitionSize;
+		kernel->length = juce::jlimit(1, juce::jmax(1, maximumLength), impulseResponse.getNumSamples());
+		kernel->numPartitions = (kernel->length + partitionSize - 1) / partitionSize;
+		kernel->numChannels = juce::jmax(1, impulseResponse.getNumChannels());
+		kernel->tag = tag;
+
+		const auto numBins = partitionSize + 1;
+		std::vector<float> head(static_cast<size_t>(kernel->numChannels) * partitionSize, 0.0f);
+		std::vector<float> spectra(static_cast<size_t>(kernel->numChannels) * kernel->numPartitions * 2 * numBins, 0.0f);
+
+		audiofft::AudioFFT fft;
+		fft.init(static_cast<size_t>(2 * partitionSize));
+		std::vector<float> workspace(static_cast<size_t>(2 * partitionSize));
+
+		for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+		{
+			const auto* samples = impulseResponse.getReadPointer(channel);
+			std::reverse_copy(samples, samples + kernel->getHeadLength(), head.begin() + static_cast<size_t>(channel + 1) * partitionSize - kernel->getHeadLength());
+
+			for (int partition = 0; partition < kernel->numPartitions; ++partition)
+			{
+				const auto start = partition * partitionSize;
+				const auto numPartitionSamples = juce::jmin(partitionSize, kernel->length - start);
+
+				std::fill(workspace.begin(), workspace.end(), 0.0f);
+				std::copy(samples + start, samples + start + numPartitionSamples, workspace.begin());
+
+				auto* spectrum = spectra.data() + kernel->getSpectrumOffset(channel, partition);
+				fft.fft(workspace.data(), spectrum, spectrum + numBins);
+			}
+		}
+
+		kernel->head = std::make_shared<const std::vector<float>>(std::move(head));
+		kernel->spectra = std::make_shared<const std::vector<float>>(std::move(spectra));
+		return kernel;
+	}
+
+	// Frees every kernel, so the owner must hand a new one over afterwards.
+	// The partition size is a power of two from minimumPartitionSize to
+	// maximumPartitionSize, or timedPartitionSize, in which case the first call
+	// for a block size, kernel length and channel count times the partition
+	// sizes, which takes a moment.
+	void prepare(const juce::dsp::ProcessSpec& spec, int maximumKernelLength, int partitionSize = timedPartitionSize)
+	{
+		if (partitionSize == timedPartitionSize)
+		{
+			partitionSize = findFastestPartitionSize(spec, maximumKernelLength);
+		}
+
+		jassert(juce::isPowerOfTwo(partitionSize) && partitionSize >= minimumPartitionSize && partitionSize <= maximumPartitionSize);
+		prepareAtPartitionSize(spec, maximumKernelLength, partitionSize);
+	}
+
+	void reset()
+	{
+		for (auto& channel : mChannels)
+		{
+			std::fill(channel.input.begin(), channel.input.end(), 0.0f);
+			std::fill(channel.history.begin(), channel.history.end(), 0.0f);
+		}
+
+		for (auto& runner : mRunners)
+		{
+			std::fill(runner.tails.begin(), runner.tails.end(), 0.0f);
+			std::fill(runner.overlaps.begin(), runner.overlaps.end(), 0.0f);
+		}
+
+		mInputPosition = 0;
+		mCurrentPartition = 0;
+
+		if (mIsCrossfading)
+		{
+			finishCrossfade();
+		}
+	}
+
+	int getPartitionSize() const
+	{
+		return mPartitionSize;
+	}
+
+	int getMaximumKernelLength() const
+	{
+		return mMaximumKernelLength;
+	}
+
+	// Any thread but the audio thread. Replaces any kernel still waiting to be
+	// picked up.
+	void setKernel(std::unique_ptr<Kernel> newKernel)
+	{
+		jassert(newKernel == nullptr || newKernel->partitionSize == mPartitionSize);
+
+		collectRetiredKernels();
+		delete mPendingKernel.exchange(newKernel.release(), std::memory_order_acq_rel);
+	}
+
+	// Any thread but the audio thread.
+	void collectRetiredKernels()
+	{
+		delete mRetiredKernel.exchange(nullptr, std::memory_order_acq_rel);
+	}
+
+	// Any thread. The length of the kernel the audio thread has taken over, or
+	// 0 before it has taken one.
+	int getKernelLength() const
+	{
+		return mKernelLength.load(std::memory_order_relaxed);
+	}
+
+	// Message thread, between prepare() calls. What prepare() allocated and the
+	// kernel the audio thread has taken over. A kernel being faded out or
+	// waiting to be picked up is not counted.
+	size_t getMemoryUsageInBytes() const
+	{
+		auto bytes = MemoryUsage::getSizeInBytes(mWorkspace)
+			+ MemoryUsage::getSizeInBytes(mSpectrum)
+			+ MemoryUsage::getSizeInBytes(mPreviousOutput)
+			+ mKernelMemoryUsageInBytes.load(std::memory_order_relaxed);
+
+		for (const auto& channel : mChannels)
+		{
+			bytes += MemoryUsage::getSizeInBytes(channel.input) + MemoryUsage::getSizeInBytes(channel.history);
+		}
+
+		for (const auto& runner : mRunners)
+		{
+			bytes += MemoryUsage::getSizeInBytes(runner.tails) + MemoryUsage::getSizeInBytes(runner.overlaps);
+		}
+
+		return bytes;
+	}
+
+	// Audio thread.
+	void process(juce::AudioBuffer<float>& buffer)
+	{
+		processUnmixed(buffer);
+
+		if (mIsCrossfading)
+		{
+			mixCrossfade(buffer);
+		}
+	}
+
+	/*
+		Audio thread. Convolves buffer in place with the current kernel. While a
+		crossfade is under way, the block convolved with the kernel being faded
+		out is left in getPreviousOutput() for the caller to mix in with
+		mixCrossfade(), which lets the two be treated differently first.
+	 */
+	void processUnmixed(juce::AudioBuffer<float>& buffer)
+	{
+		const auto numChannels = juce::jmin(buffer.getNumChannels(), static_cast<int>(mChannels.size()));
+		const auto numSamples = buffer.getNumSamples();
+		jassert(numSamples <= mPreviousOutput.getNumSamples());
+
+		if (!mIsCrossfading)
+		{
+			takePendingKernel();
+		}
+
+		auto& current = mRunners[mCurrentRunner];
+		auto& previous = mRunners[1 - mCurrentRunner];
+
+		// Without a kernel the signal passes through unchanged.
+		if (mIsCrossfading && previous.kernel == nullptr)
+		{
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				mPreviousOutput.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+			}
+		}
+
+		for (int offset = 0; offset < numSamples;)
+		{
+			const auto numChunkSamples = juce::jmin(numSamples - offset, mPartitionSize - mInputPosition);
+			const auto isWholePartition = numChunkSamples == mPartitionSize;
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				const auto* samples = buffer.getReadPointer(channel) + offset;
+				std::copy(samples, samples + numChunkSamples, mChannels[static_cast<size_t>(channel)].input.begin() + tapSize + mInputPosition);
+			}
+
+			if (isWholePartition)
+			{
+				transformInput(numChannels);
+			}
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				if (mIsCrossfading && previous.kernel != nullptr)
+				{
+					processRunner(previous, channel, mPreviousOutput.getWritePointer(channel) + offset, numChunkSamples);
+				}
+
+				if (current.kernel != nullptr)
+				{
+					processRunner(current, channel, buffer.getWritePointer(channel) + offset, numChunkSamples);
+				}
+			}
+
+			offset += numChunkSamples;
+			mInputPosition += numChunkSamples;
+
+			if (mInputPosition == mPartitionSize)
+			{
+				if (!isWholePartition)
+				{
+					transformInput(numChannels);
+					addSpills(numChannels);
+				}
+
+				mInputPosition = 0;
+				mCurrentPartition = (mCurrentPartition + 1) % mMaximumNumPartitions;
+			}
+		}
+	}
+
+	// Audio thread, after processUnmixed() during a crossfade.
+	void mixCrossfade(juce::AudioBuffer<float>& buffer)
+	{
+		jassert(mIsCrossfading);
+
+		const auto numChannels = juce::jmin(buffer.getNumChannels(), static_cast<int>(mChannels.size()));
+		const auto numSamples = buffer.getNumSamples();
+		const auto step = 1.0f / static_cast<float>(mCrossfadeLength);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			auto* samples = buffer.getWritePointer(channel);
+			const auto* previousSamples = mPreviousOutput.getReadPointer(channel);
+
+			for (int sample = 0; sample < numSamples; ++sample)
+			{
+				const auto gain = juce::jmin(1.0f, static_cast<float>(mCrossfadePosition + sample + 1) * step);
+				samples[sample] = previousSamples[sample] + gain * (samples[sample] - previousSamples[sample]);
+			}
+		}
+
+		mCrossfadePosition += numSamples;
+
+		if (mCrossfadePosition >= mCrossfadeLength)
+		{
+			finishCrossfade();
+		}
+	}
+
+	// Audio thread. What the kernel being faded out made of the last block, as
+	// many channels and samples as it had.
+	juce::AudioBuffer<float> getPreviousOutput(int numChannels, int numSamples)
+	{
+		return juce::AudioBuffer<float>(mPreviousOutput.getArrayOfWritePointers(), juce::jmin(numChannels, mPreviousOutput.getNumChannels()), numSamples);
+	}
+
+	// Audio thread.
+	bool isCrossfading() const
+	{
+		return mIsCrossfading;
+	}
+
+	// Audio thread. True for the block a crossfade starts in.
+	bool isStartingCrossfade() const
+	{
+		return mIsCrossfading && mCrossfadePosition == 0;
+	}
+
+	// Audio thread. Either may be null, which passes the signal through.
+	const Kernel* getKernel() const
+	{
+		return mRunners[mCurrentRunner].kernel;
+	}
+
+	const Kernel* getPreviousKernel() const
+	{
+		return mIsCrossfading ? mRunners[1 - mCurrentRunner].kernel : nullptr;
+	}
+
+private:
+	// Enough blocks for every partition size to complete a few partitions.
+	static constexpr int minimumNumTimedBlocks = 8;
+	static constexpr int numTimedPartitions = 4;
+	static constexpr int numTimings = 2;
+	// The dot products are a multiple of this long, reading zeros from
+	// before the partition being filled for the taps that are not there.
+	static constexpr int tapSize = 8;
+
+	struct ChannelState
+	{
+		// Zeros, then the partition being filled.
+		std::vector<float> input;
+		// The spectra of the last mMaximumNumPartitions whole partitions of
+		// input, as a ring.
+		std::vector<float> history;
+	};
+
+	// A kernel and what running it carries from partition to partition.
+	struct Runner
+	{
+		Kernel* kernel = nullptr;
+		// By channel, the part of the output for the partition being filled
+		// that does not depend on it, while it comes in pieces.
+		std::vector<float> tails;
+		// By channel, the part of the output so far that reaches past the
+		// partition being filled.
+		std::vector<float> overlaps;
+	};
+
+	int mPartitionSize = minimumPartitionSize;
+	int mNumBins = minimumPartitionSize + 1;
+	int mMaximumKernelLength = 0;
+	int mMaximumNumPartitions = 1;
+	int mCrossfadeLength = 1;
+	audiofft::AudioFFT mFft;
+
+	std::vector<ChannelState> mChannels;
+	std::array<Runner, 2> mRunners;
+	int mCurrentRunner = 0;
+	bool mIsCrossfading = false;
+	int mCrossfadePosition = 0;
+	int mInputPosition = 0;
+	int mCurrentPartition = 0;
+
+	std::vector<float> mWorkspace;
+	std::vector<float> mSpectrum;
+	juce::AudioBuffer<float> mPreviousOutput;
+
+	std::atomic<Kernel*> mPendingKernel{ nullptr };
+	std::atomic<Kernel*> mRetiredKernel{ nullptr };
+	std::atomic<int> mKernelLength{ 0 };
+	std::atomic<size_t> mKernelMemoryUsageInBytes{ 0 };
+
+	void prepareAtPartitionSize(const juce::dsp::ProcessSpec& spec, int maximumKernelLength, int partitionSize)
+	{
+		releaseKernels();
+
+		mPartitionSize = partitionSize;
+		mNumBins = mPartitionSize + 1;
+		mMaximumKernelLength = maximumKernelLength;
+		mMaximumNumPartitions = juce::jmax(1, (maximumKernelLength + mPartitionSize - 1) / mPartitionSize);
+		mFft.init(static_cast<size_t>(2 * mPartitionSize));
+		mCrossfadeLength = juce::jmax(1, juce::roundToInt(spec.sampleRate * crossfadeLengthInSeconds));
+
+		const auto numChannels = static_cast<int>(spec.numChannels);
+		mChannels.resize(static_cast<size_t>(numChannels));
+		for (auto& channel : mChannels)
+		{
+			channel.input.assign(static_cast<size_t>(tapSize + mPartitionSize), 0.0f);
+			channel.history.assign(static_cast<size_t>(mMaximumNumPartitions) * 2 * mNumBins, 0.0f);
+		}
+
+		for (auto& runner : mRunners)
+		{
+			runner.tails.assign(static_cast<size_t>(numChannels) * mPartitionSize, 0.0f);
+			runner.overlaps.assign(static_cast<size_t>(numChannels) * mPartitionSize, 0.0f);
+		}
+
+		mWorkspace.assign(static_cast<size_t>(2 * mPartitionSize), 0.0f);
+		mSpectrum.assign(static_cast<size_t>(2 * mNumBins), 0.0f);
+		mPreviousOutput.setSize(numChannels, static_cast<int>(spec.maximumBlockSize), false, false, true);
+
+		reset();
+	}
+
+	static int findFastestPartitionSize(const juce::dsp::ProcessSpec& spec, int maximumKernelLength)
+	{
+		static juce::CriticalSection lock;
+		static std::map<std::tuple<juce::uint32, int, juce::uint32>, int> fastestPartitionSizes;
+
+		const auto key = std::make_tuple(spec.maximumBlockSize, maximumKernelLength, spec.numChannels);
+		const juce::ScopedLock scopedLock(lock);
+
+		if (const auto found = fastestPartitionSizes.find(key); found != fastestPartitionSizes.end())
+		{
+			return found->second;
+		}
+
+		juce::AudioBuffer<float> impulseResponse(juce::jmax(1, static_cast<int>(spec.numChannels)), juce::jmax(1, maximumKernelLength));
+		fillWithNoise(impulseResponse);
+
+		// The longest first, as it is usually the fastest, and the rest stop
+		// timing as soon as they fall behind it.
+		auto fastestPartitionSize = maximumPartitionSize;
+		auto fastestSeconds = std::numeric_limits<double>::max();
+
+		for (auto partitionSize = maximumPartitionSize; partitionSize >= minimumPartitionSize; partitionSize /= 2)
+		{
+			const auto seconds = timePartitionSize(spec, impulseResponse, partitionSize, fastestSeconds);
+
+			if (seconds < fastestSeconds)
+			{
+				fastestPartitionSize = partitionSize;
+				fastestSeconds = seconds;
+			}
+		}
+
+		fastestPartitionSizes[key] = fastestPartitionSize;
+		return fastestPartitionSize;
+	}
+
+	// The average time a block takes plus the longest, the least of a few
+	// timings, or as soon as it is known to be no less than limitInSeconds.
+	static double timePartitionSize(const juce::dsp::ProcessSpec& spec, const juce::AudioBuffer<float>& impulseResponse, int partitionSize, double limitInSeconds)
+	{
+		const auto blockSize = juce::jmax(1, static_cast<int>(spec.maximumBlockSize));
+		const auto numBlocks = juce::jmax(minimumNumTimedBlocks, numTimedPartitions * partitionSize / blockSize);
+		const auto secondsPerTick = 1.0 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+		PartitionedConvolution convolution;
+		convolution.prepare(spec, impulseResponse.getNumSamples(), partitionSize);
+		convolution.setKernel(createKernel(impulseResponse, partitionSize, impulseResponse.getNumSamples(), 0));
+
+		// Each block is convolved from the same noise, so the output never grows.
+		juce::AudioBuffer<float> noise(static_cast<int>(spec.numChannels), blockSize);
+		juce::AudioBuffer<float> block(static_cast<int>(spec.numChannels), blockSize);
+		fillWithNoise(noise);
+
+		// Only the kernel's own work is timed, without the crossfade in.
+		convolution.process(block);
+		convolution.finishCrossfade();
+
+		auto fastestSeconds = std::numeric_limits<double>::max();
+
+		for (int timing = 0; timing < numTimings; ++timing)
+		{
+			auto totalSeconds = 0.0;
+			auto longestSeconds = 0.0;
+
+			for (int index = 0; index < numBlocks; ++index)
+			{
+				for (int channel = 0; channel < block.getNumChannels(); ++channel)
+				{
+					block.copyFrom(channel, 0, noise, channel, 0, blockSize);
+				}
+
+				const auto startTicks = juce::Time::getHighResolutionTicks();
+				convolution.processUnmixed(block);
+				const auto seconds = static_cast<double>(juce::Time::getHighResolutionTicks() - startTicks) * secondsPerTick;
+
+				totalSeconds += seconds;
+				longestSeconds = juce::jmax(longestSeconds, seconds);
+
+				if (totalSeconds / numBlocks + longestSeconds >= juce::jmin(limitInSeconds, fastestSeconds))
+				{
+					break;
+				}
+			}
+
+			fastestSeconds = juce::jmin(fastestSeconds, totalSeconds / numBlocks + longestSeconds);
+		}
+
+		return fastestSeconds;
+	}
+
+	static void fillWithNoise(juce::AudioBuffer<float>& buffer)
+	{
+		juce::Random random(1);
+
+		for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+		{
+			auto* samples = buffer.getWritePointer(channel);
+
+			for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+			{
+				samples[sample] = random.nextFloat() * 0.02f - 0.01f;
+			}
+		}
+	}
+
+	void releaseKernels()
+	{
+		for (auto& runner : mRunners)
+		{
+			delete runner.kernel;
+			runner.kernel = nullptr;
+		}
+
+		mIsCrossfading = false;
+		delete mPendingKernel.exchange(nullptr);
+		collectRetiredKernels();
+		mKernelLength.store(0, std::memory_order_relaxed);
+		mKernelMemoryUsageInBytes.store(0, std::memory_order_relaxed);
+	}
+
+	// Only while the last kernel to be retired has been collected, so there is
+	// never more than one waiting.
+	void takePendingKernel()
+	{
+		if (mRetiredKernel.load(std::memory_order_acquire) != nullptr
+			|| mPendingKernel.load(std::memory_order_relaxed) == nullptr)
+		{
+			return;
+		}
+
+		auto* kernel = mPendingKernel.exchange(nullptr, std::memory_order_acq_rel);
+		if (kernel == nullptr)
+		{
+			return;
+		}
+
+		mCurrentRunner = 1 - mCurrentRunner;
+		auto& runner = mRunners[mCurrentRunner];
+		runner.kernel = kernel;
+		startRunner(runner);
+
+		mIsCrossfading = true;
+		mCrossfadePosition = 0;
+		mKernelLength.store(kernel->length, std::memory_order_relaxed);
+		mKernelMemoryUsageInBytes.store(kernel->getMemoryUsageInBytes(), std::memory_order_relaxed);
+	}
+
+	void finishCrossfade()
+	{
+		auto& previous = mRunners[1 - mCurrentRunner];
+		auto* retired = mRetiredKernel.exchange(previous.kernel, std::memory_order_acq_rel);
+		jassert(retired == nullptr);
+		juce::ignoreUnused(retired);
+
+		previous.kernel = nullptr;
+		mIsCrossfading = false;
+	}
+
+	// Brings a kernel in partway through the input as though it had been
+	// running all along, from the spectra of the input it missed.
+	void startRunner(Runner& runner)
+	{
+		const auto previousPartition = (mCurrentPartition + mMaximumNumPartitions - 1) % mMaximumNumPartitions;
+
+		for (int channel = 0; channel < static_cast<int>(mChannels.size()); ++channel)
+		{
+			auto* overlap = runner.overlaps.data() + static_cast<size_t>(channel) * mPartitionSize;
+
+			// The last partition's output, of which only what reaches into this
+			// one is kept.
+			accumulate(runner, channel, previousPartition, 0);
+			inverseTransform();
+			std::copy(mWorkspace.begin() + mPartitionSize, mWorkspace.end(), overlap);
+
+			if (mInputPosition > 0)
+			{
+				startTail(runner, channel);
+			}
+		}
+	}
+
+	// Sets mSpectrum to the sum of the kernel's partitions from firstPartition
+	// up to but not including endPartition, each times the spectrum of the
+	// input as many partitions before newestPartition.
+	void accumulate(const Runner& runner, int channel, int newestPartition, int firstPartition, int endPartition = std::numeric_limits<int>::max())
+	{
+		const auto& kernel = *runner.kernel;
+		const auto kernelChannel = juce::jmin(channel, kernel.numChannels - 1);
+		const auto& history = mChannels[static_cast<size_t>(channel)].history;
+		endPartition = juce::jmin(endPartition, kernel.numPartitions, mMaximumNumPartitions);
+
+		std::fill(mSpectrum.begin(), mSpectrum.end(), 0.0f);
+
+		for (int partition = firstPartition; partition < endPartition; ++partition)
+		{
+			const auto historyPartition = (newestPartition - partition + mMaximumNumPartitions) % mMaximumNumPartitions;
+			multiplyAccumulate(
+				history.data() + static_cast<size_t>(historyPartition) * 2 * mNumBins,
+				kernel.getSpectrum(kernelChannel, partition),
+				mSpectrum.data(),
+				mNumBins);
+		}
+	}
+
+	void processRunner(Runner& runner, int channel, float* destination, int numSamples)
+	{
+		auto* overlap = runner.overlaps.data() + static_cast<size_t>(channel) * mPartitionSize;
+
+		if (numSamples == mPartitionSize)
+		{
+			accumulate(runner, channel, mCurrentPartition, 0);
+			inverseTransform();
+
+			for (int sample = 0; sample < mPartitionSize; ++sample)
+			{
+				destination[sample] = mWorkspace[static_cast<size_t>(sample)] + overlap[sample];
+			}
+
+			std::copy(mWorkspace.begin() + mPartitionSize, mWorkspace.end(), overlap);
+			return;
+		}
+
+		if (mInputPosition == 0)
+		{
+			startTail(runner, channel);
+		}
+
+		processHead(runner, channel, destination, numSamples);
+	}
+
+	// What the earlier partitions make of the one being filled, and past it.
+	void startTail(Runner& runner, int channel)
+	{
+		auto* tail = runner.tails.data() + static_cast<size_t>(channel) * mPartitionSize;
+		auto* overlap = runner.overlaps.data() + static_cast<size_t>(channel) * mPartitionSize;
+
+		accumulate(runner, channel, mCurrentPartition, 1);
+		inverseTransform();
+
+		for (int sample = 0; sample < mPartitionSize; ++sample)
+		{
+			tail[sample] = mWorkspace[static_cast<size_t>(sample)] + overlap[sample];
+		}
+
+		std::copy(mWorkspace.begin() + mPartitionSize, mWorkspace.end(), overlap);
+	}
+
+	// What the samples of the partition being filled make of it through the
+	// kernel's first partition, directly, plus the tail.
+	void processHead(const Runner& runner, int channel, float* destination, int numSamples) const
+	{
+		const auto& kernel = *runner.kernel;
+		const auto kernelChannel = juce::jmin(channel, kernel.numChannels - 1);
+		const auto headLength = kernel.getHeadLength();
+		const auto* headEnd = kernel.getHead(kernelChannel) + mPartitionSize;
+		const auto* input = mChannels[static_cast<size_t>(channel)].input.data() + tapSize;
+		const auto* tail = runner.tails.data() + static_cast<size_t>(channel) * mPartitionSize;
+
+		for (int sample = 0; sample < numSamples; ++sample)
+		{
+			const auto position = mInputPosition + sample;
+			const auto numTaps = roundUpToTaps(juce::jmin(position + 1, headLength));
+			destination[sample] = dotProduct(headEnd - numTaps, input + position + 1 - numTaps, numTaps) + tail[position];
+		}
+	}
+
+	// Once a partition that came in pieces is complete, what its samples make
+	// through the kernel's first partition past its end.
+	void addSpills(int numChannels)
+	{
+		for (auto& runner : mRunners)
+		{
+			if (runner.kernel == nullptr)
+			{
+				continue;
+			}
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				auto* overlap = runner.overlaps.data() + static_cast<size_t>(channel) * mPartitionSize;
+
+				accumulate(runner, channel, mCurrentPartition, 0, 1);
+				inverseTransform();
+
+				for (int sample = 0; sample < mPartitionSize; ++sample)
+				{
+					overlap[sample] += mWorkspace[static_cast<size_t>(mPartitionSize + sample)];
+				}
+			}
+		}
+	}
+
+	// The partition being filled, into its place in the history.
+	void transformInput(int numChannels)
+	{
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			auto& state = mChannels[static_cast<size_t>(channel)];
+			auto* spectrum = state.history.data() + static_cast<size_t>(mCurrentPartition) * 2 * mNumBins;
+
+			std::copy(state.input.begin() + tapSize, state.input.end(), mWorkspace.begin());
+			std::fill(mWorkspace.begin() + mPartitionSize, mWorkspace.end(), 0.0f);
+			mFft.fft(mWorkspace.data(), spectrum, spectrum + mNumBins);
+		}
+	}
+
+	// From mSpectrum into mWorkspace.
+	void inverseTransform()
+	{
+		mFft.ifft(mWorkspace.data(), mSpectrum.data(), mSpectrum.data() + mNumBins);
+	}
+
+	// size is a multiple of tapSize.
+	static float dotProduct(const float* a, const float* b, int size) noexcept
+	{
+#if SUPERTONAL_FAST_MATH_SSE2
+		FastMath::SSEFloat sums(0.0f);
+		for (int index = 0; index < size; index += static_cast<int>(FastMath::SSEFloat::size))
+		{
+			sums = sums + FastMath::SSEFloat::load(a + index) * FastMath::SSEFloat::load(b + index);
+		}
+
+		return sumOf(sums);
+#else
+		auto sum = 0.0f;
+		for (int index = 0; index < size; ++index)
+		{
+			sum += a[index] * b[index];
+		}
+
+		return sum;
+#endif
+	}
+
+	static int roundUpToTaps(int numSamples) noexcept
+	{
+		return (numSamples + tapSize - 1) / tapSize * tapSize;
+	}
+
+	template <typename Vector>
+	static float sumOf(Vector vector) noexcept
+	{
+		float lanes[Vector::size];
+		vector.store(lanes);
+		return std::accumulate(std::begin(lanes), std::end(lanes), 0.0f);
+	}
+
+	// destination += a * b, bin by bin.
+	static void multiplyAccumulate(const float* a, const float* b, float* destination, int numBins) noexcept
+	{
+		const auto* aReal = a;
+		const auto* aImaginary = a + numBins;
+		const auto* bReal = b;
+		const auto* bImaginary = b + numBins;
+		auto* real = destination;
+		auto* imaginary = destination + numBins;
+		int bin = 0;
+
+#if SUPERTONAL_FAST_MATH_SSE2
+		multiplyAccumulate<FastMath::SSEFloat>(aReal, aImaginary, bReal, bImaginary, real, imaginary, bin, numBins);
+#endif
+
+		for (; bin < numBins; ++bin)
+		{
+			real[bin] += aReal[bin] * bReal[bin] - aImaginary[bin] * bImaginary[bin];
+			imaginary[bin] += aReal[bin] * bImaginary[bin] + aImaginary[bin] * bReal[bin];
+		}
+	}
+
+	// As many whole vectors of bins as are left from bin, which is moved past them.
+	template <typename Vector>
+	static void multiplyAccumulate(const float* aReal, const float* aImaginary, const float* bReal, const float* bImaginary, float* real, float* imaginary, int& bin, int numBins) noexcept
+	{
+		for (; bin + static_cast<int>(Vector::size) <= numBins; bin += static_cast<int>(Vector::size))
+		{
+			const auto ar = Vector::load(aReal + bin);
+			const auto ai = Vector::load(aImaginary + bin);
+			const auto br = Vector::load(bReal + bin);
+			const auto bi = Vector::load(bImaginary + bin);
+
+			(Vector::load(real + bin) + ar * br - ai * bi).store(real + bin);
+			(Vector::load(imaginary + bin) + ar * bi + ai * br).store(imaginary + bin);
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartitionedConvolution)
+};
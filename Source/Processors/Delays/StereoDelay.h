@@ -0,0 +1,230 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/MemoryUsage.h"
+
+/*
+	A two channel feedback delay that works on runs of samples rather than one
+	sample at a time. Each line is a circular buffer just long enough for the
+	longest delay, and the delays are whole samples, so a run no longer than the shortest delay only reads what
+	was written before it: the echoes are read out in one or two copies, the
+	feedback is mixed with vector operations, and the result is written back in
+	one or two copies. With delays longer than the block, which is the usual
+	case, that is the whole block in one go.
+
+	The feedback of each line can be crossed into the other, and in ping-pong
+	mode the input is summed into the left line alone and the feedback fully
+	crossed, so the echoes alternate between the sides.
+
+	The output is the input with the echoes added, as the delay stage has always
+	mixed it, with the dry signal kept aside by the owner.
+ */
+class StereoDelay
+{
+public:
+	static constexpr int maximumNumChannels = 2;
+
+	StereoDelay() = default;
+
+	// maximumDelayInSamples is the longest delay that setDelay() will reach.
+	void prepare(const juce::dsp::ProcessSpec& spec, int maximumDelayInSamples)
+	{
+		mMaximumDelayInSamples = juce::jmax(1, maximumDelayInSamples);
+		// Only the last maximumDelayInSamples samples are read, and the newest of
+		// those is overwritten last, so the line needs one sample more.
+		mLineSize = mMaximumDelayInSamples + 1;
+
+		mLines.setSize(maximumNumChannels, mLineSize);
+		mDelayed.setSize(maximumNumChannels, static_cast<int>(spec.maximumBlockSize));
+		mLineInputs.setSize(maximumNumChannels, static_cast<int>(spec.maximumBlockSize));
+		mRunLength = juce::jmax(1, static_cast<int>(spec.maximumBlockSize));
+
+		reset();
+	}
+
+	void reset()
+	{
+		mLines.clear();
+		mWritePosition = 0;
+	}
+
+	// Frees the lines until the next prepare(). processBlock() passes the signal
+	// through untouched meanwhile.
+	void release()
+	{
+		mLines = juce::AudioBuffer<float>();
+		mDelayed = juce::AudioBuffer<float>();
+		mLineInputs = juce::AudioBuffer<float>();
+		mWritePosition = 0;
+	}
+
+	// Any thread. Rounded to whole samples and kept within the prepared maximum.
+	void setDelay(int channel, float delayInSamples)
+	{
+		jassert(juce::isPositiveAndBelow(channel, maximumNumChannels));
+		mDelaysInSamples[channel].store(delayInSamples);
+	}
+
+	// Any thread.
+	void setFeedback(float feedback)
+	{
+		mFeedback.store(feedback);
+	}
+
+	// Any thread. How much of each line's feedback goes into the other, from 0 to 1.
+	void setCrossFeed(float crossFeed)
+	{
+		mCrossFeed.store(juce::jlimit(0.0f, 1.0f, crossFeed));
+	}
+
+	// Any thread.
+	void setIsPingPong(bool isPingPong)
+	{
+		mIsPingPong.store(isPingPong);
+	}
+
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		const auto numChannels = juce::jmin(buffer.getNumChannels(), maximumNumChannels);
+		const auto numSamples = buffer.getNumSamples();
+
+		if (numChannels == 0 || mLines.getNumSamples() == 0)
+		{
+			return;
+		}
+
+		const auto isStereo = numChannels == maximumNumChannels;
+		const auto isPingPong = isStereo && mIsPingPong.load();
+		const auto crossFeed = isStereo ? (isPingPong ? 1.0f : mCrossFeed.load()) : 0.0f;
+		const auto feedback = mFeedback.load();
+		const auto straightFeedback = feedback * (1.0f - crossFeed);
+		const auto crossedFeedback = feedback * crossFeed;
+
+		std::array<int, maximumNumChannels> delays{};
+		auto shortestDelay = mMaximumDelayInSamples;
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			delays[channel] = juce::jlimit(1, mMaximumDelayInSamples, juce::roundToInt(mDelaysInSamples[channel].load()));
+			shortestDelay = juce::jmin(shortestDelay, delays[channel]);
+		}
+
+		auto* const* channels = buffer.getArrayOfWritePointers();
+		auto* const* delayed = mDelayed.getArrayOfWritePointers();
+		auto* const* lineInputs = mLineInputs.getArrayOfWritePointers();
+
+		for (int offset = 0; offset < numSamples;)
+		{
+			const auto runLength = juce::jmin(numSamples - offset, shortestDelay, mRunLength);
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				read(channel, delays[channel], delayed[channel], runLength);
+			}
+
+			if (isPingPong)
+			{
+				juce::FloatVectorOperations::copyWithMultiply(lineInputs[0], channels[0] + offset, 0.5f, runLength);
+				juce::FloatVectorOperations::addWithMultiply(lineInputs[0], channels[1] + offset, 0.5f, runLength);
+				juce::FloatVectorOperations::clear(lineInputs[1], runLength);
+			}
+			else
+			{
+				for (int channel = 0; channel < numChannels; ++channel)
+				{
+					juce::FloatVectorOperations::copy(lineInputs[channel], channels[channel] + offset, runLength);
+				}
+			}
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				juce::FloatVectorOperations::addWithMultiply(lineInputs[channel], delayed[channel], straightFeedback, runLength);
+
+				if (crossedFeedback != 0.0f)
+				{
+					juce::FloatVectorOperations::addWithMultiply(lineInputs[channel], delayed[1 - channel], crossedFeedback, runLength);
+				}
+
+				write(channel, lineInputs[channel], runLength);
+				juce::FloatVectorOperations::add(channels[channel] + offset, delayed[channel], runLength);
+			}
+
+			mWritePosition = wrap(mWritePosition + runLength);
+			offset += runLength;
+		}
+	}
+
+	int getMaximumDelayInSamples() const
+	{
+		return mMaximumDelayInSamples;
+	}
+
+	size_t getMemoryUsageInBytes() const
+	{
+		return MemoryUsage::getSizeInBytes(mLines)
+			+ MemoryUsage::getSizeInBytes(mDelayed)
+			+ MemoryUsage::getSizeInBytes(mLineInputs);
+	}
+
+private:
+	juce::AudioBuffer<float> mLines;
+	juce::AudioBuffer<float> mDelayed;
+	juce::AudioBuffer<float> mLineInputs;
+
+	int mLineSize = 1;
+	int mWritePosition = 0;
+	int mMaximumDelayInSamples = 1;
+	int mRunLength = 1;
+
+	std::array<std::atomic<float>, maximumNumChannels> mDelaysInSamples{};
+	std::atomic<float> mFeedback{ 0.0f };
+	std::atomic<float> mCrossFeed{ 0.0f };
+	std::atomic<bool> mIsPingPong{ false };
+
+	// The numSamples samples written delayInSamples before the write position,
+	// where numSamples is no more than delayInSamples.
+	void read(int channel, int delayInSamples, float* destination, int numSamples) const
+	{
+		const auto* line = mLines.getReadPointer(channel);
+		const auto readPosition = wrap(mWritePosition - delayInSamples + mLineSize);
+		const auto numBeforeWrap = juce::jmin(numSamples, mLineSize - readPosition);
+
+		juce::FloatVectorOperations::copy(destination, line + readPosition, numBeforeWrap);
+		juce::FloatVectorOperations::copy(destination + numBeforeWrap, line, numSamples - numBeforeWrap);
+	}
+
+	// A position less than twice the line size, brought back into the line.
+	int wrap(int position) const
+	{
+		return position >= mLineSize ? position - mLineSize : position;
+	}
+
+	void write(int channel, const float* source, int numSamples)
+	{
+		auto* line = mLines.getWritePointer(channel);
+		const auto numBeforeWrap = juce::jmin(numSamples, mLineSize - mWritePosition);
+
+		juce::FloatVectorOperations::copy(line + mWritePosition, source, numBeforeWrap);
+		juce::FloatVectorOperations::copy(line, source + numBeforeWrap, numSamples - numBeforeWrap);
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StereoDelay)
+};
@@ -20,103 +20,89 @@
 
 AmplifierEqualiser::AmplifierEqualiser()
 {
-	*mFilters[0].state = *juce::dsp::IIR::Coefficients<float>::makeLowShelf(
-		mCurrentSampleRate,
-		sFrequencies[0],
-		sQualities[0],
-		1.0f);
-	*mFilters[1].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[1],
-		sQualities[1],
-		1.0f);
-	*mFilters[2].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[2],
-		sQualities[2],
-		1.0f);
-	*mFilters[3].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[3],
-		sQualities[3],
-		1.0f);
-	*mFilters[4].state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
-		mCurrentSampleRate,
-		sFrequencies[4],
-		sQualities[4],
-		1.0f);
+	for (int index = 0; index < sFrequencies.size(); ++index)
+	{
+		updateFilterAtIndex(index);
+	}
 }
 
 void AmplifierEqualiser::prepare(juce::dsp::ProcessSpec& spec)
 {
 	mCurrentSampleRate = spec.sampleRate;
 
-	for (auto& filter : mFilters)
+	for (int index = 0; index < sFrequencies.size(); ++index)
 	{
-		filter.prepare(spec);
+		updateFilterAtIndex(index);
 	}
+
+	mFilters.prepare(spec);
 }
 
 void AmplifierEqualiser::processBlock(juce::AudioBuffer<float>& buffer)
 {
-	auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
-	auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
-
-	for (std::size_t filterIndex = 0; filterIndex < mFilters.size(); ++filterIndex)
-	{
-		mFilters[filterIndex].process(processContext);
-	}
+	mFilters.processBlock(buffer);
 }
 
 void AmplifierEqualiser::reset()
 {
-	for (auto& filter : mFilters)
-	{
-		filter.reset();
-	}
+	mFilters.reset();
 }
 
 void AmplifierEqualiser::setResonanceDecibels(float newValue)
 {
-	*mFilters[0].state = *juce::dsp::IIR::Coefficients<float>::makeLowShelf(
-		mCurrentSampleRate,
-		sFrequencies[0],
-		sQualities[0],
-		juce::Decibels::decibelsToGain(newValue));
+	setGainDecibelsAtIndex(newValue, 0);
 }
 
 void AmplifierEqualiser::setBassDecibels(float newValue)
 {
-	*mFilters[1].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[1],
-		sQualities[1],
-		juce::Decibels::decibelsToGain(newValue));
+	setGainDecibelsAtIndex(newValue, 1);
 }
 
 void AmplifierEqualiser::setMiddleDecibels(float newValue)
 {
-	*mFilters[2].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[2],
-		sQualities[2],
-		juce::Decibels::decibelsToGain(newValue));
+	setGainDecibelsAtIndex(newValue, 2);
 }
 
 void AmplifierEqualiser::setTrebleDecibels(float newValue)
 {
-	*mFilters[3].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-		mCurrentSampleRate,
-		sFrequencies[3],
-		sQualities[3],
-		juce::Decibels::decibelsToGain(newValue));
+	setGainDecibelsAtIndex(newValue, 3);
 }
 
 void AmplifierEqualiser::setPresenceDecibels(float newValue)
 {
-	*mFilters[4].state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
-		mCurrentSampleRate,
-		sFrequencies[4],
-		sQualities[4],
-		juce::Decibels::decibelsToGain(newValue));
+	setGainDecibelsAtIndex(newValue, 4);
+}
+
+void AmplifierEqualiser::setGainDecibelsAtIndex(float newValue, int index)
+{
+	mGains[index] = juce::Decibels::decibelsToGain(newValue);
+	updateFilterAtIndex(index);
+}
+
+void AmplifierEqualiser::updateFilterAtIndex(int index)
+{
+	switch (index)
+	{
+	case 0:
+		mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makeLowShelf(
+			mCurrentSampleRate,
+			sFrequencies[index],
+			sQualities[index],
+			mGains[index]));
+		break;
+	case 4:
+		mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makeHighShelf(
+			mCurrentSampleRate,
+			sFrequencies[index],
+			sQualities[index],
+			mGains[index]));
+		break;
+	default:
+		mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makePeakFilter(
+			mCurrentSampleRate,
+			sFrequencies[index],
+			sQualities[index],
+			mGains[index]));
+		break;
+	}
 }
\ No newline at end of file
@@ -18,6 +18,7 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "BiquadCascade.h"
 
 class AmplifierEqualiser
 {
@@ -45,7 +46,11 @@ private:
 
     float mCurrentSampleRate = 44100.0f;
 
-    std::array<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>, 5> mFilters;
+    BiquadCascade<5> mFilters;
+    std::array<float, 5> mGains = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+    void setGainDecibelsAtIndex(float newValue, int index);
+    void updateFilterAtIndex(int index);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AmplifierEqualiser)
 };
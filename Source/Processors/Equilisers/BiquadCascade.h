@@ -0,0 +1,420 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+#include "../../Utilities/TripleBuffer.h"
+
+/*
+	Stands in for a row of juce::dsp::ProcessorDuplicator<IIR::Filter>, which
+	takes the whole buffer through one biquad at a time, one channel at a time.
+	Here every section is applied to a sample before moving to the next, in
+	transposed direct form II, with up to four channels side by side in the
+	lanes of one register. The channels are interleaved a chunk at a time to
+	make that possible.
+
+	Sections that are off, or whose coefficients pass the signal through, as a
+	peak or shelf at 0 dB does, are left out. A section's state is zero while it
+	passes the signal through, so it is zeroed when it comes back in.
+
+	The coefficients are set from any thread and computed in place, then handed
+	to the audio thread through a TripleBuffer, which picks up the latest set
+	once per block. Nothing allocates and a block never sees half of an update.
+	With interpolation on, the audio thread moves each coefficient linearly from
+	the old set to the new across the block, and switching a section on or off
+	ramps it from or to passing the signal through.
+ */
+template <int numSections>
+class BiquadCascade
+{
+public:
+	BiquadCascade()
+	{
+		publish();
+	}
+
+	void prepare(const juce::dsp::ProcessSpec& spec)
+	{
+		mChannelGroupStates.assign((spec.numChannels + numLanes - 1) / numLanes, {});
+		jumpToTargets();
+	}
+
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
+	}
+
+	void process(float* const* channels, int numChannels, int numSamples) noexcept
+	{
+		jassert((numChannels + numLanes - 1) / numLanes <= static_cast<int>(mChannelGroupStates.size()));
+
+		if (numSamples <= 0)
+		{
+			return;
+		}
+
+		const auto& targets = mTargets.read();
+		const auto isInterpolating = mIsInterpolating.load(std::memory_order_relaxed);
+
+		std::array<int, numSections> activeSections;
+		std::array<VectorCoefficients, numSections> startCoefficients;
+		std::array<VectorCoefficients, numSections> coefficientSteps;
+		int numActiveSections = 0;
+		bool isRamping = false;
+
+		for (int section = 0; section < numSections; ++section)
+		{
+			const auto& target = targets[section];
+			const auto wasActive = mWasActive[section];
+			const auto isRampingOut = isInterpolating && wasActive && !target.isActive;
+
+			if (!target.isActive && !isRampingOut)
+			{
+				mWasActive[section] = false;
+				continue;
+			}
+
+			if (!wasActive)
+			{
+				for (auto& states : mChannelGroupStates)
+				{
+					states[section] = {};
+				}
+			}
+
+			const auto start = !isInterpolating ? target.coefficients : wasActive ? mCurrentCoefficients[section] : Coefficients{};
+			const auto end = target.isActive ? target.coefficients : Coefficients{};
+			const auto step = 1.0f / static_cast<float>(numSamples);
+
+			startCoefficients[numActiveSections] = toVector(start);
+			coefficientSteps[numActiveSections] = toVector({
+				(end.b0 - start.b0) * step,
+				(end.b1 - start.b1) * step,
+				(end.b2 - start.b2) * step,
+				(end.a1 - start.a1) * step,
+				(end.a2 - start.a2) * step });
+
+			isRamping = isRamping || !(start == end);
+			activeSections[numActiveSections++] = section;
+			mCurrentCoefficients[section] = end;
+			mWasActive[section] = target.isActive;
+		}
+
+		if (numActiveSections == 0)
+		{
+			return;
+		}
+
+		if (isRamping)
+		{
+			processChannelGroups<true>(channels, numChannels, numSamples, activeSections, numActiveSections, startCoefficients, coefficientSteps);
+		}
+		else
+		{
+			processChannelGroups<false>(channels, numChannels, numSamples, activeSections, numActiveSections, startCoefficients, coefficientSteps);
+		}
+	}
+
+	void reset()
+	{
+		for (auto& states : mChannelGroupStates)
+		{
+			states.fill({});
+		}
+
+		jumpToTargets();
+	}
+
+	// Takes the {b0, b1, b2, a0, a1, a2} of juce::dsp::IIR::ArrayCoefficients.
+	void setCoefficients(int section, const std::array<float, 6>& newCoefficients)
+	{
+		const juce::SpinLock::ScopedLockType lock(mWriterLock);
+
+		const auto a0 = newCoefficients[3];
+		auto& coefficients = mWriterSections[section].coefficients;
+		coefficients.b0 = newCoefficients[0] / a0;
+		coefficients.b1 = newCoefficients[1] / a0;
+		coefficients.b2 = newCoefficients[2] / a0;
+		coefficients.a1 = newCoefficients[4] / a0;
+		coefficients.a2 = newCoefficients[5] / a0;
+
+		mWriterSections[section].isFlat = std::abs(coefficients.b0 - 1.0f) < flatTolerance
+			&& std::abs(coefficients.b1 - coefficients.a1) < flatTolerance
+			&& std::abs(coefficients.b2 - coefficients.a2) < flatTolerance;
+
+		publish();
+	}
+
+	void setSectionIsOn(int section, bool newValue)
+	{
+		const juce::SpinLock::ScopedLockType lock(mWriterLock);
+		mWriterSections[section].isOn = newValue;
+		publish();
+	}
+
+	void setIsInterpolating(bool newValue)
+	{
+		mIsInterpolating.store(newValue, std::memory_order_relaxed);
+	}
+
+	// Any thread. The response of the sections to an impulse, from the
+	// coefficients last set rather than those the audio thread has reached.
+	void renderImpulseResponse(float* destination, int numSamples) const
+	{
+		std::array<WriterSection, numSections> sections;
+		{
+			const juce::SpinLock::ScopedLockType lock(mWriterLock);
+			sections = mWriterSections;
+		}
+
+		std::vector<double> samples(static_cast<size_t>(numSamples), 0.0);
+		if (numSamples > 0)
+		{
+			samples[0] = 1.0;
+		}
+
+		for (const auto& section : sections)
+		{
+			if (!section.isOn || section.isFlat)
+			{
+				continue;
+			}
+
+			const auto& c = section.coefficients;
+			double s1 = 0.0;
+			double s2 = 0.0;
+
+			for (auto& x : samples)
+			{
+				const auto y = c.b0 * x + s1;
+				s1 = c.b1 * x - c.a1 * y + s2;
+				s2 = c.b2 * x - c.a2 * y;
+				x = y;
+			}
+		}
+
+		std::transform(samples.begin(), samples.end(), destination, [](double sample) { return static_cast<float>(sample); });
+	}
+
+private:
+#if SUPERTONAL_FAST_MATH_SSE2
+	using Vector = FastMath::SSEFloat;
+	static constexpr int numLanes = 4;
+#else
+	using Vector = float;
+	static constexpr int numLanes = 1;
+#endif
+
+	static constexpr int chunkSize = 64;
+	// Below this a coefficient is taken to equal the one it is compared to.
+	static constexpr float flatTolerance = 1.0e-6f;
+
+	// Passes the signal through when default constructed.
+	struct Coefficients
+	{
+		float b0 = 1.0f;
+		float b1 = 0.0f;
+		float b2 = 0.0f;
+		float a1 = 0.0f;
+		float a2 = 0.0f;
+
+		bool operator==(const Coefficients& other) const
+		{
+			return b0 == other.b0 && b1 == other.b1 && b2 == other.b2 && a1 == other.a1 && a2 == other.a2;
+		}
+	};
+
+	struct VectorCoefficients
+	{
+		Vector b0, b1, b2, a1, a2;
+	};
+
+	// What the writers last set.
+	struct WriterSection
+	{
+		Coefficients coefficients;
+		bool isOn = true;
+		bool isFlat = true;
+	};
+
+	// What the audio thread reads.
+	struct Target
+	{
+		Coefficients coefficients;
+		bool isActive = false;
+	};
+
+	// Each lane is a channel.
+	struct alignas(16) State
+	{
+		std::array<float, numLanes> s1{};
+		std::array<float, numLanes> s2{};
+	};
+
+	// Parameters can change on the message thread and, when automated, on the
+	// audio thread, so the writers take turns. The audio thread never takes it.
+	mutable juce::SpinLock mWriterLock;
+	std::array<WriterSection, numSections> mWriterSections;
+	TripleBuffer<std::array<Target, numSections>> mTargets;
+	std::atomic<bool> mIsInterpolating{ true };
+
+	std::array<Coefficients, numSections> mCurrentCoefficients;
+	std::array<bool, numSections> mWasActive{};
+	std::vector<std::array<State, numSections>> mChannelGroupStates;
+	alignas(16) std::array<float, chunkSize * numLanes> mFrames{};
+
+	// Writer thread, under the lock.
+	void publish()
+	{
+		auto& targets = mTargets.getWriteBuffer();
+
+		for (int section = 0; section < numSections; ++section)
+		{
+			targets[section].coefficients = mWriterSections[section].coefficients;
+			targets[section].isActive = mWriterSections[section].isOn && !mWriterSections[section].isFlat;
+		}
+
+		mTargets.publish();
+	}
+
+	// Starts from the latest coefficients without ramping to them.
+	void jumpToTargets()
+	{
+		const auto& targets = mTargets.read();
+
+		for (int section = 0; section < numSections; ++section)
+		{
+			mCurrentCoefficients[section] = targets[section].coefficients;
+			mWasActive[section] = targets[section].isActive;
+		}
+	}
+
+	static VectorCoefficients toVector(const Coefficients& coefficients)
+	{
+		return { coefficients.b0, coefficients.b1, coefficients.b2, coefficients.a1, coefficients.a2 };
+	}
+
+	template <bool isRamping>
+	void processChannelGroups(
+		float* const* channels,
+		int numChannels,
+		int numSamples,
+		const std::array<int, numSections>& activeSections,
+		int numActiveSections,
+		const std::array<VectorCoefficients, numSections>& startCoefficients,
+		const std::array<VectorCoefficients, numSections>& coefficientSteps) noexcept
+	{
+		const auto numChannelGroups = juce::jmin(static_cast<int>(mChannelGroupStates.size()), (numChannels + numLanes - 1) / numLanes);
+
+		for (int group = 0; group < numChannelGroups; ++group)
+		{
+			auto* const* groupChannels = channels + group * numLanes;
+			const auto numGroupChannels = juce::jmin(numLanes, numChannels - group * numLanes);
+			auto& states = mChannelGroupStates[group];
+			auto coefficients = startCoefficients;
+
+			// The states are kept in registers, or at least out of the way of the
+			// frames, for the whole block.
+			std::array<Vector, numSections> s1;
+			std::array<Vector, numSections> s2;
+			for (int index = 0; index < numActiveSections; ++index)
+			{
+				s1[index] = FastMath::load<Vector>(states[activeSections[index]].s1.data());
+				s2[index] = FastMath::load<Vector>(states[activeSections[index]].s2.data());
+			}
+
+			for (int offset = 0; offset < numSamples; offset += chunkSize)
+			{
+				const auto numChunkSamples = juce::jmin(chunkSize, numSamples - offset);
+
+				interleave(groupChannels, numGroupChannels, offset, numChunkSamples);
+
+				for (int frame = 0; frame < numChunkSamples; ++frame)
+				{
+					auto* samples = mFrames.data() + frame * numLanes;
+					auto x = FastMath::load<Vector>(samples);
+
+					for (int index = 0; index < numActiveSections; ++index)
+					{
+						auto& c = coefficients[index];
+
+						if constexpr (isRamping)
+						{
+							const auto& step = coefficientSteps[index];
+							c.b0 = c.b0 + step.b0;
+							c.b1 = c.b1 + step.b1;
+							c.b2 = c.b2 + step.b2;
+							c.a1 = c.a1 + step.a1;
+							c.a2 = c.a2 + step.a2;
+						}
+
+						const auto y = c.b0 * x + s1[index];
+						s1[index] = c.b1 * x - c.a1 * y + s2[index];
+						s2[index] = c.b2 * x - c.a2 * y;
+						x = y;
+					}
+
+					FastMath::store(x, samples);
+				}
+
+				deinterleave(groupChannels, numGroupChannels, offset, numChunkSamples);
+			}
+
+			for (int index = 0; index < numActiveSections; ++index)
+			{
+				FastMath::store(s1[index], states[activeSections[index]].s1.data());
+				FastMath::store(s2[index], states[activeSections[index]].s2.data());
+			}
+		}
+	}
+
+	void interleave(float* const* channels, int numChannels, int offset, int numSamples) noexcept
+	{
+		if (numChannels < numLanes)
+		{
+			std::fill(mFrames.begin(), mFrames.end(), 0.0f);
+		}
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* source = channels[channel] + offset;
+
+			for (int sample = 0; sample < numSamples; ++sample)
+			{
+				mFrames[sample * numLanes + channel] = source[sample];
+			}
+		}
+	}
+
+	void deinterleave(float* const* channels, int numChannels, int offset, int numSamples) const noexcept
+	{
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			auto* destination = channels[channel] + offset;
+
+			for (int sample = 0; sample < numSamples; ++sample)
+			{
+				destination[sample] = mFrames[sample * numLanes + channel];
+			}
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BiquadCascade)
+};
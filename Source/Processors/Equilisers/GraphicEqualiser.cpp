@@ -22,22 +22,7 @@ GraphicEqualiser::GraphicEqualiser()
 {   
     for (auto filterIndex = 0; filterIndex < sFrequencies.size(); ++filterIndex)
     {
-        if (filterIndex < 6)
-        {
-            *mFilters[filterIndex].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-                mCurrentSampleRate,
-                sFrequencies[filterIndex],
-                sQualities[filterIndex],
-                1.0f);
-        }
-        else
-        {
-            *mFilters[filterIndex].state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
-                mCurrentSampleRate,
-                sFrequencies[filterIndex],
-                sQualities[filterIndex],
-                1.0f);
-        }
+        updateFilterAtIndex(filterIndex);
     } 
     
     mLevelGain.setGainDecibels(0.0f);
@@ -47,58 +32,59 @@ void GraphicEqualiser::prepare(juce::dsp::ProcessSpec& spec)
 {
     mCurrentSampleRate = spec.sampleRate; 
 
-    for (auto& filter : mFilters)
+    for (auto filterIndex = 0; filterIndex < sFrequencies.size(); ++filterIndex)
     {
-        filter.prepare(spec);
+        updateFilterAtIndex(filterIndex);
     }
 
+    mFilters.prepare(spec);
     mLevelGain.prepare(spec);
 }
 
 void GraphicEqualiser::processBlock(juce::AudioBuffer<float>& buffer)
 {
+    mFilters.processBlock(buffer);
+
     auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
     auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
-
-    for (std::size_t filterIndex = 0; filterIndex < mFilters.size(); ++filterIndex)
-    {
-        mFilters[filterIndex].process(processContext);
-    }
-
     mLevelGain.process(processContext);
 }
 
 void GraphicEqualiser::reset()
 {
-    for (auto& filter : mFilters)
-    {
-        filter.reset();
-    }
-
+    mFilters.reset();
     mLevelGain.reset();
 }
 
 void GraphicEqualiser::setGainDecibelsAtIndex(float newGainDecibels, int index)
 {
+    if (index < 7)
+    {
+        mGains[index] = juce::Decibels::decibelsToGain(newGainDecibels);
+        updateFilterAtIndex(index);
+    }
+    else
+    {
+        mLevelGain.setGainDecibels(newGainDecibels);
+    }
+}
 
+void GraphicEqualiser::updateFilterAtIndex(int index)
+{
     if (index < 6)
     {
-        *mFilters[index].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
+        mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makePeakFilter(
             mCurrentSampleRate,
             sFrequencies[index],
             sQualities[index],
-            juce::Decibels::decibelsToGain(newGainDecibels));
+            mGains[index]));
     }
-    else if (index == 6)
+    else
     {
-        *mFilters[index].state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
+        mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makeHighShelf(
             mCurrentSampleRate,
             sFrequencies[index],
             sQualities[index],
-            juce::Decibels::decibelsToGain(newGainDecibels));
+            mGains[index]));
     }
-    else
-    {
-        mLevelGain.setGainDecibels(newGainDecibels);
-    }
-}
\ No newline at end of file
+}
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "BiquadCascade.h"
 
 class GraphicEqualiser
 {
@@ -40,11 +41,14 @@ public:
     void setGainDecibelsAtIndex(float newGainDecibels, int index);
 
 private:
-    std::array<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>, 7> mFilters;
+    BiquadCascade<7> mFilters;
+    std::array<float, 7> mGains = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
 
     juce::dsp::Gain<float> mLevelGain;
 
     float mCurrentSampleRate = 44100.0f;
 
+    void updateFilterAtIndex(int index);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GraphicEqualiser)
 };
@@ -20,122 +20,95 @@
 
 InstrumentEqualiser::InstrumentEqualiser()
 {
-    // Initialize the filters with default values
-    *mFilters[0].state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(mCurrentSampleRate, sHighPassFrequencyNormalisableRange.start);
-    for (int i = 1; i <= 4; ++i)
+    // Every band starts off, as a bypass is a "not on"
+    for (int index = 0; index < mFrequencies.size(); ++index)
     {
-        *mFilters[i].state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(mCurrentSampleRate, getDefaultValueForIndex(i), sQualityNormalisableRange.start, 1.0f);
+        mFilters.setSectionIsOn(index, false);
+        updateFilterAtIndex(index);
     }
-    *mFilters[5].state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(mCurrentSampleRate, sLowPassFrequencyNormalisableRange.start);
 }
 
 void InstrumentEqualiser::prepare(juce::dsp::ProcessSpec& spec)
 {
     mCurrentSampleRate = spec.sampleRate;
-    for (auto& filter : mFilters)
+
+    for (int index = 0; index < mFrequencies.size(); ++index)
     {
-        filter.prepare(spec);
+        updateFilterAtIndex(index);
     }
+
+    mFilters.prepare(spec);
 }
 
 void InstrumentEqualiser::processBlock(juce::AudioBuffer<float>& buffer)
 {
-    auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
-    auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
-
-    for (std::size_t filterIndex = 0; filterIndex < mFilters.size(); ++filterIndex)
-    {
-        if (!mBypasses[filterIndex])
-        {
-            mFilters[filterIndex].process(processContext);
-        }
-    }
+    mFilters.processBlock(buffer);
 }
 
 void InstrumentEqualiser::reset()
 {
-    for (auto& filter : mFilters)
-    {
-        filter.reset();
-    }
+    mFilters.reset();
 }
 
 void InstrumentEqualiser::setOnAtIndex(bool newValue, int index)
 {
-    if (index >= 0 && index < mBypasses.size())
+    if (index >= 0 && index < mFrequencies.size())
     {
-        mBypasses[index] = !newValue; // a bypass is a "not on"
+        mFilters.setSectionIsOn(index, newValue);
     }
 }
 
 void InstrumentEqualiser::setFrequencyAtIndex(float newValue, int index)
 {
-    if (index >= 0 && index < mFilters.size() && newValue != 0.0)
+    if (index >= 0 && index < mFrequencies.size() && newValue != 0.0)
     {
         mFrequencies[index] = newValue;
-        auto& filter = mFilters[index];
-        const auto quality = mQualities[index];
-        const auto gain = mDecibelGains[index];
-
-        if (index == 0)
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(mCurrentSampleRate, newValue, quality);
-        }
-        else if (index == 5)
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(mCurrentSampleRate, newValue, quality);
-        }
-        else 
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-                mCurrentSampleRate, 
-                newValue, quality, juce::Decibels::decibelsToGain(gain));
-        }
+        updateFilterAtIndex(index);
     }
 }
 
 void InstrumentEqualiser::setGainAtIndex(float newValue, int index)
 {
-    if (index >= 0 && index < mFilters.size())
+    // For high-pass and low-pass filters, gain doesn't affect the shape of the filter, so it is only kept.
+    if (index >= 0 && index < mFrequencies.size())
     {
         mDecibelGains[index] = newValue;
-        auto& filter = mFilters[index];
-        const auto frequency = mFrequencies[index];
-        const auto quality = mQualities[index];
-
-        if (index == 0 || index == 5)
-        {
-            // For high-pass and low-pass filters, gain doesn't affect the shape of the filter, so we don't do anything here.
-            // If you want to apply gain, consider adding a separate gain stage after the filter.
-        }
-        else
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(mCurrentSampleRate, frequency, quality, juce::Decibels::decibelsToGain(newValue));
-        }
+        updateFilterAtIndex(index);
     }
 }
 
 void InstrumentEqualiser::setQualityAtIndex(float newValue, int index)
 {
-    if (index >= 0 && index < mFilters.size() && newValue != 0.0)
+    if (index >= 0 && index < mFrequencies.size() && newValue != 0.0)
     {
         mQualities[index] = newValue;
-        auto& filter = mFilters[index];
-        const auto frequency = mFrequencies[index];
-        const auto gain = mDecibelGains[index];
-
-        if (index == 0)
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(mCurrentSampleRate, frequency, newValue);
-        }
-        else if (index == 5)
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(mCurrentSampleRate, frequency, newValue);
-        }
-        else
-        {
-            *filter.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(mCurrentSampleRate, frequency, newValue, juce::Decibels::decibelsToGain(gain));
-        }
+        updateFilterAtIndex(index);
+    }
+}
+
+void InstrumentEqualiser::renderImpulseResponse(float* destination, int numSamples) const
+{
+    mFilters.renderImpulseResponse(destination, numSamples);
+}
+
+void InstrumentEqualiser::updateFilterAtIndex(int index)
+{
+    const auto frequency = mFrequencies[index];
+    const auto quality = mQualities[index];
+
+    if (index == 0)
+    {
+        mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(mCurrentSampleRate, frequency, quality));
+    }
+    else if (index == 5)
+    {
+        mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(mCurrentSampleRate, frequency, quality));
+    }
+    else
+    {
+        mFilters.setCoefficients(index, juce::dsp::IIR::ArrayCoefficients<float>::makePeakFilter(
+            mCurrentSampleRate,
+            frequency, quality, juce::Decibels::decibelsToGain(mDecibelGains[index])));
     }
 }
 
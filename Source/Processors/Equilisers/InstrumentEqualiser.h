@@ -18,6 +18,7 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "BiquadCascade.h"
 
 class InstrumentEqualiser
 {
@@ -66,10 +67,12 @@ public:
 	void setGainAtIndex(float newValue, int index);
 	void setQualityAtIndex(float newValue, int index);
 
+	// Any thread. The response of the bands that are on to an impulse.
+	void renderImpulseResponse(float* destination, int numSamples) const;
+
 private:
 	float mCurrentSampleRate = 44100.0f;
 
-	std::array<bool, 6> mBypasses = { true, true, true, true, true, true };
 	std::array<float, 6> mFrequencies = {
 		sHighPassFrequencyDefaultValue,
 		sLowPeakFrequencyDefaultValue,
@@ -94,8 +97,9 @@ private:
 		0.001L,
 		0.001L
 	};
-	std::array<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>, 6> mFilters;
+	BiquadCascade<6> mFilters;
 
+	void updateFilterAtIndex(int index);
 	float getDefaultValueForIndex(int index);
 	const juce::NormalisableRange<float>& getFrequencyNormalisableRangeForIndex(int index);
 
@@ -28,12 +28,34 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <JuceHeader.h>
+#include "../../Utilities/MemoryUsage.h"
+#include "../../Utilities/ParameterRamp.h"
 
 using namespace juce;
 
+/*
+	A chorus of up to maximumNumVoices delayed copies of the input, each swept
+	by its own sine LFO, with the LFOs spread evenly in phase.
+
+	The voices run side by side in the lanes of SIMD registers, so a register's
+	worth of voices costs about what one does. Once per block, each voice's LFO
+	is stepped through the block by rotating a sine and cosine pair, and turned
+	into a whole sample offset and a fraction for every sample; every channel
+	then reads its taps through a power of two mask and interpolates them, with
+	the interpolation picked once per block as a template argument.
+
+	The voices are scaled by one over the square root of their number, so
+	adding voices thickens the sound rather than making it louder.
+
+	The parameters are stepped a run at a time, with every channel reading the
+	same steps. The LFO rate is taken once per run, from its start.
+ */
 class Chorus
 {
 public:
+	using SIMDFloat = juce::dsp::SIMDRegister<float>;
+
+	static constexpr int maximumNumVoices = 8;
 
 	static constexpr float delayMinimumValue = 10.0f * 0.001f;
 	static constexpr float delayMaximumValue = 50.0f * 0.001f;
@@ -73,205 +95,170 @@ public:
 		frequencyMaximumValue,
 		frequencyIntervalValue);
 
+	static constexpr float voicesMinimumValue = 1.0f;
+	static constexpr float voicesMaximumValue = static_cast<float>(maximumNumVoices);
+	static constexpr float voicesDefaultValue = 1.0f;
+	static constexpr float voicesIntervalValue = 1.0f;
+	static inline const juce::NormalisableRange<float> voicesNormalisableRange = juce::NormalisableRange<float>(
+		voicesMinimumValue,
+		voicesMaximumValue,
+		voicesIntervalValue);
+
 	Chorus() = default;
 
 	void prepare(juce::dsp::ProcessSpec& spec)
 	{
-		setDelay(delayDefaultValue);
-		setWidth(widthDefaultValue);
-		setDepth(depthDefaultValue);
-		setFrequency(frequencyDefaultValue);
-
 		mCurrentSampleRate = spec.sampleRate;
 
-		float maxDelayTime = (delayMaximumValue + widthMaximumValue) * 1000;
-		delayBufferSamples = (int)(maxDelayTime * mCurrentSampleRate) + 1;
-		if (delayBufferSamples < 1)
-			delayBufferSamples = 1;
+		mDelayRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+		mWidthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+		mDepthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+		mLFOFrequencyRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+
+		// The delay and width are in seconds. The buffer holds the longest delay the
+		// LFO reaches and the samples the interpolation reads around it, rounded up
+		// to a power of two so reads wrap with a mask.
+		const auto maximumDelayInSamples = (int)std::ceil((delayMaximumValue + widthMaximumValue) * mCurrentSampleRate);
+		const auto delayBufferSamples = juce::nextPowerOfTwo(maximumDelayInSamples + interpolationMarginSamples);
+		mDelayBufferMask = delayBufferSamples - 1;
 
-		delayBufferChannels = spec.numChannels;
-		delayBuffer.setSize(delayBufferChannels, delayBufferSamples);
+		delayBuffer.setSize(spec.numChannels, delayBufferSamples);
 		delayBuffer.clear();
 
+		mReadOffsets.assign((size_t)maximumRunLength * maximumNumVoices, 0);
+		mFractions.assign((size_t)maximumRunLength * numVoiceGroups, SIMDFloat::expand(0.0f));
+
 		delayWritePosition = 0;
 		mLfoPhase = 0.0f;
 		mInverseSampleRate = 1.0f / mCurrentSampleRate;
-		twoPi = 2.0f * M_PI;
 	};
 
 	void reset()
 	{
+		delayBuffer.clear();
+		delayWritePosition = 0;
+		mLfoPhase = 0.0f;
+
+		mDelayRamp.reset();
+		mWidthRamp.reset();
+		mDepthRamp.reset();
+		mLFOFrequencyRamp.reset();
 	};
 
+	size_t getMemoryUsageInBytes() const
+	{
+		return MemoryUsage::getSizeInBytes(delayBuffer)
+			+ MemoryUsage::getSizeInBytes(mReadOffsets)
+			+ MemoryUsage::getSizeInBytes(mFractions);
+	}
+
+	// Frees the delay buffer until the next prepare().
+	void release()
+	{
+		delayBuffer = juce::AudioBuffer<float>();
+		mReadOffsets = std::vector<int>();
+		mFractions = std::vector<SIMDFloat>();
+		delayWritePosition = 0;
+	}
+
 	void process(juce::AudioBuffer<float>& buffer)
 	{
-		if (mIsBypassed)
+		if (mIsBypassed.load() || delayBuffer.getNumSamples() == 0)
 		{
 			return;
 		}
 
 		ScopedNoDenormals noDenormals;
 
-		const int numInputChannels = buffer.getNumChannels();
-		const int numOutputChannels = buffer.getNumChannels();
+		const int numChannels = juce::jmin(buffer.getNumChannels(), delayBuffer.getNumChannels());
 		const int numSamples = buffer.getNumSamples();
 
-		float currentDelay = mDelaySmoothedValue.getNextValue();
-		float currentWidth = mWidthSmoothedValue.getNextValue();
-		float currentDepth = mDepthSmoothedValue.getNextValue();
-		int numVoices = mNumVoices;
-		float currentFrequency = mLFOFrequencySmoothedValue.getNextValue();
-		bool stereo = mIsStereo;
-
-		int localWritePosition;
-		float phase;
+		const int numVoices = mNumVoices.load();
+		const int numActiveGroups = (numVoices + numLanes - 1) / numLanes;
 
-		for (int channel = 0; channel < numInputChannels; ++channel) {
-			float* channelData = buffer.getWritePointer(channel);
-			float* delayData = delayBuffer.getWritePointer(channel);
-			localWritePosition = delayWritePosition;
-			phase = mLfoPhase;
-
-			for (int sample = 0; sample < numSamples; ++sample) {
-				const float in = channelData[sample];
-				float out = 0.0f;
-				float phaseOffset = 0.0f;
-				float weight;
-
-				for (int voice = 0; voice < numVoices - 1; ++voice) {
-					if (stereo && numVoices > 2) {
-						weight = (float)voice / (float)(numVoices - 2);
-						if (channel != 0)
-							weight = 1.0f - weight;
-					}
-					else {
-						weight = 1.0f;
-					}
+		alignas(SIMDFloat) float lanes[numLanes];
+		std::array<SIMDFloat, numVoiceGroups> gains;
+		const float voiceGain = 1.0f / std::sqrt((float)numVoices);
 
-					float localDelayTime =
-						(currentDelay + currentWidth * lfo(phase + phaseOffset, mWaveform)) * mCurrentSampleRate;
-
-					float readPosition =
-						fmodf((float)localWritePosition - localDelayTime + (float)delayBufferSamples, delayBufferSamples);
-					int localReadPosition = floorf(readPosition);
-
-					switch (mInterpolation) {
-					case interpolationNearestNeighbour: {
-						float closestSample = delayData[localReadPosition % delayBufferSamples];
-						out = closestSample;
-						break;
-					}
-					case interpolationLinear: {
-						float fraction = readPosition - (float)localReadPosition;
-						float delayed0 = delayData[(localReadPosition + 0)];
-						float delayed1 = delayData[(localReadPosition + 1) % delayBufferSamples];
-						out = delayed0 + fraction * (delayed1 - delayed0);
-						break;
-					}
-					case interpolationCubic: {
-						float fraction = readPosition - (float)localReadPosition;
-						float fractionSqrt = fraction * fraction;
-						float fractionCube = fractionSqrt * fraction;
-
-						float sample0 = delayData[(localReadPosition - 1 + delayBufferSamples) % delayBufferSamples];
-						float sample1 = delayData[(localReadPosition + 0)];
-						float sample2 = delayData[(localReadPosition + 1) % delayBufferSamples];
-						float sample3 = delayData[(localReadPosition + 2) % delayBufferSamples];
-
-						float a0 = -0.5f * sample0 + 1.5f * sample1 - 1.5f * sample2 + 0.5f * sample3;
-						float a1 = sample0 - 2.5f * sample1 + 2.0f * sample2 - 0.5f * sample3;
-						float a2 = -0.5f * sample0 + 0.5f * sample2;
-						float a3 = sample1;
-						out = a0 * fractionCube + a1 * fractionSqrt + a2 * fraction + a3;
-						break;
-					}
-					}
-
-					if (stereo && numVoices == 2)
-						channelData[sample] = (channel == 0) ? in : out * currentDepth;
-					else
-						channelData[sample] += out * currentDepth * weight;
-
-					if (numVoices == 3)
-						phaseOffset += 0.25f;
-					else if (numVoices > 3)
-						phaseOffset += 1.0f / (float)(numVoices - 1);
-				}
-
-				delayData[localWritePosition] = in;
-
-				if (++localWritePosition >= delayBufferSamples)
-					localWritePosition -= delayBufferSamples;
-
-				phase += currentFrequency * mInverseSampleRate;
-				if (phase >= 1.0f)
-					phase -= 1.0f;
+		for (int group = 0; group < numVoiceGroups; ++group)
+		{
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				lanes[lane] = group * numLanes + lane < numVoices ? voiceGain : 0.0f;
 			}
-		}
 
-		delayWritePosition = localWritePosition;
-		mLfoPhase = phase;
+			gains[group] = SIMDFloat::fromRawArray(lanes);
+		}
 
-		//======================================
+		for (int offset = 0; offset < numSamples; offset += maximumRunLength)
+		{
+			const int runLength = juce::jmin(numSamples - offset, maximumRunLength);
+
+			mDelayRamp.advance(runLength);
+			mWidthRamp.advance(runLength);
+			mDepthRamp.advance(runLength);
+			mLFOFrequencyRamp.advance(runLength);
+
+			computeReadPositions(runLength, numVoices, numActiveGroups);
+
+			switch (mInterpolation) {
+			case interpolationNearestNeighbour:
+				processRun<interpolationNearestNeighbour>(buffer, offset, runLength, numChannels, numActiveGroups, gains);
+				break;
+			case interpolationLinear:
+				processRun<interpolationLinear>(buffer, offset, runLength, numChannels, numActiveGroups, gains);
+				break;
+			case interpolationCubic:
+				processRun<interpolationCubic>(buffer, offset, runLength, numChannels, numActiveGroups, gains);
+				break;
+			}
 
-		for (int channel = numInputChannels; channel < numOutputChannels; ++channel)
-			buffer.clear(channel, 0, numSamples);
+			delayWritePosition = (delayWritePosition + runLength) & mDelayBufferMask;
+		}
 	};
 
 	void setDelay(float newValue)
 	{
-		mDelaySmoothedValue.setTargetValue(newValue);
+		mDelayRamp.setTargetValue(newValue);
 	}
 
 	void setWidth(float newValue)
 	{
-		mWidthSmoothedValue.setTargetValue(newValue);
+		mWidthRamp.setTargetValue(newValue);
 	}
 
 	void setDepth(float newValue)
 	{
-		mDepthSmoothedValue.setTargetValue(newValue);
+		mDepthRamp.setTargetValue(newValue);
 	}
 
 	void setFrequency(float newValue)
 	{
-		mLFOFrequencySmoothedValue.setTargetValue(newValue);
+		mLFOFrequencyRamp.setTargetValue(newValue);
 	}
 
+	// Any thread. From 1 to maximumNumVoices.
+	void setNumVoices(int newValue)
+	{
+		mNumVoices.store(juce::jlimit(1, maximumNumVoices, newValue));
+	}
+
+	// Any thread.
 	void setBypassed(bool newValue)
 	{
-		mIsBypassed = newValue;
+		mIsBypassed.store(newValue);
 	}
 
 private:
+	static constexpr int numLanes = (int)SIMDFloat::SIMDNumElements;
+	static constexpr int numVoiceGroups = maximumNumVoices / numLanes;
+	static_assert(maximumNumVoices % numLanes == 0, "The voices must fill whole registers");
 
-	AudioSampleBuffer delayBuffer;
-	int delayBufferSamples;
-	int delayBufferChannels;
-	int delayWritePosition;
-
-	float mCurrentSampleRate = 441000;
-	float mLfoPhase;
-	float mInverseSampleRate;
-	float twoPi;
-
-	bool mIsStereo = false;
-	bool mIsBypassed = false;
-	int mNumVoices = 2;//(parameters, "Number of voices", {"2", "3", "4", "5"}, 0, [](float value){ return value + 2; })
-	int mWaveform = 0; //(parameters, "LFO Waveform", waveformItemsUI, waveformSine)
-	int mInterpolation = 0; //(parameters, "Interpolation", interpolationItemsUI, interpolationLinear)
-
-	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mDelaySmoothedValue;
-	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mWidthSmoothedValue;
-	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mDepthSmoothedValue;
-	juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mLFOFrequencySmoothedValue;
-
-	enum waveformIndex {
-		waveformSine = 0,
-		waveformTriangle,
-		waveformSawtooth,
-		waveformInverseSawtooth,
-	};
+	// The cubic interpolation reads one sample before the read position and two
+	// after it.
+	static constexpr int interpolationMarginSamples = 3;
+	static constexpr int maximumRunLength = ParameterRamp<>::maximumNumSamples;
+	static constexpr double rampLengthInSeconds = 0.05;
 
 	enum interpolationIndex {
 		interpolationNearestNeighbour = 0,
@@ -279,41 +266,185 @@ private:
 		interpolationCubic,
 	};
 
-	float lfo(float phase, int waveform) {
-		float out = 0.0f;
+	AudioSampleBuffer delayBuffer;
+	int mDelayBufferMask = 0;
+	int delayWritePosition = 0;
+
+	// By sample then voice, how far before the write position the first sample
+	// the interpolation reads lies, less one.
+	std::vector<int> mReadOffsets;
+	// By sample then voice group, the fraction of the way from that sample to
+	// the next.
+	std::vector<SIMDFloat> mFractions;
+	// By voice, the sine and cosine of its LFO's phase offset, for
+	// mOffsetsNumVoices voices.
+	std::array<float, maximumNumVoices> mOffsetSines{};
+	std::array<float, maximumNumVoices> mOffsetCosines{};
+	int mOffsetsNumVoices = 0;
+
+	float mCurrentSampleRate = 44100;
+	float mLfoPhase = 0.0f;
+	float mInverseSampleRate = 1.0f / 44100.0f;
+
+	std::atomic<bool> mIsBypassed{ false };
+	std::atomic<int> mNumVoices{ 1 };
+	int mInterpolation = interpolationNearestNeighbour;
+
+	ParameterRamp<> mDelayRamp{ delayDefaultValue };
+	ParameterRamp<> mWidthRamp{ widthDefaultValue };
+	ParameterRamp<> mDepthRamp{ depthDefaultValue };
+	ParameterRamp<> mLFOFrequencyRamp{ frequencyDefaultValue };
+
+	// Where in its cycle each voice's LFO is, relative to the first voice's.
+	static float getPhaseOffset(int voice, int numVoices)
+	{
+		return numVoices == 2 ? 0.25f * voice : (float)voice / (float)numVoices;
+	}
 
-		switch (waveform) {
-		case waveformSine: {
-			out = 0.5f + 0.5f * sinf(twoPi * phase);
-			break;
-		}
-		case waveformTriangle: {
-			if (phase < 0.25f)
-				out = 0.5f + 2.0f * phase;
-			else if (phase < 0.75f)
-				out = 1.0f - 2.0f * (phase - 0.25f);
-			else
-				out = 2.0f * (phase - 0.75f);
-			break;
-		}
-		case waveformSawtooth: {
-			if (phase < 0.5f)
-				out = 0.5f + phase;
-			else
-				out = phase - 0.5f;
-			break;
+	// Steps each voice's LFO through the run and fills mReadOffsets and
+	// mFractions. The LFOs start each run from mLfoPhase, so rounding in the
+	// rotation never builds up from one run to the next.
+	void computeReadPositions(int runLength, int numVoices, int numActiveGroups)
+	{
+		const float twoPi = juce::MathConstants<float>::twoPi;
+		const float phaseIncrement = mLFOFrequencyRamp[0] * mInverseSampleRate;
+		const auto rotationCosine = SIMDFloat::expand(std::cos(twoPi * phaseIncrement));
+		const auto rotationSine = SIMDFloat::expand(std::sin(twoPi * phaseIncrement));
+
+		// The LFO runs from 0 to 1, as 0.5 + 0.5 sin, and sweeps the delay over
+		// the width above the delay.
+		const auto isSweepSmoothing = mDelayRamp.isSmoothing() || mWidthRamp.isSmoothing();
+		auto centreInSamples = SIMDFloat::expand((mDelayRamp.getValue() + 0.5f * mWidthRamp.getValue()) * mCurrentSampleRate);
+		auto sweepInSamples = SIMDFloat::expand(0.5f * mWidthRamp.getValue() * mCurrentSampleRate);
+
+		alignas(SIMDFloat) float sines[numLanes];
+		alignas(SIMDFloat) float cosines[numLanes];
+		alignas(SIMDFloat) float delays[numLanes];
+		alignas(SIMDFloat) float fractions[numLanes];
+
+		if (numVoices != mOffsetsNumVoices)
+		{
+			for (int voice = 0; voice < maximumNumVoices; ++voice)
+			{
+				const float offset = getPhaseOffset(juce::jmin(voice, numVoices - 1), numVoices);
+				mOffsetSines[voice] = std::sin(twoPi * offset);
+				mOffsetCosines[voice] = std::cos(twoPi * offset);
+			}
+
+			mOffsetsNumVoices = numVoices;
 		}
-		case waveformInverseSawtooth: {
-			if (phase < 0.5f)
-				out = 0.5f - phase;
-			else
-				out = 1.5f - phase;
-			break;
+
+		// Each voice starts from the first voice's LFO turned by its offset.
+		const float sine0 = std::sin(twoPi * mLfoPhase);
+		const float cosine0 = std::cos(twoPi * mLfoPhase);
+
+		for (int group = 0; group < numActiveGroups; ++group)
+		{
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				const int voice = group * numLanes + lane;
+				sines[lane] = sine0 * mOffsetCosines[voice] + cosine0 * mOffsetSines[voice];
+				cosines[lane] = cosine0 * mOffsetCosines[voice] - sine0 * mOffsetSines[voice];
+			}
+
+			auto sine = SIMDFloat::fromRawArray(sines);
+			auto cosine = SIMDFloat::fromRawArray(cosines);
+
+			for (int sample = 0; sample < runLength; ++sample)
+			{
+				if (isSweepSmoothing)
+				{
+					centreInSamples = SIMDFloat::expand((mDelayRamp[sample] + 0.5f * mWidthRamp[sample]) * mCurrentSampleRate);
+					sweepInSamples = SIMDFloat::expand(0.5f * mWidthRamp[sample] * mCurrentSampleRate);
+				}
+
+				(centreInSamples + sweepInSamples * sine).copyToRawArray(delays);
+				auto* readOffsets = mReadOffsets.data() + (size_t)sample * maximumNumVoices + group * numLanes;
+
+				// The delay is at least the minimum delay, so truncating floors it.
+				for (int lane = 0; lane < numLanes; ++lane)
+				{
+					const int wholeDelay = (int)delays[lane];
+					readOffsets[lane] = wholeDelay + 1;
+					fractions[lane] = 1.0f - (delays[lane] - (float)wholeDelay);
+				}
+
+				mFractions[(size_t)sample * numVoiceGroups + group] = SIMDFloat::fromRawArray(fractions);
+
+				const auto nextSine = sine * rotationCosine + cosine * rotationSine;
+				cosine = cosine * rotationCosine - sine * rotationSine;
+				sine = nextSine;
+			}
 		}
+
+		mLfoPhase += phaseIncrement * (float)runLength;
+		mLfoPhase -= std::floor(mLfoPhase);
+	}
+
+	template <int interpolation>
+	void processRun(juce::AudioBuffer<float>& buffer, int offset, int runLength, int numChannels, int numActiveGroups,
+		const std::array<SIMDFloat, numVoiceGroups>& gains)
+	{
+		alignas(SIMDFloat) float taps[4][numLanes] = {};
+
+		for (int channel = 0; channel < numChannels; ++channel) {
+			float* channelData = buffer.getWritePointer(channel, offset);
+			float* delayData = delayBuffer.getWritePointer(channel);
+
+			for (int sample = 0; sample < runLength; ++sample) {
+				const float in = channelData[sample];
+				const int writePosition = delayWritePosition + sample;
+				auto out = SIMDFloat::expand(0.0f);
+
+				for (int group = 0; group < numActiveGroups; ++group) {
+					const auto* readOffsets = mReadOffsets.data() + (size_t)sample * maximumNumVoices + group * numLanes;
+
+					for (int lane = 0; lane < numLanes; ++lane) {
+						const int readPosition = writePosition - readOffsets[lane];
+						if (interpolation == interpolationCubic)
+							taps[0][lane] = delayData[(readPosition - 1) & mDelayBufferMask];
+						taps[1][lane] = delayData[readPosition & mDelayBufferMask];
+						if (interpolation != interpolationNearestNeighbour)
+							taps[2][lane] = delayData[(readPosition + 1) & mDelayBufferMask];
+						if (interpolation == interpolationCubic)
+							taps[3][lane] = delayData[(readPosition + 2) & mDelayBufferMask];
+					}
+
+					const auto fraction = mFractions[(size_t)sample * numVoiceGroups + group];
+					out = out + interpolate<interpolation>(taps, fraction) * gains[group];
+				}
+
+				channelData[sample] = in + out.sum() * mDepthRamp[sample];
+				delayData[writePosition & mDelayBufferMask] = in;
+			}
 		}
+	}
 
-		return out;
-	};
+	template <int interpolation>
+	static SIMDFloat interpolate(const float (&taps)[4][numLanes], SIMDFloat fraction)
+	{
+		const auto sample1 = SIMDFloat::fromRawArray(taps[1]);
+
+		if (interpolation == interpolationNearestNeighbour)
+			return sample1;
+
+		const auto sample2 = SIMDFloat::fromRawArray(taps[2]);
+
+		if (interpolation == interpolationLinear)
+			return sample1 + fraction * (sample2 - sample1);
+
+		const auto sample0 = SIMDFloat::fromRawArray(taps[0]);
+		const auto sample3 = SIMDFloat::fromRawArray(taps[3]);
+		const auto fractionSqrt = fraction * fraction;
+		const auto fractionCube = fractionSqrt * fraction;
+
+		const auto a0 = SIMDFloat::expand(-0.5f) * sample0 + SIMDFloat::expand(1.5f) * sample1
+			- SIMDFloat::expand(1.5f) * sample2 + SIMDFloat::expand(0.5f) * sample3;
+		const auto a1 = sample0 - SIMDFloat::expand(2.5f) * sample1 + SIMDFloat::expand(2.0f) * sample2
+			- SIMDFloat::expand(0.5f) * sample3;
+		const auto a2 = SIMDFloat::expand(-0.5f) * sample0 + SIMDFloat::expand(0.5f) * sample2;
+		return a0 * fractionCube + a1 * fractionSqrt + a2 * fraction + sample1;
+	}
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Chorus)
 };
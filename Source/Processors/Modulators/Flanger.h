@@ -28,6 +28,8 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <JuceHeader.h>
+#include "../../Utilities/MemoryUsage.h"
+#include "../../Utilities/ParameterRamp.h"
 
 using namespace juce;
 
@@ -85,16 +87,18 @@ public:
 
     void prepare (juce::dsp::ProcessSpec& spec)
     {
-        setDelay(delayDefaultValue);
-        setWidth(widthDefaultValue);
-        setDepth(depthDefaultValue);
-        setFeedback(feedbackDefaultValue);
-        setFrequency(frequencyDefaultValue);
-
         mCurrentSampleRate = spec.sampleRate;
 
-        float maxDelayTime = (delayMaximumValue + widthMaximumValue) * 1000;
-        mDelayBufferSamples = (int)(maxDelayTime * (float)mCurrentSampleRate) + 1;
+        mDelayRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mWidthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mDepthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mFeedbackRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mFrequencyRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+
+        // The delay and width are in seconds. The buffer holds the longest delay the
+        // LFO reaches and the samples the interpolation reads around it.
+        float maxDelayTime = delayMaximumValue + widthMaximumValue;
+        mDelayBufferSamples = (int)std::ceil(maxDelayTime * (float)mCurrentSampleRate) + interpolationMarginSamples;
         if (mDelayBufferSamples < 1)
             mDelayBufferSamples = 1;
 
@@ -109,26 +113,149 @@ public:
     };
 
     void reset() {
+        mDelayBuffer.clear();
+        mDelayWritePosition = 0;
+        mLfoPhase = 0.0f;
+
+        mDelayRamp.reset();
+        mWidthRamp.reset();
+        mDepthRamp.reset();
+        mFeedbackRamp.reset();
+        mFrequencyRamp.reset();
     };
+
+    size_t getMemoryUsageInBytes() const
+    {
+        return MemoryUsage::getSizeInBytes(mDelayBuffer);
+    }
+
+    // Frees the delay buffer until the next prepare().
+    void release()
+    {
+        mDelayBuffer = juce::AudioBuffer<float>();
+        mDelayWritePosition = 0;
+    }
+
     void process(juce::AudioBuffer<float>& buffer)
     {
-        if (mIsBypassed)
+        if (mIsBypassed.load())
         {
             return;
         }
 
         ScopedNoDenormals noDenormals;
 
-        const int numInputChannels = buffer.getNumChannels();
-        const int numOutputChannels = buffer.getNumChannels();
+        const int numChannels = juce::jmin(buffer.getNumChannels(), mDelayBuffer.getNumChannels());
         const int numSamples = buffer.getNumSamples();
 
-        int localWritePosition;
+        // The parameters are stepped a chunk at a time, and every channel reads
+        // the same steps.
+        for (int offset = 0; offset < numSamples; offset += ParameterRamp<>::maximumNumSamples)
+        {
+            const int chunkLength = juce::jmin(numSamples - offset, ParameterRamp<>::maximumNumSamples);
+
+            mDelayRamp.advance(chunkLength);
+            mWidthRamp.advance(chunkLength);
+            mDepthRamp.advance(chunkLength);
+            mFeedbackRamp.advance(chunkLength);
+            mFrequencyRamp.advance(chunkLength);
+
+            const auto isSmoothing = mDelayRamp.isSmoothing()
+                || mWidthRamp.isSmoothing()
+                || mDepthRamp.isSmoothing()
+                || mFeedbackRamp.isSmoothing()
+                || mFrequencyRamp.isSmoothing();
+
+            if (isSmoothing)
+                processChunk<true>(buffer, offset, chunkLength, numChannels);
+            else
+                processChunk<false>(buffer, offset, chunkLength, numChannels);
+        }
+    };
+
+    // Any thread.
+    void setBypassed(bool newValue)
+    {
+        mIsBypassed.store(newValue);
+    }
+
+    void setDelay(float newValue)
+    {
+        mDelayRamp.setTargetValue(newValue);
+    }
+
+    void setWidth(float newValue)
+    {
+        mWidthRamp.setTargetValue(newValue);
+    }
+
+    void setDepth(float newValue)
+    {
+        mDepthRamp.setTargetValue(newValue);
+    }
+
+    void setFeedback(float newValue)
+    {
+        mFeedbackRamp.setTargetValue(newValue);
+    }
+
+    void setFrequency(float newValue)
+    {
+        mFrequencyRamp.setTargetValue(newValue);
+    }
+
+private:   
+    // The cubic interpolation reads one sample before the read position and two
+    // after it.
+    static constexpr int interpolationMarginSamples = 3;
+    static constexpr double rampLengthInSeconds = 0.05;
+
+    enum waveformIndex {
+        waveformSine = 0,
+        waveformTriangle,
+        waveformSawtooth,
+        waveformInverseSawtooth,
+    };
+
+    enum interpolationIndex {
+        interpolationNearestNeighbour = 0,
+        interpolationLinear,
+        interpolationCubic,
+    };
+
+    AudioSampleBuffer mDelayBuffer;
+    int mDelayBufferSamples;
+    int mDelayBufferChannels;
+    int mDelayWritePosition;
+
+    float mLfoPhase;
+    float mInverseSampleRate;
+    float mTwoPi;
+    float mCurrentSampleRate = 44100;
+
+    ParameterRamp<> mDelayRamp{ delayDefaultValue };
+    ParameterRamp<> mWidthRamp{ widthDefaultValue };
+    ParameterRamp<> mDepthRamp{ depthDefaultValue };
+    ParameterRamp<> mFeedbackRamp{ feedbackDefaultValue };
+    ParameterRamp<> mFrequencyRamp{ frequencyDefaultValue };
+
+    bool mInverted = false;
+    int mWaveform = 0;  // (parameters, "LFO Waveform", waveformItemsUI, waveformSine)
+    int mInterpolation = 0; // (parameters, "Interpolation", interpolationItemsUI, interpolationLinear)
+    bool mStereo = false;
+    std::atomic<bool> mIsBypassed{ false };
+
+    // With isSmoothing false, every parameter holds for the whole chunk and is
+    // read once rather than from its ramp.
+    template <bool isSmoothing>
+    void processChunk(juce::AudioBuffer<float>& buffer, int offset, int numSamples, int numChannels)
+    {
+        int localWritePosition = mDelayWritePosition;
         float phase;
-        float phaseMain;
+        float phaseMain = mLfoPhase;
 
-        for (int channel = 0; channel < numInputChannels; ++channel) {
-            float* channelData = buffer.getWritePointer(channel);
+        for (int channel = 0; channel < numChannels; ++channel) {
+            float* channelData = buffer.getWritePointer(channel, offset);
             float* delayData = mDelayBuffer.getWritePointer(channel);
             localWritePosition = mDelayWritePosition;
             phase = mLfoPhase;
@@ -136,12 +263,12 @@ public:
                 phase = fmodf(phase + 0.25f, 1.0f);
 
             for (int sample = 0; sample < numSamples; ++sample) {
-                float currentDelay = mDelaySmoothedValue.getNextValue(); //0.002;
-                float currentWidth = mWidthSmoothedValue.getNextValue();// 0.01
-                float currentDepth = mDepthSmoothedValue.getNextValue();// 1.0;
-                float currentFeedback = mFeedbackSmoothedValue.getNextValue();// 0.0f;
+                const float currentDelay = isSmoothing ? mDelayRamp[sample] : mDelayRamp.getValue();
+                const float currentWidth = isSmoothing ? mWidthRamp[sample] : mWidthRamp.getValue();
+                const float currentDepth = isSmoothing ? mDepthRamp[sample] : mDepthRamp.getValue();
+                const float currentFeedback = isSmoothing ? mFeedbackRamp[sample] : mFeedbackRamp.getValue();
+                const float currentFrequency = isSmoothing ? mFrequencyRamp[sample] : mFrequencyRamp.getValue();
                 float currentInverted = true;
-                float currentFrequency = mFrequencySmoothedValue.getNextValue();// 0.2f;
 
                 const float in = channelData[sample];
                 float out = 0.0f;
@@ -202,79 +329,8 @@ public:
 
         mDelayWritePosition = localWritePosition;
         mLfoPhase = phaseMain;
-
-        //======================================
-
-        for (int channel = numInputChannels; channel < numOutputChannels; ++channel)
-            buffer.clear(channel, 0, numSamples);
-    };
-
-    void setBypassed(bool newValue)
-    {
-        mIsBypassed = newValue;
-    }
-
-    void setDelay(float newValue)
-    {
-        mDelaySmoothedValue.setTargetValue(newValue);
-    }
-
-    void setWidth(float newValue)
-    {
-        mWidthSmoothedValue.setTargetValue(newValue);
-    }
-
-    void setDepth(float newValue)
-    {
-        mDepthSmoothedValue.setTargetValue(newValue);
-    }
-
-    void setFeedback(float newValue)
-    {
-        mFeedbackSmoothedValue.setTargetValue(newValue);
-    }
-
-    void setFrequency(float newValue)
-    {
-        mFrequencySmoothedValue.setTargetValue(newValue);
     }
 
-private:   
-    enum waveformIndex {
-        waveformSine = 0,
-        waveformTriangle,
-        waveformSawtooth,
-        waveformInverseSawtooth,
-    };
-
-    enum interpolationIndex {
-        interpolationNearestNeighbour = 0,
-        interpolationLinear,
-        interpolationCubic,
-    };
-
-    AudioSampleBuffer mDelayBuffer;
-    int mDelayBufferSamples;
-    int mDelayBufferChannels;
-    int mDelayWritePosition;
-
-    float mLfoPhase;
-    float mInverseSampleRate;
-    float mTwoPi;
-    float mCurrentSampleRate = 441000;
-
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mDelaySmoothedValue;
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mWidthSmoothedValue;
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mDepthSmoothedValue;
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mFeedbackSmoothedValue;
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mFrequencySmoothedValue;
-
-    bool mInverted = false;
-    int mWaveform = 0;  // (parameters, "LFO Waveform", waveformItemsUI, waveformSine)
-    int mInterpolation = 0; // (parameters, "Interpolation", interpolationItemsUI, interpolationLinear)
-    bool mStereo = false;
-    bool mIsBypassed = false;
-
     float lfo (float phase, int waveform) 
     {
         float out = 0.0f;
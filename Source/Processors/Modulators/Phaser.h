@@ -25,15 +25,39 @@
 
 #pragma once
 
-#define _USE_MATH_DEFINES
 #include <cmath>
 #include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+#include "../../Utilities/ParameterRamp.h"
 
 using namespace juce;
 
+/*
+    A cascade of first order allpass filters, swept together by a sine LFO and
+    fed back from the end of the cascade to its start.
+
+    Each stage holds a single state, so the whole cascade is one contiguous
+    array of states and one coefficient, with no object per stage. The feedback
+    makes every sample depend on the one before, so the channels rather than
+    the stages run side by side in the lanes of SIMD registers, and a stereo
+    cascade costs about what a mono one does. As the stages share their
+    coefficient, the output of a group of stages follows from the group's input
+    in one multiply and add, with the rest coming from the states alone, so the
+    chain of dependent operations that each sample waits on is one step per
+    group of four stages rather than one per stage.
+
+    The LFO is only read when the coefficients are updated, every
+    updateInterval samples, and the coefficients come from a fast tan, so the
+    cost per sample is the cascade alone. The parameters are stepped a chunk at
+    a time, and the depth and feedback are only read per sample while they
+    move.
+ */
 class Phaser
 {
 public:
+    using SIMDFloat = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int maximumNumStages = 24;
 
     static constexpr float depthDefaultValue = 1.0f;
     static inline const juce::NormalisableRange<float> depthNormalisableRange = juce::NormalisableRange<float>(0.00f, 1.00f, 0.01f);
@@ -50,117 +74,115 @@ public:
     static constexpr float minimumFrequencyDefaultValue = 80.00f;
     static inline const juce::NormalisableRange<float> minimumFrequencyNormalisableRange = juce::NormalisableRange<float>(50.00f, 1000.00f, 1.00f);
 
+    // Two stages is the phaser as it has always sounded.
+    static constexpr float stagesDefaultValue = 2.0f;
+    static inline const juce::NormalisableRange<float> stagesNormalisableRange = juce::NormalisableRange<float>(2.0f, (float)maximumNumStages, 2.0f);
+
     Phaser() = default;
 
     void prepare (juce::dsp::ProcessSpec& spec) {
-        mNumFiltersPerChannel = mNumFilters;
-
-        filters.clear();
-        for (int i = 0; i < spec.numChannels * mNumFiltersPerChannel; ++i) {
-            Filter* filter;
-            filters.add(filter = new Filter());
-        }
+        mNumChannelGroups = juce::jmax(1, ((int)spec.numChannels + numLanes - 1) / numLanes);
 
-        filteredOutputs.clear();
-        for (int i = 0; i < spec.numChannels; ++i)
-            filteredOutputs.add(0.0f);
-
-        mSampleCountToUpdateFilters = 0;
-        mUpdateFiltersInterval = 32;
+        mStates.assign((size_t)mNumChannelGroups * maximumNumStages, SIMDFloat::expand(0.0f));
+        mCoefficients.assign((size_t)mNumChannelGroups * stagesPerGroup, SIMDFloat::expand(0.0f));
+        mFilteredOutputs.assign((size_t)mNumChannelGroups, SIMDFloat::expand(0.0f));
 
+        mSamplesUntilUpdate = 0;
         mLfoPhase = 0.0f;
         mInverseSampleRate = 1.0f / (float)spec.sampleRate;
-        mTwoPi = 2.0f * M_PI;
-
+        mActiveNumStages = mNumStages.load();
 
-        mDepthSmoothedValue.setTargetValue(1.0f);
-        mFeedbackSmoothedValue.setTargetValue(0.7f);
-        mSweepWidthSmoothedValue.setTargetValue(1000.0f);
-        mLFOFrequencySmoothedValue.setTargetValue(0.05f);
-        mMinFrequencySmoothedValue.setTargetValue(80.0f);
+        mDepthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mFeedbackRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mSweepWidthRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mLFOFrequencyRamp.prepare(spec.sampleRate, rampLengthInSeconds);
+        mMinFrequencyRamp.prepare(spec.sampleRate, rampLengthInSeconds);
     };
 
     void process (juce::AudioBuffer<float>& buffer) {
-        if (mIsBypassed)
+        if (mIsBypassed || mStates.empty())
         {
             return;
         }
 
         ScopedNoDenormals noDenormals;
 
-        const int numInputChannels = buffer.getNumChannels();
-        const int numOutputChannels = buffer.getNumChannels();
+        const int numChannels = juce::jmin(buffer.getNumChannels(), mNumChannelGroups * numLanes);
         const int numSamples = buffer.getNumSamples();
 
-        //======================================
-
-        float phase;
-        float phaseMain;
-        unsigned int sampleCount;
-
-        for (int channel = 0; channel < numInputChannels; ++channel) {
-            float* channelData = buffer.getWritePointer(channel);
-            sampleCount = mSampleCountToUpdateFilters;
-            phase = mLfoPhase;
-            if (mIsStereo && channel != 0)
-                phase = fmodf(phase + 0.25f, 1.0f);
-
-            for (int sample = 0; sample < numSamples; ++sample) {
-                float in = channelData[sample];
+        setActiveNumStages(mNumStages.load());
 
-                float centreFrequency = lfo(phase, mLFOWaveform);
-                centreFrequency *= mSweepWidthSmoothedValue.getNextValue();
-                centreFrequency += mMinFrequencySmoothedValue.getNextValue();
-
-                phase += mLFOFrequencySmoothedValue.getNextValue() * mInverseSampleRate;
-                if (phase >= 1.0f)
-                    phase -= 1.0f;
-
-                if (sampleCount++ % mUpdateFiltersInterval == 0)
-                    updateFilters(centreFrequency);
-
-                float filtered = in + mFeedbackSmoothedValue.getNextValue() * filteredOutputs[channel];
-                for (int i = 0; i < mNumFilters; ++i)
-                    filtered = filters[channel * mNumFilters + i]->processSingleSampleRaw(filtered);
-
-                filteredOutputs.set(channel, filtered);
-                float out = in + mDepthSmoothedValue.getNextValue() * (filtered - in) * 0.5f;
-                channelData[sample] = out;
+        for (int offset = 0; offset < numSamples; offset += ParameterRamp<>::maximumNumSamples)
+        {
+            const int chunkLength = juce::jmin(numSamples - offset, ParameterRamp<>::maximumNumSamples);
+
+            mDepthRamp.advance(chunkLength);
+            mFeedbackRamp.advance(chunkLength);
+            mSweepWidthRamp.advance(chunkLength);
+            mLFOFrequencyRamp.advance(chunkLength);
+            mMinFrequencyRamp.advance(chunkLength);
+
+            const auto isSmoothing = mDepthRamp.isSmoothing() || mFeedbackRamp.isSmoothing();
+
+            for (int rampOffset = 0; rampOffset < chunkLength;)
+            {
+                if (mSamplesUntilUpdate == 0)
+                {
+                    updateCoefficients(mSweepWidthRamp[rampOffset], mMinFrequencyRamp[rampOffset]);
+                    mSamplesUntilUpdate = updateInterval;
+                }
+
+                const int runLength = juce::jmin(chunkLength - rampOffset, mSamplesUntilUpdate);
+
+                for (int group = 0; group * numLanes < numChannels; ++group)
+                {
+                    const int numGroupChannels = juce::jmin(numLanes, numChannels - group * numLanes);
+
+                    if (isSmoothing)
+                        processRun<true>(buffer, offset + rampOffset, rampOffset, runLength, group, numGroupChannels);
+                    else
+                        processRun<false>(buffer, offset + rampOffset, rampOffset, runLength, group, numGroupChannels);
+                }
+
+                advanceLfo(rampOffset, runLength);
+                mSamplesUntilUpdate -= runLength;
+                rampOffset += runLength;
             }
-
-            if (channel == 0)
-                phaseMain = phase;
         }
-
-        mSampleCountToUpdateFilters = sampleCount;
-        mLfoPhase = phaseMain;
-
-        for (int channel = numInputChannels; channel < numOutputChannels; ++channel)
-            buffer.clear(channel, 0, numSamples);
     };
 
     void reset() 
     {
+        std::fill(mStates.begin(), mStates.end(), SIMDFloat::expand(0.0f));
+        std::fill(mFilteredOutputs.begin(), mFilteredOutputs.end(), SIMDFloat::expand(0.0f));
+        mSamplesUntilUpdate = 0;
+        mLfoPhase = 0.0f;
+
+        mDepthRamp.reset();
+        mFeedbackRamp.reset();
+        mSweepWidthRamp.reset();
+        mLFOFrequencyRamp.reset();
+        mMinFrequencyRamp.reset();
     };
 
     void setDepth(float newValue)
     {
-        mDepthSmoothedValue.setTargetValue(newValue);
+        mDepthRamp.setTargetValue(newValue);
     }
 
     void setFeedback(float newValue)
     {
-        mFeedbackSmoothedValue.setTargetValue(newValue);
+        mFeedbackRamp.setTargetValue(newValue);
     }
 
     void setWidth(float newValue)
     {
-        mSweepWidthSmoothedValue.setTargetValue(newValue);
+        mSweepWidthRamp.setTargetValue(newValue);
     }
 
     void setFrequency(float newValue)
     {
-        mLFOFrequencySmoothedValue.setTargetValue(newValue);
+        mLFOFrequencyRamp.setTargetValue(newValue);
     }
 
     void setStereo(bool newValue)
@@ -170,7 +192,13 @@ public:
 
     void setMinimumFrequency(float newValue)
     {
-        mMinFrequencySmoothedValue.setTargetValue(newValue);
+        mMinFrequencyRamp.setTargetValue(newValue);
+    }
+
+    // Any thread. Rounded to an even number from 2 to maximumNumStages.
+    void setNumStages(int newValue)
+    {
+        mNumStages.store(juce::jlimit(1, maximumNumStages / 2, (newValue + 1) / 2) * 2);
     }
 
     void setBypassed(bool newValue)
@@ -179,113 +207,196 @@ public:
     }
 
 private:
+    static constexpr int numLanes = (int)SIMDFloat::SIMDNumElements;
+    static constexpr int updateInterval = 32;
+    static constexpr double rampLengthInSeconds = 0.05;
+    // The stages whose outputs follow from one input; a group's coefficients
+    // are a to a^stagesPerGroup.
+    static constexpr int stagesPerGroup = 4;
+
+    // By channel group then stage, the state of each allpass filter.
+    std::vector<SIMDFloat> mStates;
+    // By channel group, the coefficient a every stage shares, then a^2, a^3
+    // and a^4.
+    std::vector<SIMDFloat> mCoefficients;
+    // By channel group, the last output of the cascade, fed back into it.
+    std::vector<SIMDFloat> mFilteredOutputs;
+
+    int mNumChannelGroups = 0;
+    int mSamplesUntilUpdate = 0;
+    int mActiveNumStages = 2;
+
+    float mLfoPhase = 0.0f;
+    float mInverseSampleRate = 1.0f / 44100.0f;
 
-    enum waveformIndex {
-        waveformSine = 0,
-        waveformTriangle,
-        waveformSquare,
-        waveformSawtooth,
-    };
-
-    class Filter : public IIRFilter
+    bool mIsStereo = false;
+    bool mIsBypassed = true;
+    std::atomic<int> mNumStages{ 2 };
+    
+    ParameterRamp<> mDepthRamp{ depthDefaultValue };
+    ParameterRamp<> mFeedbackRamp{ feedbackDefaultValue };
+    ParameterRamp<juce::ValueSmoothingTypes::Multiplicative> mSweepWidthRamp{ widthDefaultValue };
+    ParameterRamp<> mLFOFrequencyRamp{ frequencyDefaultValue };
+    ParameterRamp<juce::ValueSmoothingTypes::Multiplicative> mMinFrequencyRamp{ minimumFrequencyDefaultValue };
+
+    // Stages brought in since the last block start from silence rather than
+    // from whatever they held when they were last used.
+    void setActiveNumStages(int numStages)
     {
-    public:
-        void updateCoefficients (const double discreteFrequency) noexcept
+        if (numStages > mActiveNumStages)
         {
-            jassert (discreteFrequency > 0);
-
-            double wc = jmin (discreteFrequency, M_PI * 0.99);
-            double tan_half_wc = tan (wc / 2.0);
-
-            coefficients = IIRCoefficients (/* b0 */ tan_half_wc - 1.0,
-                                            /* b1 */ tan_half_wc + 1.0,
-                                            /* b2 */ 0.0,
-                                            /* a0 */ tan_half_wc + 1.0,
-                                            /* a1 */ tan_half_wc - 1.0,
-                                            /* a2 */ 0.0);
-
-            setCoefficients (coefficients);
+            for (int group = 0; group < mNumChannelGroups; ++group)
+            {
+                auto* states = mStates.data() + (size_t)group * maximumNumStages;
+                std::fill(states + mActiveNumStages, states + numStages, SIMDFloat::expand(0.0f));
+            }
         }
-    };
 
-    OwnedArray<Filter> filters;
-    Array<float> filteredOutputs;
+        mActiveNumStages = numStages;
+    }
 
-    int mNumFiltersPerChannel;
-    unsigned int mSampleCountToUpdateFilters;
-    unsigned int mUpdateFiltersInterval;
+    // Every channel after the first is a quarter of a cycle ahead in stereo.
+    void updateCoefficients(float width, float minimumFrequency)
+    {
+        alignas(SIMDFloat) float coefficients[numLanes];
 
-    float mLfoPhase;
-    float mInverseSampleRate;
-    float mTwoPi;
+        for (int group = 0; group < mNumChannelGroups; ++group)
+        {
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                const float phase = mLfoPhase + (mIsStereo && group * numLanes + lane != 0 ? 0.25f : 0.0f);
+                const float centreFrequency = lfo(phase) * width + minimumFrequency;
+                const float discreteFrequency = juce::MathConstants<float>::twoPi * centreFrequency * mInverseSampleRate;
+
+                // H(z) = (a + z^-1) / (1 + a z^-1), with a = (t - 1) / (t + 1) and
+                // t = tan(wc / 2).
+                const float wc = juce::jmin(discreteFrequency, juce::MathConstants<float>::pi * 0.99f);
+                const float tanHalfWc = FastMath::tan(wc * 0.5f);
+                coefficients[lane] = (tanHalfWc - 1.0f) / (tanHalfWc + 1.0f);
+            }
 
-    bool mIsStereo = false;
-    bool mIsBypassed = true;
-    
-    // ("Depth", "", 0.0f, 1.0f, 1.0f)
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mDepthSmoothedValue; 
+            auto* powers = mCoefficients.data() + (size_t)group * stagesPerGroup;
+            powers[0] = SIMDFloat::fromRawArray(coefficients);
 
-    // ("Feedback", "", 0.0f, 0.9f, 0.7f)
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mFeedbackSmoothedValue;
+            for (int power = 1; power < stagesPerGroup; ++power)
+            {
+                powers[power] = powers[power - 1] * powers[0];
+            }
+        }
+    }
 
-    // ("Sweep width", "Hz", 50.0f, 3000.0f, 1000.0f)
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> mSweepWidthSmoothedValue;
+    // Moves the LFO on by the run of numSamples samples from rampOffset in the
+    // chunk.
+    void advanceLfo(int rampOffset, int numSamples)
+    {
+        if (mLFOFrequencyRamp.isSmoothing())
+        {
+            for (int sample = rampOffset; sample < rampOffset + numSamples; ++sample)
+            {
+                mLfoPhase += mLFOFrequencyRamp[sample] * mInverseSampleRate;
+            }
+        }
+        else
+        {
+            mLfoPhase += mLFOFrequencyRamp.getValue() * mInverseSampleRate * (float)numSamples;
+        }
 
-    // ("LFO Frequency", "Hz", 0.0f, 2.0f, 0.05f)
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> mLFOFrequencySmoothedValue; 
+        mLfoPhase -= std::floor(mLfoPhase);
+    }
 
-    // ("Min. Frequency", "Hz", 50.0f, 1000.0f, 80.0f)
-    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> mMinFrequencySmoothedValue; 
-    
-    // {"2", "4", "6", "8", "10"}
-    int mNumFilters = 2; 
+    // With isSmoothing false, the depth and feedback hold for the whole run and
+    // are read once rather than from their ramps.
+    template <bool isSmoothing>
+    void processRun(juce::AudioBuffer<float>& buffer, int offset, int rampOffset, int runLength, int group, int numGroupChannels)
+    {
+        auto* const* channels = buffer.getArrayOfWritePointers();
+        auto* states = mStates.data() + (size_t)group * maximumNumStages;
+        const int numStages = mActiveNumStages;
+        const auto* powers = mCoefficients.data() + (size_t)group * stagesPerGroup;
+        const auto a = powers[0];
+        const auto a2 = powers[1];
+        const auto a3 = powers[2];
+        const auto a4 = powers[3];
+        const auto constantFeedbackGain = SIMDFloat::expand(mFeedbackRamp.getValue());
+        const auto constantWetGain = SIMDFloat::expand(mDepthRamp.getValue() * 0.5f);
+        auto filteredOutput = mFilteredOutputs[(size_t)group];
+
+        // The run is interleaved into lanes up front and back out afterwards, so
+        // the cascade itself only touches whole registers.
+        alignas(SIMDFloat) float lanes[updateInterval][numLanes] = {};
+
+        for (int lane = 0; lane < numGroupChannels; ++lane)
+        {
+            const float* channelData = channels[group * numLanes + lane] + offset;
 
-    // ("LFO Waveform", waveformItemsUI, waveformSine)
-    int mLFOWaveform = 0; 
+            for (int sample = 0; sample < runLength; ++sample)
+            {
+                lanes[sample][lane] = channelData[sample];
+            }
+        }
 
-    void updateFilters(double centreFrequency)
-    {
-        double discreteFrequency = mTwoPi * centreFrequency * mInverseSampleRate;
+        for (int sample = 0; sample < runLength; ++sample)
+        {
+            const auto feedbackGain = isSmoothing ? SIMDFloat::expand(mFeedbackRamp[rampOffset + sample]) : constantFeedbackGain;
+            const auto wetGain = isSmoothing ? SIMDFloat::expand(mDepthRamp[rampOffset + sample] * 0.5f) : constantWetGain;
+
+            const auto in = SIMDFloat::fromRawArray(lanes[sample]);
+            auto filtered = in + feedbackGain * filteredOutput;
+
+            // Each stage is y = a x + s, then s = x - a y, so the kth stage of a
+            // group gives a^k x + p_k, with p_1 = s_1 and p_k = a p_(k-1) + s_k,
+            // where only x waits on the stages before.
+            int stage = 0;
+
+            for (; stage + stagesPerGroup <= numStages; stage += stagesPerGroup)
+            {
+                auto* s = states + stage;
+                const auto p2 = a * s[0] + s[1];
+                const auto p3 = a * p2 + s[2];
+                const auto p4 = a * p3 + s[3];
+                const auto out1 = a * filtered + s[0];
+                const auto out2 = a2 * filtered + p2;
+                const auto out3 = a3 * filtered + p3;
+                const auto out4 = a4 * filtered + p4;
+                s[0] = filtered - a * out1;
+                s[1] = out1 - a * out2;
+                s[2] = out2 - a * out3;
+                s[3] = out3 - a * out4;
+                filtered = out4;
+            }
 
-        for (int i = 0; i < filters.size(); ++i)
-            filters[i]->updateCoefficients(discreteFrequency);
-    };
-    
-    float lfo(float phase, int waveform) {
-        float out = 0.0f;
+            // The stage count is even, so at most a pair is left.
+            if (stage < numStages)
+            {
+                auto* s = states + stage;
+                const auto out1 = a * filtered + s[0];
+                const auto out2 = a2 * filtered + (a * s[0] + s[1]);
+                s[0] = filtered - a * out1;
+                s[1] = out1 - a * out2;
+                filtered = out2;
+            }
 
-        switch (waveform) {
-        case waveformSine: {
-            out = 0.5f + 0.5f * sinf(mTwoPi * phase);
-            break;
-        }
-        case waveformTriangle: {
-            if (phase < 0.25f)
-                out = 0.5f + 2.0f * phase;
-            else if (phase < 0.75f)
-                out = 1.0f - 2.0f * (phase - 0.25f);
-            else
-                out = 2.0f * (phase - 0.75f);
-            break;
-        }
-        case waveformSquare: {
-            if (phase < 0.5f)
-                out = 1.0f;
-            else
-                out = 0.0f;
-            break;
-        }
-        case waveformSawtooth: {
-            if (phase < 0.5f)
-                out = 0.5f + phase;
-            else
-                out = phase - 0.5f;
-            break;
+            filteredOutput = filtered;
+            (in + wetGain * (filtered - in)).copyToRawArray(lanes[sample]);
         }
+
+        for (int lane = 0; lane < numGroupChannels; ++lane)
+        {
+            float* channelData = channels[group * numLanes + lane] + offset;
+
+            for (int sample = 0; sample < runLength; ++sample)
+            {
+                channelData[sample] = lanes[sample][lane];
+            }
         }
 
-        return out;
-    };
+        mFilteredOutputs[(size_t)group] = filteredOutput;
+    }
+
+    static float lfo(float phase)
+    {
+        return 0.5f + 0.5f * std::sin(juce::MathConstants<float>::twoPi * phase);
+    }
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Phaser)
 };
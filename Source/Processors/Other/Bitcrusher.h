@@ -25,7 +25,13 @@
 
 #include <JuceHeader.h>
 #include "Krusher.h"
+#include "../Equilisers/BiquadCascade.h"
 
+/*
+    Everything the Krusher needs for each channel, its bit reducer's filter and
+    the sample its resampler is holding, is sized in prepare(), so process()
+    never allocates and takes as many channels as it was prepared for.
+ */
 class Bitcrusher
 {
 public:
@@ -50,20 +56,21 @@ public:
             bitDepthMaximumValue,
             bitDepthIntervalValue);
 
-    Bitcrusher() : mDCBlockerHPF(juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>())
-    {};
+    Bitcrusher() = default;
 
     void prepare(juce::dsp::ProcessSpec& spec)
     {
-        mCurrentSampleRate = spec.sampleRate;
+        mCurrentSampleRate = static_cast<float>(spec.sampleRate);
 
-        krusher_init_lofi_resample(&resample_state);
+        mFilterStates.assign(spec.numChannels, {});
+        mHeldSamples.assign(spec.numChannels, 0.0f);
+        krusher_init_lofi_resample(&mResampleState, mHeldSamples.data(), static_cast<int>(mHeldSamples.size()));
 
-        mDCBlockerHPF.prepare(spec);
-        *mDCBlockerHPF.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(
+        mDCBlockerHPF.setCoefficients(0, juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(
             spec.sampleRate,
             15.0f,
-            0.70710678118654752440f);
+            0.70710678118654752440f));
+        mDCBlockerHPF.prepare(spec);
     }
 
     void process(juce::AudioBuffer<float>& buffer)
@@ -73,42 +80,50 @@ public:
             return;
         }
 
+        auto* const* channels = buffer.getArrayOfWritePointers();
+        const auto numChannels = juce::jmin(buffer.getNumChannels(), static_cast<int>(mFilterStates.size()));
+        const auto numSamples = buffer.getNumSamples();
+
         krusher_bit_reduce_process_block(
-            const_cast<float**> (buffer.getArrayOfWritePointers()),
-            buffer.getNumChannels(),
-            buffer.getNumSamples(),
+            channels,
+            numChannels,
+            numSamples,
             1, // "Zero-Order", "First-Order", "Second-Order", "Third-Order" 
-            mBitDepth,
-            brFilterStates.data());
+            juce::roundToInt(mBitDepth.load()),
+            mFilterStates.data());
+
+        const auto targetSampleRate = mTargetSampleRate.load();
 
-        if (mTargetSampleRate >= mCurrentSampleRate)
+        if (targetSampleRate >= mCurrentSampleRate)
         {
             return;
         }
 
-        krusher_process_lofi_downsample(nullptr,
-            &resample_state,
-            const_cast<float**> (buffer.getArrayOfWritePointers()),
-            buffer.getNumChannels(),
-            buffer.getNumSamples(),
-            double(mCurrentSampleRate / mTargetSampleRate));
-
-        auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
-        auto processContext = juce::dsp::ProcessContextReplacing<float>(audioBlock);
+        krusher_process_lofi_downsample(
+            &mResampleState,
+            mHeldSamples.data(),
+            channels,
+            numChannels,
+            numSamples,
+            double(mCurrentSampleRate / targetSampleRate));
 
-        mDCBlockerHPF.process(processContext);
+        mDCBlockerHPF.process(channels, numChannels, numSamples);
     }
 
     void reset()
     {
+        krusher_init_lofi_resample(&mResampleState, mHeldSamples.data(), static_cast<int>(mHeldSamples.size()));
+        std::fill(mFilterStates.begin(), mFilterStates.end(), KrusherBitReducerFilterState{});
         mDCBlockerHPF.reset();
     }
 
+    // Any thread.
     void setTargetSampleRate(float newValue)
     {
         mTargetSampleRate = newValue;
     }
 
+    // Any thread.
     void setBitDepth(float newValue)
     {
         mBitDepth = newValue;
@@ -128,13 +143,14 @@ private:
     float mCurrentSampleRate = 48000.0f;
 
     bool mIsBypassed = false;
-    float mTargetSampleRate = 8000.0f; // createNormalisableRange(1000.0f, 48000.0f, 8000.0f)
-    float mBitDepth = 4.0f; // NormalisableRange{ 1.0f, 12.0f, 1.0f }
+    std::atomic<float> mTargetSampleRate{ sampleRateDefaultValue };
+    std::atomic<float> mBitDepth{ bitDepthDefaultValue };
 
-    KrusherLofiResampleState resample_state{};
-    std::array<KrusherBitReducerFilterState, 2> brFilterStates{};
+    KrusherLofiResampleState mResampleState{};
+    std::vector<float> mHeldSamples;
+    std::vector<KrusherBitReducerFilterState> mFilterStates;
 
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> mDCBlockerHPF;
+    BiquadCascade<1> mDCBlockerHPF;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Bitcrusher)
 };
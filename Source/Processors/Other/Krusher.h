@@ -22,67 +22,91 @@
 */
 
 #pragma once
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cmath>
 #include <cstdint>
-#include <span>
+#include <limits>
 
+#include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+
+/*
+    The lofi resampler holds one input sample for every resample_factor
+    samples, the held sample being the one the hold starts on. The time of the
+    next hold is carried over from block to block, so the holds keep their
+    spacing whatever the block size, and the block is written a run of held
+    samples at a time. Nothing is kept but that time and the sample each
+    channel is holding, so it works in place.
+ */
 struct KrusherLofiResampleState
 {
-    double upsample_overshoot = 0.0;
-    double downsample_overshoot = 0.0;
+    // When the next hold starts, in samples from the start of the next block.
+    double next_hold_time = 0.0;
 };
 
-inline void krusher_init_lofi_resample(KrusherLofiResampleState* state)
-{
-    state->upsample_overshoot = 0.0;
-    state->downsample_overshoot = 0.0;
-}
-
 namespace krusher_detail
 {
-    inline void process_lofi_resample(float** source_buffer,
-        float** dest_buffer,
-        int num_channels,
-        int num_samples_source,
-        int num_samples_dest,
-        double resample_factor,
-        double& overshoot_samples)
+    // The first sample at or after a time, taking a time within rounding error
+    // of a whole sample as that sample, so that blocks of any size agree.
+    inline int get_hold_start(double time)
     {
-        // simple S&H lofi resampler
-        for (int channel = 0; channel < num_channels; ++channel)
-        {
-            const auto* source_data = source_buffer[channel];
-            auto* dest_data = dest_buffer[channel];
-
-            for (int i = 0; i < num_samples_dest; ++i)
-            {
-                const auto grab_index = (int)((double)i * resample_factor + overshoot_samples);
-                dest_data[i] = source_data[std::min(grab_index, num_samples_source - 1)];
-            }
-        }
-
-        overshoot_samples = (double)num_samples_dest * resample_factor - std::floor((double)num_samples_dest * resample_factor);
+        const auto whole = (int)time;
+        return time - (double)whole > 1.0e-9 ? whole + 1 : whole;
     }
 } // namespace krusher_detail
 
-inline void krusher_process_lofi_downsample([[maybe_unused]] void* ctx,
-    KrusherLofiResampleState* state,
-    float** buffer,
+inline void krusher_init_lofi_resample(KrusherLofiResampleState* state, float* held_samples, int num_channels)
+{
+    state->next_hold_time = 0.0;
+    std::fill(held_samples, held_samples + num_channels, 0.0f);
+}
+
+// held_samples has one sample for each channel, and resample_factor is at least 1.
+inline void krusher_process_lofi_downsample(KrusherLofiResampleState* state,
+    float* held_samples,
+    float* const* buffer,
     int num_channels,
     int num_samples,
     double resample_factor)
 {
-    const auto ds_buffer_size = (int)std::ceil((double)num_samples / resample_factor);
+    jassert(resample_factor >= 1.0);
+
+    auto next_hold_time = state->next_hold_time;
+
+    for (int channel = 0; channel < num_channels; ++channel)
+    {
+        auto* data = buffer[channel];
+        auto held_sample = held_samples[channel];
+        next_hold_time = state->next_hold_time;
+
+        for (int i = 0; i < num_samples;)
+        {
+            const auto hold_start = std::min(krusher_detail::get_hold_start(next_hold_time), num_samples);
+            std::fill(data + i, data + hold_start, held_sample);
+
+            if (hold_start == num_samples)
+                break;
 
-    auto* temp_data = (float*)alloca(2 * (size_t)ds_buffer_size * sizeof(float));
-    float* ds_buffer[2] = { temp_data, temp_data + ds_buffer_size };
+            held_sample = data[hold_start];
+            next_hold_time += resample_factor;
+            i = hold_start + 1;
+        }
+
+        held_samples[channel] = held_sample;
+    }
 
-    krusher_detail::process_lofi_resample(buffer, ds_buffer, num_channels, num_samples, ds_buffer_size, resample_factor, state->downsample_overshoot);
-    krusher_detail::process_lofi_resample(ds_buffer, buffer, num_channels, ds_buffer_size, num_samples, 1.0 / resample_factor, state->upsample_overshoot);
+    state->next_hold_time = next_hold_time - (double)num_samples;
 }
 
 //==============================================
+/*
+    The bit reducer encodes each block of 16 samples in the manner of BRR, at
+    the shift that loses the least, and decodes it through one of the filters.
+    The search goes through the block four samples to a register, and only the
+    filters, which feed back from one sample to the next, run a sample at a time.
+ */
 struct KrusherBitReducerFilterState
 {
     int32_t p1{};
@@ -110,162 +134,258 @@ namespace krusher_detail
         0x7FFF, // 15
     };
 
-    struct Bit_Reduction_Block
+    static constexpr int small_block_size = 16;
+
+    // The samples of one block as 16 bit values, one to a 32 bit lane so that
+    // four go through a register at a time, with the end of a short block zeroed.
+    struct alignas(16) Small_Block : std::array<int32_t, small_block_size> {};
+
+    // Encoding a sample at a shift keeps the bit_depth bits above the shift
+    // of the sample offset by 256, so decoding it again is masking those bits.
+    inline int32_t get_shift_mask(int shift, int bit_depth)
     {
-        uint8_t shift_amount{};
-        std::array<uint16_t, 16> data{};
-    };
+        return (int32_t)BIT_MASKS[bit_depth] << shift;
+    }
+
+    inline int32_t decode_sample(int32_t mask, int32_t x)
+    {
+        return (int16_t)(((x + (1 << 8)) & mask) - (1 << 8));
+    }
+
+#if SUPERTONAL_FAST_MATH_SSE2
+    inline __m128i decode_samples(__m128i mask, __m128i x)
+    {
+        const auto offset = _mm_set1_epi32(1 << 8);
+        const auto masked = _mm_sub_epi32(_mm_and_si128(_mm_add_epi32(x, offset), mask), offset);
+        return _mm_srai_epi32(_mm_slli_epi32(masked, 16), 16);
+    }
+#endif
+
+    // The squared error of the block encoded with a shift's mask. Each error is
+    // under 2^16, so the squares are exact in 64 bits.
+    inline uint64_t get_squared_error(const Small_Block& PCM_data, int32_t mask)
+    {
+#if SUPERTONAL_FAST_MATH_SSE2
+        const auto masks = _mm_set1_epi32(mask);
+        auto err_sq_accum = _mm_setzero_si128();
+
+        for (int i = 0; i < small_block_size; i += 4)
+        {
+            const auto x = _mm_load_si128(reinterpret_cast<const __m128i*>(PCM_data.data() + i));
+
+            // SSE2 only multiplies unsigned 32 bit lanes into 64 bits, and only
+            // the even ones, so the errors are made positive and the odd ones
+            // moved down.
+            const auto err = _mm_sub_epi32(x, decode_samples(masks, x));
+            const auto sign = _mm_srai_epi32(err, 31);
+            const auto err_abs = _mm_sub_epi32(_mm_xor_si128(err, sign), sign);
+            const auto err_abs_odd = _mm_srli_epi64(err_abs, 32);
+
+            err_sq_accum = _mm_add_epi64(err_sq_accum, _mm_mul_epu32(err_abs, err_abs));
+            err_sq_accum = _mm_add_epi64(err_sq_accum, _mm_mul_epu32(err_abs_odd, err_abs_odd));
+        }
+
+        alignas(16) uint64_t sums[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(sums), err_sq_accum);
+        return sums[0] + sums[1];
+#else
+        uint64_t err_sq_accum = 0;
+
+        for (int i = 0; i < small_block_size; ++i)
+        {
+            const auto err = (uint32_t)std::abs(PCM_data[i] - decode_sample(mask, PCM_data[i]));
+            err_sq_accum += (uint64_t)err * err;
+        }
+
+        return err_sq_accum;
+#endif
+    }
 
-    inline uint16_t encode_sample(uint8_t shift, int bit_depth, int16_t x)
+    // The shift that encodes the block with the least squared error, the
+    // smallest of those on a tie. Once the shift keeps every sample's top bit,
+    // the error is only the bits below it, so the larger shifts are not tried.
+    // Going down from there, the largest sample loses more of its top bits at
+    // each shift, and once those alone cost more than the best so far, so does
+    // every smaller shift. That holds unless a sample is below -256, which
+    // wraps around when offset.
+    inline int find_best_shift(const Small_Block& PCM_data, int bit_depth)
     {
-        const auto value_unsigned = (uint16_t)(x + (1 << 8));
-        return (uint16_t)(value_unsigned >> shift) & BIT_MASKS[bit_depth];
+        uint32_t all_bits = 0;
+        int32_t largest = 0;
+        int32_t smallest = 0;
+
+        for (int i = 0; i < small_block_size; ++i)
+        {
+            const auto offset_sample = PCM_data[i] + (1 << 8);
+            all_bits |= (uint32_t)(offset_sample & 0xFFFF);
+            largest = std::max(largest, offset_sample);
+            smallest = std::min(smallest, offset_sample);
+        }
+
+        const auto last_shift = std::max(0, (int)std::bit_width(all_bits) - bit_depth);
+        const auto can_stop_early = smallest >= 0;
+
+        int shift_best = 0;
+        auto err_min = std::numeric_limits<uint64_t>::max();
+
+        for (int s = last_shift; s >= 0; --s)
+        {
+            if (can_stop_early)
+            {
+                const auto lost = (uint64_t)(largest & ~((1 << (s + bit_depth)) - 1));
+                if (lost * lost > err_min)
+                    break;
+            }
+
+            const auto err_sq_accum = get_squared_error(PCM_data, get_shift_mask(s, bit_depth));
+
+            if (err_sq_accum <= err_min)
+            {
+                err_min = err_sq_accum;
+                shift_best = s;
+            }
+        }
+
+        return shift_best;
     }
 
-    inline int16_t decode_sample(uint8_t shift, uint16_t x)
+    template <typename Filter>
+    inline void apply_filter(Small_Block& data, int num_samples, Filter&& filter)
     {
-        return (int16_t)((uint16_t)(x << shift) - (1 << 8));
+        for (int i = 0; i < num_samples; ++i)
+            data[i] = filter(data[i]);
     }
 
-    inline void bit_reduce_decode(const Bit_Reduction_Block& br_block,
-        std::span<int16_t> out,
+    inline void bit_reduce_decode(Small_Block& data,
+        int num_samples,
+        int shift,
+        int bit_depth,
         int filter,
         KrusherBitReducerFilterState& state)
     {
-        uint8_t shift_amount = br_block.shift_amount;
+        const auto mask = get_shift_mask(shift, bit_depth);
+
+#if SUPERTONAL_FAST_MATH_SSE2
+        const auto masks = _mm_set1_epi32(mask);
+        for (int i = 0; i < small_block_size; i += 4)
+        {
+            auto* x = reinterpret_cast<__m128i*>(data.data() + i);
+            _mm_store_si128(x, decode_samples(masks, _mm_load_si128(x)));
+        }
+#else
+        for (int i = 0; i < small_block_size; ++i)
+            data[i] = decode_sample(mask, data[i]);
+#endif
 
-        const auto type1_filter = [&state](int16_t nibble_2r)
+        const auto type1_filter = [&state](int32_t nibble_2r)
         {
-            const auto y = int32_t(nibble_2r) + ((state.p1 * 15) >> 4);
+            const auto y = nibble_2r + ((state.p1 * 15) >> 4);
             state.p2 = 0;
             state.p1 = y;
-            return (int16_t)(y >> 4);
+            return (int32_t)(int16_t)(y >> 4);
         };
 
-        const auto type2_filter = [&state](int16_t nibble_2r)
+        const auto type2_filter = [&state](int32_t nibble_2r)
         {
-            const auto y = int32_t(nibble_2r) + ((state.p1 * 61) >> 5) - ((state.p2 * 15) >> 4);
+            const auto y = nibble_2r + ((state.p1 * 61) >> 5) - ((state.p2 * 15) >> 4);
             state.p2 = state.p1;
             state.p1 = y;
-            return (int16_t)(y >> 5);
+            return (int32_t)(int16_t)(y >> 5);
         };
 
-        const auto type3_filter = [&state](int16_t nibble_2r)
+        const auto type3_filter = [&state](int32_t nibble_2r)
         {
-            const auto y = int32_t(nibble_2r) + ((state.p1 * 115) >> 6) - ((state.p2 * 13) >> 4);
+            const auto y = nibble_2r + ((state.p1 * 115) >> 6) - ((state.p2 * 13) >> 4);
             state.p2 = state.p1;
             state.p1 = y;
-            return (int16_t)(y >> 6);
+            return (int32_t)(int16_t)(y >> 6);
         };
 
-        for (size_t i = 0; i < 16; ++i)
+        switch (filter)
         {
-            if (i >= out.size())
-                break;
+        case 1:
+            apply_filter(data, num_samples, type1_filter);
+            break;
 
-            const auto brr_sample = br_block.data[i];
+        case 2:
+            apply_filter(data, num_samples, type2_filter);
+            break;
 
-            switch (filter)
-            {
-            case 0:
-                out[i] = decode_sample(shift_amount, brr_sample);
-                break;
-
-            case 1:
-                out[i] = type1_filter(decode_sample(shift_amount, brr_sample));
-                break;
-
-            case 2:
-                out[i] = type2_filter(decode_sample(shift_amount, brr_sample));
-                break;
+        case 3:
+            apply_filter(data, num_samples, type3_filter);
+            break;
 
-            case 3:
-                out[i] = type3_filter(decode_sample(shift_amount, brr_sample));
-                break;
-
-            default:
-                break;
-            }
+        default:
+            break;
         }
     }
 
-    inline Bit_Reduction_Block bit_reduce_encode(std::span<const int16_t> PCM_data, int bit_depth)
+    inline void convert_float_to_int(const float* data_float, int num_samples, Small_Block& data_int)
     {
-        uint8_t shift_best = 0;
-        double err_min = std::numeric_limits<double>::max();
-
-        for (uint8_t s = 0; s < uint8_t(16 - bit_depth + 1); ++s)
+        if (num_samples < small_block_size)
         {
-            auto err_sq_accum = 0.0;
-            for (size_t i = 0; i < 16; ++i)
-            {
-                const auto pred = decode_sample(s, encode_sample(s, bit_depth, PCM_data[i]));
-                const auto err = double(PCM_data[i] - pred);
-                err_sq_accum += err * err;
-            }
-
-            if (err_sq_accum < err_min)
-            {
-                err_min = err_sq_accum;
-                shift_best = s;
-            }
+            std::array<float, small_block_size> padded{};
+            std::copy(data_float, data_float + num_samples, padded.begin());
+            convert_float_to_int(padded.data(), small_block_size, data_int);
+            return;
         }
 
-        Bit_Reduction_Block brr{};
-        brr.shift_amount = shift_best;
-        for (size_t i = 0; i < 16; ++i)
-            brr.data[i] = encode_sample(shift_best, bit_depth, PCM_data[i]);
-
-        return brr;
+#if SUPERTONAL_FAST_MATH_SSE2
+        for (int i = 0; i < small_block_size; i += 4)
+        {
+            const auto scaled = _mm_mul_ps(_mm_loadu_ps(data_float + i), _mm_set1_ps(float(1 << 8)));
+            const auto limited = _mm_min_ps(_mm_max_ps(scaled, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+            _mm_store_si128(reinterpret_cast<__m128i*>(data_int.data() + i), _mm_cvttps_epi32(limited));
+        }
+#else
+        for (int i = 0; i < small_block_size; ++i)
+            data_int[i] = (int32_t)juce::jlimit(-32768.0f, 32767.0f, data_float[i] * float(1 << 8));
+#endif
     }
 
-    inline void convert_float_to_int(std::span<const float> dataFloat, std::span<int16_t> dataInt)
+    inline void convert_int_to_float(const Small_Block& data_int, int num_samples, float* data_float)
     {
-        for (size_t i = 0; i < dataFloat.size(); ++i)
-            dataInt[i] = int16_t(dataFloat[i] * float(1 << 8));
-    }
+        int i = 0;
 
-    inline void convert_int_to_float(std::span<const int16_t> dataInt, std::span<float> dataFloat)
-    {
-        for (size_t i = 0; i < dataFloat.size(); ++i)
-            dataFloat[i] = ((float)dataInt[i]) / float(1 << 8);
+#if SUPERTONAL_FAST_MATH_SSE2
+        for (; i + 4 <= num_samples; i += 4)
+        {
+            const auto x = _mm_load_si128(reinterpret_cast<const __m128i*>(data_int.data() + i));
+            _mm_storeu_ps(data_float + i, _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / float(1 << 8))));
+        }
+#endif
+
+        for (; i < num_samples; ++i)
+            data_float[i] = (float)data_int[i] * (1.0f / float(1 << 8));
     }
 } // namespace krusher_detail
 
-inline void krusher_bit_reduce_process_block(float** buffer,
+// filter_states has one state for each channel.
+inline void krusher_bit_reduce_process_block(float* const* buffer,
     int32_t num_channels,
     int32_t num_samples,
     int32_t filter_index,
     int32_t bit_depth,
     KrusherBitReducerFilterState* filter_states)
 {
-    static constexpr size_t small_block_size = 16;
-    std::array<int16_t, small_block_size> samples_int{};
+    krusher_detail::Small_Block samples_int;
 
     for (int channel = 0; channel < num_channels; ++channel)
     {
-        auto samples_remaining = num_samples;
-        while (samples_remaining > 0)
+        for (int offset = 0; offset < num_samples; offset += krusher_detail::small_block_size)
         {
-            const auto samples_to_process = std::min(samples_remaining, (int)small_block_size);
-
-            std::span<float> samples_float_span{ buffer[channel] + num_samples - samples_remaining, (size_t)samples_to_process };
-            std::fill(samples_int.begin(), samples_int.end(), 0);
-            std::span<int16_t> samples_int_span{ samples_int.data(), (size_t)samples_to_process };
+            auto* samples_float = buffer[channel] + offset;
+            const auto samples_to_process = std::min(num_samples - offset, krusher_detail::small_block_size);
 
-            krusher_detail::convert_float_to_int(samples_float_span, samples_int_span);
+            krusher_detail::convert_float_to_int(samples_float, samples_to_process, samples_int);
 
             if (bit_depth < 12)
             {
-                const auto br_data = krusher_detail::bit_reduce_encode(samples_int_span, bit_depth);
-                krusher_detail::bit_reduce_decode(br_data, samples_int_span, filter_index, filter_states[channel]);
+                const auto shift = krusher_detail::find_best_shift(samples_int, bit_depth);
+                krusher_detail::bit_reduce_decode(samples_int, samples_to_process, shift, bit_depth, filter_index, filter_states[channel]);
             }
 
-            krusher_detail::convert_int_to_float(samples_int_span, samples_float_span);
-
-            samples_remaining -= samples_to_process;
+            krusher_detail::convert_int_to_float(samples_int, samples_to_process, samples_float);
         }
     }
 }
-
-
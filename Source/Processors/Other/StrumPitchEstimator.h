@@ -0,0 +1,395 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+	The pitches of all six strings of a guitar in standard tuning from one strum,
+	by estimating and cancelling one string at a time, after Klapuri's summing of
+	harmonic amplitudes.
+
+	Each string is looked for within searchRangeInCents of its open note, on a
+	grid spaced evenly in cents, which is the log frequency spectrum the sums are
+	taken over. The string whose harmonics sum highest in what is left of the
+	spectrum is taken first, and its partials taken out of the spectrum before
+	the next is looked for. The
+	amplitude taken out of each partial is no more than the average of it and
+	its neighbours, so a partial that another string shares, which standard
+	tuning has plenty of, keeps most of that string's part in it.
+
+	With all the strings found, each one's frequency is refined from the peaks
+	of those of its partials no other string found shares, or of all of them
+	when none are its own.
+
+	All its buffers and the FFT plan are made in the constructor, so process()
+	allocates nothing.
+ */
+class StrumPitchEstimator
+{
+public:
+	static constexpr int numStrings = 6;
+	// E2, A2, D3, G3, B3 and E4.
+	static constexpr std::array<float, numStrings> openStringFrequencies = { 82.407f, 110.0f, 146.832f, 195.998f, 246.942f, 329.628f };
+	// About a second at the tuner's analysis rate, which is as short as it can be
+	// and still tell apart the partials that strings a little out of tune share.
+	static constexpr int windowSize = 8192;
+
+	StrumPitchEstimator()
+	{
+		mFFT.init(static_cast<size_t>(fftSize));
+
+		for (int i = 0; i < windowSize; ++i)
+		{
+			mHannWindow[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / windowSize);
+		}
+
+		for (int offset = 0; offset <= lobeTableSize; ++offset)
+		{
+			mLobeTable[static_cast<size_t>(offset)] = getHannLobe(static_cast<float>(offset) / lobeTableResolution);
+		}
+	}
+
+	// The sample rate of what process() is given, which must be at least twice
+	// maximumPartialFrequency.
+	void prepare(double sampleRate)
+	{
+		mBinFrequency = static_cast<float>(sampleRate / fftSize);
+	}
+
+	// samples are the latest windowSize, oldest first. Writes each string's
+	// frequency in Hz to frequencies, or 0 where none was found.
+	void process(const float* samples, std::array<float, numStrings>& frequencies)
+	{
+		frequencies.fill(0.0f);
+
+		double energy = 0.0;
+
+		for (int i = 0; i < windowSize; ++i)
+		{
+			const auto sample = samples[i];
+			energy += static_cast<double>(sample) * sample;
+			mFrame[static_cast<size_t>(i)] = sample * mHannWindow[static_cast<size_t>(i)];
+		}
+
+		if (energy < windowSize * static_cast<double>(silenceLevel) * silenceLevel)
+		{
+			return;
+		}
+
+		std::fill(mFrame.begin() + windowSize, mFrame.end(), 0.0f);
+		mFFT.fft(mFrame.data(), mReal.data(), mImaginary.data());
+
+		for (size_t bin = 0; bin < mMagnitudes.size(); ++bin)
+		{
+			mMagnitudes[bin] = std::sqrt(mReal[bin] * mReal[bin] + mImaginary[bin] * mImaginary[bin]);
+		}
+
+		mResidual = mMagnitudes;
+
+		mFoundFrequencies.fill(0.0f);
+		auto firstSalience = 0.0f;
+
+		for (int iteration = 0; iteration < numStrings; ++iteration)
+		{
+			auto bestString = -1;
+			auto bestSalience = 0.0f;
+			auto bestFrequency = 0.0f;
+
+			for (int string = 0; string < numStrings; ++string)
+			{
+				if (mFoundFrequencies[static_cast<size_t>(string)] > 0.0f)
+				{
+					continue;
+				}
+
+				for (int step = -numSearchSteps; step <= numSearchSteps; ++step)
+				{
+					const auto frequency = openStringFrequencies[static_cast<size_t>(string)]
+						* std::exp2(static_cast<float>(step * searchStepInCents) / 1200.0f);
+					const auto salience = getSalience(frequency);
+
+					if (salience > bestSalience)
+					{
+						bestString = string;
+						bestSalience = salience;
+						bestFrequency = frequency;
+					}
+				}
+			}
+
+			if (iteration == 0)
+			{
+				firstSalience = bestSalience;
+			}
+
+			// What is left is noise, or partials of the strings already found.
+			if (bestString < 0 || bestSalience < minimumRelativeSalience * firstSalience)
+			{
+				break;
+			}
+
+			mFoundFrequencies[static_cast<size_t>(bestString)] = bestFrequency;
+			cancelPartials(bestFrequency);
+		}
+
+		// Once every string is found, what each shares with the others is known,
+		// so each is refined from the partials it has to itself where it has any.
+		mResidual = mMagnitudes;
+
+		for (int string = 0; string < numStrings; ++string)
+		{
+			if (mFoundFrequencies[static_cast<size_t>(string)] > 0.0f)
+			{
+				frequencies[static_cast<size_t>(string)] = refineFrequency(string, mFoundFrequencies[static_cast<size_t>(string)]);
+			}
+		}
+	}
+
+private:
+	static constexpr int fftSize = 2 * windowSize;
+	static constexpr int numBins = fftSize / 2 + 1;
+	static constexpr int searchRangeInCents = 100;
+	static constexpr int searchStepInCents = 2;
+	static constexpr int numSearchSteps = searchRangeInCents / searchStepInCents;
+	static constexpr int maximumNumPartials = 10;
+	// Below the tuner's anti-aliasing filter.
+	static constexpr float maximumPartialFrequency = 1800.0f;
+	// Klapuri's weighting of the partials, in Hz, which favours the lower ones.
+	static constexpr float partialWeightOffset = 27.0f;
+	static constexpr float partialWeightScale = 320.0f;
+	// Of the first string's salience, what another must reach to count as sounding.
+	static constexpr float minimumRelativeSalience = 0.1f;
+	// An RMS below -60 dBFS is taken as silence.
+	static constexpr float silenceLevel = 0.001f;
+	// The main lobe of a partial is two bins of the unpadded transform either
+	// side of its peak, and so four of the padded one.
+	static constexpr int lobeHalfWidthInBins = 4;
+	static constexpr int lobeTableResolution = 64;
+	static constexpr int lobeTableSize = lobeHalfWidthInBins / 2 * lobeTableResolution;
+
+	audiofft::AudioFFT mFFT;
+	std::array<float, windowSize> mHannWindow{};
+	std::array<float, lobeTableSize + 1> mLobeTable{};
+	std::array<float, fftSize> mFrame{};
+	std::array<float, numBins> mReal{};
+	std::array<float, numBins> mImaginary{};
+	std::array<float, numBins> mMagnitudes{};
+	// The magnitude spectrum, less the partials of the strings found so far.
+	std::array<float, numBins> mResidual{};
+	std::array<float, maximumNumPartials + 1> mPartialAmplitudes{};
+	std::array<float, maximumNumPartials + 1> mPartialCentres{};
+	// The frequency on the search grid of each string found so far, or 0.
+	std::array<float, numStrings> mFoundFrequencies{};
+
+	float mBinFrequency = 1.0f;
+
+	// The magnitude of the Hann window's spectrum offset bins of the unpadded
+	// transform from its peak, relative to the peak, within the main lobe.
+	static float getHannLobe(float offset)
+	{
+		if (offset == 0.0f)
+		{
+			return 1.0f;
+		}
+
+		if (std::abs(offset) == 1.0f)
+		{
+			return 0.5f;
+		}
+
+		const auto angle = juce::MathConstants<float>::pi * offset;
+		return std::abs(std::sin(angle) / (angle * (1.0f - offset * offset)));
+	}
+
+	// The lobe offset bins of the padded spectrum from its peak, which are half
+	// as many of the unpadded one.
+	float getLobe(float offset) const
+	{
+		const auto tableIndex = juce::roundToInt(std::abs(offset) * lobeTableResolution * 0.5f);
+		return tableIndex < lobeTableSize ? mLobeTable[static_cast<size_t>(tableIndex)] : 0.0f;
+	}
+
+	int getNumPartials(float frequency) const
+	{
+		return juce::jlimit(1, maximumNumPartials, static_cast<int>(maximumPartialFrequency / frequency));
+	}
+
+	float getPartialWeight(float frequency, int partial) const
+	{
+		return (frequency + partialWeightOffset) / (partial * frequency + partialWeightScale);
+	}
+
+	// The highest bin of the residual within one of the nearest to frequency,
+	// which the search grid is fine enough to land within.
+	int findPeakBin(float frequency) const
+	{
+		const auto centre = juce::jlimit(1, numBins - 2, juce::roundToInt(frequency / mBinFrequency));
+		auto peak = centre;
+
+		for (int bin = centre - 1; bin <= centre + 1; bin += 2)
+		{
+			if (mResidual[static_cast<size_t>(bin)] > mResidual[static_cast<size_t>(peak)])
+			{
+				peak = bin;
+			}
+		}
+
+		return peak;
+	}
+
+	bool isPeak(int bin) const
+	{
+		return mResidual[static_cast<size_t>(bin)] > mResidual[static_cast<size_t>(bin - 1)]
+			&& mResidual[static_cast<size_t>(bin)] >= mResidual[static_cast<size_t>(bin + 1)];
+	}
+
+	// The weighted sum of the partials of frequency, counting only those that
+	// are peaks, so the flank of a partial nearby, or of the fundamental of a
+	// string that is a little out, adds nothing.
+	float getSalience(float frequency) const
+	{
+		auto salience = 0.0f;
+		const auto numPartials = getNumPartials(frequency);
+
+		for (int partial = 1; partial <= numPartials; ++partial)
+		{
+			const auto bin = findPeakBin(partial * frequency);
+
+			if (isPeak(bin))
+			{
+				salience += getPartialWeight(frequency, partial) * mResidual[static_cast<size_t>(bin)];
+			}
+		}
+
+		return salience;
+	}
+
+	// The fractional bin of the top of the parabola through the log magnitudes
+	// of a peak and its neighbours, which for the Hann window is close to the
+	// partial's frequency.
+	float interpolatePeak(int bin) const
+	{
+		const auto before = std::log(mResidual[static_cast<size_t>(bin - 1)] + 1.0e-9f);
+		const auto peak = std::log(mResidual[static_cast<size_t>(bin)] + 1.0e-9f);
+		const auto after = std::log(mResidual[static_cast<size_t>(bin + 1)] + 1.0e-9f);
+		const auto curvature = before - 2.0f * peak + after;
+
+		return curvature < 0.0f
+			? static_cast<float>(bin) + juce::jlimit(-0.5f, 0.5f, 0.5f * (before - after) / curvature)
+			: static_cast<float>(bin);
+	}
+
+	// Whether a partial at frequency is near one of another string found.
+	bool isShared(int string, float frequency) const
+	{
+		const auto margin = lobeHalfWidthInBins * mBinFrequency;
+
+		for (int other = 0; other < numStrings; ++other)
+		{
+			const auto foundFrequency = mFoundFrequencies[static_cast<size_t>(other)];
+
+			if (other == string || foundFrequency == 0.0f)
+			{
+				continue;
+			}
+
+			for (int partial = 1; partial <= getNumPartials(foundFrequency); ++partial)
+			{
+				if (std::abs(frequency - partial * foundFrequency) < margin)
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// The average of the frequencies its partials give, each divided by its
+	// number, weighted by how much it sums to the salience and by its number,
+	// since a higher partial pins the fundamental down more finely. Partials
+	// another string could share are left out if there are any others.
+	float refineFrequency(int string, float frequency)
+	{
+		const auto numPartials = getNumPartials(frequency);
+		std::array<float, 2> weightedSums{};
+		std::array<float, 2> totalWeights{};
+
+		for (int partial = 1; partial <= numPartials; ++partial)
+		{
+			const auto bin = findPeakBin(partial * frequency);
+
+			if (!isPeak(bin))
+			{
+				continue;
+			}
+
+			const auto isClean = isShared(string, partial * frequency) ? 0 : 1;
+			const auto weight = partial * getPartialWeight(frequency, partial) * mResidual[static_cast<size_t>(bin)];
+			weightedSums[static_cast<size_t>(isClean)] += weight * interpolatePeak(bin) * mBinFrequency / partial;
+			totalWeights[static_cast<size_t>(isClean)] += weight;
+		}
+
+		if (totalWeights[1] > 0.0f)
+		{
+			return weightedSums[1] / totalWeights[1];
+		}
+
+		return totalWeights[0] > 0.0f ? weightedSums[0] / totalWeights[0] : frequency;
+	}
+
+	// Takes the string's partials out of the residual, each no further than the
+	// average of it and its neighbours, so that where another string shares a
+	// partial, which stands out above its neighbours, what that string put in it
+	// mostly stays.
+	void cancelPartials(float frequency)
+	{
+		const auto numPartials = getNumPartials(frequency);
+
+		for (int partial = 1; partial <= numPartials; ++partial)
+		{
+			const auto bin = findPeakBin(partial * frequency);
+			const auto centre = interpolatePeak(bin);
+			mPartialCentres[static_cast<size_t>(partial)] = centre;
+			mPartialAmplitudes[static_cast<size_t>(partial)] = mResidual[static_cast<size_t>(bin)] / getLobe(static_cast<float>(bin) - centre);
+		}
+
+		for (int partial = 1; partial <= numPartials; ++partial)
+		{
+			// Neither end has a neighbour beyond it, so it stands in for its own.
+			const auto amplitude = mPartialAmplitudes[static_cast<size_t>(partial)];
+			const auto below = mPartialAmplitudes[static_cast<size_t>(juce::jmax(1, partial - 1))];
+			const auto above = mPartialAmplitudes[static_cast<size_t>(juce::jmin(numPartials, partial + 1))];
+			const auto cancelled = juce::jmin(amplitude, (below + amplitude + above) / 3.0f);
+
+			const auto centre = mPartialCentres[static_cast<size_t>(partial)];
+			const auto first = juce::jmax(0, static_cast<int>(std::ceil(centre)) - lobeHalfWidthInBins);
+			const auto last = juce::jmin(numBins - 1, static_cast<int>(std::floor(centre)) + lobeHalfWidthInBins);
+
+			for (int bin = first; bin <= last; ++bin)
+			{
+				auto& residual = mResidual[static_cast<size_t>(bin)];
+				residual = juce::jmax(0.0f, residual - cancelled * getLobe(static_cast<float>(bin) - centre));
+			}
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StrumPitchEstimator)
+};
@@ -0,0 +1,418 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StrumPitchEstimator.h"
+
+/*
+	The tuner's pitch detection, on a low priority thread of its own, so that all
+	the audio thread does for it is copy its first channel into a single
+	producer, single consumer ring.
+
+	The worker wakes publishRateHz times a second and takes whatever has
+	arrived. It lowpasses that and keeps one sample in every few, so it
+	runs at around 8 kHz, which is plenty for the fundamentals of a guitar or a
+	bass. Then it finds the pitch of the latest window with the McLeod pitch
+	method, the autocorrelation coming from audio_fft. A block the ring has no
+	room for, because the worker has fallen behind, is dropped.
+
+	In strum mode it also finds the pitch of every string from the latest second,
+	once every strumHopSize samples after decimation and at most once a wake, so
+	however far behind it falls it does no more than that.
+ */
+class TunerAnalyser : private juce::Thread
+{
+public:
+	static constexpr int publishRateHz = 20;
+	// A bass's low E, up to well past the top fret of a guitar.
+	static constexpr float minimumFrequency = 40.0f;
+	static constexpr float maximumFrequency = 1500.0f;
+
+	TunerAnalyser() :
+		juce::Thread("Tuner Analyser")
+	{
+		mFFT.init(static_cast<size_t>(fftSize));
+		mKeyMaxima.reserve(windowSize / 2);
+		startThread(juce::Thread::Priority::low);
+	}
+
+	~TunerAnalyser() override
+	{
+		stopThread(stopTimeoutMilliseconds);
+	}
+
+	// Message thread, with the audio thread stopped.
+	void prepare(const juce::dsp::ProcessSpec& spec)
+	{
+		const juce::ScopedLock lock(mAnalysisLock);
+
+		const auto ringSize = juce::roundToInt(spec.sampleRate * ringLengthInSeconds) + static_cast<int>(spec.maximumBlockSize);
+		mRing.assign(static_cast<size_t>(ringSize), 0.0f);
+		mRingFifo.setTotalSize(ringSize);
+
+		mDecimationFactor = juce::jmax(1, static_cast<int>(spec.sampleRate / targetAnalysisSampleRate));
+		mAnalysisSampleRate = spec.sampleRate / mDecimationFactor;
+		mStrumPitchEstimator.prepare(mAnalysisSampleRate);
+
+		for (size_t section = 0; section < mAntiAliasingFilters.size(); ++section)
+		{
+			mAntiAliasingFilters[section].setCoefficients(juce::IIRCoefficients::makeLowPass(
+				spec.sampleRate,
+				mAnalysisSampleRate * antiAliasingFrequencyRatio,
+				antiAliasingQualities[section]));
+		}
+
+		resetAnalysis();
+	}
+
+	// Audio thread.
+	void push(const juce::AudioBuffer<float>& buffer)
+	{
+		if (buffer.getNumChannels() == 0 || mRing.empty())
+		{
+			return;
+		}
+
+		int startIndex1, blockSize1, startIndex2, blockSize2;
+		mRingFifo.prepareToWrite(buffer.getNumSamples(), startIndex1, blockSize1, startIndex2, blockSize2);
+
+		if (blockSize1 + blockSize2 < buffer.getNumSamples())
+		{
+			return;
+		}
+
+		const auto* samples = buffer.getReadPointer(0);
+		std::copy(samples, samples + blockSize1, mRing.data() + startIndex1);
+		std::copy(samples + blockSize1, samples + blockSize1 + blockSize2, mRing.data() + startIndex2);
+		mRingFifo.finishedWrite(blockSize1 + blockSize2);
+	}
+
+	// Any thread. The pitch of the latest window in Hz, or 0 when it has none.
+	float getPitch() const
+	{
+		return mPitch.load();
+	}
+
+	// Any thread.
+	void setIsStrumOn(bool isStrumOn)
+	{
+		mIsStrumOn.store(isStrumOn);
+	}
+
+	// Any thread. The pitch of a string, from the lowest, in Hz, or 0 when it is
+	// not sounding or strum mode is off.
+	float getStringPitch(int string) const
+	{
+		jassert(juce::isPositiveAndBelow(string, StrumPitchEstimator::numStrings));
+		return mStringPitches[static_cast<size_t>(string)].load();
+	}
+
+private:
+	static constexpr int stopTimeoutMilliseconds = 1000;
+	// Several wakes' worth, so a late one loses nothing.
+	static constexpr double ringLengthInSeconds = 0.25;
+	static constexpr int numEmptyWakesBeforeReset = 5;
+	static constexpr double targetAnalysisSampleRate = 8000.0;
+	// A fourth order Butterworth lowpass at a quarter of the analysis rate.
+	static constexpr double antiAliasingFrequencyRatio = 0.25;
+	static constexpr std::array<double, 2> antiAliasingQualities = { 0.54119610, 1.3065630 };
+	// 64 ms at 8 kHz, so the lowest frequency has two periods in it.
+	static constexpr int windowSize = 512;
+	// The autocorrelation of the window without wrapping around.
+	static constexpr int fftSize = 2 * windowSize;
+	// A quarter of a second at the analysis rate.
+	static constexpr int strumHopSize = 2048;
+	static constexpr int historySize = juce::jmax(windowSize, StrumPitchEstimator::windowSize);
+	// Of the highest peak of the normalised autocorrelation, what the peak taken
+	// must reach, as McLeod and Wyvill suggest. The first that does is taken, so
+	// a peak at twice the period that is a little higher loses to it.
+	static constexpr float peakThreshold = 0.93f;
+	// A window whose highest peak is lower than this holds no clear note.
+	static constexpr float minimumClarity = 0.7f;
+	// An RMS below -60 dBFS is taken as silence.
+	static constexpr float silenceLevel = 0.001f;
+
+	juce::CriticalSection mAnalysisLock;
+	std::vector<float> mRing;
+	juce::AbstractFifo mRingFifo{ 1 };
+
+	int mNumEmptyWakes = 0;
+	int mDecimationFactor = 1;
+	int mDecimationPhase = 0;
+	double mAnalysisSampleRate = targetAnalysisSampleRate;
+	std::array<juce::IIRFilter, antiAliasingQualities.size()> mAntiAliasingFilters;
+
+	// The latest historySize samples after decimation, oldest first from the
+	// write position.
+	std::array<float, historySize> mHistory{};
+	int mHistoryWritePosition = 0;
+	int mNumHistorySamples = 0;
+	int mNumSamplesSinceStrum = 0;
+
+	audiofft::AudioFFT mFFT;
+	std::array<float, fftSize> mWindow{};
+	std::array<float, fftSize / 2 + 1> mReal{};
+	std::array<float, fftSize / 2 + 1> mImaginary{};
+	std::array<float, fftSize> mAutocorrelation{};
+	std::array<float, windowSize / 2 + 2> mNormalisedAutocorrelation{};
+	std::vector<int> mKeyMaxima;
+
+	StrumPitchEstimator mStrumPitchEstimator;
+	std::array<float, StrumPitchEstimator::windowSize> mStrumWindow{};
+	std::array<float, StrumPitchEstimator::numStrings> mStrumFrequencies{};
+
+	std::atomic<float> mPitch{ 0.0f };
+	std::atomic<bool> mIsStrumOn{ false };
+	std::array<std::atomic<float>, StrumPitchEstimator::numStrings> mStringPitches{};
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			wait(1000 / publishRateHz);
+
+			const juce::ScopedLock lock(mAnalysisLock);
+
+			if (takeFromRing() == 0)
+			{
+				// Nothing arrives while the tuner is off, and what is left from
+				// before it was switched off is no use once it is back on. A
+				// host block can be longer than a wake, so a single empty one
+				// says nothing.
+				if (++mNumEmptyWakes == numEmptyWakesBeforeReset)
+				{
+					resetAnalysis();
+				}
+
+				continue;
+			}
+
+			mNumEmptyWakes = 0;
+			mPitch.store(mNumHistorySamples >= windowSize ? findPitch() : 0.0f);
+
+			if (!mIsStrumOn.load())
+			{
+				clearStringPitches();
+			}
+			else if (mNumHistorySamples == historySize && mNumSamplesSinceStrum >= strumHopSize)
+			{
+				mNumSamplesSinceStrum = 0;
+				findStringPitches();
+			}
+		}
+	}
+
+	void resetAnalysis()
+	{
+		for (auto& filter : mAntiAliasingFilters)
+		{
+			filter.reset();
+		}
+
+		mNumEmptyWakes = 0;
+		mDecimationPhase = 0;
+		mHistoryWritePosition = 0;
+		mNumHistorySamples = 0;
+		mNumSamplesSinceStrum = 0;
+		mPitch.store(0.0f);
+		clearStringPitches();
+	}
+
+	void clearStringPitches()
+	{
+		for (auto& pitch : mStringPitches)
+		{
+			pitch.store(0.0f);
+		}
+	}
+
+	void findStringPitches()
+	{
+		copyLatest(mStrumWindow.data(), StrumPitchEstimator::windowSize);
+		mStrumPitchEstimator.process(mStrumWindow.data(), mStrumFrequencies);
+
+		for (size_t string = 0; string < mStringPitches.size(); ++string)
+		{
+			mStringPitches[string].store(mStrumFrequencies[string]);
+		}
+	}
+
+	// The latest numSamples of the history, oldest first.
+	void copyLatest(float* destination, int numSamples) const
+	{
+		const auto start = (mHistoryWritePosition - numSamples + historySize) % historySize;
+		const auto numBeforeWrap = juce::jmin(numSamples, historySize - start);
+		std::copy(mHistory.begin() + start, mHistory.begin() + start + numBeforeWrap, destination);
+		std::copy(mHistory.begin(), mHistory.begin() + (numSamples - numBeforeWrap), destination + numBeforeWrap);
+	}
+
+	// The number of samples taken.
+	int takeFromRing()
+	{
+		int startIndex1, blockSize1, startIndex2, blockSize2;
+		mRingFifo.prepareToRead(mRingFifo.getNumReady(), startIndex1, blockSize1, startIndex2, blockSize2);
+		decimate(mRing.data() + startIndex1, blockSize1);
+		decimate(mRing.data() + startIndex2, blockSize2);
+		mRingFifo.finishedRead(blockSize1 + blockSize2);
+
+		return blockSize1 + blockSize2;
+	}
+
+	void decimate(const float* samples, int numSamples)
+	{
+		for (int i = 0; i < numSamples; ++i)
+		{
+			auto sample = samples[i];
+
+			for (auto& filter : mAntiAliasingFilters)
+			{
+				sample = filter.processSingleSampleRaw(sample);
+			}
+
+			if (++mDecimationPhase < mDecimationFactor)
+			{
+				continue;
+			}
+
+			mDecimationPhase = 0;
+			mHistory[static_cast<size_t>(mHistoryWritePosition)] = sample;
+			mHistoryWritePosition = (mHistoryWritePosition + 1) % historySize;
+			mNumHistorySamples = juce::jmin(mNumHistorySamples + 1, historySize);
+			++mNumSamplesSinceStrum;
+		}
+	}
+
+	// The McLeod pitch method, from the normalised square difference function
+	// of the window, 2 r(t) / m(t), where r is the autocorrelation and m the
+	// sum of the squares of the samples that r(t) multiplies.
+	float findPitch()
+	{
+		copyLatest(mWindow.data(), windowSize);
+		std::fill(mWindow.begin() + windowSize, mWindow.end(), 0.0f);
+
+		double energy = 0.0;
+
+		for (int i = 0; i < windowSize; ++i)
+		{
+			energy += static_cast<double>(mWindow[static_cast<size_t>(i)]) * mWindow[static_cast<size_t>(i)];
+		}
+
+		if (energy < windowSize * static_cast<double>(silenceLevel) * silenceLevel)
+		{
+			return 0.0f;
+		}
+
+		mFFT.fft(mWindow.data(), mReal.data(), mImaginary.data());
+
+		for (size_t bin = 0; bin < mReal.size(); ++bin)
+		{
+			mReal[bin] = mReal[bin] * mReal[bin] + mImaginary[bin] * mImaginary[bin];
+			mImaginary[bin] = 0.0f;
+		}
+
+		mFFT.ifft(mAutocorrelation.data(), mReal.data(), mImaginary.data());
+
+		// r(0) is the energy, which takes out whatever scaling the FFT has.
+		const auto scale = 2.0 * energy / mAutocorrelation[0];
+		const auto minimumLag = juce::jmax(1, static_cast<int>(mAnalysisSampleRate / maximumFrequency));
+		const auto maximumLag = juce::jmin(windowSize / 2, static_cast<int>(mAnalysisSampleRate / minimumFrequency));
+		auto squares = 2.0 * energy;
+
+		for (int lag = 0; lag <= maximumLag + 1; ++lag)
+		{
+			if (lag > 0)
+			{
+				const auto first = mWindow[static_cast<size_t>(lag - 1)];
+				const auto last = mWindow[static_cast<size_t>(windowSize - lag)];
+				squares -= static_cast<double>(first) * first + static_cast<double>(last) * last;
+			}
+
+			mNormalisedAutocorrelation[static_cast<size_t>(lag)] = squares > 0.0
+				? static_cast<float>(scale * mAutocorrelation[static_cast<size_t>(lag)] / squares)
+				: 0.0f;
+		}
+
+		// The key maxima are the highest points of the positive stretches after
+		// the first, which is the one around lag 0.
+		const auto& nsdf = mNormalisedAutocorrelation;
+		mKeyMaxima.clear();
+		auto highest = 0.0f;
+		int lag = 1;
+
+		while (lag <= maximumLag && nsdf[static_cast<size_t>(lag)] > 0.0f)
+		{
+			++lag;
+		}
+
+		while (lag <= maximumLag)
+		{
+			while (lag <= maximumLag && nsdf[static_cast<size_t>(lag)] <= 0.0f)
+			{
+				++lag;
+			}
+
+			auto keyMaximum = lag;
+
+			while (lag <= maximumLag && nsdf[static_cast<size_t>(lag)] > 0.0f)
+			{
+				if (nsdf[static_cast<size_t>(lag)] > nsdf[static_cast<size_t>(keyMaximum)])
+				{
+					keyMaximum = lag;
+				}
+
+				++lag;
+			}
+
+			if (keyMaximum <= maximumLag && keyMaximum >= minimumLag)
+			{
+				mKeyMaxima.push_back(keyMaximum);
+				highest = juce::jmax(highest, nsdf[static_cast<size_t>(keyMaximum)]);
+			}
+		}
+
+		if (highest < minimumClarity)
+		{
+			return 0.0f;
+		}
+
+		for (const auto keyMaximum : mKeyMaxima)
+		{
+			const auto before = nsdf[static_cast<size_t>(keyMaximum - 1)];
+			const auto peak = nsdf[static_cast<size_t>(keyMaximum)];
+			const auto after = nsdf[static_cast<size_t>(keyMaximum + 1)];
+
+			if (peak < peakThreshold * highest)
+			{
+				continue;
+			}
+
+			// The top of the parabola through the peak and its neighbours.
+			const auto curvature = before - 2.0f * peak + after;
+			const auto offset = curvature < 0.0f ? 0.5f * (before - after) / curvature : 0.0f;
+			const auto pitch = static_cast<float>(mAnalysisSampleRate / (keyMaximum + offset));
+
+			return pitch >= minimumFrequency && pitch <= maximumFrequency ? pitch : 0.0f;
+		}
+
+		return 0.0f;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TunerAnalyser)
+};
@@ -0,0 +1,379 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <JuceHeader.h>
+#include "../../Utilities/MemoryUsage.h"
+
+/*
+	A 2x half-band lowpass built from two parallel chains of first-order allpass
+	sections, one per polyphase branch (the structure of Laurent de Soras' HIIR).
+	The coefficients come from the elliptic half-band design, so a handful of
+	multiplies per sample gives a steep transition at a quarter of the higher
+	rate. It is not linear phase; the latency reported is the group delay at DC.
+
+	Both branches of every channel are computed side by side in one SIMD
+	register, so a 4-lane register runs a stereo pair in a single pass.
+ */
+class HalfBandPolyphaseFilter
+{
+public:
+	using SIMDFloat = juce::dsp::SIMDRegister<float>;
+
+	// numCoefficients must be even so the branches have the same length.
+	// transitionBandwidth is relative to the higher rate and below 0.5.
+	HalfBandPolyphaseFilter(int numCoefficients, double transitionBandwidth) :
+		mNumPairs(numCoefficients / 2)
+	{
+		jassert(numCoefficients > 0 && numCoefficients % 2 == 0);
+
+		const auto coefficients = computeCoefficients(numCoefficients, transitionBandwidth);
+
+		for (int pair = 0; pair < mNumPairs; ++pair)
+		{
+			alignas(SIMDFloat) float lanes[SIMDFloat::SIMDNumElements];
+			for (size_t lane = 0; lane < SIMDFloat::SIMDNumElements; ++lane)
+			{
+				lanes[lane] = static_cast<float>(coefficients[pair * 2 + lane % 2]);
+			}
+
+			mCoefficients.push_back(SIMDFloat::fromRawArray(lanes));
+		}
+
+		// Each allpass section delays DC by (1 - a) / (1 + a) samples of the lower
+		// rate, that is twice as many at the higher rate, and the odd branch is one
+		// higher-rate sample late. The filter's delay at DC is the mean of the two.
+		double evenBranchDelay = 0.0;
+		double oddBranchDelay = 1.0;
+
+		for (int index = 0; index < numCoefficients; ++index)
+		{
+			const auto sectionDelay = 2.0 * (1.0 - coefficients[index]) / (1.0 + coefficients[index]);
+			(index % 2 == 0 ? evenBranchDelay : oddBranchDelay) += sectionDelay;
+		}
+
+		mGroupDelayAtDc = 0.5 * (evenBranchDelay + oddBranchDelay);
+	}
+
+	void prepare(int numChannels)
+	{
+		mNumChannels = numChannels;
+		mNumGroups = (numChannels + channelsPerGroup - 1) / channelsPerGroup;
+		mStateX.assign(static_cast<size_t>(mNumGroups * mNumPairs), SIMDFloat::expand(0.0f));
+		mStateY.assign(static_cast<size_t>(mNumGroups * mNumPairs), SIMDFloat::expand(0.0f));
+	}
+
+	void reset()
+	{
+		std::fill(mStateX.begin(), mStateX.end(), SIMDFloat::expand(0.0f));
+		std::fill(mStateY.begin(), mStateY.end(), SIMDFloat::expand(0.0f));
+	}
+
+	// Writes numInputSamples * 2 samples to every output channel.
+	void processUp(const float* const* input, float* const* output, int numInputSamples)
+	{
+		alignas(SIMDFloat) float lanes[SIMDFloat::SIMDNumElements];
+
+		for (int group = 0; group < mNumGroups; ++group)
+		{
+			const auto firstChannel = group * channelsPerGroup;
+			const auto numChannelsInGroup = juce::jmin(channelsPerGroup, mNumChannels - firstChannel);
+			std::fill(std::begin(lanes), std::end(lanes), 0.0f);
+
+			for (int sample = 0; sample < numInputSamples; ++sample)
+			{
+				for (int channel = 0; channel < numChannelsInGroup; ++channel)
+				{
+					lanes[channel * 2] = input[firstChannel + channel][sample];
+					lanes[channel * 2 + 1] = input[firstChannel + channel][sample];
+				}
+
+				const auto filtered = processAllpassChains(SIMDFloat::fromRawArray(lanes), group);
+				filtered.copyToRawArray(lanes);
+
+				for (int channel = 0; channel < numChannelsInGroup; ++channel)
+				{
+					output[firstChannel + channel][sample * 2] = lanes[channel * 2];
+					output[firstChannel + channel][sample * 2 + 1] = lanes[channel * 2 + 1];
+				}
+			}
+		}
+	}
+
+	// Reads numOutputSamples * 2 samples from every input channel.
+	void processDown(const float* const* input, float* const* output, int numOutputSamples)
+	{
+		alignas(SIMDFloat) float lanes[SIMDFloat::SIMDNumElements];
+
+		for (int group = 0; group < mNumGroups; ++group)
+		{
+			const auto firstChannel = group * channelsPerGroup;
+			const auto numChannelsInGroup = juce::jmin(channelsPerGroup, mNumChannels - firstChannel);
+			std::fill(std::begin(lanes), std::end(lanes), 0.0f);
+
+			for (int sample = 0; sample < numOutputSamples; ++sample)
+			{
+				for (int channel = 0; channel < numChannelsInGroup; ++channel)
+				{
+					lanes[channel * 2] = input[firstChannel + channel][sample * 2 + 1];
+					lanes[channel * 2 + 1] = input[firstChannel + channel][sample * 2];
+				}
+
+				const auto filtered = processAllpassChains(SIMDFloat::fromRawArray(lanes), group);
+				filtered.copyToRawArray(lanes);
+
+				for (int channel = 0; channel < numChannelsInGroup; ++channel)
+				{
+					output[firstChannel + channel][sample] = 0.5f * (lanes[channel * 2] + lanes[channel * 2 + 1]);
+				}
+			}
+		}
+	}
+
+	// In samples of the higher rate.
+	double getGroupDelayAtDc() const
+	{
+		return mGroupDelayAtDc;
+	}
+
+	static std::vector<double> computeCoefficients(int numCoefficients, double transitionBandwidth)
+	{
+		jassert(transitionBandwidth > 0.0 && transitionBandwidth < 0.5);
+
+		auto k = std::tan((1.0 - transitionBandwidth * 2.0) * M_PI / 4.0);
+		k *= k;
+		const auto kSquareRoot = std::pow(1.0 - k * k, 0.25);
+		const auto e = 0.5 * (1.0 - kSquareRoot) / (1.0 + kSquareRoot);
+		const auto e2 = e * e;
+		const auto e4 = e2 * e2;
+		const auto q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+		const auto order = numCoefficients * 2 + 1;
+		std::vector<double> coefficients(static_cast<size_t>(numCoefficients));
+
+		for (int index = 0; index < numCoefficients; ++index)
+		{
+			const auto c = index + 1;
+
+			double numerator = 0.0;
+			for (int i = 0, sign = 1; ; ++i, sign = -sign)
+			{
+				const auto term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * M_PI / order) * sign;
+				numerator += term;
+				if (std::abs(term) <= 1e-100)
+				{
+					break;
+				}
+			}
+
+			double denominator = 0.0;
+			for (int i = 1, sign = -1; ; ++i, sign = -sign)
+			{
+				const auto term = std::pow(q, i * i) * std::cos(i * 2 * c * M_PI / order) * sign;
+				denominator += term;
+				if (std::abs(term) <= 1e-100)
+				{
+					break;
+				}
+			}
+
+			const auto ww = numerator * std::pow(q, 0.25) / (denominator + 0.5);
+			const auto wwSquared = ww * ww;
+			const auto x = std::sqrt((1.0 - wwSquared * k) * (1.0 - wwSquared / k)) / (1.0 + wwSquared);
+			coefficients[static_cast<size_t>(index)] = (1.0 - x) / (1.0 + x);
+		}
+
+		return coefficients;
+	}
+
+private:
+	static constexpr int channelsPerGroup = static_cast<int>(SIMDFloat::SIMDNumElements / 2);
+
+	const int mNumPairs;
+	int mNumChannels = 0;
+	int mNumGroups = 0;
+	double mGroupDelayAtDc = 0.0;
+	std::vector<SIMDFloat> mCoefficients;
+	std::vector<SIMDFloat> mStateX;
+	std::vector<SIMDFloat> mStateY;
+
+	SIMDFloat processAllpassChains(SIMDFloat value, int group)
+	{
+		auto* stateX = mStateX.data() + group * mNumPairs;
+		auto* stateY = mStateY.data() + group * mNumPairs;
+
+		for (int pair = 0; pair < mNumPairs; ++pair)
+		{
+			const auto previousInput = stateX[pair];
+			stateX[pair] = value;
+			value = (value - stateY[pair]) * mCoefficients[pair] + previousInput;
+			stateY[pair] = value;
+		}
+
+		return value;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HalfBandPolyphaseFilter)
+};
+
+/*
+	Cascades up to three half-band stages for 2x, 4x or 8x oversampling with the
+	same calling pattern as juce::dsp::Oversampling: processSamplesUp() returns the
+	oversampled buffer to run the nonlinear processing on, and
+	processSamplesDown() brings the result back into the host buffer.
+
+	The first stage, next to the audio band, is the steepest; the later ones only
+	have to reject images well above the audio band and get away with far fewer
+	sections. Everything is allocated in prepare() for the largest factor, so
+	setFactor() never allocates.
+ */
+class PolyphaseOversampler
+{
+public:
+	static constexpr int maximumFactor = 8;
+
+	PolyphaseOversampler()
+	{
+		for (int stage = 0; stage < maximumNumStages; ++stage)
+		{
+			const auto isFirstStage = stage == 0;
+			mUpFilters.push_back(std::make_unique<HalfBandPolyphaseFilter>(
+				isFirstStage ? firstStageNumCoefficients : laterStageNumCoefficients,
+				isFirstStage ? firstStageTransitionBandwidth : laterStageTransitionBandwidth));
+			mDownFilters.push_back(std::make_unique<HalfBandPolyphaseFilter>(
+				isFirstStage ? firstStageNumCoefficients : laterStageNumCoefficients,
+				isFirstStage ? firstStageTransitionBandwidth : laterStageTransitionBandwidth));
+		}
+	}
+
+	void prepare(const juce::dsp::ProcessSpec& spec)
+	{
+		const auto numChannels = static_cast<int>(spec.numChannels);
+		mMemoryUsageInBytes = 0;
+
+		for (int stage = 0; stage < maximumNumStages; ++stage)
+		{
+			mUpFilters[stage]->prepare(numChannels);
+			mDownFilters[stage]->prepare(numChannels);
+			mStageBuffers[stage].setSize(numChannels, static_cast<int>(spec.maximumBlockSize) << (stage + 1));
+			mMemoryUsageInBytes += MemoryUsage::getSizeInBytes(mStageBuffers[stage]);
+		}
+
+		reset();
+	}
+
+	void reset()
+	{
+		for (int stage = 0; stage < maximumNumStages; ++stage)
+		{
+			mUpFilters[stage]->reset();
+			mDownFilters[stage]->reset();
+		}
+	}
+
+	// 1, 2, 4 or 8. Call reset() as well if audio was running at another factor.
+	void setFactor(int newFactor)
+	{
+		jassert(newFactor == 1 || newFactor == 2 || newFactor == 4 || newFactor == maximumFactor);
+		mNumStages = 0;
+		while ((1 << mNumStages) < newFactor && mNumStages < maximumNumStages)
+		{
+			++mNumStages;
+		}
+	}
+
+	int getFactor() const
+	{
+		return 1 << mNumStages;
+	}
+
+	// The buffers for every stage, which are kept whatever the factor.
+	size_t getMemoryUsageInBytes() const
+	{
+		return mMemoryUsageInBytes;
+	}
+
+	// In samples of the host rate, for the round trip up and down.
+	float getLatencyInSamples() const
+	{
+		double latency = 0.0;
+
+		for (int stage = 0; stage < mNumStages; ++stage)
+		{
+			// The up and down filters each delay by the group delay at the stage's
+			// higher rate, which is 2^(stage + 1) times the host rate. Decimating
+			// keeps the odd samples, which takes one of those samples back off.
+			const auto roundTripDelay = 2.0 * mUpFilters[stage]->getGroupDelayAtDc() - 1.0;
+			latency += roundTripDelay / static_cast<double>(2 << stage);
+		}
+
+		return static_cast<float>(latency);
+	}
+
+	// Returns the buffer holding the input at the oversampled rate. When the
+	// factor is one there is nothing to do and the input itself is returned.
+	juce::AudioBuffer<float>& processSamplesUp(juce::AudioBuffer<float>& input)
+	{
+		auto* source = &input;
+		const auto numChannels = input.getNumChannels();
+		auto numSamples = input.getNumSamples();
+
+		for (int stage = 0; stage < mNumStages; ++stage)
+		{
+			auto& destination = mStageBuffers[stage];
+			destination.setSize(numChannels, numSamples * 2, false, false, true);
+			mUpFilters[stage]->processUp(source->getArrayOfReadPointers(), destination.getArrayOfWritePointers(), numSamples);
+			source = &destination;
+			numSamples *= 2;
+		}
+
+		return *source;
+	}
+
+	// Filters the oversampled buffer returned by the last processSamplesUp() back
+	// down into output.
+	void processSamplesDown(juce::AudioBuffer<float>& output)
+	{
+		for (int stage = mNumStages - 1; stage >= 0; --stage)
+		{
+			auto& source = mStageBuffers[stage];
+			auto& destination = stage == 0 ? output : mStageBuffers[stage - 1];
+			mDownFilters[stage]->processDown(source.getArrayOfReadPointers(), destination.getArrayOfWritePointers(), source.getNumSamples() / 2);
+		}
+	}
+
+private:
+	static constexpr int maximumNumStages = 3;
+	static constexpr int firstStageNumCoefficients = 12;
+	static constexpr double firstStageTransitionBandwidth = 0.04;
+	static constexpr int laterStageNumCoefficients = 4;
+	static constexpr double laterStageTransitionBandwidth = 0.2;
+
+	int mNumStages = 0;
+	// As allocated in prepare(), as processSamplesUp() shrinks the buffers to
+	// the block without freeing anything.
+	size_t mMemoryUsageInBytes = 0;
+	std::vector<std::unique_ptr<HalfBandPolyphaseFilter>> mUpFilters;
+	std::vector<std::unique_ptr<HalfBandPolyphaseFilter>> mDownFilters;
+	std::array<juce::AudioBuffer<float>, maximumNumStages> mStageBuffers;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseOversampler)
+};
@@ -23,8 +23,7 @@
 
 #include "MouseDrive.h"
 
-MouseDrive::MouseDrive() :
-    mDCBlockerHPF(juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>())
+MouseDrive::MouseDrive()
 {
     mNetlistCircuitQuantities = std::make_unique<netlist::CircuitQuantityList>();
     mNetlistCircuitQuantities->addResistor(
@@ -154,10 +153,10 @@ void MouseDrive::setFilter(float newValue)
     if (newValue != 0)
     {
         mCurrentLowPassFrequency = newValue;
-        *mLowPassFilter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(
+        mFilters.setCoefficients(0, juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(
             mCurrentSampleRate,
             mCurrentLowPassFrequency,
-            0.70710678118654752440f);
+            0.70710678118654752440f));
     }
 };
 
@@ -174,19 +173,17 @@ void MouseDrive::prepare(juce::dsp::ProcessSpec& spec)
     mGain.prepare(spec);
     mGain.setRampDurationSeconds(0.05);
 
-    mDCBlockerHPF.prepare(spec);
+    mFilters.setCoefficients(0, juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(
+        spec.sampleRate,
+        mCurrentLowPassFrequency,
+        0.70710678118654752440f));
 
-    *mDCBlockerHPF.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(
+    mFilters.setCoefficients(1, juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(
         spec.sampleRate,
         15.0f,
-        0.70710678118654752440f);
-
-    mLowPassFilter.prepare(spec);
+        0.70710678118654752440f));
 
-    *mLowPassFilter.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(
-        spec.sampleRate,
-        mCurrentLowPassFrequency,
-        0.70710678118654752440f);
+    mFilters.prepare(spec);
 
     // pre-buffering
 //    AudioBuffer<float> buffer(2, spec.maximumBlockSize);
@@ -200,7 +197,7 @@ void MouseDrive::prepare(juce::dsp::ProcessSpec& spec)
 void MouseDrive::reset()
 {
     mGain.reset();
-    mDCBlockerHPF.reset();
+    mFilters.reset();
 }
 
 void MouseDrive::processBlock(juce::AudioBuffer<float>& buffer)
@@ -229,7 +226,5 @@ void MouseDrive::processBlock(juce::AudioBuffer<float>& buffer)
 
     mGain.process(processContext);
 
-    mLowPassFilter.process(processContext);
-
-    mDCBlockerHPF.process(processContext);
+    mFilters.processBlock(buffer);
 }
@@ -25,6 +25,7 @@
 
 #include "MouseDriveWDF.h"
 #include "../../Utilities/CircuitQuantityHelper.h"
+#include "../Equilisers/BiquadCascade.h"
 #include <JuceHeader.h>
 
 class MouseDrive
@@ -85,8 +86,8 @@ private:
 
 	MouseDriveWDF mWaveDesignFilter[2];
 	juce::dsp::Gain<float> mGain;
-	juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> mLowPassFilter;
-	juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> mDCBlockerHPF;
+	// The low pass filter, then the DC blocking high pass filter.
+	BiquadCascade<2> mFilters;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MouseDrive)
 };
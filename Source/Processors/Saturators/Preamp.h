@@ -0,0 +1,219 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "WaveShaper.h"
+
+/*
+	The amplifier's gain stages, each an input gain, a wave shaper, an output gain
+	and a dry/wet mix. Rather than taking the whole buffer through every step of
+	every stage, the buffer is taken a chunk at a time through all the enabled
+	stages, so each sample is loaded from and stored to memory once while the
+	chunk stays in cache. The dry signal is only kept when a stage's mix is
+	below 1.
+ */
+class Preamp
+{
+public:
+	static constexpr int numStages = 4;
+
+	Preamp() = default;
+
+	void prepare(const juce::dsp::ProcessSpec& spec)
+	{
+		for (auto& stage : mStages)
+		{
+			stage.inputGain.reset(spec.sampleRate, rampLengthInSeconds);
+			stage.outputGain.reset(spec.sampleRate, rampLengthInSeconds);
+			stage.mix.reset(spec.sampleRate, rampLengthInSeconds);
+			stage.waveShaper.prepare(spec);
+		}
+
+		mDrySamples.setSize(static_cast<int>(spec.numChannels), chunkSize, false, false, true);
+	}
+
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		const auto numChannels = buffer.getNumChannels();
+		const auto numSamples = buffer.getNumSamples();
+		jassert(numChannels <= mDrySamples.getNumChannels());
+
+		std::array<bool, numStages> isStageOn;
+		for (int stageIndex = 0; stageIndex < numStages; ++stageIndex)
+		{
+			isStageOn[stageIndex] = mStages[stageIndex].isOn.load(std::memory_order_relaxed);
+		}
+
+		auto* const* channels = buffer.getArrayOfWritePointers();
+
+		for (int offset = 0; offset < numSamples; offset += chunkSize)
+		{
+			const auto numChunkSamples = juce::jmin(chunkSize, numSamples - offset);
+
+			for (int stageIndex = 0; stageIndex < numStages; ++stageIndex)
+			{
+				if (isStageOn[stageIndex])
+				{
+					processChunk(mStages[stageIndex], channels, numChannels, offset, numChunkSamples);
+				}
+			}
+		}
+	}
+
+	void reset()
+	{
+		for (auto& stage : mStages)
+		{
+			stage.inputGain.setCurrentAndTargetValue(stage.inputGain.getTargetValue());
+			stage.outputGain.setCurrentAndTargetValue(stage.outputGain.getTargetValue());
+			stage.mix.setCurrentAndTargetValue(stage.mix.getTargetValue());
+			stage.waveShaper.reset();
+		}
+	}
+
+	bool isAnyStageOn() const
+	{
+		return std::any_of(mStages.begin(), mStages.end(), [](const Stage& stage) { return stage.isOn.load(std::memory_order_relaxed); });
+	}
+
+	void setStageIsOn(int stageIndex, bool newValue)
+	{
+		mStages[stageIndex].isOn.store(newValue, std::memory_order_relaxed);
+	}
+
+	void setStageInputGainDecibels(int stageIndex, float newValue)
+	{
+		mStages[stageIndex].inputGain.setTargetValue(juce::Decibels::decibelsToGain(newValue));
+	}
+
+	void setStageWaveShaperFunction(int stageIndex, WaveShaper::Function newValue)
+	{
+		mStages[stageIndex].waveShaper.setFunction(newValue);
+	}
+
+	void setStageAntialiasing(int stageIndex, WaveShaper::Antialiasing newValue)
+	{
+		mStages[stageIndex].waveShaper.setAntialiasing(newValue);
+	}
+
+	void setCurveTable(const WaveShaperTable* newValue)
+	{
+		for (auto& stage : mStages)
+		{
+			stage.waveShaper.setCurveTable(newValue);
+		}
+	}
+
+	void setStageOutputGainDecibels(int stageIndex, float newValue)
+	{
+		mStages[stageIndex].outputGain.setTargetValue(juce::Decibels::decibelsToGain(newValue));
+	}
+
+	void setStageMix(int stageIndex, float newValue)
+	{
+		mStages[stageIndex].mix.setTargetValue(newValue);
+	}
+
+private:
+	static constexpr int chunkSize = 64;
+	static constexpr double rampLengthInSeconds = 0.05;
+
+	struct Stage
+	{
+		std::atomic<bool> isOn{ false };
+		juce::SmoothedValue<float> inputGain{ 1.0f };
+		juce::SmoothedValue<float> outputGain{ 1.0f };
+		juce::SmoothedValue<float> mix{ 1.0f };
+		WaveShaper waveShaper;
+	};
+
+	std::array<Stage, numStages> mStages;
+	juce::AudioBuffer<float> mDrySamples;
+	std::array<float, chunkSize> mRamp{};
+
+	void processChunk(Stage& stage, float* const* channels, int numChannels, int offset, int numSamples)
+	{
+		const auto isMixing = stage.mix.isSmoothing() || stage.mix.getTargetValue() < 1.0f;
+
+		if (isMixing)
+		{
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				juce::FloatVectorOperations::copy(mDrySamples.getWritePointer(channel), channels[channel] + offset, numSamples);
+			}
+		}
+
+		applyGain(stage.inputGain, channels, numChannels, offset, numSamples);
+
+		juce::dsp::AudioBlock<float> chunk(channels, static_cast<size_t>(numChannels), static_cast<size_t>(offset), static_cast<size_t>(numSamples));
+		stage.waveShaper.process(juce::dsp::ProcessContextReplacing<float>(chunk));
+
+		applyGain(stage.outputGain, channels, numChannels, offset, numSamples);
+
+		if (isMixing)
+		{
+			// wet * mix + dry * (1 - mix), as juce::dsp::DryWetMixer's linear rule.
+			fillRamp(stage.mix, numSamples);
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				auto* wet = channels[channel] + offset;
+				const auto* dry = mDrySamples.getReadPointer(channel);
+
+				for (int sample = 0; sample < numSamples; ++sample)
+				{
+					wet[sample] = dry[sample] + mRamp[sample] * (wet[sample] - dry[sample]);
+				}
+			}
+		}
+	}
+
+	void applyGain(juce::SmoothedValue<float>& gain, float* const* channels, int numChannels, int offset, int numSamples)
+	{
+		if (!gain.isSmoothing())
+		{
+			const auto currentGain = gain.getCurrentValue();
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				juce::FloatVectorOperations::multiply(channels[channel] + offset, currentGain, numSamples);
+			}
+
+			return;
+		}
+
+		fillRamp(gain, numSamples);
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			juce::FloatVectorOperations::multiply(channels[channel] + offset, mRamp.data(), numSamples);
+		}
+	}
+
+	void fillRamp(juce::SmoothedValue<float>& value, int numSamples)
+	{
+		for (int sample = 0; sample < numSamples; ++sample)
+		{
+			mRamp[sample] = value.getNextValue();
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Preamp)
+};
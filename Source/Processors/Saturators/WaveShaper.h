@@ -0,0 +1,332 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+#include "WaveShaperCurves.h"
+#include "WaveShaperTable.h"
+
+/*
+	Stands in for juce::dsp::WaveShaper, which calls its function through a
+	pointer for every sample. Here the curve is chosen once per block and the
+	block goes through it several samples at a time, see FastMath.
+
+	The curve can instead be applied with first or second order antiderivative
+	antialiasing, which filters the aliasing the curve creates for the price of
+	evaluating its antiderivatives, and of a half and a whole sample of delay
+	respectively. Where the inputs are too close together for the divided
+	differences to be accurate it falls back to the curve at their midpoint.
+
+	The user's curve is looked up in a WaveShaperTable, which has no closed
+	form antiderivatives, so it is never antialiased. Its table is rounded off
+	when it is baked instead.
+ */
+class WaveShaper
+{
+public:
+	// In the order of apvts::waveShaperIds, so a choice parameter's index can be
+	// cast to it.
+	enum class Function
+	{
+		hyperbolicTangent,
+		softClip,
+		arctangent,
+		cubicNonLinearity,
+		hardClip,
+		exponential,
+		curve
+	};
+
+	// In the order of apvts::antialiasingIds.
+	enum class Antialiasing
+	{
+		none,
+		firstOrder,
+		secondOrder
+	};
+
+	WaveShaper() = default;
+
+	void prepare(const juce::dsp::ProcessSpec& spec)
+	{
+		mChannelStates.assign(spec.numChannels, {});
+		mPreviousAntialiasing = Antialiasing::none;
+	}
+
+	template <typename ProcessContext>
+	void process(const ProcessContext& context) noexcept
+	{
+		const auto& inputBlock = context.getInputBlock();
+		auto& outputBlock = context.getOutputBlock();
+		const auto numChannels = outputBlock.getNumChannels();
+		const auto numSamples = outputBlock.getNumSamples();
+
+		jassert(inputBlock.getNumChannels() == numChannels);
+		jassert(inputBlock.getNumSamples() == numSamples);
+
+		if (context.isBypassed)
+		{
+			if (context.usesSeparateInputAndOutputBlocks())
+			{
+				outputBlock.copyFrom(inputBlock);
+			}
+
+			return;
+		}
+
+		const auto function = mFunction.load(std::memory_order_relaxed);
+		auto antialiasing = mAntialiasing.load(std::memory_order_relaxed);
+
+		if (numChannels > mChannelStates.size() || numSamples == 0 || function == Function::curve)
+		{
+			jassert(numSamples == 0);
+			antialiasing = Antialiasing::none;
+		}
+
+		if (antialiasing != mPreviousAntialiasing)
+		{
+			// Starts the history at the first sample, as if the input had been
+			// holding it, rather than at whatever was left from before.
+			for (size_t channel = 0; channel < mChannelStates.size() && channel < numChannels; ++channel)
+			{
+				const auto firstSample = static_cast<double>(inputBlock.getSample(static_cast<int>(channel), 0));
+				mChannelStates[channel] = { firstSample, firstSample };
+			}
+
+			mPreviousAntialiasing = antialiasing;
+		}
+
+		for (size_t channel = 0; channel < numChannels; ++channel)
+		{
+			const auto* input = inputBlock.getChannelPointer(channel);
+			auto* output = outputBlock.getChannelPointer(channel);
+
+			if (function == Function::curve)
+			{
+				processCurveSamples(input, output, numSamples);
+			}
+			else if (antialiasing == Antialiasing::none)
+			{
+				processSamples(function, input, output, numSamples);
+			}
+			else
+			{
+				processAntialiasedSamples(function, antialiasing == Antialiasing::secondOrder, input, output, numSamples, mChannelStates[channel]);
+			}
+		}
+	}
+
+	void reset()
+	{
+		std::fill(mChannelStates.begin(), mChannelStates.end(), ChannelState{});
+	}
+
+	void setFunction(Function newValue)
+	{
+		mFunction.store(newValue, std::memory_order_relaxed);
+	}
+
+	Function getFunction() const
+	{
+		return mFunction.load(std::memory_order_relaxed);
+	}
+
+	void setAntialiasing(Antialiasing newValue)
+	{
+		mAntialiasing.store(newValue, std::memory_order_relaxed);
+	}
+
+	Antialiasing getAntialiasing() const
+	{
+		return mAntialiasing.load(std::memory_order_relaxed);
+	}
+
+	// The table for Function::curve, which must outlive its use here. Without one
+	// the curve passes the signal through.
+	void setCurveTable(const WaveShaperTable* newValue)
+	{
+		mCurveTable.store(newValue, std::memory_order_release);
+	}
+
+	static void processSamples(Function function, const float* input, float* output, size_t numSamples) noexcept
+	{
+		switch (function)
+		{
+		case Function::hyperbolicTangent:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return FastMath::tanh(x); });
+			break;
+		case Function::softClip:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return x / (FastMath::abs(x) + 1.0f); });
+			break;
+		case Function::arctangent:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return FastMath::atan(x); });
+			break;
+		case Function::cubicNonLinearity:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return x - (1.0f / 3.0f) * x * x * x; });
+			break;
+		case Function::hardClip:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return FastMath::clamp<decltype(x)>(x, -1.0f, 1.0f); });
+			break;
+		case Function::exponential:
+			FastMath::applyToSamples(input, output, numSamples, [](auto x) { return FastMath::exp(x) - 1.0f; });
+			break;
+		case Function::curve:
+			// Needs the table, see processCurveSamples.
+		default:
+			jassertfalse;
+		}
+	}
+
+private:
+	// The last two inputs.
+	struct ChannelState
+	{
+		double x1 = 0.0;
+		double x2 = 0.0;
+	};
+
+	// Below this the differences between inputs are treated as zero.
+	static constexpr double illConditionedDifference = 1.0e-5;
+
+	std::atomic<Function> mFunction{ Function::softClip };
+	std::atomic<Antialiasing> mAntialiasing{ Antialiasing::none };
+	std::atomic<const WaveShaperTable*> mCurveTable{ nullptr };
+	Antialiasing mPreviousAntialiasing = Antialiasing::none;
+	std::vector<ChannelState> mChannelStates;
+
+	void processCurveSamples(const float* input, float* output, size_t numSamples) const noexcept
+	{
+		if (const auto* table = mCurveTable.load(std::memory_order_acquire))
+		{
+			table->processSamples(input, output, numSamples);
+		}
+		else if (input != output)
+		{
+			std::copy(input, input + numSamples, output);
+		}
+	}
+
+	static void processAntialiasedSamples(Function function, bool isSecondOrder, const float* input, float* output, size_t numSamples, ChannelState& state) noexcept
+	{
+		switch (function)
+		{
+		case Function::hyperbolicTangent:
+			processAntialiasedSamples<WaveShaperCurves::HyperbolicTangent>(isSecondOrder, input, output, numSamples, state);
+			break;
+		case Function::softClip:
+			processAntialiasedSamples<WaveShaperCurves::SoftClip>(isSecondOrder, input, output, numSamples, state);
+			break;
+		case Function::arctangent:
+			processAntialiasedSamples<WaveShaperCurves::Arctangent>(isSecondOrder, input, output, numSamples, state);
+			break;
+		case Function::cubicNonLinearity:
+			processAntialiasedSamples<WaveShaperCurves::CubicNonLinearity>(isSecondOrder, input, output, numSamples, state);
+			break;
+		case Function::hardClip:
+			processAntialiasedSamples<WaveShaperCurves::HardClip>(isSecondOrder, input, output, numSamples, state);
+			break;
+		case Function::exponential:
+			processAntialiasedSamples<WaveShaperCurves::Exponential>(isSecondOrder, input, output, numSamples, state);
+			break;
+		default:
+			jassertfalse;
+		}
+	}
+
+	template <typename Curve>
+	static void processAntialiasedSamples(bool isSecondOrder, const float* input, float* output, size_t numSamples, ChannelState& state) noexcept
+	{
+		auto x1 = state.x1;
+		auto x2 = state.x2;
+
+		if (!isSecondOrder)
+		{
+			// y[n] = (F1(x[n]) - F1(x[n - 1])) / (x[n] - x[n - 1])
+			auto f1x1 = Curve::F1(x1);
+
+			for (size_t sample = 0; sample < numSamples; ++sample)
+			{
+				const auto x0 = static_cast<double>(input[sample]);
+				const auto f1x0 = Curve::F1(x0);
+				const auto difference = x0 - x1;
+
+				output[sample] = static_cast<float>(std::abs(difference) < illConditionedDifference
+					? Curve::f(0.5 * (x0 + x1))
+					: (f1x0 - f1x1) / difference);
+
+				x2 = x1;
+				x1 = x0;
+				f1x1 = f1x0;
+			}
+
+			state = { x1, x2 };
+			return;
+		}
+
+		// y[n] = 2 / (x[n] - x[n - 2]) * (D[n] - D[n - 1]), where D[n] is the
+		// divided difference of F2 between x[n] and x[n - 1].
+		const auto getDividedDifference = [](double x0, double f2x0, double x1, double f2x1)
+		{
+			const auto difference = x0 - x1;
+			return std::abs(difference) < illConditionedDifference
+				? Curve::F1(0.5 * (x0 + x1))
+				: (f2x0 - f2x1) / difference;
+		};
+
+		auto f2x1 = Curve::F2(x1);
+		auto d1 = getDividedDifference(x1, f2x1, x2, Curve::F2(x2));
+
+		for (size_t sample = 0; sample < numSamples; ++sample)
+		{
+			const auto x0 = static_cast<double>(input[sample]);
+			const auto f2x0 = Curve::F2(x0);
+			const auto d0 = getDividedDifference(x0, f2x0, x1, f2x1);
+			const auto outerDifference = x0 - x2;
+
+			double y;
+			if (std::abs(outerDifference) >= illConditionedDifference)
+			{
+				y = 2.0 * (d0 - d1) / outerDifference;
+			}
+			else
+			{
+				// x[n] and x[n - 2] coincide, so take the antiderivatives around
+				// their mean instead.
+				const auto xBar = 0.5 * (x0 + x2);
+				const auto delta = xBar - x1;
+
+				y = std::abs(delta) < illConditionedDifference
+					? Curve::f(0.5 * (xBar + x1))
+					: 2.0 / delta * (Curve::F1(xBar) + (f2x1 - Curve::F2(xBar)) / delta);
+			}
+
+			output[sample] = static_cast<float>(y);
+
+			x2 = x1;
+			x1 = x0;
+			f2x1 = f2x0;
+			d1 = d0;
+		}
+
+		state = { x1, x2 };
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveShaper)
+};
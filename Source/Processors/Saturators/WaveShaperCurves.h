@@ -0,0 +1,158 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+/*
+	The wave shaper curves with their first and second antiderivatives, F1 and F2,
+	in closed form, for antiderivative antialiasing. They are in double precision
+	because the antialiased output is a difference of antiderivatives divided by
+	a difference of inputs, which loses too much in single precision.
+
+	Each F1 and F2 is zero at zero, which keeps the values small around where
+	the signal usually is.
+ */
+namespace WaveShaperCurves
+{
+	static constexpr double ln2 = 0.69314718055994531;
+	static constexpr double piSquared = 9.8696044010893586;
+
+	inline double signOf(double x)
+	{
+		return x < 0.0 ? -1.0 : 1.0;
+	}
+
+	// Li2(-u) for u in [0, 1], through Li2(z) = -Li2(z / (z - 1)) - log^2(1 - z) / 2
+	// and the Bernoulli series of Li2(w) in log(1 / (1 - w)), which here is below
+	// ln2. Error below 1e-12.
+	inline double dilogarithmOfNegative(double u)
+	{
+		const auto t = std::log1p(u);
+		const auto t2 = t * t;
+		const auto series = t * (1.0 + t * (-1.0 / 4.0 + t * (1.0 / 36.0 + t2 * (-1.0 / 3600.0 + t2 * (1.0 / 211680.0 + t2 * (-1.0 / 10886400.0 + t2 * (1.0 / 526901760.0 + t2 * (-4.0647616451442255e-11))))))));
+		return -series - 0.5 * t2;
+	}
+
+	struct HyperbolicTangent
+	{
+		static double f(double x) { return std::tanh(x); }
+
+		// log(cosh(x)), written so that cosh cannot overflow.
+		static double F1(double x)
+		{
+			const auto a = std::abs(x);
+			return a + std::log1p(std::exp(-2.0 * a)) - ln2;
+		}
+
+		static double F2(double x)
+		{
+			const auto a = std::abs(x);
+			return signOf(x) * (0.5 * a * a - a * ln2 + 0.5 * dilogarithmOfNegative(std::exp(-2.0 * a)) + piSquared / 24.0);
+		}
+	};
+
+	struct SoftClip
+	{
+		static double f(double x) { return x / (std::abs(x) + 1.0); }
+
+		static double F1(double x)
+		{
+			const auto a = std::abs(x);
+			return a - std::log1p(a);
+		}
+
+		static double F2(double x)
+		{
+			const auto a = std::abs(x);
+			return signOf(x) * (0.5 * a * a + a - (1.0 + a) * std::log1p(a));
+		}
+	};
+
+	struct Arctangent
+	{
+		static double f(double x) { return std::atan(x); }
+
+		static double F1(double x)
+		{
+			return x * std::atan(x) - 0.5 * std::log1p(x * x);
+		}
+
+		static double F2(double x)
+		{
+			return 0.5 * (x * x - 1.0) * std::atan(x) + 0.5 * x - 0.5 * x * std::log1p(x * x);
+		}
+	};
+
+	struct CubicNonLinearity
+	{
+		static double f(double x) { return x - x * x * x / 3.0; }
+
+		static double F1(double x)
+		{
+			const auto x2 = x * x;
+			return x2 / 2.0 - x2 * x2 / 12.0;
+		}
+
+		static double F2(double x)
+		{
+			const auto x2 = x * x;
+			return x * x2 / 6.0 - x * x2 * x2 / 60.0;
+		}
+	};
+
+	struct HardClip
+	{
+		static double f(double x) { return std::clamp(x, -1.0, 1.0); }
+
+		static double F1(double x)
+		{
+			const auto a = std::abs(x);
+			return a <= 1.0 ? 0.5 * x * x : a - 0.5;
+		}
+
+		static double F2(double x)
+		{
+			const auto a = std::abs(x);
+			return a <= 1.0 ? x * x * x / 6.0 : signOf(x) * (0.5 * a * a - 0.5 * a + 1.0 / 6.0);
+		}
+	};
+
+	// The input is limited to where e^x fits in a float, as the plain curve
+	// does, so that the differences of antiderivatives stay finite.
+	struct Exponential
+	{
+		static constexpr double maximumInput = 88.0;
+
+		static double f(double x) { return std::exp(std::min(x, maximumInput)) - 1.0; }
+
+		static double F1(double x)
+		{
+			x = std::min(x, maximumInput);
+			return std::exp(x) - x - 1.0;
+		}
+
+		static double F2(double x)
+		{
+			x = std::min(x, maximumInput);
+			return std::exp(x) - 0.5 * x * x - x - 1.0;
+		}
+	};
+}
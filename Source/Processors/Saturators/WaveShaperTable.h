@@ -0,0 +1,390 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Utilities/FastMath.h"
+
+/*
+	A transfer curve drawn as points, joined by a monotone cubic so that it
+	never overshoots between them. Beyond the first and last points it holds
+	their values. It is saved in the preset as text, "cubic;x,y;x,y;...".
+ */
+struct WaveShaperCurve
+{
+	enum class Interpolation
+	{
+		linear,
+		cubic
+	};
+
+	static constexpr float inputRange = 4.0f;
+	static constexpr int maximumNumPoints = 64;
+
+	Interpolation interpolation = Interpolation::cubic;
+	std::vector<juce::Point<float>> points;
+
+	static WaveShaperCurve getDefault()
+	{
+		WaveShaperCurve curve;
+		curve.points = { { -inputRange, -1.0f }, { -1.0f, -0.75f }, { 0.0f, 0.0f }, { 1.0f, 0.75f }, { inputRange, 1.0f } };
+		return curve;
+	}
+
+	juce::String toString() const
+	{
+		juce::StringArray tokens;
+		tokens.add(interpolation == Interpolation::linear ? "linear" : "cubic");
+
+		for (const auto& point : points)
+		{
+			tokens.add(juce::String(point.x) + "," + juce::String(point.y));
+		}
+
+		return tokens.joinIntoString(";");
+	}
+
+	// Anything unreadable gives the default curve.
+	static WaveShaperCurve fromString(const juce::String& text)
+	{
+		const auto tokens = juce::StringArray::fromTokens(text, ";", "");
+		if (tokens.size() < 3)
+		{
+			return getDefault();
+		}
+
+		WaveShaperCurve curve;
+		curve.interpolation = tokens[0] == "linear" ? Interpolation::linear : Interpolation::cubic;
+
+		for (int tokenIndex = 1; tokenIndex < tokens.size(); ++tokenIndex)
+		{
+			const auto coordinates = juce::StringArray::fromTokens(tokens[tokenIndex], ",", "");
+			if (coordinates.size() == 2)
+			{
+				curve.addPoint({ coordinates[0].getFloatValue(), coordinates[1].getFloatValue() });
+			}
+		}
+
+		return curve.points.size() >= 2 ? curve : getDefault();
+	}
+
+	// Reads one point per line, x and y separated by a comma, tab or spaces, as
+	// exported from a spreadsheet. The x values are scaled to the input range.
+	static WaveShaperCurve fromPointList(const juce::String& text)
+	{
+		WaveShaperCurve imported;
+		auto maximumX = 0.0f;
+
+		for (const auto& line : juce::StringArray::fromLines(text))
+		{
+			const auto coordinates = juce::StringArray::fromTokens(line, ", \t", "");
+			if (coordinates.size() >= 2 && coordinates[0].containsOnly("0123456789.-+eE"))
+			{
+				const juce::Point<float> point{ coordinates[0].getFloatValue(), coordinates[1].getFloatValue() };
+				imported.points.push_back(point);
+				maximumX = juce::jmax(maximumX, std::abs(point.x));
+			}
+		}
+
+		if (imported.points.size() < 2 || maximumX <= 0.0f)
+		{
+			return getDefault();
+		}
+
+		// Thins the points out evenly if there are more than the editor handles.
+		const auto step = juce::jmax<size_t>(1, (imported.points.size() + maximumNumPoints - 1) / maximumNumPoints);
+
+		WaveShaperCurve curve;
+		for (size_t pointIndex = 0; pointIndex < imported.points.size(); pointIndex += step)
+		{
+			const auto& point = imported.points[pointIndex];
+			curve.addPoint({ point.x * inputRange / maximumX, point.y });
+		}
+
+		return curve;
+	}
+
+	// Keeps the points sorted and inside the range, replacing any point at the
+	// same x.
+	void addPoint(juce::Point<float> point)
+	{
+		point.x = juce::jlimit(-inputRange, inputRange, point.x);
+		point.y = juce::jlimit(-inputRange, inputRange, point.y);
+
+		const auto position = std::lower_bound(points.begin(), points.end(), point, [](const auto& a, const auto& b) { return a.x < b.x; });
+
+		if (position != points.end() && position->x == point.x)
+		{
+			*position = point;
+		}
+		else if (static_cast<int>(points.size()) < maximumNumPoints)
+		{
+			points.insert(position, point);
+		}
+	}
+
+	float evaluate(float x) const
+	{
+		if (points.empty())
+		{
+			return x;
+		}
+
+		if (x <= points.front().x)
+		{
+			return points.front().y;
+		}
+
+		if (x >= points.back().x)
+		{
+			return points.back().y;
+		}
+
+		const auto upper = static_cast<size_t>(std::upper_bound(points.begin(), points.end(), x, [](float value, const auto& point) { return value < point.x; }) - points.begin());
+		const auto lower = upper - 1;
+		const auto& p0 = points[lower];
+		const auto& p1 = points[upper];
+		const auto width = p1.x - p0.x;
+		const auto t = (x - p0.x) / width;
+
+		if (interpolation == Interpolation::linear)
+		{
+			return p0.y + t * (p1.y - p0.y);
+		}
+
+		// Fritsch-Carlson tangents, so that a monotone run of points stays
+		// monotone in between.
+		const auto getTangent = [this](size_t index)
+		{
+			const auto getSlope = [this](size_t from)
+			{
+				return (points[from + 1].y - points[from].y) / (points[from + 1].x - points[from].x);
+			};
+
+			if (index == 0)
+			{
+				return getSlope(0);
+			}
+
+			if (index == points.size() - 1)
+			{
+				return getSlope(index - 1);
+			}
+
+			const auto before = getSlope(index - 1);
+			const auto after = getSlope(index);
+			return before * after <= 0.0f ? 0.0f : 2.0f / (1.0f / before + 1.0f / after);
+		};
+
+		const auto m0 = getTangent(lower) * width;
+		const auto m1 = getTangent(upper) * width;
+		const auto t2 = t * t;
+		const auto t3 = t2 * t;
+
+		return (2.0f * t3 - 3.0f * t2 + 1.0f) * p0.y
+			+ (t3 - 2.0f * t2 + t) * m0
+			+ (-2.0f * t3 + 3.0f * t2) * p1.y
+			+ (t3 - t2) * m1;
+	}
+};
+
+/*
+	A curve baked into a table over the input range. Baking rounds off the
+	curve's corners with a short raised cosine kernel, since a corner in a
+	transfer curve makes harmonics that never die away and alias, and moves
+	the curve so that silence stays silent. Lookup interpolates linearly or
+	with a Catmull-Rom cubic, eight or four samples at a time where the build
+	allows it, and costs the same whatever the curve.
+
+	Tables are immutable once made, so one can be read by any number of stages
+	and plugin instances at once, see WaveShaperTableCache.
+ */
+class WaveShaperTable
+{
+public:
+	static constexpr int size = 4096;
+
+	explicit WaveShaperTable(const WaveShaperCurve& curve) :
+		mIsCubic(curve.interpolation == WaveShaperCurve::Interpolation::cubic)
+	{
+		constexpr int smoothingRadius = 16;
+
+		std::vector<float> samples(static_cast<size_t>(size + 2 * smoothingRadius));
+		for (int index = 0; index < static_cast<int>(samples.size()); ++index)
+		{
+			samples[static_cast<size_t>(index)] = curve.evaluate(getInputForIndex(index - smoothingRadius));
+		}
+
+		std::array<float, 2 * smoothingRadius + 1> kernel;
+		auto kernelSum = 0.0f;
+		for (int offset = -smoothingRadius; offset <= smoothingRadius; ++offset)
+		{
+			const auto weight = 0.5f + 0.5f * std::cos(juce::MathConstants<float>::pi * static_cast<float>(offset) / static_cast<float>(smoothingRadius + 1));
+			kernel[static_cast<size_t>(offset + smoothingRadius)] = weight;
+			kernelSum += weight;
+		}
+
+		// One guard value either side, so the cubic can read around every index.
+		mValues.resize(static_cast<size_t>(size + 2));
+		for (int index = -1; index <= size; ++index)
+		{
+			const auto centre = juce::jlimit(0, size - 1, index) + smoothingRadius;
+			auto value = 0.0f;
+
+			for (int offset = -smoothingRadius; offset <= smoothingRadius; ++offset)
+			{
+				value += kernel[static_cast<size_t>(offset + smoothingRadius)] * samples[static_cast<size_t>(centre + offset)];
+			}
+
+			mValues[static_cast<size_t>(index + 1)] = value / kernelSum;
+		}
+
+		auto silence = 0.0f;
+		processSamples(&silence, &silence, 1);
+
+		for (auto& value : mValues)
+		{
+			value -= silence;
+		}
+	}
+
+	// Input and output may be the same, but must not otherwise overlap.
+	void processSamples(const float* input, float* output, size_t numSamples) const noexcept
+	{
+		size_t sample = 0;
+
+#if SUPERTONAL_FAST_MATH_SSE2
+		for (; sample + 4 <= numSamples; sample += 4)
+		{
+			// SSE2 has no integer minimum, so the index is limited as a float.
+			const auto position = getPosition(_mm_loadu_ps(input + sample));
+			const auto index = _mm_cvttps_epi32(_mm_min_ps(position, _mm_set1_ps(static_cast<float>(size - 2))));
+			const auto t = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+
+			// SSE2 has no gather, so the four table reads are scalar.
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+			alignas(16) float vm1[4], v0[4], v1[4], v2[4];
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const auto* values = mValues.data() + indices[lane];
+				vm1[lane] = values[0];
+				v0[lane] = values[1];
+				v1[lane] = values[2];
+				v2[lane] = values[3];
+			}
+
+			const FastMath::SSEFloat a = _mm_load_ps(v0);
+			const FastMath::SSEFloat b = _mm_load_ps(v1);
+
+			if (!mIsCubic)
+			{
+				(a + FastMath::SSEFloat(t) * (b - a)).store(output + sample);
+				continue;
+			}
+
+			interpolateCubic<FastMath::SSEFloat>(_mm_load_ps(vm1), a, b, _mm_load_ps(v2), t).store(output + sample);
+		}
+#endif
+
+		for (; sample < numSamples; ++sample)
+		{
+			const auto position = juce::jlimit(0.0f, static_cast<float>(size - 1), (input[sample] + WaveShaperCurve::inputRange) * indicesPerInput);
+			const auto index = juce::jmin(static_cast<int>(position), size - 2);
+			const auto t = position - static_cast<float>(index);
+			const auto* values = mValues.data() + index;
+
+			output[sample] = mIsCubic
+				? interpolateCubic<float>(values[0], values[1], values[2], values[3], t)
+				: values[1] + t * (values[2] - values[1]);
+		}
+	}
+
+	size_t getSizeInBytes() const
+	{
+		return sizeof(*this) + mValues.size() * sizeof(float);
+	}
+
+private:
+	static constexpr float indicesPerInput = static_cast<float>(size - 1) / (2.0f * WaveShaperCurve::inputRange);
+
+	bool mIsCubic;
+	// mValues[index + 1] is the value at getInputForIndex(index).
+	std::vector<float> mValues;
+
+	static float getInputForIndex(int index)
+	{
+		return static_cast<float>(index) / indicesPerInput - WaveShaperCurve::inputRange;
+	}
+
+	template <typename Float>
+	static Float interpolateCubic(Float vm1, Float v0, Float v1, Float v2, Float t)
+	{
+		const Float c1 = 0.5f * (v1 - vm1);
+		const Float c2 = vm1 - 2.5f * v0 + 2.0f * v1 - 0.5f * v2;
+		const Float c3 = 0.5f * (v2 - vm1) + 1.5f * (v0 - v1);
+		return ((c3 * t + c2) * t + c1) * t + v0;
+	}
+
+#if SUPERTONAL_FAST_MATH_SSE2
+	static __m128 getPosition(__m128 input)
+	{
+		const auto position = _mm_mul_ps(_mm_add_ps(input, _mm_set1_ps(WaveShaperCurve::inputRange)), _mm_set1_ps(indicesPerInput));
+		return _mm_min_ps(_mm_max_ps(position, _mm_setzero_ps()), _mm_set1_ps(static_cast<float>(size - 1)));
+	}
+#endif
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveShaperTable)
+};
+
+/*
+	Tables shared by every stage of every plugin instance in the process, held
+	through a juce::SharedResourcePointer. Asking for a curve that is already
+	baked returns the same table. Only called from the message thread.
+ */
+class WaveShaperTableCache
+{
+public:
+	std::shared_ptr<const WaveShaperTable> getTable(const WaveShaperCurve& curve)
+	{
+		const juce::ScopedLock lock(mLock);
+		const auto key = curve.toString();
+
+		// Tables nobody else holds any more go. The processors hold on to a table
+		// they replace until their audio thread is done with it, so one that an
+		// audio thread might still be reading from is never released here.
+		for (auto iterator = mTables.begin(); iterator != mTables.end();)
+		{
+			iterator = iterator->second.use_count() == 1 && iterator->first != key ? mTables.erase(iterator) : std::next(iterator);
+		}
+
+		auto& table = mTables[key];
+		if (table == nullptr)
+		{
+			table = std::make_shared<const WaveShaperTable>(curve);
+		}
+
+		return table;
+	}
+
+private:
+	juce::CriticalSection mLock;
+	std::map<juce::String, std::shared_ptr<const WaveShaperTable>> mTables;
+};
@@ -0,0 +1,211 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SUPERTONAL_FAST_MATH_SSE2 1
+#include <immintrin.h>
+#endif
+
+/*
+	Approximations of the transcendental functions the wave shapers use, written
+	once against a handful of operations that are provided for float and for
+	SSE2 registers, so the same arithmetic runs on 1 or 4 samples. Nothing
+	branches, which is what lets a block of samples go through them four at a
+	time.
+
+	The error bounds are the largest absolute errors against the double
+	precision functions, sampled across the whole float range.
+ */
+namespace FastMath
+{
+	inline float min(float a, float b) { return a < b ? a : b; }
+	inline float max(float a, float b) { return a > b ? a : b; }
+	inline float abs(float a) { return std::abs(a); }
+	inline float copySign(float magnitude, float sign) { return std::copysign(magnitude, sign); }
+	inline float select(bool condition, float a, float b) { return condition ? a : b; }
+	inline float roundToWhole(float a) { return std::nearbyint(a); }
+
+	// a * 2^n for whole n in [-126, 127].
+	inline float scaleByPowerOfTwo(float a, float n)
+	{
+		const auto bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(scale));
+		return a * scale;
+	}
+
+#if SUPERTONAL_FAST_MATH_SSE2
+	struct SSEFloat
+	{
+		static constexpr size_t size = 4;
+
+		SSEFloat() = default;
+		SSEFloat(__m128 newValue) : value(newValue) {}
+		SSEFloat(float newValue) : value(_mm_set1_ps(newValue)) {}
+
+		static SSEFloat load(const float* source) { return _mm_loadu_ps(source); }
+		void store(float* destination) const { _mm_storeu_ps(destination, value); }
+
+		__m128 value;
+	};
+
+	inline SSEFloat operator+(SSEFloat a, SSEFloat b) { return _mm_add_ps(a.value, b.value); }
+	inline SSEFloat operator-(SSEFloat a, SSEFloat b) { return _mm_sub_ps(a.value, b.value); }
+	inline SSEFloat operator*(SSEFloat a, SSEFloat b) { return _mm_mul_ps(a.value, b.value); }
+	inline SSEFloat operator/(SSEFloat a, SSEFloat b) { return _mm_div_ps(a.value, b.value); }
+	inline SSEFloat operator>(SSEFloat a, SSEFloat b) { return _mm_cmpgt_ps(a.value, b.value); }
+	inline SSEFloat min(SSEFloat a, SSEFloat b) { return _mm_min_ps(a.value, b.value); }
+	inline SSEFloat max(SSEFloat a, SSEFloat b) { return _mm_max_ps(a.value, b.value); }
+	inline SSEFloat abs(SSEFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.value); }
+
+	inline SSEFloat copySign(SSEFloat magnitude, SSEFloat sign)
+	{
+		const auto signMask = _mm_set1_ps(-0.0f);
+		return _mm_or_ps(_mm_andnot_ps(signMask, magnitude.value), _mm_and_ps(signMask, sign.value));
+	}
+
+	// condition is the all ones or all zeros result of a comparison.
+	inline SSEFloat select(SSEFloat condition, SSEFloat a, SSEFloat b)
+	{
+		return _mm_or_ps(_mm_and_ps(condition.value, a.value), _mm_andnot_ps(condition.value, b.value));
+	}
+
+	// Rounds to nearest, as the conversion follows the default MXCSR rounding mode.
+	inline SSEFloat roundToWhole(SSEFloat a)
+	{
+		return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.value));
+	}
+
+	inline SSEFloat scaleByPowerOfTwo(SSEFloat a, SSEFloat n)
+	{
+		const auto exponent = _mm_add_epi32(_mm_cvtps_epi32(n.value), _mm_set1_epi32(127));
+		return _mm_mul_ps(a.value, _mm_castsi128_ps(_mm_slli_epi32(exponent, 23)));
+	}
+#endif
+
+	// Loads and stores for code written once for float and the registers.
+	template <typename Float>
+	Float load(const float* source) { return Float::load(source); }
+
+	template <>
+	inline float load<float>(const float* source) { return *source; }
+
+	template <typename Float>
+	void store(Float value, float* destination) { value.store(destination); }
+
+	template <>
+	inline void store<float>(float value, float* destination) { *destination = value; }
+
+	template <typename Float>
+	Float clamp(Float x, Float lower, Float upper)
+	{
+		return FastMath::min(FastMath::max(x, lower), upper);
+	}
+
+	// Error below 3e-7 relative to the result for x in [-87, 88]. Inputs outside
+	// that are clamped to it, so the result is never zero, infinite or denormal.
+	template <typename Float>
+	Float exp(Float x)
+	{
+		x = FastMath::clamp<Float>(x, -87.0f, 88.0f);
+
+		// x = n * ln2 + f with n whole and |f| <= ln2 / 2. ln2 is split in two so
+		// that f keeps its precision when n is large.
+		const Float n = FastMath::roundToWhole(x * 1.44269504f);
+		const Float f = (x - n * 0.693145752f) - n * 1.42860677e-6f;
+
+		// Taylor series of e^f.
+		const Float p = 1.0f + f * (1.0f + f * (1.0f / 2.0f + f * (1.0f / 6.0f + f * (1.0f / 24.0f + f * (1.0f / 120.0f + f * (1.0f / 720.0f))))));
+
+		return FastMath::scaleByPowerOfTwo(p, n);
+	}
+
+	// Error below 2e-7.
+	template <typename Float>
+	Float tanh(Float x)
+	{
+		// tanh saturates to 1 in single precision well before 9.
+		const Float e = FastMath::exp<Float>(2.0f * FastMath::clamp<Float>(x, -9.0f, 9.0f));
+		return (e - 1.0f) / (e + 1.0f);
+	}
+
+	// Error below 2e-7.
+	template <typename Float>
+	Float atan(Float x)
+	{
+		// Reduce |x| to [-tan(pi / 8), tan(pi / 8)] around 0, pi / 4 or pi / 2.
+		const Float a = FastMath::abs(x);
+		const auto isAboveThreeEighths = a > Float(2.41421356f);
+		const auto isAboveOneEighth = a > Float(0.414213562f);
+
+		const Float reciprocal = -1.0f / FastMath::max(a, Float(1.0f));
+		const Float shifted = (a - 1.0f) / (a + 1.0f);
+		const Float r = FastMath::select(isAboveThreeEighths, reciprocal, FastMath::select(isAboveOneEighth, shifted, a));
+		const Float offset = FastMath::select(isAboveThreeEighths, Float(1.57079633f), FastMath::select(isAboveOneEighth, Float(0.785398163f), Float(0.0f)));
+
+		const Float z = r * r;
+		const Float p = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * r + r;
+
+		return FastMath::copySign(offset + p, x);
+	}
+
+	// For |x| < pi / 2, with error below 3e-7 relative to the result.
+	template <typename Float>
+	Float tan(Float x)
+	{
+		// Reduce |x| to [0, pi / 4], using tan(x) = 1 / tan(pi / 2 - x) above it.
+		// pi / 2 is split in two so that the difference keeps its precision.
+		const Float a = FastMath::abs(x);
+		const auto isAboveQuarter = a > Float(0.785398163f);
+		const Float r = FastMath::select(isAboveQuarter, (1.5703125f - a) + 4.83826794897e-4f, a);
+
+		const Float z = r * r;
+		const Float p = (((((9.38540185543e-3f * z + 3.11992232697e-3f) * z + 2.44301354525e-2f) * z
+			+ 5.34112807005e-2f) * z + 1.33387994085e-1f) * z + 3.33331568548e-1f) * z * r + r;
+
+		return FastMath::copySign(FastMath::select(isAboveQuarter, 1.0f / p, p), x);
+	}
+
+	// Applies shape, which takes and returns any of the float types above, to
+	// numSamples samples, four at a time where the build allows it.
+	// Input and output may be the same, but must not otherwise overlap.
+	template <typename Shape>
+	void applyToSamples(const float* input, float* output, size_t numSamples, Shape shape) noexcept
+	{
+		size_t sample = 0;
+
+#if SUPERTONAL_FAST_MATH_SSE2
+		for (; sample + SSEFloat::size <= numSamples; sample += SSEFloat::size)
+		{
+			shape(SSEFloat::load(input + sample)).store(output + sample);
+		}
+#endif
+
+		for (; sample < numSamples; ++sample)
+		{
+			output[sample] = shape(input[sample]);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+	The sizes of the containers processors allocate in prepare(), for the
+	memory each stage of the chain reports. Only the samples are counted, not
+	the few pointers and the padding around them.
+ */
+namespace MemoryUsage
+{
+	template <typename SampleType>
+	size_t getSizeInBytes(const juce::AudioBuffer<SampleType>& buffer)
+	{
+		return static_cast<size_t>(buffer.getNumChannels()) * static_cast<size_t>(buffer.getNumSamples()) * sizeof(SampleType);
+	}
+
+	template <typename ElementType>
+	size_t getSizeInBytes(const std::vector<ElementType>& vector)
+	{
+		return vector.capacity() * sizeof(ElementType);
+	}
+}
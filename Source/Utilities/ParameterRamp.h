@@ -0,0 +1,128 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+	A smoothed parameter that is stepped once per chunk of samples rather than
+	once per sample. advance() works out the chunk's values into a small
+	aligned ramp that every channel then reads, so all channels see the same
+	values. When the parameter is not moving, no ramp is written, and a kernel
+	can take getValue() for the whole chunk instead.
+
+	The target can be set from any thread and is picked up by the next
+	advance().
+ */
+template <typename SmoothingType = juce::ValueSmoothingTypes::Linear>
+class ParameterRamp
+{
+public:
+	// The most samples a single advance() covers.
+	static constexpr int maximumNumSamples = 64;
+
+	explicit ParameterRamp(float initialValue = 0.0f)
+		: mTargetValue(initialValue)
+	{
+		mSmoothedValue.setCurrentAndTargetValue(initialValue);
+		mValue = initialValue;
+	}
+
+	// Ramps across rampLengthInSeconds, starting from the current target.
+	void prepare(double sampleRate, double rampLengthInSeconds)
+	{
+		mSmoothedValue.reset(sampleRate, rampLengthInSeconds);
+		reset();
+	}
+
+	// Jumps to the target.
+	void reset()
+	{
+		mSmoothedValue.setCurrentAndTargetValue(mTargetValue.load());
+		mValue = mSmoothedValue.getCurrentValue();
+		mIsSmoothing = false;
+	}
+
+	// Any thread.
+	void setTargetValue(float newValue)
+	{
+		mTargetValue.store(newValue);
+	}
+
+	float getTargetValue() const
+	{
+		return mTargetValue.load();
+	}
+
+	// Steps the parameter on by numSamples, no more than maximumNumSamples.
+	void advance(int numSamples)
+	{
+		jassert(juce::isPositiveAndNotGreaterThan(numSamples, maximumNumSamples));
+		numSamples = juce::jlimit(0, maximumNumSamples, numSamples);
+
+		mSmoothedValue.setTargetValue(mTargetValue.load());
+		mIsSmoothing = mSmoothedValue.isSmoothing();
+
+		if (!mIsSmoothing)
+		{
+			mValue = mSmoothedValue.getCurrentValue();
+			return;
+		}
+
+		for (int sample = 0; sample < numSamples; ++sample)
+		{
+			mRamp[sample] = mSmoothedValue.getNextValue();
+		}
+
+		mValue = mSmoothedValue.getCurrentValue();
+	}
+
+	// Whether the values differ across the last advance(). When they don't,
+	// getValue() holds for every sample of it.
+	bool isSmoothing() const
+	{
+		return mIsSmoothing;
+	}
+
+	// The value at the end of the last advance().
+	float getValue() const
+	{
+		return mValue;
+	}
+
+	// The values of the last advance(), when it was smoothing.
+	const float* getRamp() const
+	{
+		return mRamp.data();
+	}
+
+	float operator[](int sample) const
+	{
+		return mIsSmoothing ? mRamp[sample] : mValue;
+	}
+
+private:
+	juce::SmoothedValue<float, SmoothingType> mSmoothedValue;
+	std::atomic<float> mTargetValue;
+	alignas(16) std::array<float, maximumNumSamples> mRamp{};
+	float mValue = 0.0f;
+	bool mIsSmoothing = false;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterRamp)
+};
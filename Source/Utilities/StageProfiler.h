@@ -0,0 +1,290 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+enum class ProfiledStage
+{
+	tuner,
+	noiseGate,
+	inputGain,
+	preCompressor,
+	graphicEqualiser,
+	tubeScreamer,
+	mouseDrive,
+	preamp,
+	amplifierEqualiser,
+	delay,
+	chorus,
+	phaser,
+	flanger,
+	bitcrusher,
+	reverb,
+	cabinet,
+	instrumentEqualiser,
+	instrumentCompressor,
+	limiter,
+	lofi,
+	outputGain,
+	oversampling,
+	total,
+	count
+};
+
+static inline juce::String getProfiledStageName(ProfiledStage stage)
+{
+	static const std::array<const char*, static_cast<size_t>(ProfiledStage::count)> names = {
+		"Tuner",
+		"Noise Gate",
+		"Input Gain",
+		"Pre Compressor",
+		"Graphic EQ",
+		"Tube Screamer",
+		"Mouse Drive",
+		"Preamp",
+		"Amp EQ",
+		"Delay",
+		"Chorus",
+		"Phaser",
+		"Flanger",
+		"Bit Crusher",
+		"Reverb",
+		"Cabinet",
+		"Instrument EQ",
+		"Instrument Compressor",
+		"Limiter",
+		"Lofi",
+		"Output Gain",
+		"Oversampling",
+		"Total"
+	};
+
+	return names[static_cast<size_t>(stage)];
+}
+
+/*
+	Block timings for each stage of processBlock. The audio thread is the only
+	writer and every field is a relaxed atomic, so the message thread can take a
+	snapshot at any time without locking; a snapshot may straddle a block, which
+	does not matter for a display. Timings are only taken while enabled, so the
+	cost when no editor is open is one relaxed load per stage.
+
+	Block times also go into a histogram of quarter-octave bins from 64 ns to
+	about 4 ms, which the 99th percentile is read from.
+ */
+class StageProfiler
+{
+public:
+	static constexpr int numStages = static_cast<int>(ProfiledStage::count);
+	static constexpr int numHistogramBins = 64;
+
+	struct StageStatistics
+	{
+		double minimumSeconds = 0.0;
+		double meanSeconds = 0.0;
+		double percentile99Seconds = 0.0;
+		double maximumSeconds = 0.0;
+		juce::uint32 numBlocks = 0;
+	};
+
+	struct Snapshot
+	{
+		std::array<StageStatistics, numStages> stages;
+		double deadlineSeconds = 0.0;
+	};
+
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(StageProfiler& profiler, ProfiledStage stage) :
+			mProfiler(profiler),
+			mStage(stage),
+			mStartTicks(profiler.isEnabled() ? juce::Time::getHighResolutionTicks() : 0)
+		{
+		}
+
+		~ScopedTimer()
+		{
+			if (mStartTicks != 0)
+			{
+				mProfiler.addBlockTime(mStage, juce::Time::getHighResolutionTicks() - mStartTicks);
+			}
+		}
+
+	private:
+		StageProfiler& mProfiler;
+		const ProfiledStage mStage;
+		const juce::int64 mStartTicks;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+	};
+
+	StageProfiler() :
+		mSecondsPerTick(1.0 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()))
+	{
+		clear();
+	}
+
+	// Message thread.
+	void setEnabled(bool newValue)
+	{
+		mIsEnabled.store(newValue, std::memory_order_relaxed);
+	}
+
+	bool isEnabled() const
+	{
+		return mIsEnabled.load(std::memory_order_relaxed);
+	}
+
+	// Audio thread, at the start of every block. Clears the statistics when the
+	// message thread asked for it.
+	void beginBlock(int numSamples, double sampleRate)
+	{
+		if (mIsClearRequested.exchange(false, std::memory_order_acquire))
+		{
+			clear();
+		}
+
+		if (sampleRate > 0.0)
+		{
+			mDeadlineSeconds.store(numSamples / sampleRate, std::memory_order_relaxed);
+		}
+	}
+
+	// Message thread. Takes the statistics gathered since the last call and starts
+	// a new window.
+	Snapshot takeSnapshot()
+	{
+		Snapshot snapshot;
+		snapshot.deadlineSeconds = mDeadlineSeconds.load(std::memory_order_relaxed);
+
+		for (int stageIndex = 0; stageIndex < numStages; ++stageIndex)
+		{
+			const auto& accumulator = mAccumulators[stageIndex];
+			auto& statistics = snapshot.stages[stageIndex];
+
+			statistics.numBlocks = accumulator.numBlocks.load(std::memory_order_relaxed);
+			if (statistics.numBlocks == 0)
+			{
+				continue;
+			}
+
+			statistics.minimumSeconds = accumulator.minimumTicks.load(std::memory_order_relaxed) * mSecondsPerTick;
+			statistics.maximumSeconds = accumulator.maximumTicks.load(std::memory_order_relaxed) * mSecondsPerTick;
+			statistics.meanSeconds = accumulator.totalTicks.load(std::memory_order_relaxed) * mSecondsPerTick / statistics.numBlocks;
+
+			const auto percentile99Count = static_cast<juce::uint32>(std::ceil(statistics.numBlocks * 0.99));
+			juce::uint32 cumulativeCount = 0;
+
+			for (int bin = 0; bin < numHistogramBins; ++bin)
+			{
+				cumulativeCount += accumulator.histogram[bin].load(std::memory_order_relaxed);
+				if (cumulativeCount >= percentile99Count)
+				{
+					statistics.percentile99Seconds = juce::jmin(getBinUpperEdgeSeconds(bin), statistics.maximumSeconds);
+					break;
+				}
+			}
+		}
+
+		mIsClearRequested.store(true, std::memory_order_release);
+		return snapshot;
+	}
+
+private:
+	struct Accumulator
+	{
+		std::atomic<juce::int64> minimumTicks;
+		std::atomic<juce::int64> maximumTicks;
+		std::atomic<juce::int64> totalTicks;
+		std::atomic<juce::uint32> numBlocks;
+		std::array<std::atomic<juce::uint32>, numHistogramBins> histogram;
+	};
+
+	std::array<Accumulator, numStages> mAccumulators;
+	std::atomic<bool> mIsEnabled{ false };
+	std::atomic<bool> mIsClearRequested{ false };
+	std::atomic<double> mDeadlineSeconds{ 0.0 };
+	const double mSecondsPerTick;
+
+	// Only ever called from the audio thread, or before it starts.
+	void clear()
+	{
+		for (auto& accumulator : mAccumulators)
+		{
+			accumulator.minimumTicks.store(std::numeric_limits<juce::int64>::max(), std::memory_order_relaxed);
+			accumulator.maximumTicks.store(0, std::memory_order_relaxed);
+			accumulator.totalTicks.store(0, std::memory_order_relaxed);
+			accumulator.numBlocks.store(0, std::memory_order_relaxed);
+
+			for (auto& count : accumulator.histogram)
+			{
+				count.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void addBlockTime(ProfiledStage stage, juce::int64 ticks)
+	{
+		auto& accumulator = mAccumulators[static_cast<size_t>(stage)];
+
+		if (ticks < accumulator.minimumTicks.load(std::memory_order_relaxed))
+		{
+			accumulator.minimumTicks.store(ticks, std::memory_order_relaxed);
+		}
+
+		if (ticks > accumulator.maximumTicks.load(std::memory_order_relaxed))
+		{
+			accumulator.maximumTicks.store(ticks, std::memory_order_relaxed);
+		}
+
+		accumulator.totalTicks.store(accumulator.totalTicks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+		accumulator.numBlocks.store(accumulator.numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		auto& count = accumulator.histogram[getHistogramBin(ticks * mSecondsPerTick)];
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	static constexpr double histogramLowestSeconds = 64.0e-9;
+	static constexpr double histogramBinsPerOctave = 4.0;
+
+	static int getHistogramBin(double seconds)
+	{
+		if (seconds <= histogramLowestSeconds)
+		{
+			return 0;
+		}
+
+		const auto bin = static_cast<int>(std::log2(seconds / histogramLowestSeconds) * histogramBinsPerOctave);
+		return juce::jmin(bin, numHistogramBins - 1);
+	}
+
+	static double getBinUpperEdgeSeconds(int bin)
+	{
+		if (bin == numHistogramBins - 1)
+		{
+			return std::numeric_limits<double>::max();
+		}
+
+		return histogramLowestSeconds * std::exp2((bin + 1) / histogramBinsPerOctave);
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StageProfiler)
+};
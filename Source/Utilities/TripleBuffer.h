@@ -0,0 +1,73 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+	Hands a value from one writer thread to one reader thread without locking or
+	allocating. The writer fills the back copy and publishes it by swapping it
+	with the middle one; the reader swaps the middle copy with its front one when
+	something new was published. Neither side ever waits for the other, and the
+	reader always sees a complete value.
+
+	T should be cheap to copy around in place, e.g. a fixed-size array, because
+	all three copies are allocated up front.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	// Writer thread. The back copy still holds whatever was written to it two
+	// publishes ago, so overwrite it completely.
+	T& getWriteBuffer()
+	{
+		return mBuffers[mBackIndex];
+	}
+
+	// Writer thread.
+	void publish()
+	{
+		mBackIndex = mMiddleIndex.exchange(mBackIndex | newDataFlag, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// Reader thread. Picks up the most recently published value, if there is one.
+	const T& read()
+	{
+		if ((mMiddleIndex.load(std::memory_order_relaxed) & newDataFlag) != 0)
+		{
+			mFrontIndex = mMiddleIndex.exchange(mFrontIndex, std::memory_order_acq_rel) & indexMask;
+		}
+
+		return mBuffers[mFrontIndex];
+	}
+
+private:
+	static constexpr int newDataFlag = 4;
+	static constexpr int indexMask = 3;
+
+	std::array<T, 3> mBuffers;
+	int mFrontIndex = 0;
+	std::atomic<int> mMiddleIndex{ 1 };
+	int mBackIndex = 2;
+
+	JUCE_DECLARE_NON_COPYABLE(TripleBuffer)
+};
@@ -0,0 +1,391 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <JuceHeader.h>
+#include <iostream>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+#include "ProcessorBenchmarks.h"
+
+namespace
+{
+	constexpr auto outputOption = "--output|-o";
+	constexpr auto filterOption = "--filter|-f";
+	constexpr auto blockSizesOption = "--block-sizes|-b";
+	constexpr auto sampleRatesOption = "--sample-rates|-r";
+	constexpr auto secondsOption = "--seconds|-s";
+	constexpr auto repetitionsOption = "--repetitions|-n";
+	constexpr auto toleranceOption = "--tolerance|-t";
+
+	constexpr auto defaultBlockSizes = "16,32,64,128,256,512,1024,2048,4096";
+	constexpr auto defaultSampleRates = "44100,48000,88200,96000,176400,192000";
+	constexpr double defaultSeconds = 0.25;
+	constexpr int defaultRepetitions = 5;
+	constexpr double defaultTolerancePercent = 10.0;
+
+	constexpr int numChannels = 2;
+	constexpr int resultsFormatVersion = 1;
+
+	// Reference cycles from the time stamp counter where there is one. Elsewhere
+	// cycles are estimated from the elapsed time and the nominal clock speed.
+	inline bool hasCycleCounter()
+	{
+#if JUCE_INTEL
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	inline juce::uint64 readCycleCounter()
+	{
+#if JUCE_INTEL
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	struct Measurement
+	{
+		double nanosecondsPerSample = 0.0;
+		double minimumNanosecondsPerSample = 0.0;
+		double cyclesPerSample = 0.0;
+		double maximumBlockNanoseconds = 0.0;
+	};
+
+	juce::Array<int> getIntegerListForOption(const juce::ArgumentList& arguments, juce::StringRef option, const juce::String& defaultValue)
+	{
+		const auto value = arguments.containsOption(option) ? arguments.getValueForOption(option) : defaultValue;
+
+		juce::Array<int> integers;
+		for (const auto& token : juce::StringArray::fromTokens(value, ",", {}))
+		{
+			if (!token.trim().containsOnly("0123456789") || token.getIntValue() <= 0)
+			{
+				juce::ConsoleApplication::fail("Invalid value for " + juce::String(option) + ": " + value);
+			}
+
+			integers.add(token.getIntValue());
+		}
+
+		return integers;
+	}
+
+	double getDoubleForOption(const juce::ArgumentList& arguments, juce::StringRef option, double defaultValue)
+	{
+		if (!arguments.containsOption(option))
+		{
+			return defaultValue;
+		}
+
+		const auto value = arguments.getValueForOption(option);
+		if (!value.containsOnly("0123456789.") || value.getDoubleValue() <= 0.0)
+		{
+			juce::ConsoleApplication::fail("Invalid value for " + juce::String(option) + ": " + value);
+		}
+
+		return value.getDoubleValue();
+	}
+
+	// A low E string with some noise on top, loud enough to drive every stage.
+	void fillInput(juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		juce::Random random(1);
+		const auto angleDelta = juce::MathConstants<double>::twoPi * 82.41 / sampleRate;
+
+		for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
+		{
+			const auto value = static_cast<float>(0.5 * std::sin(angleDelta * sample)) + 0.05f * (random.nextFloat() * 2.0f - 1.0f);
+			for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+			{
+				buffer.setSample(channel, sample, value);
+			}
+		}
+	}
+
+	Measurement measure(const ProcessorBenchmark& benchmark, ParameterSetting setting, double sampleRate, int blockSize, double seconds, int repetitions)
+	{
+		juce::dsp::ProcessSpec spec;
+		spec.sampleRate = sampleRate;
+		spec.maximumBlockSize = static_cast<juce::uint32>(blockSize);
+		spec.numChannels = numChannels;
+
+		const auto process = benchmark.create(spec, setting);
+
+		const auto numBlocks = juce::jmax(16, static_cast<int>(std::ceil(seconds * sampleRate / blockSize)));
+		juce::AudioBuffer<float> input(numChannels, blockSize * numBlocks);
+		juce::AudioBuffer<float> buffer(numChannels, blockSize);
+		fillInput(input, sampleRate);
+
+		juce::ScopedNoDenormals noDenormals;
+
+		const auto runBlock = [&](int block)
+		{
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				buffer.copyFrom(channel, 0, input, channel, block * blockSize, blockSize);
+			}
+
+			const auto startTicks = juce::Time::getHighResolutionTicks();
+			const auto startCycles = readCycleCounter();
+			process(buffer);
+			const auto endCycles = readCycleCounter();
+			const auto endTicks = juce::Time::getHighResolutionTicks();
+
+			return std::make_pair(endTicks - startTicks, endCycles - startCycles);
+		};
+
+		// One pass to settle parameter smoothing and fill delay lines.
+		for (int block = 0; block < numBlocks; ++block)
+		{
+			runBlock(block);
+		}
+
+		std::vector<double> nanosecondsPerSample;
+		std::vector<double> cyclesPerSample;
+		double maximumBlockNanoseconds = 0.0;
+
+		const auto nanosecondsPerTick = 1.0e9 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+		const auto totalSamples = static_cast<double>(numBlocks) * blockSize;
+
+		for (int repetition = 0; repetition < repetitions; ++repetition)
+		{
+			juce::int64 totalTicks = 0;
+			juce::uint64 totalCycles = 0;
+
+			for (int block = 0; block < numBlocks; ++block)
+			{
+				const auto [ticks, cycles] = runBlock(block);
+				totalTicks += ticks;
+				totalCycles += cycles;
+				maximumBlockNanoseconds = juce::jmax(maximumBlockNanoseconds, static_cast<double>(ticks) * nanosecondsPerTick);
+			}
+
+			nanosecondsPerSample.push_back(static_cast<double>(totalTicks) * nanosecondsPerTick / totalSamples);
+			cyclesPerSample.push_back(static_cast<double>(totalCycles) / totalSamples);
+		}
+
+		std::sort(nanosecondsPerSample.begin(), nanosecondsPerSample.end());
+		std::sort(cyclesPerSample.begin(), cyclesPerSample.end());
+
+		Measurement measurement;
+		measurement.nanosecondsPerSample = nanosecondsPerSample[nanosecondsPerSample.size() / 2];
+		measurement.minimumNanosecondsPerSample = nanosecondsPerSample.front();
+		measurement.maximumBlockNanoseconds = maximumBlockNanoseconds;
+
+		if (hasCycleCounter())
+		{
+			measurement.cyclesPerSample = cyclesPerSample[cyclesPerSample.size() / 2];
+		}
+		else
+		{
+			measurement.cyclesPerSample = measurement.nanosecondsPerSample * juce::SystemStats::getCpuSpeedInMegahertz() * 1.0e-3;
+		}
+
+		return measurement;
+	}
+
+	juce::var createSystemInformation()
+	{
+		auto system = std::make_unique<juce::DynamicObject>();
+		system->setProperty("operatingSystem", juce::SystemStats::getOperatingSystemName());
+		system->setProperty("cpuVendor", juce::SystemStats::getCpuVendor());
+		system->setProperty("cpuModel", juce::SystemStats::getCpuModel());
+		system->setProperty("cpuSpeedMegahertz", juce::SystemStats::getCpuSpeedInMegahertz());
+		system->setProperty("numPhysicalCpus", juce::SystemStats::getNumPhysicalCpus());
+		system->setProperty("juceVersion", juce::SystemStats::getJUCEVersion());
+		system->setProperty("cyclesSource", hasCycleCounter() ? "tsc" : "estimated");
+#if JUCE_DEBUG
+		system->setProperty("configuration", "Debug");
+#else
+		system->setProperty("configuration", "Release");
+#endif
+		return system.release();
+	}
+
+	void run(const juce::ArgumentList& arguments)
+	{
+		const auto blockSizes = getIntegerListForOption(arguments, blockSizesOption, defaultBlockSizes);
+		const auto sampleRates = getIntegerListForOption(arguments, sampleRatesOption, defaultSampleRates);
+		const auto seconds = getDoubleForOption(arguments, secondsOption, defaultSeconds);
+		const auto repetitions = static_cast<int>(getDoubleForOption(arguments, repetitionsOption, defaultRepetitions));
+		const auto filter = arguments.containsOption(filterOption) ? arguments.getValueForOption(filterOption) : juce::String();
+
+		juce::Array<juce::var> results;
+
+		for (const auto& benchmark : createProcessorBenchmarks())
+		{
+			if (filter.isNotEmpty() && !benchmark.processorName.containsIgnoreCase(filter))
+			{
+				continue;
+			}
+
+			for (const auto setting : { ParameterSetting::minimum, ParameterSetting::standard, ParameterSetting::maximum })
+			{
+				for (const auto sampleRate : sampleRates)
+				{
+					for (const auto blockSize : blockSizes)
+					{
+						std::cerr << benchmark.processorName << " " << benchmark.variantName << " "
+							<< getParameterSettingName(setting) << " " << sampleRate << " Hz " << blockSize << " samples" << std::endl;
+
+						const auto measurement = measure(benchmark, setting, sampleRate, blockSize, seconds, repetitions);
+
+						auto result = std::make_unique<juce::DynamicObject>();
+						result->setProperty("processor", benchmark.processorName);
+						result->setProperty("variant", benchmark.variantName);
+						result->setProperty("setting", getParameterSettingName(setting));
+						result->setProperty("sampleRate", sampleRate);
+						result->setProperty("blockSize", blockSize);
+						result->setProperty("nsPerSample", measurement.nanosecondsPerSample);
+						result->setProperty("minNsPerSample", measurement.minimumNanosecondsPerSample);
+						result->setProperty("cyclesPerSample", measurement.cyclesPerSample);
+						result->setProperty("maxBlockNs", measurement.maximumBlockNanoseconds);
+						result->setProperty("deadlineShare", measurement.maximumBlockNanoseconds * 1.0e-9 * sampleRate / blockSize);
+						results.add(result.release());
+					}
+				}
+			}
+		}
+
+		auto root = std::make_unique<juce::DynamicObject>();
+		root->setProperty("version", resultsFormatVersion);
+		root->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+		root->setProperty("system", createSystemInformation());
+		root->setProperty("numChannels", numChannels);
+		root->setProperty("seconds", seconds);
+		root->setProperty("repetitions", repetitions);
+		root->setProperty("results", results);
+
+		const auto json = juce::JSON::toString(juce::var(root.release()));
+
+		if (arguments.containsOption(outputOption))
+		{
+			const auto outputFile = arguments.getFileForOption(outputOption);
+			if (!outputFile.replaceWithText(json))
+			{
+				juce::ConsoleApplication::fail("Could not write " + outputFile.getFullPathName());
+			}
+		}
+		else
+		{
+			std::cout << json << std::endl;
+		}
+	}
+
+	juce::String getResultKey(const juce::var& result)
+	{
+		return result["processor"].toString() + "/" + result["variant"].toString() + "/" + result["setting"].toString()
+			+ "/" + result["sampleRate"].toString() + "/" + result["blockSize"].toString();
+	}
+
+	juce::var readResults(const juce::File& file)
+	{
+		const auto json = juce::JSON::parse(file);
+		if (!json.isObject() || !json["results"].isArray())
+		{
+			juce::ConsoleApplication::fail(file.getFullPathName() + " is not a benchmark results file");
+		}
+
+		return json["results"];
+	}
+
+	// Exits with an error when any case present in both files got slower by more
+	// than the tolerance, so it can gate a build.
+	void compare(const juce::ArgumentList& arguments)
+	{
+		arguments.checkMinNumArguments(3);
+
+		const auto baselineResults = readResults(arguments[1].resolveAsExistingFile());
+		const auto currentResults = readResults(arguments[2].resolveAsExistingFile());
+		const auto tolerancePercent = getDoubleForOption(arguments, toleranceOption, defaultTolerancePercent);
+
+		std::map<juce::String, double> baselineNanosecondsPerSample;
+		for (const auto& result : *baselineResults.getArray())
+		{
+			baselineNanosecondsPerSample[getResultKey(result)] = result["nsPerSample"];
+		}
+
+		int numCompared = 0;
+		int numRegressions = 0;
+
+		for (const auto& result : *currentResults.getArray())
+		{
+			const auto baseline = baselineNanosecondsPerSample.find(getResultKey(result));
+			if (baseline == baselineNanosecondsPerSample.end() || baseline->second <= 0.0)
+			{
+				continue;
+			}
+
+			++numCompared;
+
+			const auto changePercent = (static_cast<double>(result["nsPerSample"]) / baseline->second - 1.0) * 100.0;
+			if (changePercent > tolerancePercent)
+			{
+				++numRegressions;
+				std::cout << getResultKey(result) << ": " << juce::String(baseline->second, 3) << " -> "
+					<< juce::String(static_cast<double>(result["nsPerSample"]), 3) << " ns/sample (+"
+					<< juce::String(changePercent, 1) << "%)" << std::endl;
+			}
+		}
+
+		std::cout << numRegressions << " of " << numCompared << " cases regressed by more than "
+			<< juce::String(tolerancePercent, 1) << "%" << std::endl;
+
+		if (numRegressions > 0)
+		{
+			juce::ConsoleApplication::fail({}, 1);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::ConsoleApplication consoleApplication;
+	consoleApplication.addHelpCommand("--help|-h", "Times each Supertonal processor on its own.", false);
+	consoleApplication.addCommand({
+		"--compare",
+		"--compare <baseline.json> <current.json> [--tolerance <percent>]",
+		"Lists the cases that got slower between two result files.",
+		"Cases are matched on processor, variant, setting, sample rate and block size. The command fails when any "
+		"of them got slower by more than the tolerance, which is 10% unless given.",
+		compare
+	});
+	consoleApplication.addDefaultCommand({
+		"",
+		"[--output <file>] [--filter <processor>] [--block-sizes <list>] [--sample-rates <list>] [--seconds <seconds>] [--repetitions <count>]",
+		"Runs every processor benchmark and writes the results as JSON.",
+		"Each processor is prepared on its own for every combination of block size and sample rate, at the minimum, "
+		"default and maximum of its parameter ranges. The reported time is the median of the repetitions, each of which "
+		"processes --seconds of a stereo test signal. Results go to standard output unless --output is given; progress "
+		"goes to standard error.",
+		run
+	});
+
+	return consoleApplication.findAndRunCommand(argc, argv);
+}
@@ -0,0 +1,473 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "BinaryData.h"
+#include "../../../Source/PluginAudioParameters.h"
+#include "../../../Source/Processors/Saturators/MouseDrive.h"
+#include "../../../Source/Processors/Saturators/TubeScreamer.h"
+#include "../../../Source/Processors/Saturators/Preamp.h"
+#include "../../../Source/Processors/Equilisers/GraphicEqualiser.h"
+#include "../../../Source/Processors/Equilisers/AmplifierEqualiser.h"
+#include "../../../Source/Processors/Equilisers/InstrumentEqualiser.h"
+#include "../../../Source/Processors/CTAGDRC/dsp/include/Compressor.h"
+#include "../../../Source/Processors/Other/Bitcrusher.h"
+#include "../../../Source/Processors/Modulators/Phaser.h"
+#include "../../../Source/Processors/Modulators/Chorus.h"
+#include "../../../Source/Processors/Modulators/Flanger.h"
+#include "../../../Source/Processors/Convolution/LinearStageFolder.h"
+#include "../../../Source/Processors/Delays/StereoDelay.h"
+
+enum class ParameterSetting
+{
+	minimum,
+	standard,
+	maximum
+};
+
+static inline juce::String getParameterSettingName(ParameterSetting setting)
+{
+	switch (setting)
+	{
+	case ParameterSetting::minimum:
+		return "minimum";
+	case ParameterSetting::maximum:
+		return "maximum";
+	default:
+		return "default";
+	}
+}
+
+static inline float getValueForSetting(const juce::NormalisableRange<float>& range, float defaultValue, ParameterSetting setting)
+{
+	switch (setting)
+	{
+	case ParameterSetting::minimum:
+		return range.start;
+	case ParameterSetting::maximum:
+		return range.end;
+	default:
+		return defaultValue;
+	}
+}
+
+/*
+	One processor class in one configuration. create() builds and prepares a fresh
+	instance for the given spec and settings, and returns the per-block call that
+	is timed; the closure owns the instance.
+ */
+struct ProcessorBenchmark
+{
+	using ProcessFunction = std::function<void(juce::AudioBuffer<float>&)>;
+
+	juce::String processorName;
+	juce::String variantName;
+	std::function<ProcessFunction(juce::dsp::ProcessSpec&, ParameterSetting)> create;
+};
+
+// The amplifier's gain stages with the first numStagesOn of them enabled. The
+// curve shaper uses the default curve.
+class PreampStages
+{
+public:
+	PreampStages(int numStagesOn, WaveShaper::Function function, WaveShaper::Antialiasing antialiasing) :
+		mCurveTable(WaveShaperCurve::getDefault()),
+		mNumStagesOn(numStagesOn)
+	{
+		mPreamp.setCurveTable(&mCurveTable);
+
+		for (int stageIndex = 0; stageIndex < mNumStagesOn; ++stageIndex)
+		{
+			mPreamp.setStageIsOn(stageIndex, true);
+			mPreamp.setStageWaveShaperFunction(stageIndex, function);
+			mPreamp.setStageAntialiasing(stageIndex, antialiasing);
+		}
+	}
+
+	void prepare(juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		mPreamp.prepare(spec);
+
+		const auto gainDecibels = getValueForSetting(apvts::gainDecibelsNormalisableRange, apvts::gainDeciblesDefaultValue, setting);
+
+		for (int stageIndex = 0; stageIndex < mNumStagesOn; ++stageIndex)
+		{
+			mPreamp.setStageInputGainDecibels(stageIndex, gainDecibels);
+			mPreamp.setStageOutputGainDecibels(stageIndex, -gainDecibels);
+			mPreamp.setStageMix(stageIndex, setting == ParameterSetting::minimum ? 0.0f : 1.0f);
+		}
+
+		// Starts at the settings rather than ramping to them.
+		mPreamp.reset();
+	}
+
+	void processBlock(juce::AudioBuffer<float>& buffer)
+	{
+		mPreamp.processBlock(buffer);
+	}
+
+private:
+	Preamp mPreamp;
+	WaveShaperTable mCurveTable;
+	int mNumStagesOn;
+};
+
+// Resampled to sampleRate and normalised, as the cabinet reads it.
+static inline std::shared_ptr<const ImpulseResponseCache::ImpulseResponse> getDefaultCabinetImpulseResponse(double sampleRate)
+{
+	juce::SharedResourcePointer<ImpulseResponseCache> impulseResponseCache;
+
+	ImpulseResponseSource source;
+	source.data = BinaryData::default_cab_wav;
+	source.dataSize = static_cast<size_t>(BinaryData::default_cab_wavSize);
+
+	auto impulseResponse = impulseResponseCache->getImpulseResponse(source, sampleRate);
+	jassert(impulseResponse != nullptr);
+	return impulseResponse;
+}
+
+static inline std::vector<ProcessorBenchmark> createProcessorBenchmarks()
+{
+	std::vector<ProcessorBenchmark> benchmarks;
+
+	benchmarks.push_back({ "TubeScreamer", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto tubeScreamer = std::make_shared<TubeScreamer>();
+		tubeScreamer->prepare(spec);
+		tubeScreamer->setDrive(getValueForSetting(TubeScreamer::driveNormalisableRange, TubeScreamer::driveDefaultValue, setting));
+		tubeScreamer->setLevel(getValueForSetting(TubeScreamer::levelNormalisableRange, TubeScreamer::levelDefaultValue, setting));
+		tubeScreamer->setTone(getValueForSetting(TubeScreamer::toneNormalisableRange, TubeScreamer::toneDefaultValue, setting));
+		tubeScreamer->setDiodeType(static_cast<int>(getValueForSetting(TubeScreamer::diodeTypeNormalisableRange, TubeScreamer::diodeTypeDefaultValue, setting)));
+		tubeScreamer->setDiodeCount(static_cast<int>(getValueForSetting(TubeScreamer::diodeCountNormalisableRange, TubeScreamer::diodeCountDefaultValue, setting)));
+		return ProcessorBenchmark::ProcessFunction([tubeScreamer](juce::AudioBuffer<float>& buffer) { tubeScreamer->processBlock(buffer); });
+	} });
+
+	benchmarks.push_back({ "MouseDrive", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto mouseDrive = std::make_shared<MouseDrive>();
+		mouseDrive->prepare(spec);
+		mouseDrive->setDistortion(getValueForSetting(MouseDrive::distortionNormalisableRange, MouseDrive::distortionDefaultValue, setting));
+		mouseDrive->setVolume(getValueForSetting(MouseDrive::volumeNormalisableRange, MouseDrive::volumeDefaultValue, setting));
+		mouseDrive->setFilter(getValueForSetting(MouseDrive::filterNormalisableRange, MouseDrive::filterDefaultValue, setting));
+		return ProcessorBenchmark::ProcessFunction([mouseDrive](juce::AudioBuffer<float>& buffer) { mouseDrive->processBlock(buffer); });
+	} });
+
+	benchmarks.push_back({ "GraphicEqualiser", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto graphicEqualiser = std::make_shared<GraphicEqualiser>();
+		graphicEqualiser->prepare(spec);
+		for (int index = 0; index <= static_cast<int>(GraphicEqualiser::sFrequencies.size()); ++index)
+		{
+			graphicEqualiser->setGainDecibelsAtIndex(getValueForSetting(GraphicEqualiser::sDecibelGainNormalisableRange, apvts::defaultValueOff, setting), index);
+		}
+		return ProcessorBenchmark::ProcessFunction([graphicEqualiser](juce::AudioBuffer<float>& buffer) { graphicEqualiser->processBlock(buffer); });
+	} });
+
+	benchmarks.push_back({ "AmplifierEqualiser", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto amplifierEqualiser = std::make_shared<AmplifierEqualiser>();
+		amplifierEqualiser->prepare(spec);
+		const auto decibels = getValueForSetting(AmplifierEqualiser::sDecibelsNormalisableRange, apvts::defaultValueOff, setting);
+		amplifierEqualiser->setResonanceDecibels(decibels);
+		amplifierEqualiser->setBassDecibels(decibels);
+		amplifierEqualiser->setMiddleDecibels(decibels);
+		amplifierEqualiser->setTrebleDecibels(decibels);
+		amplifierEqualiser->setPresenceDecibels(decibels);
+		return ProcessorBenchmark::ProcessFunction([amplifierEqualiser](juce::AudioBuffer<float>& buffer) { amplifierEqualiser->processBlock(buffer); });
+	} });
+
+	// Every band is switched off at the minimum, so that setting measures the
+	// cost of an idle equaliser.
+	benchmarks.push_back({ "InstrumentEqualiser", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto instrumentEqualiser = std::make_shared<InstrumentEqualiser>();
+		instrumentEqualiser->prepare(spec);
+		for (int index = 0; index < 6; ++index)
+		{
+			instrumentEqualiser->setOnAtIndex(setting != ParameterSetting::minimum, index);
+			instrumentEqualiser->setGainAtIndex(getValueForSetting(InstrumentEqualiser::sDecibelsNormalisableRange, apvts::defaultValueOff, setting), index);
+			instrumentEqualiser->setQualityAtIndex(getValueForSetting(InstrumentEqualiser::sQualityNormalisableRange, apvts::qualityOnDefaultValue, setting), index);
+		}
+		return ProcessorBenchmark::ProcessFunction([instrumentEqualiser](juce::AudioBuffer<float>& buffer) { instrumentEqualiser->processBlock(buffer); });
+	} });
+
+	// The threshold range runs the other way round, so that the maximum
+	// setting is the one doing the most gain reduction.
+	benchmarks.push_back({ "Compressor", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		const auto isMaximum = setting == ParameterSetting::maximum;
+		const auto threshold = setting == ParameterSetting::minimum
+			? apvts::Ctagdrc::thresholdEnd
+			: (isMaximum ? apvts::Ctagdrc::thresholdStart : -20.0f);
+
+		auto compressor = std::make_shared<Compressor>();
+		compressor->prepare(spec);
+		compressor->setPower(false);
+		compressor->setLookahead(isMaximum);
+		compressor->setAutoAttack(isMaximum);
+		compressor->setAutoRelease(isMaximum);
+		compressor->setAutoMakeup(isMaximum);
+		compressor->setThreshold(threshold);
+		compressor->setRatio(getValueForSetting({ apvts::Ctagdrc::ratioStart, apvts::Ctagdrc::ratioEnd }, apvts::Ctagdrc::ratioDefault, setting));
+		compressor->setKnee(getValueForSetting({ apvts::Ctagdrc::kneeStart, apvts::Ctagdrc::kneeEnd }, 6.0f, setting));
+		compressor->setAttack(getValueForSetting({ apvts::Ctagdrc::attackStart, apvts::Ctagdrc::attackEnd }, apvts::Ctagdrc::attackDefault, setting));
+		compressor->setRelease(getValueForSetting({ apvts::Ctagdrc::releaseStart, apvts::Ctagdrc::releaseEnd }, apvts::Ctagdrc::releaseDefault, setting));
+		compressor->setMix(getValueForSetting({ apvts::Ctagdrc::mixStart, apvts::Ctagdrc::mixEnd }, apvts::Ctagdrc::mixEnd, setting));
+		return ProcessorBenchmark::ProcessFunction([compressor](juce::AudioBuffer<float>& buffer) { compressor->process(buffer); });
+	} });
+
+	// One voice is the chorus as it has always sounded; more fill the SIMD lanes
+	// the one voice leaves empty.
+	for (const auto numVoices : { 1, 4, Chorus::maximumNumVoices })
+	{
+		benchmarks.push_back({ "Chorus", juce::String(numVoices) + (numVoices == 1 ? " voice" : " voices"), [numVoices](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+		{
+			auto chorus = std::make_shared<Chorus>();
+			chorus->prepare(spec);
+			chorus->setBypassed(false);
+			chorus->setNumVoices(numVoices);
+			chorus->setDelay(getValueForSetting(Chorus::delayNormalisableRange, Chorus::delayDefaultValue, setting));
+			chorus->setWidth(getValueForSetting(Chorus::widthNormalisableRange, Chorus::widthDefaultValue, setting));
+			chorus->setDepth(getValueForSetting(Chorus::depthNormalisableRange, Chorus::depthDefaultValue, setting));
+			chorus->setFrequency(getValueForSetting(Chorus::lfoFrequencyNormalisableRange, Chorus::frequencyDefaultValue, setting));
+			return ProcessorBenchmark::ProcessFunction([chorus](juce::AudioBuffer<float>& buffer) { chorus->process(buffer); });
+		} });
+	}
+
+	// Two stages is the phaser as it has always sounded; twelve is a deep one.
+	for (const auto numStages : { 2, 12, Phaser::maximumNumStages })
+	{
+		benchmarks.push_back({ "Phaser", juce::String(numStages) + " stages", [numStages](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+		{
+			auto phaser = std::make_shared<Phaser>();
+			phaser->prepare(spec);
+			phaser->setBypassed(false);
+			phaser->setNumStages(numStages);
+			phaser->setDepth(getValueForSetting(Phaser::depthNormalisableRange, Phaser::depthDefaultValue, setting));
+			phaser->setFeedback(getValueForSetting(Phaser::feedbackNormalisableRange, Phaser::feedbackDefaultValue, setting));
+			phaser->setWidth(getValueForSetting(Phaser::widthNormalisableRange, Phaser::widthDefaultValue, setting));
+			phaser->setFrequency(getValueForSetting(Phaser::frequencyNormalisableRange, Phaser::frequencyDefaultValue, setting));
+			phaser->setMinimumFrequency(getValueForSetting(Phaser::minimumFrequencyNormalisableRange, Phaser::minimumFrequencyDefaultValue, setting));
+			phaser->setStereo(setting == ParameterSetting::maximum);
+			return ProcessorBenchmark::ProcessFunction([phaser](juce::AudioBuffer<float>& buffer) { phaser->process(buffer); });
+		} });
+	}
+
+	benchmarks.push_back({ "Flanger", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto flanger = std::make_shared<Flanger>();
+		flanger->prepare(spec);
+		flanger->setBypassed(false);
+		flanger->setDelay(getValueForSetting(Flanger::delayNormalisableRange, Flanger::delayDefaultValue, setting));
+		flanger->setWidth(getValueForSetting(Flanger::widthNormalisableRange, Flanger::widthDefaultValue, setting));
+		flanger->setDepth(getValueForSetting(Flanger::depthNormalisableRange, Flanger::depthDefaultValue, setting));
+		flanger->setFeedback(getValueForSetting(Flanger::feedbackNormalisableRange, Flanger::feedbackDefaultValue, setting));
+		flanger->setFrequency(getValueForSetting(Flanger::frequencyNormalisableRange, Flanger::frequencyDefaultValue, setting));
+		return ProcessorBenchmark::ProcessFunction([flanger](juce::AudioBuffer<float>& buffer) { flanger->process(buffer); });
+	} });
+
+	benchmarks.push_back({ "Bitcrusher", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto bitcrusher = std::make_shared<Bitcrusher>();
+		bitcrusher->prepare(spec);
+		bitcrusher->setIsBypassed(false);
+		bitcrusher->setTargetSampleRate(getValueForSetting(Bitcrusher::sampleRateNormalisableRange, Bitcrusher::sampleRateDefaultValue, setting));
+		bitcrusher->setBitDepth(getValueForSetting(Bitcrusher::bitDepthNormalisableRange, Bitcrusher::bitDepthDefaultValue, setting));
+		return ProcessorBenchmark::ProcessFunction([bitcrusher](juce::AudioBuffer<float>& buffer) { bitcrusher->process(buffer); });
+	} });
+
+	benchmarks.push_back({ "StereoDelay", {}, [](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+	{
+		auto delay = std::make_shared<StereoDelay>();
+		delay->prepare(spec, static_cast<int>(std::ceil(apvts::delayTimeMsMaximumValue * spec.sampleRate / 1000)));
+		const auto delayInSamples = static_cast<float>(getValueForSetting(apvts::delayTimeMsNormalisableRange, apvts::delayTimeMsDefaultValue, setting) * spec.sampleRate / 1000);
+		delay->setDelay(0, delayInSamples);
+		delay->setDelay(1, delayInSamples * 0.75f);
+		delay->setFeedback(apvts::defaultValueQuarter);
+		delay->setCrossFeed(apvts::defaultValueQuarter);
+		return ProcessorBenchmark::ProcessFunction([delay](juce::AudioBuffer<float>& buffer) { delay->processBlock(buffer); });
+	} });
+
+	// The cabinet path as PluginAudioProcessor runs it. The settings have no
+	// parameters to change here, so only the default one is worth measuring, and
+	// the variants are the bundled impulse responses, alone, with the lofi
+	// cabinet folded into the same kernel, and blended as three microphones,
+	// levelled, inverted and delayed against each other.
+	const auto createMicrophone = [](const char* data, int dataSize, float gainDecibels, bool isPolarityInverted, float delayInMilliseconds)
+	{
+		LinearStageFolder::Microphone microphone;
+		microphone.source.data = data;
+		microphone.source.dataSize = static_cast<size_t>(dataSize);
+		microphone.gainDecibels = gainDecibels;
+		microphone.isPolarityInverted = isPolarityInverted;
+		microphone.delayInMilliseconds = delayInMilliseconds;
+		return microphone;
+	};
+
+	const auto defaultMicrophone = createMicrophone(BinaryData::default_cab_wav, BinaryData::default_cab_wavSize, 0.0f, false, 0.0f);
+	const auto croyMicrophone = createMicrophone(BinaryData::croy_cab_wav, BinaryData::croy_cab_wavSize, 0.0f, false, 0.0f);
+
+	const std::array<std::tuple<juce::String, std::vector<LinearStageFolder::Microphone>, bool>, 4> cabinets = { {
+		{ "default", { defaultMicrophone }, false },
+		{ "croy", { croyMicrophone }, false },
+		{ "default+lofi", { defaultMicrophone }, true },
+		{ "3 microphones", {
+			defaultMicrophone,
+			createMicrophone(BinaryData::croy_cab_wav, BinaryData::croy_cab_wavSize, -6.0f, false, 0.35f),
+			createMicrophone(BinaryData::default_cab_wav, BinaryData::default_cab_wavSize, -12.0f, true, 1.5f) }, false },
+	} };
+
+	for (const auto& [cabinetName, microphones, isLofiFolded] : cabinets)
+	{
+		benchmarks.push_back({ "CabinetConvolution", cabinetName, [microphones = microphones, isLofiFolded = isLofiFolded](juce::dsp::ProcessSpec& spec, ParameterSetting)
+		{
+			auto folder = std::make_shared<LinearStageFolder>();
+			folder->prepare(spec);
+
+			LinearStageFolder::Settings settings;
+			settings.microphones = microphones;
+
+			if (isLofiFolded)
+			{
+				settings.lofi.data = BinaryData::lofi_cab_wav;
+				settings.lofi.dataSize = static_cast<size_t>(BinaryData::lofi_cab_wavSize);
+			}
+
+			folder->fold(std::move(settings));
+
+			// The kernel is folded on a background thread and taken over from
+			// processBlock(), so silence is pushed through until it is in place.
+			juce::AudioBuffer<float> silence(static_cast<int>(spec.numChannels), static_cast<int>(spec.maximumBlockSize));
+			const auto startMilliseconds = juce::Time::getMillisecondCounter();
+
+			while (folder->getImpulseResponseSize() <= 1 && juce::Time::getMillisecondCounter() - startMilliseconds < 10000)
+			{
+				silence.clear();
+				folder->beginBlock();
+				folder->processBlock(silence);
+				juce::Thread::sleep(1);
+			}
+
+			folder->reset();
+
+			return ProcessorBenchmark::ProcessFunction([folder](juce::AudioBuffer<float>& buffer)
+			{
+				folder->beginBlock();
+				folder->processBlock(buffer);
+			});
+		} });
+	}
+
+	// The cabinet's convolution engine against juce::dsp::Convolution, as the
+	// plugin used it before, on the same impulse response. Both are given the
+	// default cabinet as the cache reads it, and neither has anything folded in,
+	// so only the engines differ. Run with --block-sizes 16,32,64,128,256,512,1024
+	// for the sizes hosts use.
+	benchmarks.push_back({ "ConvolutionEngine", "hybrid partitioned", [](juce::dsp::ProcessSpec& spec, ParameterSetting)
+	{
+		const auto impulseResponse = getDefaultCabinetImpulseResponse(spec.sampleRate);
+		const auto length = impulseResponse->buffer.getNumSamples();
+
+		auto convolution = std::make_shared<PartitionedConvolution>();
+		convolution->prepare(spec, length);
+		convolution->setKernel(PartitionedConvolution::createKernel(impulseResponse->buffer, convolution->getPartitionSize(), length, 0));
+
+		// The kernel is taken over by the first block, and reset() ends the
+		// crossfade to it.
+		juce::AudioBuffer<float> silence(static_cast<int>(spec.numChannels), static_cast<int>(spec.maximumBlockSize));
+		silence.clear();
+		convolution->process(silence);
+		convolution->reset();
+
+		return ProcessorBenchmark::ProcessFunction([convolution](juce::AudioBuffer<float>& buffer) { convolution->process(buffer); });
+	} });
+
+	benchmarks.push_back({ "ConvolutionEngine", "juce::dsp::Convolution", [](juce::dsp::ProcessSpec& spec, ParameterSetting)
+	{
+		const auto impulseResponse = getDefaultCabinetImpulseResponse(spec.sampleRate);
+		juce::AudioBuffer<float> buffer(impulseResponse->buffer);
+
+		auto convolution = std::make_shared<juce::dsp::Convolution>(juce::dsp::Convolution::NonUniform{ 128 });
+		convolution->prepare(spec);
+		convolution->loadImpulseResponse(
+			std::move(buffer),
+			spec.sampleRate,
+			juce::dsp::Convolution::Stereo::yes,
+			juce::dsp::Convolution::Trim::no,
+			juce::dsp::Convolution::Normalise::no);
+
+		// Loaded on a background thread and swapped in from process(), so
+		// silence is pushed through until it is in place.
+		juce::AudioBuffer<float> silence(static_cast<int>(spec.numChannels), static_cast<int>(spec.maximumBlockSize));
+		const auto startMilliseconds = juce::Time::getMillisecondCounter();
+
+		while (convolution->getCurrentIRSize() <= 1 && juce::Time::getMillisecondCounter() - startMilliseconds < 10000)
+		{
+			silence.clear();
+			auto audioBlock = juce::dsp::AudioBlock<float>(silence);
+			convolution->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+			juce::Thread::sleep(1);
+		}
+
+		convolution->reset();
+
+		return ProcessorBenchmark::ProcessFunction([convolution](juce::AudioBuffer<float>& buffer)
+		{
+			auto audioBlock = juce::dsp::AudioBlock<float>(buffer);
+			convolution->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		});
+	} });
+
+	for (int waveShaperIndex = 0; waveShaperIndex < static_cast<int>(apvts::waveShaperIds.size()); ++waveShaperIndex)
+	{
+		for (int antialiasingIndex = 0; antialiasingIndex < static_cast<int>(apvts::antialiasingIds.size()); ++antialiasingIndex)
+		{
+			const auto function = static_cast<WaveShaper::Function>(waveShaperIndex);
+			const auto antialiasing = static_cast<WaveShaper::Antialiasing>(antialiasingIndex);
+
+			// The curve is never antialiased.
+			if (function == WaveShaper::Function::curve && antialiasing != WaveShaper::Antialiasing::none)
+			{
+				continue;
+			}
+
+			const auto variant = antialiasing == WaveShaper::Antialiasing::none
+				? apvts::waveShaperIds[waveShaperIndex]
+				: apvts::waveShaperIds[waveShaperIndex] + " " + apvts::antialiasingIds[antialiasingIndex];
+
+			benchmarks.push_back({ "WaveShaperStage", variant, [function, antialiasing](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+			{
+				auto stages = std::make_shared<PreampStages>(1, function, antialiasing);
+				stages->prepare(spec, setting);
+				return ProcessorBenchmark::ProcessFunction([stages](juce::AudioBuffer<float>& buffer) { stages->processBlock(buffer); });
+			} });
+
+			benchmarks.push_back({ "WaveShaperStages", variant, [function, antialiasing](juce::dsp::ProcessSpec& spec, ParameterSetting setting)
+			{
+				auto stages = std::make_shared<PreampStages>(Preamp::numStages, function, antialiasing);
+				stages->prepare(spec, setting);
+				return ProcessorBenchmark::ProcessFunction([stages](juce::AudioBuffer<float>& buffer) { stages->processBlock(buffer); });
+			} });
+		}
+	}
+
+	return benchmarks;
+}
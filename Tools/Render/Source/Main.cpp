@@ -0,0 +1,389 @@
+/*
+    This code is part of the Supertonal guitar effects multi-processor.
+    Copyright (C) 2023-2024  Paul Jones
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <JuceHeader.h>
+#include <iostream>
+
+#include "../../../Source/PluginAudioProcessor.h"
+
+namespace
+{
+	constexpr auto inputOption = "--input|-i";
+	constexpr auto outputOption = "--output|-o";
+	constexpr auto presetOption = "--preset|-p";
+	constexpr auto sampleRateOption = "--sample-rate|-r";
+	constexpr auto blockSizeOption = "--block-size|-b";
+	constexpr auto tailOption = "--tail|-t";
+	constexpr auto bpmOption = "--bpm";
+	constexpr auto compensateLatencyOption = "--compensate-latency";
+	constexpr auto budgetOption = "--budget";
+	constexpr auto partitionSizeOption = "--partition-size";
+
+	constexpr int defaultBlockSize = 512;
+	constexpr double defaultTailSeconds = 2.0;
+	constexpr double defaultBeatsPerMinute = 120.0;
+	constexpr double defaultFootprintSampleRate = 48000.0;
+
+	// processBlock reads the tempo from the play head, so the offline render
+	// supplies a fixed one that advances with the rendered position.
+	class FixedTempoPlayHead : public juce::AudioPlayHead
+	{
+	public:
+		explicit FixedTempoPlayHead(double beatsPerMinute) : mBeatsPerMinute(beatsPerMinute)
+		{
+		}
+
+		juce::Optional<PositionInfo> getPosition() const override
+		{
+			PositionInfo positionInfo;
+			positionInfo.setBpm(mBeatsPerMinute);
+			positionInfo.setTimeInSamples(mTimeInSamples);
+			positionInfo.setIsPlaying(true);
+			return positionInfo;
+		}
+
+		void advance(int numSamples)
+		{
+			mTimeInSamples += numSamples;
+		}
+
+	private:
+		const double mBeatsPerMinute;
+		juce::int64 mTimeInSamples = 0;
+	};
+
+	// A number greater than zero, or no less than zero when isZeroAllowed.
+	double getDoubleForOption(const juce::ArgumentList& arguments, juce::StringRef option, double defaultValue, bool isZeroAllowed = false)
+	{
+		if (!arguments.containsOption(option))
+		{
+			return defaultValue;
+		}
+
+		const auto value = arguments.getValueForOption(option);
+		if (!value.containsOnly("0123456789.")
+			|| !value.containsAnyOf("0123456789")
+			|| (!isZeroAllowed && value.getDoubleValue() <= 0.0))
+		{
+			juce::ConsoleApplication::fail("Invalid value for " + juce::String(option) + ": " + value);
+		}
+
+		return value.getDoubleValue();
+	}
+
+	// A whole number of samples greater than zero.
+	int getIntForOption(const juce::ArgumentList& arguments, juce::StringRef option, int defaultValue)
+	{
+		if (!arguments.containsOption(option))
+		{
+			return defaultValue;
+		}
+
+		const auto value = arguments.getValueForOption(option);
+		if (value.isEmpty() || value.length() > 9 || !value.containsOnly("0123456789") || value.getIntValue() <= 0)
+		{
+			juce::ConsoleApplication::fail("Invalid value for " + juce::String(option) + ": " + value);
+		}
+
+		return value.getIntValue();
+	}
+
+	// The processor renders offline at PartitionedConvolution::defaultPartitionSize
+	// unless another is given, so the same input always renders the same.
+	void setConvolutionPartitionSize(const juce::ArgumentList& arguments, PluginAudioProcessor& processor)
+	{
+		const auto partitionSize = getIntForOption(arguments, partitionSizeOption, PartitionedConvolution::defaultPartitionSize);
+		if (!juce::isPowerOfTwo(partitionSize)
+			|| partitionSize < PartitionedConvolution::minimumPartitionSize
+			|| partitionSize > PartitionedConvolution::maximumPartitionSize)
+		{
+			juce::ConsoleApplication::fail("The partition size must be a power of two from "
+				+ juce::String(PartitionedConvolution::minimumPartitionSize) + " to "
+				+ juce::String(PartitionedConvolution::maximumPartitionSize));
+		}
+
+		processor.setConvolutionPartitionSize(partitionSize);
+	}
+
+	// The convolution engines build their impulse responses on a background thread
+	// and only swap them in (with a short crossfade) from inside processBlock, so
+	// silence is pushed through until that has settled. Everything is reset
+	// afterwards, which keeps the render identical regardless of how long the
+	// load took. Returns false when the cabinet is switched on but never loaded.
+	bool waitForImpulseResponses(PluginAudioProcessor& processor, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer, double sampleRate)
+	{
+		constexpr juce::uint32 timeoutMilliseconds = 10000;
+		constexpr double crossfadeSeconds = 0.1;
+
+		const auto startMilliseconds = juce::Time::getMillisecondCounter();
+		const auto isCabinetOn = *processor.getAudioProcessorValueTreeState()
+			.getRawParameterValue(apvts::cabinetImpulseResponseConvolutionOnId) > 0.5f;
+
+		while (isCabinetOn && processor.getCabinetImpulseResponseSize() <= 1)
+		{
+			if (juce::Time::getMillisecondCounter() - startMilliseconds > timeoutMilliseconds)
+			{
+				return false;
+			}
+
+			buffer.clear();
+			processor.processBlock(buffer, midiBuffer);
+			juce::Thread::sleep(1);
+		}
+
+		const auto crossfadeBlocks = static_cast<int>(std::ceil(crossfadeSeconds * sampleRate / buffer.getNumSamples()));
+		for (int block = 0; block < crossfadeBlocks; ++block)
+		{
+			buffer.clear();
+			processor.processBlock(buffer, midiBuffer);
+		}
+
+		processor.reset();
+		return true;
+	}
+
+	void loadPresetIfGiven(const juce::ArgumentList& arguments, PluginAudioProcessor& processor)
+	{
+		if (arguments.containsOption(presetOption))
+		{
+			const auto presetFile = arguments.getExistingFileForOption(presetOption);
+			if (!processor.getPresetManager().loadPresetFile(presetFile))
+			{
+				juce::ConsoleApplication::fail("Could not load preset " + presetFile.getFullPathName());
+			}
+		}
+	}
+
+	void render(const juce::ArgumentList& arguments)
+	{
+		const auto inputFile = arguments.getExistingFileForOption(inputOption);
+		arguments.failIfOptionIsMissing(outputOption);
+		const auto outputFile = arguments.getFileForOption(outputOption);
+
+		juce::AudioFormatManager audioFormatManager;
+		audioFormatManager.registerBasicFormats();
+
+		std::unique_ptr<juce::AudioFormatReader> reader(audioFormatManager.createReaderFor(inputFile));
+		if (reader == nullptr)
+		{
+			juce::ConsoleApplication::fail("Could not open " + inputFile.getFullPathName() + " as an audio file");
+		}
+
+		const auto sourceSampleRate = reader->sampleRate;
+		const auto sourceLengthInSamples = reader->lengthInSamples;
+		const auto sourceNumChannels = static_cast<int>(reader->numChannels);
+
+		const auto sampleRate = getDoubleForOption(arguments, sampleRateOption, sourceSampleRate);
+		const auto blockSize = getIntForOption(arguments, blockSizeOption, defaultBlockSize);
+		const auto tailSeconds = getDoubleForOption(arguments, tailOption, defaultTailSeconds, true);
+		const auto beatsPerMinute = getDoubleForOption(arguments, bpmOption, defaultBeatsPerMinute);
+
+		PluginAudioProcessor processor;
+		const auto numChannels = processor.getTotalNumOutputChannels();
+
+		FixedTempoPlayHead playHead(beatsPerMinute);
+		processor.setPlayHead(&playHead);
+		processor.setNonRealtime(true);
+		setConvolutionPartitionSize(arguments, processor);
+		processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+		loadPresetIfGiven(arguments, processor);
+		processor.prepareToPlay(sampleRate, blockSize);
+
+		juce::AudioBuffer<float> processBuffer(numChannels, blockSize);
+		juce::AudioBuffer<float> sourceBuffer(sourceNumChannels, blockSize);
+		juce::MidiBuffer midiBuffer;
+
+		// The render would not be what the preset sounds like.
+		if (!waitForImpulseResponses(processor, processBuffer, midiBuffer, sampleRate))
+		{
+			juce::ConsoleApplication::fail("The cabinet impulse response did not load");
+		}
+
+		// The reader source pulls one block at a time from the file, so sessions of
+		// any length are streamed rather than loaded into memory.
+		juce::AudioFormatReaderSource readerSource(reader.release(), true);
+		std::unique_ptr<juce::ResamplingAudioSource> resamplingSource;
+		juce::AudioSource* source = &readerSource;
+
+		if (sourceSampleRate != sampleRate)
+		{
+			resamplingSource = std::make_unique<juce::ResamplingAudioSource>(&readerSource, false, sourceNumChannels);
+			resamplingSource->setResamplingRatio(sourceSampleRate / sampleRate);
+			source = resamplingSource.get();
+		}
+
+		source->prepareToPlay(blockSize, sampleRate);
+
+		const auto latencySamples = arguments.containsOption(compensateLatencyOption) ? processor.getLatencySamples() : 0;
+		const auto renderedLengthInSamples = static_cast<juce::int64>(std::ceil(sourceLengthInSamples * sampleRate / sourceSampleRate))
+			+ static_cast<juce::int64>(tailSeconds * sampleRate);
+		const auto totalLengthInSamples = renderedLengthInSamples + latencySamples;
+
+		outputFile.deleteFile();
+		auto outputStream = outputFile.createOutputStream();
+		if (outputStream == nullptr)
+		{
+			juce::ConsoleApplication::fail("Could not create " + outputFile.getFullPathName());
+		}
+
+		juce::WavAudioFormat wavAudioFormat;
+		std::unique_ptr<juce::AudioFormatWriter> writer(wavAudioFormat.createWriterFor(
+			outputStream.get(),
+			sampleRate,
+			static_cast<unsigned int>(numChannels),
+			32,
+			{},
+			0));
+
+		if (writer == nullptr)
+		{
+			juce::ConsoleApplication::fail("Could not create a WAV writer for " + outputFile.getFullPathName());
+		}
+
+		outputStream.release();
+
+		const auto startTicks = juce::Time::getHighResolutionTicks();
+
+		for (juce::int64 position = 0; position < totalLengthInSamples; position += blockSize)
+		{
+			const auto numSamples = static_cast<int>(std::min<juce::int64>(blockSize, totalLengthInSamples - position));
+
+			// Short final blocks are zero padded so every callback has the prepared size.
+			juce::AudioSourceChannelInfo channelInfo(&sourceBuffer, 0, blockSize);
+			source->getNextAudioBlock(channelInfo);
+			sourceBuffer.clear(numSamples, blockSize - numSamples);
+
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				processBuffer.copyFrom(channel, 0, sourceBuffer, std::min(channel, sourceNumChannels - 1), 0, blockSize);
+			}
+
+			processor.processBlock(processBuffer, midiBuffer);
+			playHead.advance(blockSize);
+
+			const auto skippedSamples = static_cast<int>(juce::jlimit<juce::int64>(0, numSamples, latencySamples - position));
+			if (skippedSamples < numSamples)
+			{
+				writer->writeFromAudioSampleBuffer(processBuffer, skippedSamples, numSamples - skippedSamples);
+			}
+		}
+
+		writer.reset();
+		processor.releaseResources();
+		processor.setPlayHead(nullptr);
+
+		const auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+		const auto renderedSeconds = static_cast<double>(renderedLengthInSamples) / sampleRate;
+
+		std::cout << "Rendered " << juce::String(renderedSeconds, 2) << " s to " << outputFile.getFullPathName()
+			<< " in " << juce::String(elapsedSeconds, 2) << " s ("
+			<< juce::String(renderedSeconds / juce::jmax(elapsedSeconds, 1.0e-9), 1) << "x real time)" << std::endl;
+	}
+
+	// Prepares the processor as a host would, lets the cabinet load, and reports
+	// the memory each slot of the chain holds. With a budget it fails when the
+	// total is over it, so a build can be held to a footprint.
+	void footprint(const juce::ArgumentList& arguments)
+	{
+		const auto sampleRate = getDoubleForOption(arguments, sampleRateOption, defaultFootprintSampleRate);
+		const auto blockSize = getIntForOption(arguments, blockSizeOption, defaultBlockSize);
+
+		PluginAudioProcessor processor;
+		const auto numChannels = processor.getTotalNumOutputChannels();
+
+		FixedTempoPlayHead playHead(defaultBeatsPerMinute);
+		processor.setPlayHead(&playHead);
+		processor.setNonRealtime(true);
+		setConvolutionPartitionSize(arguments, processor);
+		processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+		loadPresetIfGiven(arguments, processor);
+		processor.prepareToPlay(sampleRate, blockSize);
+
+		juce::AudioBuffer<float> processBuffer(numChannels, blockSize);
+		juce::MidiBuffer midiBuffer;
+
+		// The cabinet's kernel is most of the total, so without it neither the
+		// report nor the budget would mean anything.
+		if (!waitForImpulseResponses(processor, processBuffer, midiBuffer, sampleRate))
+		{
+			juce::ConsoleApplication::fail("The cabinet impulse response did not load, so the footprint cannot be measured");
+		}
+
+		const auto& effectChain = processor.getEffectChain();
+
+		for (const auto& key : effectChain.getKeys())
+		{
+			const auto bytes = effectChain.getMemoryUsageInBytes(key);
+			if (bytes > 0)
+			{
+				std::cout << effectChain.getName(key).paddedRight(' ', 24)
+					<< juce::File::descriptionOfSizeInBytes(static_cast<juce::int64>(bytes)) << std::endl;
+			}
+		}
+
+		const auto totalBytes = effectChain.getMemoryUsageInBytes();
+		std::cout << juce::String("Total").paddedRight(' ', 24)
+			<< juce::File::descriptionOfSizeInBytes(static_cast<juce::int64>(totalBytes))
+			<< " at " << juce::String(sampleRate, 0) << " Hz" << std::endl;
+
+		processor.releaseResources();
+		processor.setPlayHead(nullptr);
+
+		if (arguments.containsOption(budgetOption))
+		{
+			const auto budgetInBytes = getDoubleForOption(arguments, budgetOption, 0.0) * 1024.0 * 1024.0;
+			if (static_cast<double>(totalBytes) > budgetInBytes)
+			{
+				std::cerr << "The footprint is over the budget of "
+					<< juce::File::descriptionOfSizeInBytes(static_cast<juce::int64>(budgetInBytes)) << std::endl;
+				juce::ConsoleApplication::fail({}, 1);
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::ConsoleApplication consoleApplication;
+	consoleApplication.addHelpCommand("--help|-h", "Renders an audio file through the Supertonal processing chain.", false);
+	consoleApplication.addDefaultCommand({
+		"",
+		"--input <file> --output <file> [--preset <file>] [--sample-rate <hz>] [--block-size <samples>] [--tail <seconds>] [--bpm <bpm>] [--compensate-latency] [--partition-size <samples>]",
+		"Renders the input file through the processor and writes a 32-bit float WAV file.",
+		"The preset is an XML file as saved by the preset manager. The input is resampled when --sample-rate differs from "
+		"its own rate, and --tail seconds of silence are rendered after it so delay and reverb tails are kept. "
+		"--compensate-latency drops the samples the processor reports as latency so the output lines up with the input. "
+		"The convolutions run at --partition-size, a power of two from 64 to 2048 and 512 by default, rather than at "
+		"the fastest size timed on this machine, so a render is the same every time.",
+		render
+	});
+	consoleApplication.addCommand({
+		"--footprint",
+		"--footprint [--preset <file>] [--sample-rate <hz>] [--block-size <samples>] [--budget <MiB>] [--partition-size <samples>]",
+		"Reports the memory the processing chain holds once prepared.",
+		"Prepares the processor at --sample-rate, 48 kHz by default, with the preset's effects switched on, and prints "
+		"what each slot of the chain has allocated and the total. Only buffers the chain's own processors allocate are "
+		"counted. With --budget, exits with an error when the total is over that many MiB. Also exits with an error when "
+		"the cabinet is switched on but its impulse response does not load.",
+		footprint
+	});
+
+	return consoleApplication.findAndRunCommand(argc, argv);
+}